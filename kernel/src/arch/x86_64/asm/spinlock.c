@@ -1,56 +1,84 @@
 #include <common/spinlock.h>
 #include <process/preempt.h>
+#include <asm/cmpxchg.h>
+
+// 等待者每排在前面一个票号，就多执行这么多次pause再去读owner
+#define SPIN_BACKOFF_UNIT 32
+// 单次退避最多执行的pause次数
+#define SPIN_BACKOFF_MAX 1024
+
+/**
+ * @brief 领取票号，并等待轮到自己
+ *
+ * @param lock
+ */
+static __always_inline void __ticket_spin_lock(spinlock_t *lock)
+{
+    uint16_t ticket = 1;
+    // 原子地领取票号（next++），ticket中得到的是旧值
+    asm volatile("lock xaddw %0, %1   \n\t" : "+r"(ticket), "+m"(lock->tickets.next)::"memory");
+
+    while (1)
+    {
+        uint16_t owner = READ_ONCE(lock->tickets.owner);
+        if (owner == ticket)
+            break;
+        // 按照前面还有多少个等待者进行退避，减少对锁所在缓存行的争抢
+        uint32_t spins = (uint32_t)(uint16_t)(ticket - owner) * SPIN_BACKOFF_UNIT;
+        if (spins > SPIN_BACKOFF_MAX)
+            spins = SPIN_BACKOFF_MAX;
+        while (spins--)
+            asm volatile("pause   \n\t" ::: "memory");
+    }
+    barrier();
+}
+
+/**
+ * @brief 把锁交给下一个票号
+ *
+ * 只有持锁者会修改owner，因此不需要lock前缀；x86的写操作本身具有release语义
+ */
+static __always_inline void __ticket_spin_unlock(spinlock_t *lock)
+{
+    barrier();
+    asm volatile("incw %0   \n\t" : "+m"(lock->tickets.owner)::"memory");
+}
 
 void __arch_spin_lock(spinlock_t *lock)
 {
-    __asm__ __volatile__("1:    \n\t"
-                         "lock decb %0   \n\t" // 尝试-1
-                         "jns 3f    \n\t"      // 加锁成功，跳转到步骤3
-                         "2:    \n\t"          // 加锁失败，稍后再试
-                         "pause \n\t"
-                         "cmpb $0, %0   \n\t"
-                         "jle   2b  \n\t" // 若锁被占用，则继续重试
-                         "jmp 1b    \n\t" // 尝试加锁
-                         "3:"
-                         : "=m"(lock->lock)::"memory");
+    __ticket_spin_lock(lock);
     rs_preempt_disable();
 }
 
 void __arch_spin_unlock(spinlock_t *lock)
 {
-    __asm__ __volatile__("movb $1, %0   \n\t" : "=m"(lock->lock)::"memory");
+    __ticket_spin_unlock(lock);
     rs_preempt_enable();
 }
 
 void __arch_spin_lock_no_preempt(spinlock_t *lock)
 {
-    __asm__ __volatile__("1:    \n\t"
-                         "lock decb %0   \n\t" // 尝试-1
-                         "jns 3f    \n\t"      // 加锁成功，跳转到步骤3
-                         "2:    \n\t"          // 加锁失败，稍后再试
-                         "pause \n\t"
-                         "cmpb $0, %0   \n\t"
-                         "jle   2b  \n\t" // 若锁被占用，则继续重试
-                         "jmp 1b    \n\t" // 尝试加锁
-                         "3:"
-                         : "=m"(lock->lock)::"memory");
+    __ticket_spin_lock(lock);
 }
 
 void __arch_spin_unlock_no_preempt(spinlock_t *lock)
 {
-    __asm__ __volatile__("movb $1, %0   \n\t" : "=m"(lock->lock)::"memory");
+    __ticket_spin_unlock(lock);
 }
 
 long __arch_spin_trylock(spinlock_t *lock)
 {
-    uint64_t tmp_val = 0;
+    spinlock_t old, new;
     rs_preempt_disable();
-    // 交换tmp_val和lock的值，若tmp_val==1则证明加锁成功
-    asm volatile("lock xchg %%bx, %1  \n\t" // 确保只有1个进程能得到锁
-                 : "=q"(tmp_val), "=m"(lock->lock)
-                 : "b"(0)
-                 : "memory");
-    if (!tmp_val)
-        rs_preempt_enable();
-    return tmp_val;
+    old.val = READ_ONCE(lock->val);
+    // 仅当锁空闲（owner == next）时领取票号
+    if (old.tickets.owner == old.tickets.next)
+    {
+        new.val = old.val;
+        ++new.tickets.next;
+        if (arch_try_cmpxchg(&lock->val, &old.val, new.val))
+            return 1;
+    }
+    rs_preempt_enable();
+    return 0;
 }
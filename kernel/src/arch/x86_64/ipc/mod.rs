@@ -1,10 +1,14 @@
 use super::interrupt::TrapFrame;
 
-use crate::{arch::CurrentIrqArch, exception::InterruptArch};
+use crate::{arch::CurrentIrqArch, exception::InterruptArch, process::ProcessManager};
 
 #[no_mangle]
-pub unsafe extern "C" fn do_signal(_frame: &mut TrapFrame) {
+pub unsafe extern "C" fn do_signal(frame: &mut TrapFrame) {
     CurrentIrqArch::interrupt_enable();
+    if frame.from_user() {
+        // 线程组中的其他线程调用了exit_group，当前线程在返回用户态之前退出
+        ProcessManager::exit_if_group_exiting();
+    }
     // todo: 处理信号
     return;
 }
@@ -0,0 +1,65 @@
+//! 异常表
+//!
+//! 内核中可能因为访问用户空间而发生缺页的指令（例如用户空间拷贝函数中的`rep movsb`），
+//! 都会在`__ex_table`段中登记一项：发生异常的指令地址以及对应的修复代码的地址。
+//! 内核态发生缺页时，缺页处理函数在表中查找异常发生的地址，若找到，则把返回地址改为修复代码，
+//! 由修复代码向调用者返回错误，而不是杀死当前进程。
+
+use crate::arch::interrupt::TrapFrame;
+
+/// 异常表中的一项
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct ExceptionTableEntry {
+    /// 可能发生异常的指令的地址
+    pub insn: usize,
+    /// 发生异常后跳转到的修复代码的地址
+    pub fixup: usize,
+}
+
+extern "C" {
+    /// 由链接脚本定义，是`__ex_table`段的起始和结束地址
+    static __start___ex_table: ExceptionTableEntry;
+    static __stop___ex_table: ExceptionTableEntry;
+}
+
+/// @brief 获取内核的异常表
+fn exception_table() -> &'static [ExceptionTableEntry] {
+    unsafe {
+        let start = &__start___ex_table as *const ExceptionTableEntry;
+        let stop = &__stop___ex_table as *const ExceptionTableEntry;
+        let len = (stop as usize - start as usize) / core::mem::size_of::<ExceptionTableEntry>();
+        return core::slice::from_raw_parts(start, len);
+    }
+}
+
+/// @brief 在异常表中查找指令地址对应的修复代码地址
+///
+/// 异常表只包含用户空间访问函数中的少量指令，因此直接顺序查找
+pub fn search_exception_table(ip: usize) -> Option<usize> {
+    return exception_table()
+        .iter()
+        .find(|entry| entry.insn == ip)
+        .map(|entry| entry.fixup);
+}
+
+/// @brief 内核态发生异常时，尝试通过异常表修复
+///
+/// ## 参数
+///
+/// - `regs`：异常发生时保存的现场
+///
+/// ## 返回值
+///
+/// 找到了修复代码，并已经把返回地址设置为修复代码时返回1，否则返回0
+#[no_mangle]
+pub unsafe extern "C" fn rs_exception_fixup(regs: *mut TrapFrame) -> i32 {
+    let regs = &mut *regs;
+    match search_exception_table(regs.rip as usize) {
+        Some(fixup) => {
+            regs.rip = fixup as u64;
+            return 1;
+        }
+        None => return 0,
+    }
+}
@@ -1,4 +1,6 @@
 pub mod barrier;
+pub mod extable;
+pub mod usercopy;
 
 use alloc::vec::Vec;
 use hashbrown::HashSet;
@@ -306,6 +308,7 @@ pub fn mm_init() {
     }
 
     unsafe { X86_64MMArch::init() };
+    usercopy::usercopy_init();
     kdebug!("bootstrap info: {:?}", unsafe { BOOTSTRAP_MM_INFO });
     kdebug!("phys[0]=virt[0x{:x}]", unsafe {
         MMArch::phys_2_virt(PhysAddr::new(0)).unwrap().data()
@@ -535,7 +538,13 @@ impl FrameAllocator for LockedFrameAllocator {
     }
 
     unsafe fn usage(&self) -> crate::mm::allocator::page_frame::PageFrameUsage {
-        todo!()
+        if let Some(ref allocator) = *INNER_ALLOCATOR.lock_irqsave() {
+            return allocator.usage();
+        }
+        return crate::mm::allocator::page_frame::PageFrameUsage::new(
+            crate::mm::allocator::page_frame::PageFrameCount::new(0),
+            crate::mm::allocator::page_frame::PageFrameCount::new(0),
+        );
     }
 }
 
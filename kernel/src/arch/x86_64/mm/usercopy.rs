@@ -0,0 +1,266 @@
+//! 内核访问用户空间的底层拷贝函数
+//!
+//! 这些函数中所有访问用户空间的指令都登记在异常表（见extable.rs）中。
+//! 用户空间的页不存在时，缺页处理函数会跳转到修复代码，函数返回未能拷贝的字节数，
+//! 而不是杀死当前进程。
+//!
+//! - cpu支持ERMS（Enhanced REP MOVSB/STOSB）时，直接使用`rep movsb`/`rep stosb`，
+//!   否则先用`rep movsq`按8字节拷贝，再拷贝剩余的字节
+//! - 若CR4.SMAP已开启，访问用户空间前后分别执行`stac`/`clac`
+
+use core::{
+    arch::asm,
+    sync::atomic::{AtomicBool, Ordering},
+};
+
+use x86::{
+    controlregs::{cr4, Cr4},
+    cpuid::{cpuid, CpuIdResult},
+};
+
+/// cpu是否支持ERMS
+static USERCOPY_ERMS: AtomicBool = AtomicBool::new(false);
+/// 是否已经开启SMAP（开启后，访问用户空间前需要执行stac）
+static USERCOPY_SMAP: AtomicBool = AtomicBool::new(false);
+
+/// @brief 根据cpu的特性选择用户空间拷贝函数的实现
+pub fn usercopy_init() {
+    let max_leaf = cpuid!(0x0).eax;
+    if max_leaf < 0x7 {
+        return;
+    }
+    let res: CpuIdResult = cpuid!(0x7, 0x0);
+    // CPUID.(EAX=07H,ECX=0):EBX[bit 9] ERMS
+    USERCOPY_ERMS.store(res.ebx & (1 << 9) != 0, Ordering::SeqCst);
+    // CPUID.(EAX=07H,ECX=0):EBX[bit 20] SMAP
+    let smap = res.ebx & (1 << 20) != 0 && unsafe { cr4() }.contains(Cr4::CR4_ENABLE_SMAP);
+    USERCOPY_SMAP.store(smap, Ordering::SeqCst);
+}
+
+/// @brief 允许内核访问用户空间（SMAP开启时）
+#[inline(always)]
+fn user_access_begin() {
+    if USERCOPY_SMAP.load(Ordering::Relaxed) {
+        unsafe { asm!("stac", options(nomem, nostack)) };
+    }
+}
+
+/// @brief 禁止内核访问用户空间（SMAP开启时）
+#[inline(always)]
+fn user_access_end() {
+    if USERCOPY_SMAP.load(Ordering::Relaxed) {
+        unsafe { asm!("clac", options(nomem, nostack)) };
+    }
+}
+
+/// @brief 在内核与用户空间之间拷贝数据，访问到不存在的页时不会导致内核崩溃
+///
+/// ## 参数
+///
+/// - `dst`：目标地址
+/// - `src`：源地址
+/// - `len`：要拷贝的字节数
+///
+/// ## 返回值
+///
+/// 未能拷贝的字节数，全部拷贝成功时为0
+///
+/// ## Safety
+///
+/// 调用者需要保证地址范围已经通过verify_area的检查，且内核空间的一侧是有效的
+pub unsafe fn copy_user(dst: *mut u8, src: *const u8, len: usize) -> usize {
+    if len == 0 {
+        return 0;
+    }
+    user_access_begin();
+    let left = if USERCOPY_ERMS.load(Ordering::Relaxed) {
+        copy_user_erms(dst, src, len)
+    } else {
+        copy_user_movsq(dst, src, len)
+    };
+    user_access_end();
+    return left;
+}
+
+/// @brief 把用户空间的一段内存清零，访问到不存在的页时不会导致内核崩溃
+///
+/// ## 返回值
+///
+/// 未能清零的字节数，全部清零时为0
+///
+/// ## Safety
+///
+/// 调用者需要保证地址范围已经通过verify_area的检查
+pub unsafe fn clear_user_raw(dst: *mut u8, len: usize) -> usize {
+    if len == 0 {
+        return 0;
+    }
+    user_access_begin();
+    let left = clear_user_stosb(dst, len);
+    user_access_end();
+    return left;
+}
+
+/// @brief 从用户空间读取一个u32，访问到不存在的页时不会导致内核崩溃
+///
+/// 只使用一条对齐的`mov`指令读取，因此相对于其他cpu上的原子操作也是原子的。
+/// 这个函数不会睡眠，可以在持有自旋锁、关中断的情况下调用
+///
+/// ## 返回值
+///
+/// 读取到的值，访问失败时返回None
+///
+/// ## Safety
+///
+/// 调用者需要保证地址已经通过verify_area的检查，且4字节对齐
+pub unsafe fn get_user_u32(src: *const u32) -> Option<u32> {
+    let mut val: u32 = 0;
+    user_access_begin();
+    let err = get_user_u32_asm(src, &mut val);
+    user_access_end();
+    if err != 0 {
+        return None;
+    }
+    return Some(val);
+}
+
+/// @brief 对用户空间的一个u32执行`lock cmpxchg`：若它等于old，则替换为new
+///
+/// 这个函数不会睡眠，可以在持有自旋锁、关中断的情况下调用
+///
+/// ## 返回值
+///
+/// 执行cmpxchg之前的值（与old相等时表示替换成功），访问失败（包括写入只读的页）时返回None
+///
+/// ## Safety
+///
+/// 调用者需要保证地址已经通过verify_area的检查，且4字节对齐
+pub unsafe fn cmpxchg_user_u32(dst: *mut u32, old: u32, new: u32) -> Option<u32> {
+    let mut cur: u32 = 0;
+    user_access_begin();
+    let err = cmpxchg_user_u32_asm(dst, old, new, &mut cur);
+    user_access_end();
+    if err != 0 {
+        return None;
+    }
+    return Some(cur);
+}
+
+/// 读取*src并保存到*val中，成功时返回0，访问失败时返回1
+#[naked]
+unsafe extern "sysv64" fn get_user_u32_asm(src: *const u32, val: *mut u32) -> usize {
+    asm!(
+        "
+    2:  mov eax, dword ptr [rdi]
+        mov dword ptr [rsi], eax
+        xor eax, eax
+        ret
+    3:  mov eax, 1
+        ret
+
+        .pushsection __ex_table, \"a\"
+        .balign 8
+        .quad 2b, 3b
+        .popsection
+        ",
+        options(noreturn)
+    );
+}
+
+/// 对*dst执行cmpxchg，把执行之前的值保存到*cur中，成功时返回0，访问失败时返回1
+#[naked]
+unsafe extern "sysv64" fn cmpxchg_user_u32_asm(
+    dst: *mut u32,
+    old: u32,
+    new: u32,
+    cur: *mut u32,
+) -> usize {
+    asm!(
+        "
+        mov eax, esi
+    2:  lock cmpxchg dword ptr [rdi], edx
+        mov dword ptr [rcx], eax
+        xor eax, eax
+        ret
+    3:  mov eax, 1
+        ret
+
+        .pushsection __ex_table, \"a\"
+        .balign 8
+        .quad 2b, 3b
+        .popsection
+        ",
+        options(noreturn)
+    );
+}
+
+/// 使用`rep movsb`拷贝，返回未能拷贝的字节数
+#[naked]
+unsafe extern "sysv64" fn copy_user_erms(dst: *mut u8, src: *const u8, len: usize) -> usize {
+    asm!(
+        "
+        mov rcx, rdx
+    2:  rep movsb
+        xor eax, eax
+        ret
+    3:  mov rax, rcx
+        ret
+
+        .pushsection __ex_table, \"a\"
+        .balign 8
+        .quad 2b, 3b
+        .popsection
+        ",
+        options(noreturn)
+    );
+}
+
+/// 先使用`rep movsq`按8字节拷贝，再使用`rep movsb`拷贝剩余的字节，返回未能拷贝的字节数
+#[naked]
+unsafe extern "sysv64" fn copy_user_movsq(dst: *mut u8, src: *const u8, len: usize) -> usize {
+    asm!(
+        "
+        mov rcx, rdx
+        shr rcx, 3
+        and edx, 7
+    2:  rep movsq
+        mov ecx, edx
+    4:  rep movsb
+        xor eax, eax
+        ret
+        // rep movsq中断时，剩余的字节数为rcx * 8加上尾部的字节数
+    3:  lea rax, [rdx + rcx * 8]
+        ret
+    5:  mov rax, rcx
+        ret
+
+        .pushsection __ex_table, \"a\"
+        .balign 8
+        .quad 2b, 3b
+        .quad 4b, 5b
+        .popsection
+        ",
+        options(noreturn)
+    );
+}
+
+/// 使用`rep stosb`清零，返回未能清零的字节数
+#[naked]
+unsafe extern "sysv64" fn clear_user_stosb(dst: *mut u8, len: usize) -> usize {
+    asm!(
+        "
+        mov rcx, rsi
+        xor eax, eax
+    2:  rep stosb
+        ret
+    3:  mov rax, rcx
+        ret
+
+        .pushsection __ex_table, \"a\"
+        .balign 8
+        .quad 2b, 3b
+        .popsection
+        ",
+        options(noreturn)
+    );
+}
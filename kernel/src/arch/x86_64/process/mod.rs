@@ -19,10 +19,12 @@ use crate::{
         VirtAddr,
     },
     process::{
-        fork::CloneFlags, KernelStack, ProcessControlBlock, ProcessFlags, ProcessManager,
-        SwitchResult, SWITCH_RESULT,
+        fork::{CloneFlags, KernelCloneArgs},
+        KernelStack, ProcessControlBlock, ProcessFlags, ProcessManager, SwitchResult,
+        SWITCH_RESULT,
     },
     syscall::{Syscall, SystemError},
+    trace_event,
 };
 
 use self::{
@@ -160,7 +162,8 @@ impl ArchPCBInfo {
         if x86::controlregs::cr4().contains(Cr4::CR4_ENABLE_FSGSBASE) {
             self.fsbase = x86::current::segmentation::rdfsbase() as usize;
         } else {
-            self.fsbase = 0;
+            // 不支持fsgsbase指令时，通过MSR读取（用户线程的TLS依赖于此）
+            self.fsbase = x86::msr::rdmsr(x86::msr::IA32_FS_BASE) as usize;
         }
     }
 
@@ -175,6 +178,8 @@ impl ArchPCBInfo {
     pub unsafe fn restore_fsbase(&mut self) {
         if x86::controlregs::cr4().contains(Cr4::CR4_ENABLE_FSGSBASE) {
             x86::current::segmentation::wrfsbase(self.fsbase as u64);
+        } else {
+            x86::msr::wrmsr(x86::msr::IA32_FS_BASE, self.fsbase as u64);
         }
     }
 
@@ -232,7 +237,7 @@ impl ProcessManager {
     ///
     /// 由于这个过程与具体的架构相关，所以放在这里
     pub fn copy_thread(
-        _clone_flags: &CloneFlags,
+        clone_args: &KernelCloneArgs,
         current_pcb: &Arc<ProcessControlBlock>,
         new_pcb: &Arc<ProcessControlBlock>,
         current_trapframe: &TrapFrame,
@@ -242,6 +247,11 @@ impl ProcessManager {
         // 子进程的返回值为0
         child_trapframe.set_return_value(0);
 
+        // 如果指定了用户栈，则子进程从新的栈上开始执行
+        if clone_args.stack != 0 {
+            child_trapframe.rsp = clone_args.stack as u64;
+        }
+
         // 设置子进程的栈基址（开始执行中断返回流程时的栈基址）
         let mut new_arch_guard = new_pcb.arch_info();
         let kernel_stack_guard = new_pcb.kernel_stack();
@@ -259,7 +269,11 @@ impl ProcessManager {
             *trap_frame_ptr = child_trapframe;
         }
 
-        let current_arch_guard = current_pcb.arch_info_irqsave();
+        let mut current_arch_guard = current_pcb.arch_info_irqsave();
+        // fsbase只在上下文切换时才会被保存，因此这里需要先读取当前的值
+        if Arc::ptr_eq(current_pcb, &ProcessManager::current_pcb()) {
+            unsafe { current_arch_guard.save_fsbase() };
+        }
         new_arch_guard.fsbase = current_arch_guard.fsbase;
         new_arch_guard.gsbase = current_arch_guard.gsbase;
         new_arch_guard.fs = current_arch_guard.fs;
@@ -272,6 +286,11 @@ impl ProcessManager {
         }
         drop(current_arch_guard);
 
+        // 设置线程局部存储
+        if clone_args.flags.contains(CloneFlags::CLONE_SETTLS) {
+            new_arch_guard.fsbase = clone_args.tls;
+        }
+
         // 设置返回地址（子进程开始执行的指令地址）
 
         if new_pcb.flags().contains(ProcessFlags::KTHREAD) {
@@ -293,6 +312,7 @@ impl ProcessManager {
     /// - `next`：下一个进程的pcb
     pub unsafe fn switch_process(prev: Arc<ProcessControlBlock>, next: Arc<ProcessControlBlock>) {
         assert!(CurrentIrqArch::is_irq_enabled() == false);
+        trace_event!(TP_SCHED_SWITCH, prev.pid().into(), next.pid().into());
 
         // 保存浮点寄存器
         prev.arch_info().save_fp_state();
@@ -307,11 +327,15 @@ impl ProcessManager {
         prev.arch_info().save_gsbase();
         next.arch_info().restore_gsbase();
 
-        // 切换地址空间
+        // 切换地址空间。同一线程组内的线程共享地址空间，此时无需重新加载CR3（也就不会刷新TLB）
         let next_addr_space = next.basic().user_vm().as_ref().unwrap().clone();
         compiler_fence(Ordering::SeqCst);
 
-        next_addr_space.read().user_mapper.utable.make_current();
+        let next_addr_space_guard = next_addr_space.read();
+        if !next_addr_space_guard.user_mapper.utable.is_current() {
+            next_addr_space_guard.user_mapper.utable.make_current();
+        }
+        drop(next_addr_space_guard);
         compiler_fence(Ordering::SeqCst);
         // 切换内核栈
 
@@ -60,6 +60,9 @@ impl Syscall {
 
         drop(old_address_space);
         drop(irq_guard);
+
+        // 已经不再使用vfork的父进程的地址空间，让父进程继续运行
+        ProcessManager::complete_vfork_done();
         // kdebug!("to load binary file");
         let mut param = ExecParam::new(path.as_str(), address_space.clone(), ExecParamFlags::EXEC);
 
@@ -5,6 +5,7 @@ use alloc::string::String;
 use crate::{
     include::bindings::bindings::set_system_trap_gate,
     syscall::{Syscall, SystemError, SYS_RT_SIGRETURN},
+    trace_event,
 };
 
 use super::{interrupt::TrapFrame, mm::barrier::mfence};
@@ -35,6 +36,7 @@ pub extern "C" fn syscall_handler(frame: &mut TrapFrame) -> () {
         frame.r15 as usize,
     ];
     mfence();
+    trace_event!(TP_SYSCALL_ENTER, syscall_num, args[0], args[1], args[2]);
 
     // 由于进程管理未完成重构，有些系统调用需要在这里临时处理，以后这里的特殊处理要删掉。
     match syscall_num {
@@ -43,7 +45,9 @@ pub extern "C" fn syscall_handler(frame: &mut TrapFrame) -> () {
         }
         _ => {}
     }
-    syscall_return!(Syscall::handle(syscall_num, &args, frame) as u64, frame);
+    let ret = Syscall::handle(syscall_num, &args, frame);
+    trace_event!(TP_SYSCALL_EXIT, syscall_num, ret);
+    syscall_return!(ret as u64, frame);
 }
 
 /// 系统调用初始化
@@ -56,6 +56,7 @@ struct cpu_core_info_t
 {
     uint64_t stack_start;     // 栈基地址
     uint64_t ist_stack_start; // IST栈基地址
+    uint32_t apic_id;         // 该处理器的local APIC ID
 };
 
 extern struct cpu_core_info_t cpu_core_info[MAX_CPU_NUM];
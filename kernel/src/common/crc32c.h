@@ -0,0 +1,25 @@
+#pragma once
+#include <common/sys/types.h>
+
+/**
+ * @brief 计算crc32c（Castagnoli多项式，LSB优先）
+ *
+ * 支持流式计算：把上一次的返回值作为下一次的crc初始值传入即可。
+ * 函数内部不做初始值和结果的取反，标准的CRC-32C需要以0xFFFFFFFF作为初始值，并对最终结果取反
+ *
+ * @param crc crc初始值
+ * @param buffer 输入缓冲区
+ * @param len buffer大小（bytes）
+ * @return uint32_t crc
+ */
+uint32_t crc32c(uint32_t crc, const uint8_t *buffer, size_t len);
+
+/**
+ * @brief 使用查表法计算crc32c（不使用硬件加速，结果与crc32c相同）
+ *
+ * @param crc crc初始值
+ * @param buffer 输入缓冲区
+ * @param len buffer大小（bytes）
+ * @return uint32_t crc
+ */
+uint32_t crc32c_generic(uint32_t crc, const uint8_t *buffer, size_t len);
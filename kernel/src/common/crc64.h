@@ -2,11 +2,23 @@
 #include <common/sys/types.h>
 
 /**
- * @brief 计算crc64
+ * @brief 计算crc64（MSB优先，函数内部不对初始值和结果取反）
+ *
+ * 支持流式计算：把上一次的返回值作为下一次的crc初始值传入即可。cpu支持PCLMULQDQ时会自动使用硬件加速
+ *
+ * @param crc crc初始值
+ * @param buffer 输入缓冲区
+ * @param len buffer大小（bytes）
+ * @return uint64_t crc
+ */
+uint64_t crc64(uint64_t crc, const uint8_t *buffer, size_t len);
+
+/**
+ * @brief 使用查表法计算crc64（不使用硬件加速，结果与crc64相同）
  *
  * @param crc crc初始值
  * @param buffer 输入缓冲区
  * @param len buffer大小（bytes）
  * @return uint64_t crc
  */
-uint64_t crc64(uint64_t crc, const uint8_t *buffer, size_t len);
\ No newline at end of file
+uint64_t crc64_generic(uint64_t crc, const uint8_t *buffer, size_t len);
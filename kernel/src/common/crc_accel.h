@@ -0,0 +1,51 @@
+#pragma once
+#include <common/sys/types.h>
+
+// cpu是否支持SSE4.2的crc32指令，由crc_accel_init()设置
+extern bool crc_accel_has_sse42;
+// cpu是否支持PCLMULQDQ，由crc_accel_init()设置
+extern bool crc_accel_has_pclmul;
+
+// 使用PCLMULQDQ折叠的最小长度（更短时，保存/恢复SIMD状态的开销超过了收益）
+#define CRC_PCLMUL_MIN_LEN 256
+// 每次关中断并保存SIMD状态后最多处理的字节数，用于限制关中断的时间
+#define CRC_PCLMUL_CHUNK 4096
+
+/**
+ * @brief MSB优先的crc使用PCLMULQDQ折叠时所需的常量
+ *
+ * k[i] = { x^(128*(i+1)) mod P, x^(128*(i+1)+64) mod P }，分别与128位块的低64位、高64位相乘，
+ * 相当于把这个块向后移动(i+1)个块
+ */
+struct crc_fold_consts
+{
+    uint64_t k[4][2];
+};
+
+// crc32（多项式0x04C11DB7）的折叠常量
+extern struct crc_fold_consts crc32_fold_consts;
+// crc64（多项式0x42F0E1EBA9EA3693）的折叠常量
+extern struct crc_fold_consts crc64_fold_consts;
+
+/**
+ * @brief 使用PCLMULQDQ计算MSB优先、初始值和结果均不取反的crc
+ *
+ * 调用者需要保证crc_accel_has_pclmul为true。不足CRC_PCLMUL_MIN_LEN的部分以及末尾不足16字节的部分
+ * 使用generic（查表法）计算
+ *
+ * @param consts 折叠常量
+ * @param width crc的位数（不超过64）
+ * @param crc crc初始值
+ * @param buffer 输入缓冲区
+ * @param len buffer大小（bytes）
+ * @param generic 同一个crc的查表法实现
+ * @return uint64_t crc
+ */
+uint64_t crc_pclmul_msb(const struct crc_fold_consts *consts, uint32_t width, uint64_t crc, const uint8_t *buffer,
+                        size_t len, uint64_t (*generic)(uint64_t crc, const uint8_t *buffer, size_t len));
+
+/**
+ * @brief 检测cpu的特性，选择crc的实现，并计算折叠常量
+ *
+ */
+void crc_accel_init();
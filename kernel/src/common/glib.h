@@ -65,11 +65,66 @@ static __always_inline ul ALIGN(const ul addr, const ul _align)
 }
 
 
+/**
+ * @brief memcpy/memset的实现选择，由glib_mem_init()在启动时根据cpu的特性设置
+ *
+ * - memcpy的长度不小于__memcpy_movsb_threshold时，使用rep movsb（ERMS），支持FSRM时短拷贝也使用它
+ * - memset的长度不小于__memset_stosb_threshold时，使用rep stosb（ERMS），支持FSRS时短填充也使用它
+ * - memset的长度不小于__memset_nt_threshold时，使用不经过cache的movnti写入，避免大块清零冲刷cache
+ * - 其余情况使用rep movsq/stosq加上尾部的字节
+ */
+extern uint64_t __memcpy_movsb_threshold;
+extern uint64_t __memset_stosb_threshold;
+extern uint64_t __memset_nt_threshold;
+
+/**
+ * @brief 使用movnti清零（或填充）一段8字节对齐、长度为8的倍数的内存，完成后执行sfence
+ */
+static __always_inline void __memset_nt(void *dst, uint64_t val, ul size)
+{
+    uint64_t *p = (uint64_t *)dst;
+    uint64_t *end = (uint64_t *)((ul)dst + size);
+    while (p < end)
+    {
+        __asm__ __volatile__("movnti %1, 0(%0)	\n\t"
+                             "movnti %1, 8(%0)	\n\t"
+                             "movnti %1, 16(%0)	\n\t"
+                             "movnti %1, 24(%0)	\n\t"
+                             "movnti %1, 32(%0)	\n\t"
+                             "movnti %1, 40(%0)	\n\t"
+                             "movnti %1, 48(%0)	\n\t"
+                             "movnti %1, 56(%0)	\n\t"
+                             :
+                             : "r"(p), "r"(val)
+                             : "memory");
+        p += 8;
+    }
+    __asm__ __volatile__("sfence" ::: "memory");
+}
+
 void *memset(void *dst, unsigned char C, ul size)
 {
 
     int d0, d1;
     unsigned long tmp = C * 0x0101010101010101UL;
+    if (size >= __memset_nt_threshold && ((ul)dst & 63) == 0)
+    {
+        // 大块内存按64字节为单位使用movnti写入，剩余部分继续使用下面的方法
+        ul nt_size = size & ~63UL;
+        __memset_nt(dst, tmp, nt_size);
+        memset((void *)((ul)dst + nt_size), C, size - nt_size);
+        return dst;
+    }
+    if (size >= __memset_stosb_threshold)
+    {
+        __asm__ __volatile__("cld	\n\t"
+                             "rep	\n\t"
+                             "stosb	\n\t"
+                             : "=&c"(d0), "=&D"(d1)
+                             : "a"(tmp), "0"(size), "1"(dst)
+                             : "memory");
+        return dst;
+    }
     __asm__ __volatile__("cld	\n\t"
                          "rep	\n\t"
                          "stosq	\n\t"
@@ -91,12 +146,7 @@ void *memset(void *dst, unsigned char C, ul size)
 
 void *memset_c(void *dst, uint8_t c, size_t count)
 {
-    uint8_t *xs = (uint8_t *)dst;
-
-    while (count--)
-        *xs++ = c;
-
-    return dst;
+    return memset(dst, c, count);
 }
 
 /**
@@ -110,6 +160,16 @@ void *memset_c(void *dst, uint8_t c, size_t count)
 static void *memcpy(void *dst, const void *src, long Num)
 {
     int d0 = 0, d1 = 0, d2 = 0;
+    if ((ul)Num >= __memcpy_movsb_threshold)
+    {
+        __asm__ __volatile__("cld	\n\t"
+                             "rep	\n\t"
+                             "movsb	\n\t"
+                             : "=&c"(d0), "=&D"(d1), "=&S"(d2)
+                             : "0"(Num), "1"(dst), "2"(src)
+                             : "memory");
+        return dst;
+    }
     __asm__ __volatile__("cld	\n\t"
                          "rep	\n\t"
                          "movsq	\n\t"
@@ -129,6 +189,12 @@ static void *memcpy(void *dst, const void *src, long Num)
     return dst;
 }
 
+/**
+ * @brief 根据cpu的特性选择memcpy/memset的实现
+ *
+ */
+void glib_mem_init();
+
 // 从io口读入8个bit
 unsigned char io_in8(unsigned short port)
 {
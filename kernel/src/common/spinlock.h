@@ -16,12 +16,28 @@
 /**
  * @brief 定义自旋锁结构体
  *
+ * 排队自旋锁（ticket lock）：加锁时原子地领取票号next，然后等待owner等于自己的票号。
+ * owner == next 表示锁空闲，因此全0即为未加锁状态。
  */
 typedef struct
 {
-    int8_t lock; // 1:unlocked 0:locked
+    union
+    {
+        uint32_t val;
+        struct
+        {
+            uint16_t owner; // 当前持有锁的票号
+            uint16_t next;  // 下一个可领取的票号
+        } tickets;
+    };
 } spinlock_t;
 
+/**
+ * @brief 定义并静态初始化一个自旋锁
+ *
+ */
+#define DEFINE_SPINLOCK(x) spinlock_t x = {.val = 0}
+
 extern void __arch_spin_lock(spinlock_t *lock);
 extern void __arch_spin_unlock(spinlock_t *lock);
 
@@ -58,7 +74,7 @@ void spin_unlock(spinlock_t *lock)
 void spin_init(spinlock_t *lock)
 {
     barrier();
-    lock->lock = 1;
+    lock->val = 0;
     barrier();
 }
 
@@ -146,8 +162,9 @@ long spin_trylock(spinlock_t *lock)
  */
 static inline bool spin_is_locked(const spinlock_t *lock)
 {
-    int x = READ_ONCE(lock->lock);
-    return (x == 0) ? true : false;
+    spinlock_t x;
+    x.val = READ_ONCE(lock->val);
+    return (x.tickets.owner != x.tickets.next) ? true : false;
 }
 
 #define assert_spin_locked(lock) BUG_ON(!spin_is_locked(lock))
\ No newline at end of file
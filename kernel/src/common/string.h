@@ -63,18 +63,26 @@ long strnlen_user(const char *src, unsigned long maxlen);
  */
 static inline int memcmp(const void *s1, const void *s2, size_t len)
 {
-    int diff;
+    const uint8_t *p1 = (const uint8_t *)s1;
+    const uint8_t *p2 = (const uint8_t *)s2;
 
-    asm("cld \n\t"  // 复位DF，确保s1、s2指针是自增的
-        "repz; cmpsb\n\t" CC_SET(nz)
-        : CC_OUT(nz)(diff), "+D"(s1), "+S"(s2)
-        : "c"(len)
-        : "memory");
-
-    if (diff)
-        diff = *(const unsigned char *)(s1 - 1) - *(const unsigned char *)(s2 - 1);
-
-    return diff;
+    // 每次比较8个字节（repz cmpsb每次只能比较一个字节，且很慢），找到不同的8字节之后再逐字节比较
+    while (len >= 8)
+    {
+        if (*(const uint64_t *)p1 != *(const uint64_t *)p2)
+            break;
+        p1 += 8;
+        p2 += 8;
+        len -= 8;
+    }
+    while (len--)
+    {
+        if (*p1 != *p2)
+            return (int)*p1 - (int)*p2;
+        ++p1;
+        ++p2;
+    }
+    return 0;
 }
 
 /**
@@ -0,0 +1,2 @@
+pub mod profiler;
+pub mod tracepoint;
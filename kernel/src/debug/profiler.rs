@@ -0,0 +1,385 @@
+//! 内核采样分析器
+//!
+//! 使用架构性能计数器（不支持时退化为local apic定时器）周期性地打断cpu，
+//! 记录被打断处的rip以及沿着帧指针回溯得到的调用栈。样本被写入每个cpu独立的缓冲区，
+//! 读取/proc/profile时再通过kallsyms符号化，并以火焰图工具使用的folded格式输出：
+//!
+//! ```text
+//! 最外层函数;...;被打断的函数 样本数
+//! ```
+//!
+//! 向/proc/profile写入`start [频率]`开始采样（会清空之前的样本），写入`stop`停止采样。
+use core::{
+    cell::UnsafeCell,
+    ffi::{c_char, CStr},
+    sync::atomic::{AtomicBool, AtomicUsize, Ordering},
+};
+
+use alloc::{
+    collections::BTreeMap,
+    format,
+    string::{String, ToString},
+    sync::Arc,
+    vec::Vec,
+};
+
+use crate::{
+    include::bindings::bindings::{pt_regs, smp_get_total_cpu, Cpu_tsc_freq, APIC_TIMER_INTERVAL},
+    kinfo, kwarn,
+    libs::{rcu::Rcu, spinlock::SpinLock},
+    mm::percpu::PerCpu,
+    process::KernelStack,
+    smp::core::smp_get_processor_id,
+    syscall::SystemError,
+    time::MSEC_PER_SEC,
+};
+
+extern "C" {
+    fn apic_pmu_init(handler: extern "C" fn(regs: *mut pt_regs)) -> i32;
+    fn apic_pmu_start(period: u64);
+    fn apic_pmu_stop();
+    fn kallsyms_lookup(addr: u64, offset: *mut u64) -> *const c_char;
+}
+
+/// 每个样本最多记录的栈帧数
+const PROFILE_MAX_DEPTH: usize = 32;
+/// 每个cpu的缓冲区最多保存的样本数
+const PROFILE_SAMPLES_PER_CPU: usize = 2048;
+/// 默认的采样频率（Hz）
+const PROFILE_DEFAULT_FREQ: u64 = 1000;
+/// 使用local apic定时器采样时的频率（即时钟中断的频率），由APIC定时器的中断间隔得到
+const PROFILE_TIMER_FREQ: u64 = MSEC_PER_SEC as u64 / APIC_TIMER_INTERVAL as u64;
+
+/// 每次开始采样时递增，用于判断各个cpu的性能计数器是否已经按照最新的配置启动
+static PROFILE_GENERATION: AtomicUsize = AtomicUsize::new(0);
+/// 每个cpu上性能计数器所对应的采样编号，0表示没有启动
+static PROFILE_CPU_GENERATION: [AtomicUsize; PerCpu::MAX_CPU_NUM] = {
+    const STOPPED: AtomicUsize = AtomicUsize::new(0);
+    [STOPPED; PerCpu::MAX_CPU_NUM]
+};
+
+lazy_static! {
+    /// 当前（或最近一次）的采样
+    static ref PROFILER: Rcu<Option<Arc<Profiler>>> = Rcu::new(None);
+    /// 性能计数器是否可用（None表示尚未检测）
+    static ref PMU_AVAILABLE: SpinLock<Option<bool>> = SpinLock::new(None);
+}
+
+/// 一个样本
+#[derive(Clone, Copy)]
+struct ProfileSample {
+    /// 是否在用户态被打断
+    user: bool,
+    depth: usize,
+    /// ips[0]为被打断处的rip，之后依次为各层调用者的返回地址
+    ips: [usize; PROFILE_MAX_DEPTH],
+}
+
+/// 一个cpu的样本缓冲区。只有该cpu在中断上下文中写入，因此不需要加锁
+struct ProfileBuffer {
+    samples: UnsafeCell<Vec<ProfileSample>>,
+    /// 已经写入的样本数
+    len: AtomicUsize,
+    /// 由于缓冲区已满而丢弃的样本数
+    dropped: AtomicUsize,
+}
+
+unsafe impl Sync for ProfileBuffer {}
+
+impl ProfileBuffer {
+    fn new() -> Self {
+        let empty = ProfileSample {
+            user: false,
+            depth: 0,
+            ips: [0; PROFILE_MAX_DEPTH],
+        };
+        return Self {
+            samples: UnsafeCell::new(vec![empty; PROFILE_SAMPLES_PER_CPU]),
+            len: AtomicUsize::new(0),
+            dropped: AtomicUsize::new(0),
+        };
+    }
+
+    /// 获取已经写入的样本
+    fn samples(&self) -> &[ProfileSample] {
+        let len = self.len.load(Ordering::Acquire);
+        return unsafe { &(*self.samples.get())[..len] };
+    }
+}
+
+/// 一次采样
+struct Profiler {
+    /// 采样编号
+    generation: usize,
+    /// 采样频率（Hz）
+    freq: u64,
+    /// 性能计数器的采样周期（cpu周期数），为0表示使用定时器采样
+    period: u64,
+    enabled: AtomicBool,
+    buffers: Vec<ProfileBuffer>,
+}
+
+impl Profiler {
+    /// 在中断上下文中记录一个样本
+    fn record(&self, regs: &pt_regs) {
+        let buffer = match self.buffers.get(smp_get_processor_id() as usize) {
+            Some(buffer) => buffer,
+            None => return,
+        };
+        let index = buffer.len.load(Ordering::Relaxed);
+        if index >= PROFILE_SAMPLES_PER_CPU {
+            buffer.dropped.fetch_add(1, Ordering::Relaxed);
+            return;
+        }
+        let sample = unsafe { &mut (*buffer.samples.get())[index] };
+        if regs.cs & 3 != 0 {
+            sample.user = true;
+            sample.depth = 0;
+        } else {
+            sample.user = false;
+            sample.depth = unsafe { walk_stack(regs, &mut sample.ips) };
+        }
+        buffer.len.store(index + 1, Ordering::Release);
+    }
+
+    fn is_pmu(&self) -> bool {
+        return self.period != 0;
+    }
+}
+
+/// @brief 沿着帧指针回溯内核栈
+///
+/// 只会访问被打断时所在的内核栈内的地址，因此即使遇到没有帧指针的函数，也不会访问非法地址
+///
+/// @return 记录的栈帧数
+unsafe fn walk_stack(regs: &pt_regs, ips: &mut [usize; PROFILE_MAX_DEPTH]) -> usize {
+    ips[0] = regs.rip as usize;
+    let mut depth = 1;
+
+    // 内核栈按照其大小对齐
+    let stack_top = (regs.rsp as usize & !(KernelStack::SIZE - 1)) + KernelStack::SIZE;
+    let mut low = regs.rsp as usize;
+    let mut rbp = regs.rbp as usize;
+    while depth < PROFILE_MAX_DEPTH {
+        if rbp < low || rbp + 16 > stack_top || rbp & 7 != 0 {
+            break;
+        }
+        let frame = rbp as *const usize;
+        // 调用时先压入返回地址，再压入调用者的rbp
+        let ret_addr = *frame.add(1);
+        if ret_addr == 0 {
+            break;
+        }
+        ips[depth] = ret_addr;
+        depth += 1;
+        low = rbp + 16;
+        rbp = *frame;
+    }
+    return depth;
+}
+
+/// @brief 获取地址所在的函数名
+///
+/// ## 参数
+///
+/// - `addr` : 要查找的地址
+/// - `leaf` : 是否是被打断处的rip（其他栈帧都是返回地址，指向call指令的下一条指令）
+fn symbolize(addr: usize, leaf: bool) -> String {
+    // kallsyms_lookup按照返回地址的语义查找（函数起始地址 < addr <= 下一个函数的起始地址）
+    let lookup_addr = if leaf { addr + 1 } else { addr };
+    let name = unsafe { kallsyms_lookup(lookup_addr as u64, core::ptr::null_mut()) };
+    if name.is_null() {
+        return format!("{:#x}", addr);
+    }
+    return unsafe { CStr::from_ptr(name) }
+        .to_string_lossy()
+        .to_string();
+}
+
+/// @brief 检测并初始化性能计数器
+fn profile_pmu_available() -> bool {
+    let mut available = PMU_AVAILABLE.lock();
+    if let Some(available) = *available {
+        return available;
+    }
+    let ok = unsafe { apic_pmu_init(profile_pmu_interrupt) } == 0 && unsafe { Cpu_tsc_freq } != 0;
+    if !ok {
+        kwarn!("Profiler: performance counters are unavailable, falling back to the apic timer");
+    }
+    *available = Some(ok);
+    return ok;
+}
+
+/// @brief 开始采样（之前的样本会被丢弃）
+///
+/// ## 参数
+///
+/// - `freq` : 采样频率（Hz）。不支持性能计数器时固定使用时钟中断的频率
+pub fn profile_start(freq: u64) -> Result<(), SystemError> {
+    if freq == 0 || freq > 100000 {
+        return Err(SystemError::EINVAL);
+    }
+    let (freq, period) = if profile_pmu_available() {
+        // 以TSC的频率近似cpu的主频
+        let period = (unsafe { Cpu_tsc_freq } / freq).clamp(1000, i32::MAX as u64);
+        (freq, period)
+    } else {
+        (PROFILE_TIMER_FREQ, 0)
+    };
+
+    let cpus = unsafe { smp_get_total_cpu() } as usize;
+    let mut buffers = Vec::with_capacity(cpus);
+    for _ in 0..cpus {
+        buffers.push(ProfileBuffer::new());
+    }
+    let profiler = Arc::new(Profiler {
+        generation: PROFILE_GENERATION.fetch_add(1, Ordering::AcqRel) + 1,
+        freq,
+        period,
+        enabled: AtomicBool::new(true),
+        buffers,
+    });
+    if let Some(old) = PROFILER.read().as_ref() {
+        old.enabled.store(false, Ordering::Release);
+    }
+    PROFILER.replace(Some(profiler));
+    kinfo!("Profiler started, frequency: {}Hz", freq);
+    return Ok(());
+}
+
+/// @brief 停止采样，已经记录的样本会被保留
+pub fn profile_stop() {
+    if let Some(profiler) = PROFILER.read().as_ref() {
+        profiler.enabled.store(false, Ordering::Release);
+    }
+    kinfo!("{}", profile_summary());
+}
+
+/// @brief 在时钟中断中调用
+///
+/// 负责按照最新的配置启动或者停止本cpu的性能计数器；不支持性能计数器时直接在这里采样
+#[no_mangle]
+pub extern "C" fn rs_profile_tick(regs: *mut pt_regs) {
+    let cpu_id = smp_get_processor_id() as usize;
+    let running = PROFILE_CPU_GENERATION[cpu_id].load(Ordering::Relaxed);
+    let profiler = PROFILER.read();
+    match profiler.as_ref() {
+        Some(p) if p.enabled.load(Ordering::Acquire) => {
+            if !p.is_pmu() {
+                p.record(unsafe { &*regs });
+            } else if running != p.generation {
+                unsafe { apic_pmu_start(p.period) };
+                PROFILE_CPU_GENERATION[cpu_id].store(p.generation, Ordering::Relaxed);
+            }
+        }
+        _ => {
+            if running != 0 {
+                unsafe { apic_pmu_stop() };
+                PROFILE_CPU_GENERATION[cpu_id].store(0, Ordering::Relaxed);
+            }
+        }
+    }
+}
+
+/// 性能计数器溢出中断的处理函数
+extern "C" fn profile_pmu_interrupt(regs: *mut pt_regs) {
+    let cpu_id = smp_get_processor_id() as usize;
+    let profiler = PROFILER.read();
+    match profiler.as_ref() {
+        Some(p)
+            if p.enabled.load(Ordering::Acquire)
+                && PROFILE_CPU_GENERATION[cpu_id].load(Ordering::Relaxed) == p.generation =>
+        {
+            p.record(unsafe { &*regs });
+        }
+        _ => {
+            unsafe { apic_pmu_stop() };
+            PROFILE_CPU_GENERATION[cpu_id].store(0, Ordering::Relaxed);
+        }
+    }
+}
+
+/// @brief 以folded格式导出最近一次采样的结果
+pub fn profile_folded() -> Vec<u8> {
+    let profiler = match PROFILER.read().as_ref() {
+        Some(p) => p.clone(),
+        None => return Vec::new(),
+    };
+
+    // 调用栈 -> 样本数
+    let mut stacks: BTreeMap<String, usize> = BTreeMap::new();
+    let mut symbols: BTreeMap<(usize, bool), String> = BTreeMap::new();
+    for buffer in profiler.buffers.iter() {
+        for sample in buffer.samples() {
+            let stack = if sample.user {
+                String::from("[user]")
+            } else {
+                let mut frames: Vec<&str> = Vec::with_capacity(sample.depth);
+                for (i, ip) in sample.ips[..sample.depth].iter().enumerate().rev() {
+                    let key = (*ip, i == 0);
+                    if !symbols.contains_key(&key) {
+                        symbols.insert(key, symbolize(*ip, i == 0));
+                    }
+                    frames.push(symbols.get(&key).unwrap().as_str());
+                }
+                frames.join(";")
+            };
+            *stacks.entry(stack).or_insert(0) += 1;
+        }
+    }
+
+    let mut result = Vec::new();
+    for (stack, count) in stacks.iter() {
+        result.extend_from_slice(format!("{} {}\n", stack, count).as_bytes());
+    }
+    return result;
+}
+
+/// @brief 获取采样的概况
+fn profile_summary() -> String {
+    let profiler = match PROFILER.read().as_ref() {
+        Some(p) => p.clone(),
+        None => return String::from("Profiler never started"),
+    };
+    let samples: usize = profiler.buffers.iter().map(|b| b.samples().len()).sum();
+    let dropped: usize = profiler
+        .buffers
+        .iter()
+        .map(|b| b.dropped.load(Ordering::Relaxed))
+        .sum();
+    return format!(
+        "Profiler {}, source: {}, frequency: {}Hz, samples: {}, dropped: {}",
+        if profiler.enabled.load(Ordering::Relaxed) {
+            "running"
+        } else {
+            "stopped"
+        },
+        if profiler.is_pmu() { "pmu" } else { "timer" },
+        profiler.freq,
+        samples,
+        dropped
+    );
+}
+
+/// @brief 处理写入/proc/profile的命令
+///
+/// 支持的命令：`start [频率]`、`stop`
+pub fn profile_control(cmd: &str) -> Result<(), SystemError> {
+    let mut args = cmd
+        .trim_matches(|c: char| c.is_whitespace() || c == '\0')
+        .split_whitespace();
+    match args.next() {
+        Some("start") => {
+            let freq = match args.next() {
+                Some(freq) => freq.parse::<u64>().map_err(|_| SystemError::EINVAL)?,
+                None => PROFILE_DEFAULT_FREQ,
+            };
+            return profile_start(freq);
+        }
+        Some("stop") => {
+            profile_stop();
+            return Ok(());
+        }
+        _ => return Err(SystemError::EINVAL),
+    }
+}
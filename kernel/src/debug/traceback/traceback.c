@@ -2,24 +2,39 @@
 #include <common/printk.h>
 #include <process/process.h>
 
-static int lookup_kallsyms(uint64_t addr, int level)
+const char *kallsyms_lookup(uint64_t addr, uint64_t *offset)
 {
-    const char *str = (const char *)&kallsyms_names;
+    if (&kallsyms_num == NULL || kallsyms_num == 0)
+        return NULL;
+    if (addr <= kallsyms_address[0] || addr > kallsyms_address[kallsyms_num - 1])
+        return NULL;
 
-    // 暴力查找符合要求的symbol
-    // todo: 改用二分搜索。
-    // 由于符号表使用nm -n生成，因此是按照地址升序排列的，因此可以二分
-    uint64_t index = 0;
-    for (index = 0; index < kallsyms_num - 1; ++index)
+    // 符号表使用nm -n生成，按照地址升序排列，因此可以二分查找
+    // 找到满足kallsyms_address[index] < addr <= kallsyms_address[index + 1]的index
+    uint64_t low = 0, high = kallsyms_num - 1;
+    while (high - low > 1)
     {
-        if (addr > kallsyms_address[index] && addr <= kallsyms_address[index + 1])
-            break;
+        uint64_t mid = low + (high - low) / 2;
+        if (kallsyms_address[mid] < addr)
+            low = mid;
+        else
+            high = mid;
     }
 
-    if (index < kallsyms_num) // 找到对应的函数
+    const char *str = (const char *)&kallsyms_names;
+    if (offset != NULL)
+        *offset = addr - kallsyms_address[low];
+    return &str[kallsyms_names_index[low]];
+}
+
+static int lookup_kallsyms(uint64_t addr, int level)
+{
+    uint64_t offset = 0;
+    const char *name = kallsyms_lookup(addr, &offset);
+    if (name != NULL) // 找到对应的函数
     {
         // 依次输出函数名称、rip离函数起始处的偏移量、函数执行的rip
-        printk("function:%s() \t(+) %04d address:%#018lx\n", &str[kallsyms_names_index[index]], addr - kallsyms_address[index], addr);
+        printk("function:%s() \t(+) %04d address:%#018lx\n", name, offset, addr);
         return 0;
     }
     else
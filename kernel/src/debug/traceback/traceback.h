@@ -9,6 +9,15 @@ extern const uint64_t kallsyms_num __attribute__((weak));
 extern const uint64_t kallsyms_names_index[] __attribute__((weak));
 extern const char *kallsyms_names __attribute__((weak));
 
+/**
+ * @brief 查找地址所在的函数
+ *
+ * @param addr 要查找的地址
+ * @param offset 若不为NULL，则返回地址相对于函数起始处的偏移量
+ * @return const char* 函数名，找不到时返回NULL
+ */
+const char *kallsyms_lookup(uint64_t addr, uint64_t *offset);
+
 /**
  * @brief 追溯内核栈调用情况
  *
@@ -0,0 +1,296 @@
+//! 静态跟踪点
+//!
+//! 在调度、系统调用、定时器、块设备和网络等热路径上埋设跟踪点。跟踪点被关闭时只有一次
+//! 对`AtomicBool`的读取和一个预测为不跳转的分支；打开后，事件被写入当前cpu的二进制环形缓冲区，
+//! 读取/proc/trace时再合并所有cpu的事件、按时间排序后转换成文本。
+//!
+//! - 读取/proc/trace_events可以查看所有跟踪点及其开关状态，写入`<跟踪点名称|all> <0|1>`开关跟踪点
+//! - 读取/proc/trace得到事件，写入任意内容清空缓冲区
+//!
+//! 在代码中使用`trace_event!(TP_XXX, 参数...)`产生事件，参数会被转换成u64。
+use core::{
+    arch::x86_64::_rdtsc,
+    intrinsics::unlikely,
+    sync::atomic::{AtomicBool, AtomicU64, Ordering},
+};
+
+use alloc::{boxed::Box, format, string::String, vec::Vec};
+
+use crate::{
+    include::bindings::bindings::{smp_get_total_cpu, Cpu_tsc_freq},
+    libs::{
+        lazy_init::Lazy,
+        once::Once,
+        seq_ring::{SeqRing, SeqRingRead, SeqRingSlot},
+    },
+    process::ProcessManager,
+    smp::core::smp_get_processor_id,
+    syscall::SystemError,
+};
+
+/// 每个cpu的缓冲区能保存的事件数（必须是2的幂）
+const TRACE_ENTRIES_PER_CPU: usize = 4096;
+/// 每个事件最多携带的参数个数
+pub const TRACE_MAX_ARGS: usize = 4;
+
+/// @brief 产生一个跟踪事件
+///
+/// 跟踪点关闭时，参数不会被求值
+#[macro_export]
+macro_rules! trace_event {
+    ($tp:ident $(, $arg:expr)* $(,)?) => {
+        if $crate::debug::tracepoint::$tp.is_enabled() {
+            $crate::debug::tracepoint::$tp.emit(&[$(($arg) as u64),*]);
+        }
+    };
+}
+
+/// 一个静态跟踪点
+#[derive(Debug)]
+pub struct TracePoint {
+    id: u16,
+    name: &'static str,
+    /// 各个参数的名称
+    args: &'static [&'static str],
+    enabled: AtomicBool,
+}
+
+impl TracePoint {
+    const fn new(id: u16, name: &'static str, args: &'static [&'static str]) -> Self {
+        return Self {
+            id,
+            name,
+            args,
+            enabled: AtomicBool::new(false),
+        };
+    }
+
+    #[inline(always)]
+    pub fn is_enabled(&self) -> bool {
+        return unlikely(self.enabled.load(Ordering::Relaxed));
+    }
+
+    /// 把事件写入当前cpu的缓冲区
+    #[cold]
+    #[inline(never)]
+    pub fn emit(&self, args: &[u64]) {
+        let buffers = match TRACE_BUFFERS.try_get() {
+            Some(buffers) => buffers,
+            None => return,
+        };
+        let buffer = match buffers.get(smp_get_processor_id() as usize) {
+            Some(buffer) => buffer,
+            None => return,
+        };
+        let mut entry = TraceEntry {
+            tsc: unsafe { _rdtsc() },
+            pid: ProcessManager::current_pcb().pid().into() as u32,
+            id: self.id,
+            nr_args: args.len().min(TRACE_MAX_ARGS) as u16,
+            args: [0; TRACE_MAX_ARGS],
+        };
+        entry.args[..entry.nr_args as usize].copy_from_slice(&args[..entry.nr_args as usize]);
+        buffer.push(&entry);
+    }
+}
+
+pub static TP_SCHED_ENQUEUE: TracePoint = TracePoint::new(0, "sched_enqueue", &["pid", "cpu"]);
+pub static TP_SCHED_SWITCH: TracePoint = TracePoint::new(1, "sched_switch", &["prev", "next"]);
+pub static TP_SYSCALL_ENTER: TracePoint =
+    TracePoint::new(2, "syscall_enter", &["nr", "arg0", "arg1", "arg2"]);
+pub static TP_SYSCALL_EXIT: TracePoint = TracePoint::new(3, "syscall_exit", &["nr", "ret"]);
+pub static TP_TIMER_ACTIVATE: TracePoint = TracePoint::new(4, "timer_activate", &["expire", "now"]);
+pub static TP_BLOCK_RQ_ISSUE: TracePoint =
+    TracePoint::new(5, "block_rq_issue", &["write", "lba", "count"]);
+pub static TP_BLOCK_RQ_COMPLETE: TracePoint =
+    TracePoint::new(6, "block_rq_complete", &["write", "lba", "count", "error"]);
+pub static TP_NET_POLL_IFACES: TracePoint = TracePoint::new(7, "net_poll_ifaces", &["ifaces"]);
+
+/// 所有的跟踪点，下标即为跟踪点的id
+static TRACEPOINTS: [&TracePoint; 8] = [
+    &TP_SCHED_ENQUEUE,
+    &TP_SCHED_SWITCH,
+    &TP_SYSCALL_ENTER,
+    &TP_SYSCALL_EXIT,
+    &TP_TIMER_ACTIVATE,
+    &TP_BLOCK_RQ_ISSUE,
+    &TP_BLOCK_RQ_COMPLETE,
+    &TP_NET_POLL_IFACES,
+];
+
+/// 每个cpu的事件缓冲区，在第一次打开跟踪点时分配
+static TRACE_BUFFERS: Lazy<Vec<TraceBuffer>> = Lazy::new();
+static TRACE_INIT: Once = Once::new();
+
+/// 缓冲区中的一个事件
+#[derive(Debug, Clone, Copy)]
+struct TraceEntry {
+    /// 事件发生时的TSC
+    tsc: u64,
+    pid: u32,
+    id: u16,
+    nr_args: u16,
+    args: [u64; TRACE_MAX_ARGS],
+}
+
+impl TraceEntry {
+    const fn empty() -> Self {
+        return Self {
+            tsc: 0,
+            pid: 0,
+            id: 0,
+            nr_args: 0,
+            args: [0; TRACE_MAX_ARGS],
+        };
+    }
+}
+
+/// 一个cpu的事件缓冲区
+struct TraceBuffer {
+    ring: SeqRing<TraceEntry>,
+    /// 上一次清空缓冲区时的head，读者不会读取在此之前的事件
+    tail: AtomicU64,
+}
+
+impl TraceBuffer {
+    fn new() -> Self {
+        let mut slots = Vec::with_capacity(TRACE_ENTRIES_PER_CPU);
+        for _ in 0..TRACE_ENTRIES_PER_CPU {
+            slots.push(SeqRingSlot::new(TraceEntry::empty()));
+        }
+        // 缓冲区在第一次打开跟踪点时分配，此后不会被释放
+        let slots: &'static [SeqRingSlot<TraceEntry>] = Box::leak(slots.into_boxed_slice());
+        return Self {
+            ring: SeqRing::new(slots),
+            tail: AtomicU64::new(0),
+        };
+    }
+
+    #[inline(always)]
+    fn push(&self, entry: &TraceEntry) {
+        self.ring.push(entry);
+    }
+
+    /// 读取缓冲区中仍然保存着的全部事件
+    fn collect(&self, result: &mut Vec<(u32, TraceEntry)>, cpu: u32) {
+        let head = self.ring.head();
+        let start = self.ring.oldest().max(self.tail.load(Ordering::Acquire));
+        for seq in start..head {
+            if let SeqRingRead::Ok(entry) = self.ring.load(seq) {
+                result.push((cpu, entry));
+            }
+        }
+    }
+
+    fn clear(&self) {
+        self.tail.store(self.ring.head(), Ordering::Release);
+    }
+}
+
+/// @brief 分配每个cpu的事件缓冲区
+fn trace_buffers_init() {
+    TRACE_INIT.call_once(|| {
+        let cpus = unsafe { smp_get_total_cpu() } as usize;
+        let mut buffers = Vec::with_capacity(cpus);
+        for _ in 0..cpus {
+            buffers.push(TraceBuffer::new());
+        }
+        TRACE_BUFFERS.init(buffers);
+    });
+}
+
+/// @brief 打开或关闭跟踪点
+///
+/// ## 参数
+///
+/// - `name` : 跟踪点的名称，为`all`时表示所有跟踪点
+/// - `enable` : 是否打开
+pub fn trace_set_enabled(name: &str, enable: bool) -> Result<(), SystemError> {
+    if enable {
+        trace_buffers_init();
+    }
+    let mut found = false;
+    for tp in TRACEPOINTS.iter() {
+        if name == "all" || tp.name == name {
+            tp.enabled.store(enable, Ordering::Relaxed);
+            found = true;
+        }
+    }
+    if !found {
+        return Err(SystemError::ENOENT);
+    }
+    return Ok(());
+}
+
+/// @brief 列出所有的跟踪点及其开关状态
+pub fn trace_events_list() -> String {
+    let mut result = String::new();
+    for tp in TRACEPOINTS.iter() {
+        result.push_str(&format!(
+            "{} {}\n",
+            tp.name,
+            tp.enabled.load(Ordering::Relaxed) as u8
+        ));
+    }
+    return result;
+}
+
+/// @brief 处理写入/proc/trace_events的命令：`<跟踪点名称|all> <0|1>`
+pub fn trace_events_control(cmd: &str) -> Result<(), SystemError> {
+    let mut args = cmd
+        .trim_matches(|c: char| c.is_whitespace() || c == '\0')
+        .split_whitespace();
+    let name = args.next().ok_or(SystemError::EINVAL)?;
+    let enable = match args.next() {
+        Some("1") => true,
+        Some("0") => false,
+        _ => return Err(SystemError::EINVAL),
+    };
+    return trace_set_enabled(name, enable);
+}
+
+/// @brief 清空所有cpu的事件缓冲区
+pub fn trace_clear() {
+    if let Some(buffers) = TRACE_BUFFERS.try_get() {
+        for buffer in buffers.iter() {
+            buffer.clear();
+        }
+    }
+}
+
+/// @brief 把所有cpu的事件按照时间顺序转换成文本
+///
+/// 每一行的格式为`[cpu] 秒.微秒: pid=<pid> <跟踪点>: <参数名>=<参数值> ...`
+pub fn trace_dump() -> Vec<u8> {
+    let buffers = match TRACE_BUFFERS.try_get() {
+        Some(buffers) => buffers,
+        None => return Vec::new(),
+    };
+    let mut entries = Vec::new();
+    for (cpu, buffer) in buffers.iter().enumerate() {
+        buffer.collect(&mut entries, cpu as u32);
+    }
+    entries.sort_by_key(|(_, entry)| entry.tsc);
+
+    let tsc_freq = unsafe { Cpu_tsc_freq }.max(1) as u128;
+    let mut result = Vec::new();
+    for (cpu, entry) in entries.iter() {
+        let tp = TRACEPOINTS[entry.id as usize];
+        let micros = (entry.tsc as u128 * 1000000 / tsc_freq) as u64;
+        let mut line = format!(
+            "[{:03}] {:5}.{:06}: pid={} {}:",
+            cpu,
+            micros / 1000000,
+            micros % 1000000,
+            entry.pid,
+            tp.name
+        );
+        for i in 0..entry.nr_args as usize {
+            let name = tp.args.get(i).copied().unwrap_or("?");
+            line.push_str(&format!(" {}={}", name, entry.args[i] as i64));
+        }
+        line.push('\n');
+        result.extend_from_slice(line.as_bytes());
+    }
+    return result;
+}
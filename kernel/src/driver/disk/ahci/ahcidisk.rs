@@ -11,6 +11,7 @@ use crate::kdebug;
 use crate::libs::{spinlock::SpinLock, vec_cursor::VecCursor};
 use crate::mm::phys_2_virt;
 use crate::syscall::SystemError;
+use crate::trace_event;
 use crate::{
     driver::disk::ahci::hba::{
         FisRegH2D, FisType, HbaCmdHeader, ATA_CMD_READ_DMA_EXT, ATA_CMD_WRITE_DMA_EXT,
@@ -490,7 +491,16 @@ impl BlockDevice for LockedAhciDisk {
         count: usize,          // 读取lba的数量
         buf: &mut [u8],
     ) -> Result<usize, SystemError> {
-        self.0.lock().read_at(lba_id_start, count, buf)
+        trace_event!(TP_BLOCK_RQ_ISSUE, 0, lba_id_start, count);
+        let r = self.0.lock().read_at(lba_id_start, count, buf);
+        trace_event!(
+            TP_BLOCK_RQ_COMPLETE,
+            0,
+            lba_id_start,
+            count,
+            r.as_ref().err().map_or(0, |e| -e.to_posix_errno())
+        );
+        return r;
     }
 
     #[inline]
@@ -500,6 +510,15 @@ impl BlockDevice for LockedAhciDisk {
         count: usize,
         buf: &[u8],
     ) -> Result<usize, SystemError> {
-        self.0.lock().write_at(lba_id_start, count, buf)
+        trace_event!(TP_BLOCK_RQ_ISSUE, 1, lba_id_start, count);
+        let r = self.0.lock().write_at(lba_id_start, count, buf);
+        trace_event!(
+            TP_BLOCK_RQ_COMPLETE,
+            1,
+            lba_id_start,
+            count,
+            r.as_ref().err().map_or(0, |e| -e.to_posix_errno())
+        );
+        return r;
     }
 }
@@ -1 +1,2 @@
 pub mod ahci;
+pub mod zram;
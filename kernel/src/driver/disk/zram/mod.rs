@@ -0,0 +1,592 @@
+//! 基于LZ4的压缩内存块设备（zram）
+//!
+//! 写入的数据以页（4KB）为单位压缩后保存在内存中，读取时再解压：
+//!
+//! - 全部由同一个8字节值填充的页（最常见的是全零页）不占用存储空间，只记录填充值
+//! - 压缩后的数据保存在按大小分类的内存池（zpool）中，压缩后仍大于ZRAM_HUGE_SIZE的页以原始数据保存
+//! - 每个cpu有ZRAM_STREAMS_PER_CPU个压缩流（LZ4的状态和输出缓冲区），由可睡眠的锁保护。
+//!   压缩在设备的锁之外进行，多个cpu（以及同一个cpu上被抢占的多个写者）可以同时压缩
+//! - 对同一个页的写入由页锁串行化，不完整的页的读-改-写因此不会覆盖并发写入的数据。
+//!   页锁按页号散列到ZRAM_PAGE_LOCKS个睡眠锁上
+//!
+//! 向/proc/zram写入`create <大小(MiB)>`创建一个设备，读取/proc/zram得到所有设备的统计信息。
+//! 设备上有一个覆盖整个设备的分区，可以在其上建立文件系统作为临时盘使用
+use core::{
+    ffi::c_void,
+    fmt::Write,
+    sync::atomic::{AtomicUsize, Ordering},
+};
+
+use alloc::{
+    format,
+    string::String,
+    sync::{Arc, Weak},
+    vec,
+    vec::Vec,
+};
+
+use crate::{
+    arch::{mm::LockedFrameAllocator, MMArch},
+    driver::base::{
+        block::{
+            block_device::{BlockDevice, BlockDeviceOps, BlockId, LBA_SIZE},
+            disk_info::Partition,
+        },
+        device::{mkdev, Device, DeviceNumber, DeviceType, IdTable, KObject},
+    },
+    filesystem::vfs::IndexNode,
+    include::bindings::bindings::{
+        smp_get_total_cpu, LZ4_compressBound, LZ4_compress_fast_extState, LZ4_decompress_safe,
+        LZ4_sizeofState,
+    },
+    kinfo,
+    libs::{
+        mutex::{Mutex, MutexGuard},
+        rwlock::RwLock,
+        spinlock::SpinLock,
+    },
+    mm::{allocator::page_frame::FrameAllocator, MemoryManagementArch},
+    smp::core::smp_get_processor_id,
+    syscall::SystemError,
+};
+
+use self::zpool::{ZHandle, ZPool, ZPOOL_PAGE_SIZE};
+
+mod zpool;
+
+/// zram的页大小
+pub const ZRAM_PAGE_SIZE: usize = ZPOOL_PAGE_SIZE;
+/// 每个页包含的LBA数
+const ZRAM_LBAS_PER_PAGE: usize = ZRAM_PAGE_SIZE / LBA_SIZE;
+/// 压缩后超过这个大小的页不再压缩，直接保存原始数据（解压的开销不值得）
+const ZRAM_HUGE_SIZE: usize = ZRAM_PAGE_SIZE / 4 * 3;
+/// 每个cpu的压缩流数量
+const ZRAM_STREAMS_PER_CPU: usize = 2;
+/// 每个设备的页锁数量
+const ZRAM_PAGE_LOCKS: usize = 64;
+/// zram设备的最大数量（即占用的次设备号数量）
+const ZRAM_MAX_DEVICES: usize = 16;
+
+/// 一个页的保存状态
+#[derive(Debug, Clone, Copy)]
+enum ZramSlot {
+    /// 从未被写入过，读取时为全零
+    Empty,
+    /// 由同一个8字节值填充的页
+    Same(u64),
+    /// 保存在内存池中的页，len为ZRAM_PAGE_SIZE时保存的是原始数据
+    Stored { handle: ZHandle, len: usize },
+}
+
+/// 设备的元数据：每个页的保存状态以及内存池
+struct ZramMeta {
+    slots: Vec<ZramSlot>,
+    pool: ZPool,
+}
+
+/// 压缩流
+struct ZcompStream {
+    /// LZ4的压缩状态（需要按指针对齐）
+    state: Vec<u64>,
+    /// 压缩的输出缓冲区
+    buf: Vec<u8>,
+}
+
+impl ZcompStream {
+    fn new() -> Self {
+        let state_size = unsafe { LZ4_sizeofState() } as usize;
+        let bound = unsafe { LZ4_compressBound(ZRAM_PAGE_SIZE as i32) } as usize;
+        return Self {
+            state: vec![0u64; (state_size + 7) / 8],
+            buf: vec![0u8; bound],
+        };
+    }
+
+    /// @brief 压缩一个页，返回压缩后的长度
+    fn compress(&mut self, src: &[u8]) -> Result<usize, SystemError> {
+        let len = unsafe {
+            LZ4_compress_fast_extState(
+                self.state.as_mut_ptr() as *mut c_void,
+                src.as_ptr() as *const _,
+                self.buf.as_mut_ptr() as *mut _,
+                src.len() as i32,
+                self.buf.len() as i32,
+                1,
+            )
+        };
+        if len <= 0 {
+            return Err(SystemError::EIO);
+        }
+        return Ok(len as usize);
+    }
+}
+
+/// 设备的统计信息
+#[derive(Debug, Default)]
+pub struct ZramStats {
+    /// 读取的页数
+    pub num_reads: AtomicUsize,
+    /// 写入的页数
+    pub num_writes: AtomicUsize,
+    /// 读取失败的次数
+    pub failed_reads: AtomicUsize,
+    /// 写入失败的次数
+    pub failed_writes: AtomicUsize,
+    /// 当前保存的页数（不包括同值页）
+    pub pages_stored: AtomicUsize,
+    /// 当前的同值页数
+    pub same_pages: AtomicUsize,
+    /// 当前以原始数据保存的页数
+    pub huge_pages: AtomicUsize,
+    /// 压缩后的数据的总大小
+    pub compr_data_size: AtomicUsize,
+    /// 内存池占用的页数的最大值
+    pub max_used_pages: AtomicUsize,
+}
+
+/// 压缩内存块设备
+pub struct ZramDevice {
+    /// 设备的编号（zram<id>）
+    id: usize,
+    /// 设备的页数
+    nr_pages: usize,
+    meta: RwLock<ZramMeta>,
+    /// 按cpu划分的压缩流
+    streams: Vec<Vec<Mutex<ZcompStream>>>,
+    /// 页锁，页号为index的页使用第index % ZRAM_PAGE_LOCKS个
+    page_locks: Vec<Mutex<()>>,
+    stats: ZramStats,
+    partitions: Vec<Arc<Partition>>,
+    id_table: IdTable,
+    sys_info: SpinLock<Option<Arc<dyn IndexNode>>>,
+    self_ref: Weak<ZramDevice>,
+}
+
+impl core::fmt::Debug for ZramDevice {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        write!(f, "{{ name: zram{}, pages: {} }}", self.id, self.nr_pages)
+    }
+}
+
+impl ZramDevice {
+    /// @brief 创建一个zram设备
+    ///
+    /// ## 参数
+    ///
+    /// - `id`：设备的编号
+    /// - `size`：设备的大小（字节），向上取整到页
+    /// - `devnum`：设备号
+    ///
+    /// 创建的设备没有注册到块设备层，需要通过zram_create创建可以被使用的设备
+    pub fn new(id: usize, size: usize, devnum: DeviceNumber) -> Arc<Self> {
+        let nr_pages = (size + ZRAM_PAGE_SIZE - 1) / ZRAM_PAGE_SIZE;
+        let nr_cpus = unsafe { smp_get_total_cpu() } as usize;
+        let streams = (0..nr_cpus.max(1))
+            .map(|_| {
+                (0..ZRAM_STREAMS_PER_CPU)
+                    .map(|_| Mutex::new(ZcompStream::new()))
+                    .collect()
+            })
+            .collect();
+
+        return Arc::new_cyclic(|self_ref: &Weak<ZramDevice>| {
+            let disk: Weak<dyn BlockDevice> = self_ref.clone();
+            let sectors = (nr_pages * ZRAM_LBAS_PER_PAGE) as u64;
+            Self {
+                id,
+                nr_pages,
+                meta: RwLock::new(ZramMeta {
+                    slots: vec![ZramSlot::Empty; nr_pages],
+                    pool: ZPool::new(),
+                }),
+                streams,
+                page_locks: (0..ZRAM_PAGE_LOCKS).map(|_| Mutex::new(())).collect(),
+                stats: ZramStats::default(),
+                partitions: vec![Partition::new(0, 0, sectors, disk, 0)],
+                id_table: IdTable::new(format!("zram{}", id), devnum),
+                sys_info: SpinLock::new(None),
+                self_ref: self_ref.clone(),
+            }
+        });
+    }
+
+    /// @brief 设备的统计信息
+    pub fn stats(&self) -> &ZramStats {
+        return &self.stats;
+    }
+
+    /// @brief 获取当前cpu的一个空闲的压缩流，都被占用时睡眠等待其中的第一个
+    fn stream(&self) -> MutexGuard<ZcompStream> {
+        let streams = &self.streams[smp_get_processor_id() as usize % self.streams.len()];
+        for stream in streams.iter() {
+            if let Ok(guard) = stream.try_lock() {
+                return guard;
+            }
+        }
+        return streams[0].lock();
+    }
+
+    /// @brief 获取页锁。对同一个页的写入必须持有它
+    fn page_lock(&self, index: usize) -> MutexGuard<()> {
+        return self.page_locks[index % ZRAM_PAGE_LOCKS].lock();
+    }
+
+    /// @brief 页是否由同一个8字节值填充，是则返回这个值
+    fn same_filled(data: &[u8]) -> Option<u64> {
+        let first = u64::from_ne_bytes(data[0..8].try_into().unwrap());
+        for chunk in data.chunks_exact(8) {
+            if u64::from_ne_bytes(chunk.try_into().unwrap()) != first {
+                return None;
+            }
+        }
+        return Some(first);
+    }
+
+    /// @brief 释放一个页原先占用的空间，并更新统计信息
+    fn free_slot(&self, meta: &mut ZramMeta, slot: ZramSlot) {
+        match slot {
+            ZramSlot::Empty => {}
+            ZramSlot::Same(_) => {
+                self.stats.same_pages.fetch_sub(1, Ordering::Relaxed);
+            }
+            ZramSlot::Stored { handle, len } => {
+                meta.pool.free(handle);
+                self.stats.pages_stored.fetch_sub(1, Ordering::Relaxed);
+                self.stats.compr_data_size.fetch_sub(len, Ordering::Relaxed);
+                if len == ZRAM_PAGE_SIZE {
+                    self.stats.huge_pages.fetch_sub(1, Ordering::Relaxed);
+                }
+            }
+        }
+    }
+
+    /// @brief 读取一个完整的页
+    fn read_page(&self, index: usize, out: &mut [u8]) -> Result<(), SystemError> {
+        self.stats.num_reads.fetch_add(1, Ordering::Relaxed);
+        let meta = self.meta.read();
+        match meta.slots[index] {
+            ZramSlot::Empty => out.fill(0),
+            ZramSlot::Same(value) => {
+                for chunk in out.chunks_exact_mut(8) {
+                    chunk.copy_from_slice(&value.to_ne_bytes());
+                }
+            }
+            ZramSlot::Stored { handle, len } => {
+                let data = &meta.pool.load(handle)[..len];
+                if len == ZRAM_PAGE_SIZE {
+                    out.copy_from_slice(data);
+                } else {
+                    let r = unsafe {
+                        LZ4_decompress_safe(
+                            data.as_ptr() as *const _,
+                            out.as_mut_ptr() as *mut _,
+                            len as i32,
+                            ZRAM_PAGE_SIZE as i32,
+                        )
+                    };
+                    if r != ZRAM_PAGE_SIZE as i32 {
+                        self.stats.failed_reads.fetch_add(1, Ordering::Relaxed);
+                        return Err(SystemError::EIO);
+                    }
+                }
+            }
+        }
+        return Ok(());
+    }
+
+    /// @brief 写入一个完整的页，调用者需要持有页锁
+    fn write_page(&self, index: usize, data: &[u8]) -> Result<(), SystemError> {
+        self.stats.num_writes.fetch_add(1, Ordering::Relaxed);
+
+        if let Some(value) = Self::same_filled(data) {
+            let mut meta = self.meta.write();
+            let old = core::mem::replace(&mut meta.slots[index], ZramSlot::Same(value));
+            self.free_slot(&mut meta, old);
+            self.stats.same_pages.fetch_add(1, Ordering::Relaxed);
+            return Ok(());
+        }
+
+        // 压缩在设备的锁之外进行
+        let mut stream = self.stream();
+        let clen = match stream.compress(data) {
+            Ok(clen) => clen,
+            Err(e) => {
+                self.stats.failed_writes.fetch_add(1, Ordering::Relaxed);
+                return Err(e);
+            }
+        };
+        let (src, len) = if clen > ZRAM_HUGE_SIZE {
+            (data, ZRAM_PAGE_SIZE)
+        } else {
+            (&stream.buf[..clen], clen)
+        };
+
+        let mut meta = self.meta.write();
+        let handle = meta.pool.store(src);
+        drop(stream);
+        let old = core::mem::replace(&mut meta.slots[index], ZramSlot::Stored { handle, len });
+        self.free_slot(&mut meta, old);
+
+        self.stats.pages_stored.fetch_add(1, Ordering::Relaxed);
+        self.stats.compr_data_size.fetch_add(len, Ordering::Relaxed);
+        if len == ZRAM_PAGE_SIZE {
+            self.stats.huge_pages.fetch_add(1, Ordering::Relaxed);
+        }
+        self.stats
+            .max_used_pages
+            .fetch_max(meta.pool.nr_pages(), Ordering::Relaxed);
+        return Ok(());
+    }
+
+    /// @brief 检查LBA范围，返回范围的字节偏移量
+    fn check_range(
+        &self,
+        lba_id_start: BlockId,
+        count: usize,
+        buf_len: usize,
+    ) -> Result<usize, SystemError> {
+        let end = lba_id_start.checked_add(count).ok_or(SystemError::EINVAL)?;
+        if end > self.nr_pages * ZRAM_LBAS_PER_PAGE {
+            return Err(SystemError::EINVAL);
+        }
+        if count * LBA_SIZE > buf_len {
+            return Err(SystemError::E2BIG);
+        }
+        return Ok(lba_id_start * LBA_SIZE);
+    }
+
+    /// @brief 输出设备的统计信息
+    fn dump(&self, out: &mut String) {
+        let orig_data_size = (self.stats.pages_stored.load(Ordering::Relaxed)
+            + self.stats.same_pages.load(Ordering::Relaxed))
+            * ZRAM_PAGE_SIZE;
+        let mem_used = self.meta.read().pool.nr_pages() * ZRAM_PAGE_SIZE;
+        writeln!(
+            out,
+            "zram{} {} {} {} {} {} {} {} {} {} {} {} {}",
+            self.id,
+            self.nr_pages * ZRAM_PAGE_SIZE,
+            orig_data_size,
+            self.stats.compr_data_size.load(Ordering::Relaxed),
+            mem_used,
+            self.stats.max_used_pages.load(Ordering::Relaxed) * ZRAM_PAGE_SIZE,
+            self.stats.same_pages.load(Ordering::Relaxed),
+            self.stats.huge_pages.load(Ordering::Relaxed),
+            self.stats.num_reads.load(Ordering::Relaxed),
+            self.stats.num_writes.load(Ordering::Relaxed),
+            self.stats.failed_reads.load(Ordering::Relaxed),
+            self.stats.failed_writes.load(Ordering::Relaxed),
+            self.streams.len() * ZRAM_STREAMS_PER_CPU,
+        )
+        .ok();
+    }
+}
+
+impl KObject for ZramDevice {}
+
+impl Device for ZramDevice {
+    fn dev_type(&self) -> DeviceType {
+        return DeviceType::Block;
+    }
+
+    fn as_any_ref(&self) -> &dyn core::any::Any {
+        return self;
+    }
+
+    fn id_table(&self) -> IdTable {
+        return self.id_table.clone();
+    }
+
+    fn set_sys_info(&self, sys_info: Option<Arc<dyn IndexNode>>) {
+        *self.sys_info.lock() = sys_info;
+    }
+
+    fn sys_info(&self) -> Option<Arc<dyn IndexNode>> {
+        return self.sys_info.lock().clone();
+    }
+}
+
+impl BlockDevice for ZramDevice {
+    fn read_at(
+        &self,
+        lba_id_start: BlockId,
+        count: usize,
+        buf: &mut [u8],
+    ) -> Result<usize, SystemError> {
+        let start = self.check_range(lba_id_start, count, buf.len())?;
+        let end = start + count * LBA_SIZE;
+        let mut page_buf: Vec<u8> = Vec::new();
+
+        let mut offset = start;
+        while offset < end {
+            let index = offset / ZRAM_PAGE_SIZE;
+            let page_offset = offset % ZRAM_PAGE_SIZE;
+            let len = (ZRAM_PAGE_SIZE - page_offset).min(end - offset);
+            let dst = &mut buf[offset - start..offset - start + len];
+            if len == ZRAM_PAGE_SIZE {
+                // 完整的页直接解压到调用者的缓冲区
+                self.read_page(index, dst)?;
+            } else {
+                page_buf.resize(ZRAM_PAGE_SIZE, 0);
+                self.read_page(index, &mut page_buf)?;
+                dst.copy_from_slice(&page_buf[page_offset..page_offset + len]);
+            }
+            offset += len;
+        }
+        return Ok(count * LBA_SIZE);
+    }
+
+    fn write_at(
+        &self,
+        lba_id_start: BlockId,
+        count: usize,
+        buf: &[u8],
+    ) -> Result<usize, SystemError> {
+        let start = self.check_range(lba_id_start, count, buf.len())?;
+        let end = start + count * LBA_SIZE;
+        let mut page_buf: Vec<u8> = Vec::new();
+
+        let mut offset = start;
+        while offset < end {
+            let index = offset / ZRAM_PAGE_SIZE;
+            let page_offset = offset % ZRAM_PAGE_SIZE;
+            let len = (ZRAM_PAGE_SIZE - page_offset).min(end - offset);
+            let src = &buf[offset - start..offset - start + len];
+            let _page_guard = self.page_lock(index);
+            if len == ZRAM_PAGE_SIZE {
+                self.write_page(index, src)?;
+            } else {
+                // 不完整的页需要先读出原来的内容。读出与写回都在页锁下进行，中间不会有其他的写入
+                page_buf.resize(ZRAM_PAGE_SIZE, 0);
+                self.read_page(index, &mut page_buf)?;
+                page_buf[page_offset..page_offset + len].copy_from_slice(src);
+                self.write_page(index, &page_buf)?;
+            }
+            offset += len;
+        }
+        return Ok(count * LBA_SIZE);
+    }
+
+    fn sync(&self) -> Result<(), SystemError> {
+        return Ok(());
+    }
+
+    fn blk_size_log2(&self) -> u8 {
+        return 9;
+    }
+
+    fn as_any_ref(&self) -> &dyn core::any::Any {
+        return self;
+    }
+
+    fn device(&self) -> Arc<dyn Device> {
+        return self.self_ref.upgrade().unwrap();
+    }
+
+    fn block_size(&self) -> usize {
+        return LBA_SIZE;
+    }
+
+    fn partitions(&self) -> Vec<Arc<Partition>> {
+        return self.partitions.clone();
+    }
+}
+
+lazy_static! {
+    /// 所有的zram设备
+    static ref ZRAM_DEVICES: Mutex<Vec<Arc<ZramDevice>>> = Mutex::new(Vec::new());
+}
+
+/// zram设备占用的设备号区域的起始设备号
+static ZRAM_DEVNUM_BASE: SpinLock<Option<DeviceNumber>> = SpinLock::new(None);
+
+/// @brief 创建一个zram设备
+///
+/// ## 参数
+///
+/// - `size`：设备的大小（字节）
+///
+/// ## 返回值
+///
+/// 新创建的设备
+///
+/// ## 错误
+///
+/// - `EINVAL`：大小为0
+/// - `ENOMEM`：大小超过了物理内存的总量
+/// - `ENOSPC`：设备的数量已经达到ZRAM_MAX_DEVICES
+pub fn zram_create(size: usize) -> Result<Arc<ZramDevice>, SystemError> {
+    if size == 0 {
+        return Err(SystemError::EINVAL);
+    }
+    // 每个页的元数据都会被预先分配，超过物理内存的设备即使压缩率很高也没有意义
+    let total_mem = unsafe { LockedFrameAllocator.usage() }.total().data() * MMArch::PAGE_SIZE;
+    if size > total_mem {
+        return Err(SystemError::ENOMEM);
+    }
+    let base = {
+        let mut base = ZRAM_DEVNUM_BASE.lock();
+        if base.is_none() {
+            *base = Some(BlockDeviceOps::alloc_blockdev_region(
+                0,
+                ZRAM_MAX_DEVICES,
+                "zram",
+            )?);
+        }
+        base.unwrap()
+    };
+
+    // 从选择编号到加入设备列表都持有锁，并发的创建不会得到相同的编号
+    let mut devices = ZRAM_DEVICES.lock();
+    let id = devices.len();
+    if id >= ZRAM_MAX_DEVICES {
+        return Err(SystemError::ENOSPC);
+    }
+    let devnum = mkdev(base.major(), base.minor() + id);
+    let dev = ZramDevice::new(id, size, devnum);
+    BlockDeviceOps::bdev_add(dev.clone(), dev.id_table.clone());
+    devices.push(dev.clone());
+    drop(devices);
+    kinfo!(
+        "zram{} created, size: {} bytes",
+        id,
+        dev.nr_pages * ZRAM_PAGE_SIZE
+    );
+    return Ok(dev);
+}
+
+/// @brief 根据编号获取zram设备
+pub fn zram_get(id: usize) -> Option<Arc<ZramDevice>> {
+    return ZRAM_DEVICES.lock().get(id).cloned();
+}
+
+/// @brief 处理写入/proc/zram的命令：`create <大小(MiB)>`
+pub fn zram_control(cmd: &str) -> Result<(), SystemError> {
+    let mut args = cmd
+        .trim_matches(|c: char| c.is_whitespace() || c == '\0')
+        .split_whitespace();
+    if args.next() != Some("create") {
+        return Err(SystemError::EINVAL);
+    }
+    let mib = args
+        .next()
+        .ok_or(SystemError::EINVAL)?
+        .parse::<usize>()
+        .map_err(|_| SystemError::EINVAL)?;
+    let size = mib.checked_mul(1024 * 1024).ok_or(SystemError::EINVAL)?;
+    zram_create(size)?;
+    return Ok(());
+}
+
+/// @brief 输出所有zram设备的统计信息，单位为字节（页数的字段除外）
+pub fn zram_dump() -> String {
+    let mut result = String::from(
+        "name disksize orig_data_size compr_data_size mem_used mem_used_max same_pages huge_pages \
+         num_reads num_writes failed_reads failed_writes streams\n",
+    );
+    let devices: Vec<Arc<ZramDevice>> = ZRAM_DEVICES.lock().clone();
+    for dev in devices.iter() {
+        dev.dump(&mut result);
+    }
+    return result;
+}
@@ -0,0 +1,205 @@
+//! zram使用的按大小分类的内存池
+//!
+//! 压缩后的数据按长度向上取整到ZPOOL_CLASS_GRANULARITY的倍数，放入对应的大小类中。
+//! 每个大小类由若干个zspage组成：zspage是1到ZPOOL_MAX_ZSPAGE_PAGES个连续的4KB页，
+//! 被划分为相同大小的槽，用一个位图记录哪些槽已被占用。槽可以跨越页的边界，
+//! 每个大小类选择浪费最少的zspage大小，因此较大的对象（例如3KB）也能紧密地排列，而不是每页只放一个。
+//! zspage中所有的槽都被释放后，它会被立即归还给内核堆。
+use alloc::{boxed::Box, vec, vec::Vec};
+
+/// 内存池中每个页的大小
+pub const ZPOOL_PAGE_SIZE: usize = 4096;
+/// 大小类之间的间隔（也是最小的槽的大小），使得每个页的槽数不超过64，可以用一个u64作为位图
+pub const ZPOOL_CLASS_GRANULARITY: usize = ZPOOL_PAGE_SIZE / 64;
+/// 大小类的数量
+const ZPOOL_NR_CLASSES: usize = ZPOOL_PAGE_SIZE / ZPOOL_CLASS_GRANULARITY;
+/// 一个zspage最多包含的页数
+const ZPOOL_MAX_ZSPAGE_PAGES: usize = 4;
+/// 一个zspage最多包含的槽数（位图的位数）
+const ZPOOL_MAX_ZSPAGE_SLOTS: usize = 64;
+
+/// 内存池中的一个对象的位置
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct ZHandle {
+    /// 大小类的下标
+    class: u16,
+    /// 槽在zspage中的下标
+    slot: u16,
+    /// zspage在大小类中的下标
+    page: u32,
+}
+
+/// 大小类中的一个zspage
+struct ZClassPage {
+    data: Box<[u8]>,
+    /// 已被占用的槽的位图
+    used: u64,
+}
+
+/// 一个大小类
+struct SizeClass {
+    /// 槽的大小
+    size: usize,
+    /// 每个zspage包含的页数
+    pages_per_zspage: usize,
+    /// 每个zspage中的槽数
+    slots_per_page: usize,
+    /// 所有的zspage，已被归还的为None
+    pages: Vec<Option<ZClassPage>>,
+    /// 还有空闲槽的zspage的下标
+    partial: Vec<u32>,
+    /// pages中为None的下标，新建zspage时优先使用
+    vacant: Vec<u32>,
+}
+
+impl SizeClass {
+    fn new(size: usize) -> Self {
+        // 选择槽占用的比例最高的zspage大小（比例相同时选择较小的）
+        let mut best = (1, ZPOOL_PAGE_SIZE / size);
+        for nr_pages in 2..=ZPOOL_MAX_ZSPAGE_PAGES {
+            let slots = (nr_pages * ZPOOL_PAGE_SIZE / size).min(ZPOOL_MAX_ZSPAGE_SLOTS);
+            // slots * size / (nr_pages * PAGE) > best_slots * size / (best_pages * PAGE)
+            if slots * best.0 > best.1 * nr_pages {
+                best = (nr_pages, slots);
+            }
+        }
+        return Self {
+            size,
+            pages_per_zspage: best.0,
+            slots_per_page: best.1,
+            pages: Vec::new(),
+            partial: Vec::new(),
+            vacant: Vec::new(),
+        };
+    }
+
+    /// @brief 页中所有的槽都被占用时的位图
+    fn full_mask(&self) -> u64 {
+        if self.slots_per_page == 64 {
+            return u64::MAX;
+        }
+        return (1u64 << self.slots_per_page) - 1;
+    }
+
+    /// @brief 分配一个槽，返回（zspage的下标，槽的下标，是否新建了zspage）
+    fn alloc(&mut self) -> (u32, u16, bool) {
+        let mut new_page = false;
+        if self.partial.is_empty() {
+            let page = ZClassPage {
+                data: vec![0u8; self.pages_per_zspage * ZPOOL_PAGE_SIZE].into_boxed_slice(),
+                used: 0,
+            };
+            let index = match self.vacant.pop() {
+                Some(index) => {
+                    self.pages[index as usize] = Some(page);
+                    index
+                }
+                None => {
+                    self.pages.push(Some(page));
+                    (self.pages.len() - 1) as u32
+                }
+            };
+            self.partial.push(index);
+            new_page = true;
+        }
+
+        let index = *self.partial.last().unwrap();
+        let full_mask = self.full_mask();
+        let page = self.pages[index as usize].as_mut().unwrap();
+        let slot = (!page.used).trailing_zeros() as u16;
+        page.used |= 1 << slot;
+        if page.used == full_mask {
+            self.partial.pop();
+        }
+        return (index, slot, new_page);
+    }
+
+    /// @brief 释放一个槽，返回是否归还了zspage
+    fn free(&mut self, index: u32, slot: u16) -> bool {
+        let full_mask = self.full_mask();
+        let page = self.pages[index as usize].as_mut().unwrap();
+        assert!(page.used & (1 << slot) != 0, "zpool: double free");
+        let was_full = page.used == full_mask;
+        page.used &= !(1 << slot);
+
+        if page.used == 0 {
+            self.pages[index as usize] = None;
+            self.vacant.push(index);
+            if !was_full {
+                let pos = self.partial.iter().position(|&i| i == index).unwrap();
+                self.partial.swap_remove(pos);
+            }
+            return true;
+        }
+        if was_full {
+            self.partial.push(index);
+        }
+        return false;
+    }
+
+    fn slot(&self, index: u32, slot: u16) -> &[u8] {
+        let page = self.pages[index as usize].as_ref().unwrap();
+        let start = slot as usize * self.size;
+        return &page.data[start..start + self.size];
+    }
+
+    fn slot_mut(&mut self, index: u32, slot: u16) -> &mut [u8] {
+        let size = self.size;
+        let page = self.pages[index as usize].as_mut().unwrap();
+        let start = slot as usize * size;
+        return &mut page.data[start..start + size];
+    }
+}
+
+/// 按大小分类的内存池
+pub struct ZPool {
+    classes: Vec<SizeClass>,
+    /// 内存池占用的页数
+    nr_pages: usize,
+}
+
+impl ZPool {
+    pub fn new() -> Self {
+        let classes = (1..=ZPOOL_NR_CLASSES)
+            .map(|i| SizeClass::new(i * ZPOOL_CLASS_GRANULARITY))
+            .collect();
+        return Self {
+            classes,
+            nr_pages: 0,
+        };
+    }
+
+    /// @brief 内存池占用的页数
+    pub fn nr_pages(&self) -> usize {
+        return self.nr_pages;
+    }
+
+    /// @brief 保存一个对象（长度为1到ZPOOL_PAGE_SIZE字节），返回它的位置
+    pub fn store(&mut self, data: &[u8]) -> ZHandle {
+        assert!(!data.is_empty() && data.len() <= ZPOOL_PAGE_SIZE);
+        let class = (data.len() + ZPOOL_CLASS_GRANULARITY - 1) / ZPOOL_CLASS_GRANULARITY - 1;
+        let (page, slot, new_page) = self.classes[class].alloc();
+        if new_page {
+            self.nr_pages += self.classes[class].pages_per_zspage;
+        }
+        self.classes[class].slot_mut(page, slot)[..data.len()].copy_from_slice(data);
+        return ZHandle {
+            class: class as u16,
+            slot,
+            page,
+        };
+    }
+
+    /// @brief 获取对象所在的槽（槽的长度可能大于保存时的长度）
+    pub fn load(&self, handle: ZHandle) -> &[u8] {
+        return self.classes[handle.class as usize].slot(handle.page, handle.slot);
+    }
+
+    /// @brief 释放一个对象
+    pub fn free(&mut self, handle: ZHandle) {
+        let class = &mut self.classes[handle.class as usize];
+        if class.free(handle.page, handle.slot) {
+            self.nr_pages -= class.pages_per_zspage;
+        }
+    }
+}
@@ -1,9 +1,11 @@
 #include "apic.h"
 #include "apic_timer.h"
 #include <common/cpu.h>
+#include <common/errno.h>
 #include <common/glib.h>
 #include <common/kprint.h>
 #include <common/printk.h>
+#include <common/spinlock.h>
 #include <driver/acpi/acpi.h>
 #include <exception/gate.h>
 #include <driver/uart/uart.h>
@@ -18,6 +20,7 @@ extern void (*interrupt_table[24])(void);
 extern uint32_t rs_current_pcb_preempt_count();
 extern uint32_t rs_current_pcb_pid();
 extern uint32_t rs_current_pcb_flags();
+extern void rs_cputime_account_irq(uint64_t cycles);
 
 static bool flag_support_apic = false;
 static bool flag_support_x2apic = false;
@@ -405,6 +408,36 @@ int apic_init()
     // sti();
     return 0;
 }
+/**
+ * @brief 执行外部中断（I/O APIC或MSI）的处理程序，并向中断控制器发送应答
+ *
+ * @param irq 中断描述结构体
+ * @param rsp 中断栈指针
+ * @param number 中断向量号
+ */
+static __always_inline void __do_IRQ_desc(irq_desc_t *irq, struct pt_regs *rsp, ul number)
+{
+    // 执行中断上半部处理程序
+    if (irq->handler != NULL)
+        irq->handler(number, irq->parameter, rsp);
+    else if (!(irq->flags & IRQ_FLAG_THREADED))
+        kwarn("Intr vector [%d] does not have a handler!", number);
+
+    if (irq->flags & IRQ_FLAG_THREADED)
+    {
+        // 在中断线程处理完毕之前屏蔽该中断，防止电平触发的中断不断重复到来
+        if ((irq->flags & IRQ_FLAG_ONESHOT) && irq->controller != NULL)
+            irq->controller->disable(number);
+        rs_irq_wake_thread(number);
+    }
+
+    // 向中断控制器发送应答消息
+    if (irq->controller != NULL && irq->controller->ack != NULL)
+        irq->controller->ack(number);
+    else
+        __send_eoi(); // 向EOI寄存器写入0x00表示结束中断
+}
+
 /**
  * @brief 中断服务程序
  *
@@ -413,22 +446,14 @@ int apic_init()
  */
 void do_IRQ(struct pt_regs *rsp, ul number)
 {
+    uint64_t irq_start = rdtsc();
 
     if (number < 0x80 && number >= 32) // 以0x80为界限，低于0x80的是外部中断控制器，高于0x80的是Local APIC
     {
         // ==========外部中断控制器========
         irq_desc_t *irq = &interrupt_desc[number - 32];
 
-        // 执行中断上半部处理程序
-        if (irq != NULL && irq->handler != NULL)
-            irq->handler(number, irq->parameter, rsp);
-        else
-            kwarn("Intr vector [%d] does not have a handler!");
-        // 向中断控制器发送应答消息
-        if (irq->controller != NULL && irq->controller->ack != NULL)
-            irq->controller->ack(number);
-        else
-            __send_eoi();
+        __do_IRQ_desc(irq, rsp, number);
     }
     else if (number >= 200)
     {
@@ -444,16 +469,7 @@ void do_IRQ(struct pt_regs *rsp, ul number)
     {
         irq_desc_t *irq = &local_apic_interrupt_desc[number - 150];
 
-        // 执行中断上半部处理程序
-        if (irq != NULL && irq->handler != NULL)
-            irq->handler(number, irq->parameter, rsp);
-        else
-            kwarn("Intr vector [%d] does not have a handler!");
-        // 向中断控制器发送应答消息
-        if (irq->controller != NULL && irq->controller->ack != NULL)
-            irq->controller->ack(number);
-        else
-            __send_eoi(); // 向EOI寄存器写入0x00表示结束中断
+        __do_IRQ_desc(irq, rsp, number);
     }
     else
     {
@@ -463,6 +479,9 @@ void do_IRQ(struct pt_regs *rsp, ul number)
         return;
     }
 
+    // 统计处理硬件中断所花费的时间
+    rs_cputime_account_irq(rdtsc() - irq_start);
+
     // kdebug("before softirq");
     // 进入软中断处理程序
     rs_do_softirq();
@@ -535,20 +554,52 @@ void apic_ioapic_write_rte(unsigned char index, ul value)
 }
 
 // =========== 中断控制操作接口 ============
+// 保护RTE的读-改-写。中断线程可能在其他cpu上重新使能中断，因此需要加锁
+static DEFINE_SPINLOCK(ioapic_rte_lock);
+
 void apic_ioapic_enable(ul irq_num)
 {
     ul index = 0x10 + ((irq_num - 32) << 1);
+    uint64_t flags;
+    spin_lock_irqsave(&ioapic_rte_lock, flags);
     ul value = apic_ioapic_read_rte(index);
     value &= (~0x10000UL);
     apic_ioapic_write_rte(index, value);
+    spin_unlock_irqrestore(&ioapic_rte_lock, flags);
 }
 
 void apic_ioapic_disable(ul irq_num)
 {
     ul index = 0x10 + ((irq_num - 32) << 1);
+    uint64_t flags;
+    spin_lock_irqsave(&ioapic_rte_lock, flags);
     ul value = apic_ioapic_read_rte(index);
     value |= (0x10000UL);
     apic_ioapic_write_rte(index, value);
+    spin_unlock_irqrestore(&ioapic_rte_lock, flags);
+}
+
+/**
+ * @brief 修改RTE的目标处理器（物理目标模式）
+ *
+ * @param irq_num 中断向量号
+ * @param apic_id 目标处理器的APIC ID
+ * @return int 错误码
+ */
+int apic_ioapic_set_affinity(ul irq_num, uint32_t apic_id)
+{
+    if (apic_id > 0xff)
+        return -EINVAL;
+    ul index = 0x10 + ((irq_num - 32) << 1);
+    uint64_t flags;
+    spin_lock_irqsave(&ioapic_rte_lock, flags);
+    ul value = apic_ioapic_read_rte(index);
+    // 清除目标字段[63:56]以及目标模式位（使用物理模式）
+    value &= ~((0xffUL << 56) | (1UL << 11));
+    value |= ((ul)apic_id << 56);
+    apic_ioapic_write_rte(index, value);
+    spin_unlock_irqrestore(&ioapic_rte_lock, flags);
+    return 0;
 }
 
 ul apic_ioapic_install(ul irq_num, void *arg)
@@ -305,6 +305,7 @@ uint apic_get_ics(const uint type, ul ret_vaddr[], uint *total);
 void apic_ioapic_enable(ul irq_num);
 void apic_ioapic_disable(ul irq_num);
 ul apic_ioapic_install(ul irq_num, void *arg);
+int apic_ioapic_set_affinity(ul irq_num, uint32_t apic_id);
 void apic_ioapic_uninstall(ul irq_num);
 void apic_ioapic_level_ack(ul irq_num); // ioapic电平触发 应答
 void apic_ioapic_edge_ack(ul irq_num);  // ioapic边沿触发 应答
@@ -1,2 +1,6 @@
+#pragma once
 #include <common/stddef.h>
-extern uint64_t ioapic_get_base_paddr();
\ No newline at end of file
+extern uint64_t ioapic_get_base_paddr();
+
+// 5ms产生一次中断（调度器的时钟周期，rust侧的cpu时间统计也依赖于它）
+#define APIC_TIMER_INTERVAL 5
\ No newline at end of file
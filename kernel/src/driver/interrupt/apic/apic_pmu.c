@@ -0,0 +1,139 @@
+#include "apic_pmu.h"
+#include <common/cpu.h>
+#include <common/kprint.h>
+#include <exception/irq.h>
+
+// 每个cpu当前使用的采样周期（由于只在本cpu上读写，因此不需要加锁）
+static uint64_t apic_pmu_period[MAX_CPU_NUM] = {0};
+// 架构性能监控的版本号
+static uint32_t apic_pmu_version = 0;
+static void (*apic_pmu_sample_handler)(struct pt_regs *regs) = NULL;
+
+/**
+ * @brief 写入local apic的性能计数器LVT
+ *
+ * @param value LVT的值
+ */
+static void apic_pmu_write_LVT(uint32_t value)
+{
+    if (CURRENT_APIC_STATE == APIC_X2APIC_ENABLED)
+        wrmsr(0x834, value);
+    else
+        __write4b(APIC_LOCAL_APIC_VIRT_BASE_ADDR + LOCAL_APIC_OFFSET_Local_APIC_LVT_PERFORMANCE_MONITOR, value);
+}
+
+/**
+ * @brief 重新装载计数器，使其在period个周期之后溢出
+ *
+ */
+static void apic_pmu_reload(uint64_t period)
+{
+    // 写入IA32_PMC0时，低32位会被符号扩展到整个计数器
+    wrmsr(IA32_PMC0, (uint64_t)(-(int64_t)period) & 0xffffffffUL);
+}
+
+bool apic_pmu_supported()
+{
+    uint32_t eax, ebx, ecx, edx;
+    cpu_cpuid(0, 0, &eax, &ebx, &ecx, &edx);
+    if (eax < 0xa)
+        return false;
+
+    cpu_cpuid(0xa, 0, &eax, &ebx, &ecx, &edx);
+    uint32_t version = eax & 0xff;
+    uint32_t nr_counters = (eax >> 8) & 0xff;
+    uint32_t ebx_len = (eax >> 24) & 0xff;
+    // EBX的第0位为1表示UnHalted Core Cycles事件不可用
+    if (version == 0 || nr_counters == 0 || ebx_len == 0 || (ebx & 1))
+        return false;
+    apic_pmu_version = version;
+    return true;
+}
+
+void apic_pmu_start(uint64_t period)
+{
+    uint32_t cpu_id = rs_current_pcb_cpuid();
+    apic_pmu_period[cpu_id] = period;
+
+    wrmsr(IA32_PERFEVTSEL0, 0);
+    apic_pmu_reload(period);
+    apic_pmu_write_LVT(APIC_PMU_IRQ_NUM);
+    if (apic_pmu_version >= 2)
+    {
+        wrmsr(IA32_PERF_GLOBAL_OVF_CTRL, 1);
+        wrmsr(IA32_PERF_GLOBAL_CTRL, rdmsr(IA32_PERF_GLOBAL_CTRL) | 1);
+    }
+    wrmsr(IA32_PERFEVTSEL0,
+          PERFEVTSEL_EVENT_CORE_CYCLES | PERFEVTSEL_USR | PERFEVTSEL_OS | PERFEVTSEL_INT | PERFEVTSEL_EN);
+}
+
+void apic_pmu_stop()
+{
+    wrmsr(IA32_PERFEVTSEL0, 0);
+    apic_pmu_write_LVT(APIC_LVT_INT_MASKED | APIC_PMU_IRQ_NUM);
+    apic_pmu_period[rs_current_pcb_cpuid()] = 0;
+}
+
+/**
+ * @brief 性能计数器溢出中断的处理函数
+ *
+ */
+static void apic_pmu_handler(uint64_t number, uint64_t param, struct pt_regs *regs)
+{
+    uint32_t cpu_id = rs_current_pcb_cpuid();
+    uint64_t period = apic_pmu_period[cpu_id];
+    if (period == 0)
+        return;
+
+    if (apic_pmu_sample_handler != NULL)
+        apic_pmu_sample_handler(regs);
+
+    // 若采样处理函数停止了计数器，则不再重新装载
+    if (apic_pmu_period[cpu_id] == 0)
+        return;
+    apic_pmu_reload(period);
+    if (apic_pmu_version >= 2)
+        wrmsr(IA32_PERF_GLOBAL_OVF_CTRL, 1);
+    // 投递中断时，处理器会自动屏蔽性能计数器的LVT，需要重新解除屏蔽
+    apic_pmu_write_LVT(APIC_PMU_IRQ_NUM);
+}
+
+static void apic_pmu_enable(uint64_t irq_num)
+{
+}
+
+static void apic_pmu_disable(uint64_t irq_num)
+{
+    apic_pmu_stop();
+}
+
+static uint64_t apic_pmu_install(uint64_t irq_num, void *arg)
+{
+    // 计数器在apic_pmu_start()时才会被启动
+    apic_pmu_write_LVT(APIC_LVT_INT_MASKED | APIC_PMU_IRQ_NUM);
+    return 0;
+}
+
+static void apic_pmu_uninstall(uint64_t irq_num)
+{
+    apic_pmu_write_LVT(APIC_LVT_INT_MASKED);
+}
+
+static hardware_intr_controller apic_pmu_intr_controller = {
+    .enable = apic_pmu_enable,
+    .disable = apic_pmu_disable,
+    .install = apic_pmu_install,
+    .uninstall = apic_pmu_uninstall,
+    .ack = apic_local_apic_edge_ack,
+};
+
+int apic_pmu_init(void (*handler)(struct pt_regs *regs))
+{
+    if (!apic_pmu_supported())
+        return -ENOTSUP;
+    apic_pmu_sample_handler = handler;
+    int retval = irq_register(APIC_PMU_IRQ_NUM, NULL, &apic_pmu_handler, 0, &apic_pmu_intr_controller, "apic pmu");
+    if (retval == 0)
+        kinfo("APIC PMU initialized, architectural perfmon version %d", apic_pmu_version);
+    return retval;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <common/glib.h>
+#include "apic.h"
+
+// local apic的性能计数器溢出中断向量号
+#define APIC_PMU_IRQ_NUM 153
+
+// 架构性能监控相关的MSR
+#define IA32_PMC0 0xc1
+#define IA32_PERFEVTSEL0 0x186
+#define IA32_PERF_GLOBAL_STATUS 0x38e
+#define IA32_PERF_GLOBAL_CTRL 0x38f
+#define IA32_PERF_GLOBAL_OVF_CTRL 0x390
+
+// IA32_PERFEVTSEL的标志位
+#define PERFEVTSEL_USR (1UL << 16)
+#define PERFEVTSEL_OS (1UL << 17)
+#define PERFEVTSEL_INT (1UL << 20)
+#define PERFEVTSEL_EN (1UL << 22)
+// 架构事件：UnHalted Core Cycles
+#define PERFEVTSEL_EVENT_CORE_CYCLES 0x3c
+
+/**
+ * @brief 检测当前处理器是否支持用通用性能计数器0对cpu周期进行计数
+ *
+ * @return true 支持
+ */
+bool apic_pmu_supported();
+
+/**
+ * @brief 注册性能计数器溢出中断
+ *
+ * @param handler 中断到来时调用的函数
+ * @return int 成功返回0
+ */
+int apic_pmu_init(void (*handler)(struct pt_regs *regs));
+
+/**
+ * @brief 在当前cpu上启动性能计数器，每经过period个cpu周期产生一次中断
+ *
+ * @param period 采样周期（cpu周期数），不能超过2^31
+ */
+void apic_pmu_start(uint64_t period);
+
+/**
+ * @brief 停止当前cpu上的性能计数器
+ */
+void apic_pmu_stop();
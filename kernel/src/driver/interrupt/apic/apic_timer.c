@@ -7,10 +7,14 @@
 // #pragma GCC push_options
 // #pragma GCC optimize("O0")
 uint64_t apic_timer_ticks_result = 0;
-static spinlock_t apic_timer_init_lock = {1};
+static DEFINE_SPINLOCK(apic_timer_init_lock);
 // bsp 是否已经完成apic时钟初始化
 static bool bsp_initialized = false;
 
+// 采样分析器的时钟中断钩子（定义在debug/profiler.rs）
+extern void rs_profile_tick(struct pt_regs *regs);
+extern void rs_cputime_account_tick(struct pt_regs *regs);
+
 /**
  * @brief 初始化AP核的apic时钟
  *
@@ -90,6 +94,8 @@ hardware_intr_controller apic_timer_intr_controller = {
 void apic_timer_handler(uint64_t number, uint64_t param, struct pt_regs *regs)
 {
     io_mfence();
+    rs_profile_tick(regs);
+    rs_cputime_account_tick(regs);
     sched_update_jiffies();
     io_mfence();
 }
@@ -2,10 +2,9 @@
 
 #include <common/unistd.h>
 #include "apic.h"
+#include "apic2rust.h"
 
 extern uint64_t apic_timer_ticks_result;
-// 5ms产生一次中断
-#define APIC_TIMER_INTERVAL 5
 #define APIC_TIMER_DIVISOR 3
 
 #define APIC_TIMER_IRQ_NUM 151
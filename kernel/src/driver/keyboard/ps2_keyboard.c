@@ -16,6 +16,10 @@ extern void ps2_keyboard_parse_keycode(uint8_t input);
 // 缓冲区读写锁
 static spinlock_t ps2_kb_buf_rw_lock;
 
+// 扫描码缓冲区：中断上半部存入扫描码，由中断线程解析
+static struct kfifo_t kb_scancode_buf;
+static spinlock_t ps2_kb_scancode_lock;
+
 /**
  * @brief 重置ps2键盘输入缓冲区
  *
@@ -34,6 +38,7 @@ hardware_intr_controller ps2_keyboard_intr_controller =
         .install = apic_ioapic_install,
         .uninstall = apic_ioapic_uninstall,
         .ack = apic_ioapic_edge_ack,
+        .set_affinity = apic_ioapic_set_affinity,
 
 };
 
@@ -133,15 +138,37 @@ struct vfs_file_operations_t ps2_keyboard_fops =
 
 /**
  * @brief 键盘中断处理函数（中断上半部）
- *  将数据存入缓冲区
+ *  读取扫描码并存入缓冲区，由中断线程解析
  * @param irq_num 中断向量号
- * @param param 参数
+ * @param buf_vaddr 扫描码缓冲区
  * @param regs 寄存器信息
  */
 void ps2_keyboard_handler(ul irq_num, ul buf_vaddr, struct pt_regs *regs)
 {
     unsigned char x = io_in8(PORT_PS2_KEYBOARD_DATA);
-    ps2_keyboard_parse_keycode((uint8_t)x);
+    kfifo_in_locked((struct kfifo_t *)buf_vaddr, &x, 1, &ps2_kb_scancode_lock);
+}
+
+/**
+ * @brief 键盘中断的线程化处理函数（中断下半部）
+ *  解析缓冲区中的扫描码，并将按键送往tty。解析时需要获取tty的锁，因此不在中断上下文中进行
+ * @param irq_num 中断向量号
+ * @param buf_vaddr 扫描码缓冲区
+ */
+void ps2_keyboard_thread_fn(ul irq_num, ul buf_vaddr)
+{
+    struct kfifo_t *fifo = (struct kfifo_t *)buf_vaddr;
+    uint8_t x;
+    while (1)
+    {
+        uint64_t flags;
+        spin_lock_irqsave(&ps2_kb_scancode_lock, flags);
+        uint32_t len = kfifo_out(fifo, &x, 1);
+        spin_unlock_irqrestore(&ps2_kb_scancode_lock, flags);
+        if (len == 0)
+            break;
+        ps2_keyboard_parse_keycode(x);
+    }
 }
 /**
  * @brief 初始化键盘驱动程序的函数
@@ -154,6 +181,7 @@ void ps2_keyboard_init()
 
     // 初始化键盘循环队列缓冲区
     kfifo_alloc(&kb_buf, ps2_keyboard_buffer_size, 0);
+    kfifo_alloc(&kb_scancode_buf, ps2_keyboard_scancode_buffer_size, 0);
 
     // ======== 初始化中断RTE entry ==========
 
@@ -186,9 +214,11 @@ void ps2_keyboard_init()
 
     // 初始化键盘缓冲区的读写锁
     spin_init(&ps2_kb_buf_rw_lock);
+    spin_init(&ps2_kb_scancode_lock);
 
-    // 注册中断处理程序
-    irq_register(PS2_KEYBOARD_INTR_VECTOR, &entry, &ps2_keyboard_handler, (ul)&kb_buf, &ps2_keyboard_intr_controller, "ps/2 keyboard");
+    // 注册中断处理程序：上半部只读取扫描码，解析扫描码的工作交给中断线程
+    irq_register_threaded(PS2_KEYBOARD_INTR_VECTOR, &entry, &ps2_keyboard_handler, &ps2_keyboard_thread_fn,
+                          (ul)&kb_scancode_buf, &ps2_keyboard_intr_controller, "ps/2 keyboard", 0);
 
     // 先读一下键盘的数据，防止由于在键盘初始化之前，由于按键被按下从而导致接收不到中断。
     io_in8(PORT_PS2_KEYBOARD_DATA);
@@ -6,6 +6,7 @@
 
 // 定义键盘循环队列缓冲区大小为100bytes
 #define ps2_keyboard_buffer_size 8
+#define ps2_keyboard_scancode_buffer_size 64 // 中断上半部与中断线程之间的扫描码缓冲区大小
 
 #define KEYBOARD_CMD_RESET_BUFFER 1
 
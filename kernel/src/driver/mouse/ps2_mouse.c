@@ -81,6 +81,7 @@ hardware_intr_controller ps2_mouse_intr_controller =
         .install = apic_ioapic_install,
         .uninstall = apic_ioapic_uninstall,
         .ack = apic_ioapic_edge_ack,
+        .set_affinity = apic_ioapic_set_affinity,
 
 };
 
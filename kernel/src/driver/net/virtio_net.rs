@@ -232,7 +232,11 @@ pub fn virtio_net<T: Transport + 'static>(transport: T) {
     let driver: VirtioNICDriver<T> = VirtioNICDriver::new(driver_net);
     let iface = VirtioInterface::new(driver);
     // 将网卡的接口信息注册到全局的网卡接口信息表中
-    NET_DRIVERS.write().insert(iface.nic_id(), iface.clone());
+    NET_DRIVERS.update(|drivers| {
+        let mut drivers = drivers.clone();
+        drivers.insert(iface.nic_id(), iface.clone());
+        drivers
+    });
     kinfo!(
         "Virtio-net driver init successfully!\tNetDevID: [{}], MAC: [{}]",
         iface.name(),
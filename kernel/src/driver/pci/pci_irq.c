@@ -5,6 +5,9 @@
 #include "common/string.h"
 #include "mm/slab.h"
 
+// 修改MSI/MSI-X中断的消息地址（由rust实现）
+extern int rs_pci_irq_set_affinity(ul irq_num, uint32_t apic_id);
+
 // 现在pci设备的中断由自己进行控制，这些不执行内容的函数是为了适配旧的中断处理机制
 void pci_irq_enable(ul irq_num)
 {
@@ -28,7 +31,8 @@ void pci_irq_uninstall(ul irq_num)
 /// @param parameter 中断处理函数传入参数
 /// @param irq_name 中断名字
 /// @param pci_irq_ack 对于中断的回复，为NULL时会使用默认回应
-uint16_t c_irq_install(ul irq_num,void (*pci_irq_handler)(ul irq_num, ul parameter, struct pt_regs *regs),ul parameter,const char *irq_name,void (*pci_irq_ack)(ul irq_num))
+/// @param affinity 中断被投递到的cpu的掩码（即MSI消息地址所指向的cpu）
+uint16_t c_irq_install(ul irq_num,void (*pci_irq_handler)(ul irq_num, ul parameter, struct pt_regs *regs),ul parameter,const char *irq_name,void (*pci_irq_ack)(ul irq_num),uint64_t affinity)
 {
     // 由于为I/O APIC分配的中断向量号是从32开始的，因此要减去32才是对应的interrupt_desc的元素
     irq_desc_t *p = NULL;
@@ -54,6 +58,7 @@ uint16_t c_irq_install(ul irq_num,void (*pci_irq_handler)(ul irq_num, ul paramet
         pci_interrupt_controller->install = pci_irq_install;
         pci_interrupt_controller->uninstall = pci_irq_uninstall;
         pci_interrupt_controller->ack = pci_irq_ack;
+        pci_interrupt_controller->set_affinity = rs_pci_irq_set_affinity;
         p->controller = pci_interrupt_controller;
     }
     size_t namelen = strlen(irq_name) + 1;
@@ -62,6 +67,8 @@ uint16_t c_irq_install(ul irq_num,void (*pci_irq_handler)(ul irq_num, ul paramet
     strncpy(p->irq_name, irq_name, namelen);
     p->parameter = parameter;
     p->flags = 0;
+    p->affinity = affinity;
+    p->thread_fn = NULL;
     p->handler = pci_irq_handler;
     return 0;
 };
@@ -91,5 +98,8 @@ void c_irq_uninstall(ul irq_num)
         p->controller = NULL;
     }
     p->parameter = 0;
+    p->flags = 0;
+    p->affinity = 0;
+    p->thread_fn = NULL;
     p->handler = NULL;
 }
\ No newline at end of file
@@ -3,16 +3,100 @@
 use core::mem::size_of;
 use core::ptr::NonNull;
 
+use alloc::collections::BTreeMap;
 use alloc::ffi::CString;
 use alloc::vec::Vec;
 
-use super::pci::{PciDeviceStructure, PciDeviceStructureGeneralDevice, PciError};
+use super::pci::{
+    BusDeviceFunction, PciDeviceStructure, PciDeviceStructureGeneralDevice, PciError,
+};
 use crate::arch::msi::{ia64_pci_get_arch_msi_message_address, ia64_pci_get_arch_msi_message_data};
 use crate::arch::{PciArch, TraitPciArch};
+use crate::exception::irq::{irq_get_affinity, irq_set_affinity};
 use crate::include::bindings::bindings::{
-    c_irq_install, c_irq_uninstall, pt_regs, ul, EAGAIN, EINVAL,
+    c_irq_install, c_irq_uninstall, cpu_core_info, pt_regs, ul, EAGAIN, EINVAL,
 };
+use crate::libs::spinlock::SpinLock;
 use crate::libs::volatile::{volread, volwrite, Volatile, VolatileReadable, VolatileWritable};
+use crate::mm::VirtAddr;
+
+lazy_static! {
+    /// 已经安装的MSI/MSI-X中断的消息地址所在的位置（以中断向量号为索引），用于修改中断的目标处理器
+    static ref MSI_TARGETS: SpinLock<BTreeMap<u16, MsiTarget>> = SpinLock::new(BTreeMap::new());
+}
+
+/// MSI/MSI-X中断的消息地址所在的位置
+#[derive(Copy, Clone, Debug)]
+enum MsiTarget {
+    /// MSI的消息地址位于配置空间中，同一设备的所有向量共用一个地址
+    Msi {
+        bus_device_function: BusDeviceFunction,
+        cap_offset: u8,
+    },
+    /// MSI-X表项的虚拟地址，每个向量有独立的地址
+    Msix { entry: VirtAddr },
+}
+
+/// @brief 只包含processor的亲和性掩码
+///
+/// 掩码只有64位，编号更大的处理器返回InvalidProcessor
+fn processor_affinity(processor: u16) -> Result<u64, PciError> {
+    return 1u64
+        .checked_shl(processor as u32)
+        .ok_or(PciError::PciIrqError(PciIrqError::InvalidProcessor(
+            processor,
+        )));
+}
+
+/// @brief 获取cpu对应的APIC ID
+#[inline]
+fn cpu_apic_id(processor: u16) -> u16 {
+    return unsafe { cpu_core_info[processor as usize].apic_id as u16 };
+}
+
+/// @brief 修改MSI/MSI-X中断的目标处理器。对于MSI中断，同一设备的所有向量会一起被迁移
+/// @param irq_num 中断向量号
+/// @param apic_id 目标处理器的APIC ID
+/// @return 一切正常返回Ok(0),有错误返回对应错误原因
+pub fn pci_irq_set_affinity(irq_num: u16, apic_id: u32) -> Result<u8, PciError> {
+    if apic_id > 0xff {
+        return Err(PciError::PciIrqError(PciIrqError::InvalidIrqNum(irq_num)));
+    }
+    let msg_address = ia64_pci_get_arch_msi_message_address(apic_id as u16);
+    // 在持有锁的情况下修改，防止与中断的卸载并发
+    let targets = MSI_TARGETS.lock_irqsave();
+    match targets.get(&irq_num) {
+        Some(MsiTarget::Msi {
+            bus_device_function,
+            cap_offset,
+        }) => {
+            PciArch::write_config(bus_device_function, cap_offset + 4, msg_address);
+        }
+        Some(MsiTarget::Msix { entry }) => {
+            let msix_entry = NonNull::new(entry.data() as *mut MsixEntry).unwrap();
+            unsafe {
+                // 修改期间屏蔽该表项，防止设备使用新旧混合的消息
+                let vector_control = volread!(msix_entry, vector_control);
+                volwrite!(msix_entry, vector_control, vector_control | 1);
+                volwrite!(msix_entry, msg_addr, msg_address);
+                volwrite!(msix_entry, vector_control, vector_control);
+            }
+        }
+        None => {
+            return Err(PciError::PciIrqError(PciIrqError::IrqNotInited));
+        }
+    }
+    return Ok(0);
+}
+
+/// @brief 供中断子系统调用的MSI/MSI-X中断的set_affinity接口
+#[no_mangle]
+pub extern "C" fn rs_pci_irq_set_affinity(irq_num: ul, apic_id: u32) -> i32 {
+    match pci_irq_set_affinity(irq_num as u16, apic_id) {
+        Ok(_) => 0,
+        Err(_) => -(EINVAL as i32),
+    }
+}
 
 /// MSIX表的一项
 #[repr(C)]
@@ -42,6 +126,8 @@ pub enum PciIrqError {
     BarGetVaddrFailed,
     MaskNotSupported,
     IrqNotInited,
+    /// 处理器的编号超出了亲和性掩码能表示的范围
+    InvalidProcessor(u16),
 }
 /// PCI设备的中断类型
 #[derive(Copy, Clone, Debug)]
@@ -319,6 +405,25 @@ pub trait PciInterrupt: PciDeviceStructure {
                     }
                     let irq_num =
                         self.irq_vector_mut().unwrap()[msg.irq_common_message.irq_index as usize];
+                    let (processor, trigger) = match msg.irq_specific_message {
+                        IrqSpecificMsg::Legacy => {
+                            return Err(PciError::PciIrqError(PciIrqError::IrqTypeUnmatch));
+                        }
+                        IrqSpecificMsg::Msi {
+                            processor,
+                            trigger_mode,
+                        } => (processor, trigger_mode),
+                    };
+                    // 同一个设备的所有MSI中断都投递到第0个中断的目标cpu上
+                    let affinity = if msg.irq_common_message.irq_index == 0 {
+                        processor_affinity(processor)?
+                    } else {
+                        let first_irq = self.irq_vector_mut().unwrap()[0];
+                        match irq_get_affinity(first_irq as u64) {
+                            Some(affinity) => affinity,
+                            None => processor_affinity(processor)?,
+                        }
+                    };
                     let common_msg = &msg.irq_common_message;
                     let result = unsafe {
                         c_irq_install(
@@ -327,6 +432,7 @@ pub trait PciInterrupt: PciDeviceStructure {
                             common_msg.irq_parameter as u64,
                             common_msg.irq_name.as_ptr(),
                             common_msg.irq_ack,
+                            affinity,
                         )
                     };
                     match result as u32 {
@@ -340,16 +446,19 @@ pub trait PciInterrupt: PciDeviceStructure {
                         }
                         _ => {}
                     }
+                    MSI_TARGETS.lock_irqsave().insert(
+                        irq_num,
+                        MsiTarget::Msi {
+                            bus_device_function: self.common_header().bus_device_function,
+                            cap_offset,
+                        },
+                    );
                     //MSI中断只需配置一次PCI寄存器
                     if common_msg.irq_index == 0 {
-                        let msg_address = ia64_pci_get_arch_msi_message_address(0);
-                        let trigger = match msg.irq_specific_message {
-                            IrqSpecificMsg::Legacy => {
-                                return Err(PciError::PciIrqError(PciIrqError::IrqTypeUnmatch));
-                            }
-                            IrqSpecificMsg::Msi { trigger_mode, .. } => trigger_mode,
-                        };
-                        let msg_data = ia64_pci_get_arch_msi_message_data(irq_num, 0, trigger);
+                        let apic_id = cpu_apic_id(processor);
+                        let msg_address = ia64_pci_get_arch_msi_message_address(apic_id);
+                        let msg_data =
+                            ia64_pci_get_arch_msi_message_data(irq_num, apic_id, trigger);
                         //写入Message Data和Message Address
                         if address_64 {
                             PciArch::write_config(
@@ -468,6 +577,16 @@ pub trait PciInterrupt: PciDeviceStructure {
                     }
                     let irq_num =
                         self.irq_vector_mut().unwrap()[msg.irq_common_message.irq_index as usize];
+                    let (processor, trigger) = match msg.irq_specific_message {
+                        IrqSpecificMsg::Legacy => {
+                            return Err(PciError::PciIrqError(PciIrqError::IrqTypeUnmatch));
+                        }
+                        IrqSpecificMsg::Msi {
+                            processor,
+                            trigger_mode,
+                        } => (processor, trigger_mode),
+                    };
+                    let affinity = processor_affinity(processor)?;
                     let common_msg = &msg.irq_common_message;
                     let result = unsafe {
                         c_irq_install(
@@ -476,6 +595,7 @@ pub trait PciInterrupt: PciDeviceStructure {
                             common_msg.irq_parameter as u64,
                             common_msg.irq_name.as_ptr(),
                             common_msg.irq_ack,
+                            affinity,
                         )
                     };
                     match result as u32 {
@@ -490,14 +610,9 @@ pub trait PciInterrupt: PciDeviceStructure {
                         _ => {}
                     }
 
-                    let msg_address = ia64_pci_get_arch_msi_message_address(0);
-                    let trigger = match msg.irq_specific_message {
-                        IrqSpecificMsg::Legacy => {
-                            return Err(PciError::PciIrqError(PciIrqError::IrqTypeUnmatch));
-                        }
-                        IrqSpecificMsg::Msi { trigger_mode, .. } => trigger_mode,
-                    };
-                    let msg_data = ia64_pci_get_arch_msi_message_data(irq_num, 0, trigger);
+                    let apic_id = cpu_apic_id(processor);
+                    let msg_address = ia64_pci_get_arch_msi_message_address(apic_id);
+                    let msg_data = ia64_pci_get_arch_msi_message_data(irq_num, apic_id, trigger);
                     //写入Message Data和Message Address
                     let pcistandardbar = self
                         .bar()
@@ -509,6 +624,9 @@ pub trait PciInterrupt: PciDeviceStructure {
                         + msix_table_offset as usize
                         + msg.irq_common_message.irq_index as usize * size_of::<MsixEntry>();
                     let msix_entry = NonNull::new(vaddr.data() as *mut MsixEntry).unwrap();
+                    MSI_TARGETS
+                        .lock_irqsave()
+                        .insert(irq_num, MsiTarget::Msix { entry: vaddr });
                     unsafe {
                         volwrite!(msix_entry, vector_control, 0);
                         volwrite!(msix_entry, msg_data, msg_data);
@@ -560,6 +678,7 @@ pub trait PciInterrupt: PciDeviceStructure {
                     ..
                 } => {
                     for vector in self.irq_vector_mut().unwrap() {
+                        MSI_TARGETS.lock_irqsave().remove(vector);
                         unsafe {
                             c_irq_uninstall(vector.clone() as u64);
                         }
@@ -607,6 +726,7 @@ pub trait PciInterrupt: PciDeviceStructure {
                     ..
                 } => {
                     for vector in self.irq_vector_mut().unwrap() {
+                        MSI_TARGETS.lock_irqsave().remove(vector);
                         unsafe {
                             c_irq_uninstall(vector.clone() as u64);
                         }
@@ -644,6 +764,21 @@ pub trait PciInterrupt: PciDeviceStructure {
         }
         return Err(PciError::PciIrqError(PciIrqError::PciDeviceNotSupportIrq));
     }
+    /// @brief 修改相应位置的中断的目标处理器（MSI中断的所有向量共用一个目标处理器）
+    /// @param self PCI设备的可变引用
+    /// @param irq_index 中断的位置（在vec中的index和安装的index相同）
+    /// @param processor 目标处理器的编号
+    fn irq_set_affinity(&mut self, irq_index: u16, processor: u16) -> Result<u8, PciError> {
+        let irq_num = *self
+            .irq_vector_mut()
+            .and_then(|irq_vector| irq_vector.get(irq_index as usize))
+            .ok_or(PciError::PciIrqError(PciIrqError::InvalidIrqIndex(
+                irq_index,
+            )))?;
+        irq_set_affinity(irq_num as u64, processor_affinity(processor)?)
+            .map_err(|_| PciError::PciIrqError(PciIrqError::InvalidIrqNum(irq_num)))?;
+        return Ok(0);
+    }
     /// @brief 屏蔽相应位置的中断
     /// @param self PCI设备的可变引用
     /// @param irq_index 中断的位置（在vec中的index和安装的index相同）
@@ -61,6 +61,7 @@ hardware_intr_controller HPET_intr_controller =
         .install = apic_ioapic_install,
         .uninstall = apic_ioapic_uninstall,
         .ack = apic_ioapic_edge_ack,
+        .set_affinity = apic_ioapic_set_affinity,
 };
 
 void HPET_handler(uint64_t number, uint64_t param, struct pt_regs *regs)
@@ -1,7 +1,7 @@
 use core::{
     ffi::{c_uint, c_void},
     mem::MaybeUninit,
-    sync::atomic::{AtomicBool, Ordering},
+    sync::atomic::{AtomicBool, AtomicU32, Ordering},
 };
 
 use alloc::{boxed::Box, sync::Arc};
@@ -45,6 +45,12 @@ pub struct VideoRefreshManager {
     fb_info: multiboot_tag_framebuffer_info_t,
     refresh_target: RwLock<Option<Arc<SpinLock<Box<[u32]>>>>>,
     running: AtomicBool,
+    /// 双缓冲区中自上次刷新以来被修改过的像素行的范围[dirty_start, dirty_end)，
+    /// dirty_start >= dirty_end表示没有被修改过。
+    ///
+    /// 修改双缓冲区的一方以及刷新任务都要在持有双缓冲区的锁时访问它们
+    dirty_start: AtomicU32,
+    dirty_end: AtomicU32,
 }
 
 const REFRESH_INTERVAL: u64 = 30;
@@ -155,11 +161,44 @@ impl VideoRefreshManager {
         let mut refresh_target = self.refresh_target.write_irqsave();
         if let ScmBuffer::DoubleBuffer(double_buffer) = &buf_info.buf {
             *refresh_target = Some(double_buffer.clone());
+            self.mark_all_dirty();
             return Ok(());
         }
         return Err(SystemError::EINVAL);
     }
 
+    /// @brief 标记双缓冲区中[y_start, y_end)范围内的像素行已被修改，下次刷新时需要拷贝到帧缓冲区
+    ///
+    /// 调用者需要持有双缓冲区的锁
+    #[inline]
+    pub fn mark_dirty(&self, y_start: u32, y_end: u32) {
+        self.dirty_start.fetch_min(y_start, Ordering::Relaxed);
+        self.dirty_end.fetch_max(y_end, Ordering::Relaxed);
+    }
+
+    /// @brief 标记整个双缓冲区都已被修改
+    #[inline]
+    pub fn mark_all_dirty(&self) {
+        self.mark_dirty(0, self.fb_info.framebuffer_height);
+    }
+
+    /// @brief 自上次刷新以来，双缓冲区是否被修改过（不持有锁时只能作为提示）
+    #[inline]
+    fn is_dirty(&self) -> bool {
+        return self.dirty_start.load(Ordering::Relaxed) < self.dirty_end.load(Ordering::Relaxed);
+    }
+
+    /// @brief 取出并清空被修改过的像素行的范围。调用者需要持有双缓冲区的锁
+    fn take_dirty(&self) -> Option<(u32, u32)> {
+        let start = self.dirty_start.swap(u32::MAX, Ordering::Relaxed);
+        let end = self.dirty_end.swap(0, Ordering::Relaxed);
+        let end = end.min(self.fb_info.framebuffer_height);
+        if start >= end {
+            return None;
+        }
+        return Some((start, end));
+    }
+
     #[allow(dead_code)]
     pub fn refresh_target(&self) -> RwLockReadGuard<'_, Option<Arc<SpinLock<Box<[u32]>>>>> {
         let x = self.refresh_target.read();
@@ -240,6 +279,8 @@ impl VideoRefreshManager {
             device_buffer: RwLock::new(device_buffer),
             refresh_target: RwLock::new(None),
             running: AtomicBool::new(false),
+            dirty_start: AtomicU32::new(u32::MAX),
+            dirty_end: AtomicU32::new(0),
         };
 
         __MAMAGER = Some(result);
@@ -278,6 +319,12 @@ impl TimerFunction for VideoRefreshExecutor {
             }
         };
 
+        // 屏幕内容没有变化，不需要刷新
+        if !manager.is_dirty() {
+            start_next_refresh();
+            return Ok(());
+        }
+
         let mut refresh_target: Option<RwLockReadGuard<'_, Option<Arc<SpinLock<Box<[u32]>>>>>> =
             None;
         const TRY_TIMES: i32 = 2;
@@ -309,12 +356,20 @@ impl TimerFunction for VideoRefreshExecutor {
                 start_next_refresh();
                 return Ok(());
             }
-            let mut target_guard = target_guard.unwrap();
-            unsafe {
-                p.copy_from_nonoverlapping(
-                    target_guard.as_mut_ptr() as *mut u8,
-                    manager.device_buffer().buf_size() as usize,
-                )
+            let target_guard = target_guard.unwrap();
+            // 只拷贝被修改过的像素行
+            if let Some((start, end)) = manager.take_dirty() {
+                let bytes_per_line = manager.device_buffer().buf_size()
+                    / manager.fb_info.framebuffer_height as usize;
+                let offset = start as usize * bytes_per_line;
+                let len = (end - start) as usize * bytes_per_line;
+                unsafe {
+                    copy_to_framebuffer(
+                        p.add(offset),
+                        (target_guard.as_ptr() as *const u8).add(offset),
+                        len,
+                    )
+                };
             }
         }
 
@@ -324,6 +379,34 @@ impl TimerFunction for VideoRefreshExecutor {
     }
 }
 
+/// @brief 把数据拷贝到帧缓冲区
+///
+/// 帧缓冲区不会被cpu读取，使用非临时存储指令写入，避免污染cache
+///
+/// ## 安全性
+///
+/// dst和src都需要按4字节对齐，len需要是4的倍数
+#[cfg(target_arch = "x86_64")]
+unsafe fn copy_to_framebuffer(dst: *mut u8, src: *const u8, len: usize) {
+    let dst = dst as *mut u32;
+    let src = src as *const u32;
+    for i in 0..len / 4 {
+        core::arch::asm!(
+            "movnti [{0}], {1:e}",
+            in(reg) dst.add(i),
+            in(reg) src.add(i).read(),
+            options(nostack, preserves_flags)
+        );
+    }
+    // 非临时存储是弱序的，需要确保它们在返回之前全部完成
+    core::arch::asm!("sfence", options(nostack, preserves_flags));
+}
+
+#[cfg(not(target_arch = "x86_64"))]
+unsafe fn copy_to_framebuffer(dst: *mut u8, src: *const u8, len: usize) {
+    dst.copy_from_nonoverlapping(src, len);
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn rs_video_init() -> i32 {
     return VideoRefreshManager::video_init()
@@ -12,7 +12,9 @@
 #include <common/asm.h>
 #include <common/printk.h>
 #include <common/string.h>
+#include <common/cpu.h>
 #include <mm/slab.h>
+#include <smp/smp.h>
 extern void ignore_int();
 
 #pragma GCC push_options
@@ -210,6 +212,8 @@ int irq_register(ul irq_num, void *arg, void (*handler)(ul irq_num, ul parameter
 
     p->parameter = paramater;
     p->flags = 0;
+    p->affinity = IRQ_AFFINITY_DEFAULT;
+    p->thread_fn = NULL;
     p->handler = handler;
     io_mfence();
     p->controller->install(irq_num, arg);
@@ -220,6 +224,126 @@ int irq_register(ul irq_num, void *arg, void (*handler)(ul irq_num, ul parameter
     return 0;
 }
 
+/**
+ * @brief 注册线程化的中断
+ *
+ * @param irq_num 中断向量号
+ * @param arg 传递给中断安装接口的参数
+ * @param handler 在中断上下文中执行的处理函数（可以为NULL）
+ * @param thread_fn 在内核线程中执行的处理函数
+ * @param paramater 中断处理函数的参数
+ * @param controller 中断控制器结构
+ * @param irq_name 中断名
+ * @param flags 额外的标志位（如IRQ_FLAG_ONESHOT）
+ * @return int
+ */
+int irq_register_threaded(ul irq_num, void *arg, void (*handler)(ul irq_num, ul parameter, struct pt_regs *regs),
+                          void (*thread_fn)(ul irq_num, ul parameter), ul paramater,
+                          hardware_intr_controller *controller, char *irq_name, ul flags)
+{
+    if (thread_fn == NULL)
+        return -EINVAL;
+    irq_desc_t *p = irq_get_desc(irq_num);
+    if (p == NULL)
+    {
+        kerror("irq_register_threaded(): invalid irq num: %ld.", irq_num);
+        return -EINVAL;
+    }
+    // 先准备好中断线程，再使能中断
+    int retval = rs_irq_thread_create(irq_num, irq_name);
+    if (retval != 0)
+        return retval;
+
+    retval = irq_register(irq_num, arg, handler, paramater, controller, irq_name);
+    if (retval != 0)
+        return retval;
+    // irq_register()会清空标志位，因此需要在使能中断之后立即设置。在此之前到来的中断只会执行handler
+    p->thread_fn = thread_fn;
+    p->flags = IRQ_FLAG_THREADED | (flags & IRQ_FLAG_ONESHOT);
+    io_mfence();
+    return 0;
+}
+
+/**
+ * @brief 获取中断向量号对应的中断描述结构体
+ *
+ * @param irq_num 中断向量号
+ * @return irq_desc_t* 向量号无效时返回NULL
+ */
+irq_desc_t *irq_get_desc(ul irq_num)
+{
+    if (irq_num >= 32 && irq_num < 32 + IRQ_NUM)
+        return &interrupt_desc[irq_num - 32];
+    else if (irq_num >= 150 && irq_num < 150 + LOCAL_APIC_IRQ_NUM)
+        return &local_apic_interrupt_desc[irq_num - 150];
+    return NULL;
+}
+
+/**
+ * @brief 设置中断的cpu亲和性，中断将被投递到掩码中编号最小的在线cpu上
+ *
+ * @param irq_num 中断向量号
+ * @param mask cpu掩码
+ * @return int 成功则返回目标cpu的编号，失败则返回负的错误码
+ */
+int irq_set_affinity(ul irq_num, uint64_t mask)
+{
+    irq_desc_t *p = irq_get_desc(irq_num);
+    if (p == NULL || p->controller == NULL)
+        return -EINVAL;
+    if (p->controller->set_affinity == NULL)
+        return -ENOTSUP;
+
+    uint32_t total_cpu = smp_get_total_cpu();
+    if (total_cpu < 64)
+        mask &= (1UL << total_cpu) - 1;
+    if (mask == 0)
+        return -EINVAL;
+
+    uint32_t cpu_id = __builtin_ctzl(mask);
+    int retval = p->controller->set_affinity(irq_num, cpu_core_info[cpu_id].apic_id);
+    if (retval != 0)
+        return retval;
+    p->affinity = mask;
+    io_mfence();
+
+    // 中断线程跟随中断迁移到目标cpu上，以便复用中断处理函数预热过的缓存
+    if (p->flags & IRQ_FLAG_THREADED)
+        rs_irq_thread_set_affinity(irq_num, cpu_id);
+    return cpu_id;
+}
+
+/**
+ * @brief 获取中断的cpu亲和性
+ *
+ * @param irq_num 中断向量号
+ * @return uint64_t cpu掩码（中断未注册时返回0）
+ */
+uint64_t irq_get_affinity(ul irq_num)
+{
+    irq_desc_t *p = irq_get_desc(irq_num);
+    if (p == NULL || p->controller == NULL)
+        return 0;
+    return p->affinity;
+}
+
+/**
+ * @brief 执行线程化中断的处理函数（由中断线程调用）
+ *
+ * @param irq_num 中断向量号
+ */
+void irq_run_thread_fn(ul irq_num)
+{
+    irq_desc_t *p = irq_get_desc(irq_num);
+    if (p == NULL || p->thread_fn == NULL)
+        return;
+    p->thread_fn(irq_num, p->parameter);
+
+    // 中断在进入线程之前被屏蔽了，处理完毕后重新使能
+    if ((p->flags & IRQ_FLAG_ONESHOT) && p->controller != NULL)
+        p->controller->enable(irq_num);
+}
+
 /**
  * @brief 中断注销函数
  *
@@ -238,6 +362,8 @@ int irq_unregister(ul irq_num)
     p->irq_name = NULL;
     p->parameter = NULL;
     p->flags = 0;
+    p->affinity = 0;
+    p->thread_fn = NULL;
     p->handler = NULL;
 
     return 0;
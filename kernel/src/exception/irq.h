@@ -27,6 +27,11 @@ extern void do_IRQ(struct pt_regs *regs, ul number);
 extern void (*SMP_interrupt_table[SMP_IRQ_NUM])(void);
 
 extern void (*syscall_intr_table[1])(void);
+
+// ==================implementation with rust===================
+extern int rs_irq_thread_create(ul irq_num, const char *irq_name);
+extern void rs_irq_wake_thread(ul irq_num);
+extern void rs_irq_thread_set_affinity(ul irq_num, uint32_t cpu_id);
 extern void (*local_apic_interrupt_table[LOCAL_APIC_IRQ_NUM])(void);
 
 /* ========= 中断向量分配表 ==========
@@ -119,6 +124,8 @@ typedef struct hardware_intr_type
     void (*uninstall)(ul irq_num);
     // 应答中断操作接口
     void (*ack)(ul irq_num);
+    // 设置中断投递的目标处理器（可为NULL，表示不支持修改）
+    int (*set_affinity)(ul irq_num, uint32_t apic_id);
 } hardware_intr_controller;
 
 // 中断描述结构体
@@ -134,8 +141,20 @@ typedef struct
 
     // 自定义的标志位
     ul flags;
+
+    // 允许处理该中断的cpu的掩码
+    uint64_t affinity;
+    // 线程化中断的处理函数（在内核线程中执行，可以睡眠）
+    void (*thread_fn)(ul irq_num, ul parameter);
 } irq_desc_t;
 
+// irq_desc_t的标志位
+#define IRQ_FLAG_THREADED (1UL << 0) // 中断具有在内核线程中执行的处理函数
+#define IRQ_FLAG_ONESHOT (1UL << 1)  // 在线程化的处理函数执行完毕之前屏蔽该中断（用于电平触发的中断）
+
+// 默认只有BSP处理外部中断
+#define IRQ_AFFINITY_DEFAULT (1UL << 0)
+
 
 // 这几个表一定要放在这里，否则在HPET初始化后收到中断，会产生page fault
 irq_desc_t interrupt_desc[IRQ_NUM] = {0};
@@ -156,6 +175,57 @@ irq_desc_t SMP_IPI_desc[SMP_IRQ_NUM] = {0};
  */
 int irq_register(ul irq_num, void *arg, void (*handler)(ul irq_num, ul parameter, struct pt_regs *regs), ul paramater, hardware_intr_controller *controller, char *irq_name);
 
+/**
+ * @brief 注册线程化的中断
+ *
+ * 中断发生时，先在中断上下文中执行handler（可以为NULL），然后唤醒该中断的内核线程执行thread_fn。
+ *
+ * @param irq_num 中断向量号
+ * @param arg 传递给中断安装接口的参数
+ * @param handler 在中断上下文中执行的处理函数（可以为NULL）
+ * @param thread_fn 在内核线程中执行的处理函数
+ * @param paramater 中断处理函数的参数
+ * @param controller 中断控制器结构
+ * @param irq_name 中断名
+ * @param flags 额外的标志位（如IRQ_FLAG_ONESHOT）
+ * @return int
+ */
+int irq_register_threaded(ul irq_num, void *arg, void (*handler)(ul irq_num, ul parameter, struct pt_regs *regs),
+                          void (*thread_fn)(ul irq_num, ul parameter), ul paramater,
+                          hardware_intr_controller *controller, char *irq_name, ul flags);
+
+/**
+ * @brief 获取中断向量号对应的中断描述结构体
+ *
+ * @param irq_num 中断向量号
+ * @return irq_desc_t* 向量号无效时返回NULL
+ */
+irq_desc_t *irq_get_desc(ul irq_num);
+
+/**
+ * @brief 设置中断的cpu亲和性，中断将被投递到掩码中编号最小的在线cpu上
+ *
+ * @param irq_num 中断向量号
+ * @param mask cpu掩码
+ * @return int 成功则返回目标cpu的编号，失败则返回负的错误码
+ */
+int irq_set_affinity(ul irq_num, uint64_t mask);
+
+/**
+ * @brief 获取中断的cpu亲和性
+ *
+ * @param irq_num 中断向量号
+ * @return uint64_t cpu掩码（中断未注册时返回0）
+ */
+uint64_t irq_get_affinity(ul irq_num);
+
+/**
+ * @brief 执行线程化中断的处理函数（由中断线程调用）
+ *
+ * @param irq_num 中断向量号
+ */
+void irq_run_thread_fn(ul irq_num);
+
 /**
  * @brief 中断注销函数
  * 
@@ -0,0 +1,238 @@
+//! 中断的cpu亲和性与线程化中断
+//!
+//! 中断描述结构体以及中断控制器的操作接口定义在irq.c中，这里负责：
+//!
+//! - 为线程化的中断创建内核线程，并在中断到来时唤醒它
+//! - 对外提供设置中断cpu亲和性的接口
+use core::{
+    ffi::{c_char, CStr},
+    ops::Range,
+    sync::atomic::{AtomicBool, Ordering},
+};
+
+use alloc::{
+    boxed::Box,
+    collections::BTreeMap,
+    format,
+    string::{String, ToString},
+    sync::Arc,
+    vec::Vec,
+};
+
+use crate::{
+    arch::{sched::sched, CurrentIrqArch},
+    exception::InterruptArch,
+    include::bindings::bindings::ul,
+    kwarn,
+    libs::{rcu::Rcu, spinlock::SpinLock},
+    process::{
+        kthread::{KernelThreadClosure, KernelThreadMechanism},
+        ProcessControlBlock, ProcessManager,
+    },
+    syscall::SystemError,
+};
+
+extern "C" {
+    #[link_name = "irq_set_affinity"]
+    fn c_irq_set_affinity(irq_num: ul, mask: u64) -> i32;
+    #[link_name = "irq_get_affinity"]
+    fn c_irq_get_affinity(irq_num: ul) -> u64;
+    fn irq_run_thread_fn(irq_num: ul);
+}
+
+/// 外部中断（I/O APIC）的向量号范围
+pub const IOAPIC_IRQ_RANGE: Range<u64> = 32..56;
+/// Local APIC中断（包括MSI/MSI-X）的向量号范围
+pub const LOCAL_APIC_IRQ_RANGE: Range<u64> = 150..200;
+
+lazy_static! {
+    /// 线程化中断的内核线程（以中断向量号为索引）
+    static ref IRQ_THREADS: Rcu<BTreeMap<u64, Arc<IrqThread>>> = Rcu::new(BTreeMap::new());
+}
+
+/// 线程化中断的内核线程
+#[derive(Debug)]
+struct IrqThread {
+    irq_num: u64,
+    name: String,
+    /// 中断是否已经到来、等待线程处理
+    pending: SpinLock<bool>,
+    /// 内核线程是否已经（或正在）被创建
+    spawned: AtomicBool,
+    /// 内核线程的pcb。在kthreadd启动之前注册的中断，其线程会被推迟到irq_thread_init()时再创建
+    pcb: SpinLock<Option<Arc<ProcessControlBlock>>>,
+    /// 线程要绑定到的cpu
+    cpu: SpinLock<Option<u32>>,
+}
+
+impl IrqThread {
+    /// 创建内核线程（若尚未创建）
+    fn spawn(&self) -> Result<(), SystemError> {
+        if self.spawned.swap(true, Ordering::AcqRel) {
+            return Ok(());
+        }
+        let pcb = KernelThreadMechanism::create(
+            KernelThreadClosure::UsizeClosure((Box::new(irq_thread), self.irq_num as usize)),
+            format!("irq/{}-{}", self.irq_num, self.name),
+        )
+        .ok_or_else(|| {
+            self.spawned.store(false, Ordering::Release);
+            SystemError::ENOMEM
+        })?;
+        if let Some(cpu_id) = *self.cpu.lock_irqsave() {
+            KernelThreadMechanism::bind(&pcb, cpu_id);
+        }
+        *self.pcb.lock_irqsave() = Some(pcb.clone());
+        ProcessManager::wakeup(&pcb)?;
+        return Ok(());
+    }
+
+    /// 在中断上下文中调用，唤醒内核线程
+    ///
+    /// 内核线程尚未创建时（kthreadd启动之前），只记录中断已经到来，绝不在中断上下文中执行thread_fn。
+    /// 对于IRQ_FLAG_ONESHOT的中断，其中断线在线程处理完毕之前保持屏蔽；
+    /// 线程在irq_thread_init()中被创建后，会立即处理这些被推迟的中断
+    fn wakeup(&self) {
+        let mut pending = self.pending.lock_irqsave();
+        *pending = true;
+        drop(pending);
+
+        if let Some(pcb) = self.pcb.lock_irqsave().clone() {
+            ProcessManager::wakeup(&pcb).ok();
+        }
+    }
+}
+
+/// 线程化中断的内核线程的主循环
+fn irq_thread(irq_num: usize) -> i32 {
+    let thread = match IRQ_THREADS.read().get(&(irq_num as u64)) {
+        Some(thread) => thread.clone(),
+        None => return -1,
+    };
+    let pcb = ProcessManager::current_pcb();
+
+    loop {
+        let irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
+        let mut pending = thread.pending.lock();
+        if *pending {
+            *pending = false;
+            drop(pending);
+            drop(irq_guard);
+            unsafe { irq_run_thread_fn(irq_num as ul) };
+            continue;
+        }
+
+        if KernelThreadMechanism::should_stop(&pcb) {
+            return 0;
+        }
+        // 持有pending的锁时标记睡眠，避免在此期间到来的中断的唤醒丢失
+        ProcessManager::mark_sleep(true).ok();
+        drop(pending);
+        drop(irq_guard);
+        sched();
+    }
+}
+
+/// @brief 为线程化的中断注册内核线程（由irq_register_threaded调用）
+///
+/// @return 成功返回0，失败返回负的错误码
+#[no_mangle]
+pub extern "C" fn rs_irq_thread_create(irq_num: ul, irq_name: *const c_char) -> i32 {
+    let name = if irq_name.is_null() {
+        String::from("unknown")
+    } else {
+        unsafe { CStr::from_ptr(irq_name) }
+            .to_string_lossy()
+            .to_string()
+    };
+    let thread = Arc::new(IrqThread {
+        irq_num,
+        name,
+        pending: SpinLock::new(false),
+        spawned: AtomicBool::new(false),
+        pcb: SpinLock::new(None),
+        cpu: SpinLock::new(None),
+    });
+    IRQ_THREADS.update(|threads| {
+        let mut threads = threads.clone();
+        threads.insert(irq_num, thread.clone());
+        threads
+    });
+
+    // kthreadd尚未启动时，推迟到irq_thread_init()再创建
+    if KernelThreadMechanism::daemon_started() {
+        if let Err(e) = thread.spawn() {
+            return e.to_posix_errno();
+        }
+    }
+    return 0;
+}
+
+/// @brief 唤醒中断的内核线程（由中断处理程序调用）
+#[no_mangle]
+pub extern "C" fn rs_irq_wake_thread(irq_num: ul) {
+    let threads = IRQ_THREADS.read();
+    match threads.get(&irq_num) {
+        Some(thread) => thread.wakeup(),
+        None => kwarn!("Threaded irq {} does not have a thread!", irq_num),
+    }
+}
+
+/// @brief 中断的cpu亲和性被修改后，把中断线程迁移到新的目标cpu上
+#[no_mangle]
+pub extern "C" fn rs_irq_thread_set_affinity(irq_num: ul, cpu_id: u32) {
+    let thread = match IRQ_THREADS.read().get(&irq_num) {
+        Some(thread) => thread.clone(),
+        None => return,
+    };
+    *thread.cpu.lock_irqsave() = Some(cpu_id);
+    if let Some(pcb) = thread.pcb.lock_irqsave().as_ref() {
+        KernelThreadMechanism::bind(pcb, cpu_id);
+    }
+}
+
+/// @brief 为kthreadd启动之前注册的线程化中断创建内核线程
+pub fn irq_thread_init() {
+    let threads: Vec<Arc<IrqThread>> = IRQ_THREADS.read().values().cloned().collect();
+    for thread in threads {
+        if let Err(e) = thread.spawn() {
+            kwarn!(
+                "Failed to create thread for irq {}: {:?}",
+                thread.irq_num,
+                e
+            );
+        }
+    }
+}
+
+/// @brief 设置中断的cpu亲和性
+///
+/// ## 参数
+///
+/// - `irq_num` : 中断向量号
+/// - `mask` : 允许处理该中断的cpu的掩码。中断会被投递到其中编号最小的在线cpu上
+///
+/// ## 返回值
+///
+/// 成功时返回中断被投递到的cpu的编号
+pub fn irq_set_affinity(irq_num: u64, mask: u64) -> Result<u32, SystemError> {
+    let retval = unsafe { c_irq_set_affinity(irq_num, mask) };
+    if retval < 0 {
+        return Err(SystemError::from_posix_errno(retval).unwrap_or(SystemError::EINVAL));
+    }
+    return Ok(retval as u32);
+}
+
+/// @brief 获取中断的cpu亲和性
+///
+/// 中断未注册时返回None
+pub fn irq_get_affinity(irq_num: u64) -> Option<u64> {
+    if !IOAPIC_IRQ_RANGE.contains(&irq_num) && !LOCAL_APIC_IRQ_RANGE.contains(&irq_num) {
+        return None;
+    }
+    let mask = unsafe { c_irq_get_affinity(irq_num) };
+    if mask == 0 {
+        return None;
+    }
+    return Some(mask);
+}
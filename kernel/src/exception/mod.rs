@@ -1,6 +1,7 @@
 use crate::arch::CurrentIrqArch;
 
 pub mod ipi;
+pub mod irq;
 pub mod softirq;
 
 /// @brief 中断相关的操作
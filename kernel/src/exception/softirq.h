@@ -23,3 +23,4 @@ extern void rs_clear_softirq_pending(uint32_t softirq_num);
 #define MAX_SOFTIRQ_NUM 64
 #define TIMER_SIRQ 0         // 时钟软中断号
 #define VIDEO_REFRESH_SIRQ 1 // 帧缓冲区刷新软中断
+#define RCU_SIRQ 2           // RCU回调软中断
@@ -6,17 +6,21 @@ use core::{
     sync::atomic::{compiler_fence, Ordering},
 };
 
-use alloc::{boxed::Box, sync::Arc};
+use alloc::{boxed::Box, format, sync::Arc, vec::Vec};
 use num_traits::FromPrimitive;
 
 use crate::{
     arch::interrupt::{cli, sti},
-    arch::CurrentIrqArch,
+    arch::{sched::sched, CurrentIrqArch},
     exception::InterruptArch,
-    include::bindings::bindings::MAX_CPU_NUM,
+    include::bindings::bindings::{smp_get_total_cpu, MAX_CPU_NUM},
     kdebug, kinfo,
-    libs::rwlock::RwLock,
-    process::ProcessManager,
+    libs::rcu::Rcu,
+    process::{
+        kthread::{KernelThreadClosure, KernelThreadMechanism},
+        ProcessControlBlock, ProcessFlags, ProcessManager,
+    },
+    sched::cputime::cputime_set_softirq,
     smp::core::smp_get_processor_id,
     syscall::SystemError,
     time::timer::clock,
@@ -28,6 +32,11 @@ const MAX_SOFTIRQ_RESTART: i32 = 20;
 static mut __CPU_PENDING: Option<Box<[VecStatus; MAX_CPU_NUM as usize]>> = None;
 static mut __SORTIRQ_VECTORS: *mut Softirq = null_mut();
 
+lazy_static! {
+    /// 每个cpu上的ksoftirqd内核线程，下标为cpu id
+    static ref KSOFTIRQD: Rcu<Vec<Arc<ProcessControlBlock>>> = Rcu::new(Vec::new());
+}
+
 #[no_mangle]
 pub extern "C" fn rs_softirq_init() {
     softirq_init().expect("softirq_init failed");
@@ -47,6 +56,64 @@ pub fn softirq_init() -> Result<(), SystemError> {
     return Ok(());
 }
 
+/// 创建每个cpu上的ksoftirqd内核线程
+///
+/// 中断返回时处理软中断的时间是有限的，处理不完的软中断交由ksoftirqd以普通进程的优先级处理，
+/// 这样既不会让用户进程饿死，也不必等到下一次中断才被处理。
+pub fn ksoftirqd_init() {
+    let cpu_num = unsafe { smp_get_total_cpu() };
+    let mut threads = Vec::with_capacity(cpu_num as usize);
+    for cpu_id in 0..cpu_num {
+        let pcb = KernelThreadMechanism::create(
+            KernelThreadClosure::UsizeClosure((Box::new(ksoftirqd), cpu_id as usize)),
+            format!("ksoftirqd/{cpu_id}"),
+        )
+        .unwrap_or_else(|| panic!("Failed to create ksoftirqd/{cpu_id}"));
+        KernelThreadMechanism::bind(&pcb, cpu_id);
+        threads.push(pcb);
+    }
+
+    for pcb in threads.iter() {
+        ProcessManager::wakeup(pcb).expect("Failed to wakeup ksoftirqd");
+    }
+    KSOFTIRQD.replace(threads);
+    kinfo!("ksoftirqd initialized.");
+}
+
+/// ksoftirqd内核线程的主循环
+fn ksoftirqd(_cpu_id: usize) -> i32 {
+    let pcb = ProcessManager::current_pcb();
+    loop {
+        if KernelThreadMechanism::should_stop(&pcb) {
+            return 0;
+        }
+
+        let irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
+        if cpu_pending(smp_get_processor_id() as usize).is_empty() {
+            ProcessManager::mark_sleep(true).ok();
+            drop(irq_guard);
+            sched();
+            continue;
+        }
+
+        softirq_vectors().do_softirq();
+        drop(irq_guard);
+
+        // 每处理完一轮就检查是否需要让出cpu，避免饿死其他进程
+        if pcb.flags().contains(ProcessFlags::NEED_SCHEDULE) {
+            sched();
+        }
+    }
+}
+
+/// 唤醒指定cpu上的ksoftirqd
+fn wakeup_softirqd(cpu_id: u32) {
+    let threads = KSOFTIRQD.read();
+    if let Some(pcb) = threads.get(cpu_id as usize) {
+        ProcessManager::wakeup(pcb).ok();
+    }
+}
+
 #[inline(always)]
 pub fn softirq_vectors() -> &'static mut Softirq {
     unsafe {
@@ -69,6 +136,8 @@ pub enum SoftirqNumber {
     /// 时钟软中断信号
     TIMER = 0,
     VideoRefresh = 1, //帧缓冲区刷新软中断
+    /// RCU回调软中断
+    RCU = 2,
 }
 
 impl From<u64> for SoftirqNumber {
@@ -82,6 +151,7 @@ bitflags! {
     pub struct VecStatus: u64 {
         const TIMER = 1 << 0;
         const VIDEO_REFRESH = 1 << 1;
+        const RCU = 1 << 2;
     }
 }
 
@@ -97,7 +167,8 @@ pub trait SoftirqVec: Send + Sync + Debug {
 
 #[derive(Debug)]
 pub struct Softirq {
-    table: RwLock<[Option<Arc<dyn SoftirqVec>>; MAX_SOFTIRQ_NUM as usize]>,
+    /// 软中断处理函数表。每次处理软中断时都要读取，而注册、解注册很少发生，因此使用RCU保护
+    table: Rcu<[Option<Arc<dyn SoftirqVec>>; MAX_SOFTIRQ_NUM as usize]>,
 }
 impl Softirq {
     fn new() -> Softirq {
@@ -113,7 +184,7 @@ impl Softirq {
         };
 
         return Softirq {
-            table: RwLock::new(data),
+            table: Rcu::new(data),
         };
     }
 
@@ -131,14 +202,20 @@ impl Softirq {
 
         // let self = &mut SOFTIRQ_VECTORS.lock();
         // 判断该软中断向量是否已经被注册
-        let mut table_guard = self.table.write();
-        if table_guard[softirq_num as usize].is_some() {
-            // kdebug!("register_softirq failed");
-
+        let mut registered = false;
+        self.table.update(|table| {
+            let mut table = table.clone();
+            if table[softirq_num as usize].is_some() {
+                // kdebug!("register_softirq failed");
+                registered = true;
+            } else {
+                table[softirq_num as usize] = Some(handler);
+            }
+            table
+        });
+        if registered {
             return Err(SystemError::EINVAL);
         }
-        table_guard[softirq_num as usize] = Some(handler);
-        drop(table_guard);
 
         // kdebug!(
         //     "register_softirq successfully, softirq_num = {:?}",
@@ -153,10 +230,12 @@ impl Softirq {
     /// @param irq_num 中断向量号码   
     pub fn unregister_softirq(&self, softirq_num: SoftirqNumber) {
         // kdebug!("unregister_softirq softirq_num = {:?}", softirq_num as u64);
-        let table_guard = &mut self.table.write();
         // 将软中断向量清空
-        table_guard[softirq_num as usize] = None;
-        drop(table_guard);
+        self.table.update(|table| {
+            let mut table = table.clone();
+            table[softirq_num as usize] = None;
+            table
+        });
         // 将对应位置的pending和runing都置0
         // self.running.lock().set(VecStatus::from(softirq_num), false);
         // 将对应CPU的pending置0
@@ -179,6 +258,7 @@ impl Softirq {
 
             sti();
             if pending != 0 {
+                cputime_set_softirq(true);
                 for i in 0..MAX_SOFTIRQ_NUM {
                     if pending & (1 << i) == 0 {
                         continue;
@@ -204,19 +284,20 @@ impl Softirq {
                         unsafe { ProcessManager::current_pcb().set_preempt_count(prev_count) };
                     }
                 }
+                cputime_set_softirq(false);
             }
             cli();
             max_restart -= 1;
             compiler_fence(Ordering::SeqCst);
             if cpu_pending(cpu_id as usize).is_empty() {
-                compiler_fence(Ordering::SeqCst);
-                if clock() < end && max_restart > 0 {
-                    continue;
-                } else {
-                    break;
-                }
+                break;
+            }
+            compiler_fence(Ordering::SeqCst);
+            if clock() < end && max_restart > 0 {
+                continue;
             } else {
-                // TODO：当有softirqd时 唤醒它
+                // 超出了本次处理的时间或次数限制，剩余的软中断交给ksoftirqd处理
+                wakeup_softirqd(cpu_id);
                 break;
             }
         }
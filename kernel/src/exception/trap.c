@@ -8,6 +8,13 @@
 
 extern void ignore_int();
 
+/**
+ * @brief 在异常表中查找异常发生的地址，找到时把返回地址设置为对应的修复代码
+ *
+ * @return int 找到修复代码时返回1，否则返回0
+ */
+extern int rs_exception_fixup(struct pt_regs *regs);
+
 // 0 #DE 除法错误
 void do_divide_error(struct pt_regs *regs, unsigned long error_code)
 {
@@ -207,6 +214,10 @@ void do_page_fault(struct pt_regs *regs, unsigned long error_code)
 
     __asm__ __volatile__("movq	%%cr2,	%0" : "=r"(cr2)::"memory");
 
+    // 内核访问用户空间时发生的缺页，若异常表中有修复代码，则返回到修复代码，由其向调用者返回错误
+    if (!(error_code & 0x04) && rs_exception_fixup(regs))
+        return;
+
     kerror("do_page_fault(14),Error code :%#018lx,RSP:%#018lx, RBP=%#018lx, RIP:%#018lx CPU:%d, pid=%d\n", error_code,
            regs->rsp, regs->rbp, regs->rip, rs_current_pcb_cpuid(), rs_current_pcb_pid());
     kerror("regs->rax = %#018lx\n", regs->rax);
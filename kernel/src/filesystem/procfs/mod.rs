@@ -10,25 +10,56 @@ use alloc::{
 };
 
 use crate::{
+    arch::{mm::LockedFrameAllocator, MMArch},
+    debug::{
+        profiler::{profile_control, profile_folded},
+        tracepoint::{trace_clear, trace_dump, trace_events_control, trace_events_list},
+    },
+    driver::disk::zram::{zram_control, zram_dump},
+    exception::irq::{irq_get_affinity, irq_set_affinity, IOAPIC_IRQ_RANGE, LOCAL_APIC_IRQ_RANGE},
     filesystem::vfs::{
         core::{generate_inode_id, ROOT_INODE},
         FileType,
     },
+    include::bindings::bindings::smp_get_total_cpu,
     kerror, kinfo,
+    ktest::bench::{kbench_control, kbench_dump},
     libs::{
+        kmsg::kmsg_dump,
+        lock_stat::{lock_stat_control, lock_stat_dump},
         once::Once,
         spinlock::{SpinLock, SpinLockGuard},
     },
-    process::{Pid, ProcessManager},
-    syscall::SystemError,
+    mm::{
+        allocator::{kernel_allocator::kernel_heap_pages, page_frame::FrameAllocator},
+        page_cache::page_cache_nr_pages,
+        MemoryManagementArch,
+    },
+    process::{Pid, ProcessManager, ProcessState},
+    sched::{
+        cputime::{cputime_snapshot, CpuTimeSnapshot},
+        loadavg::{loadavg_get, loadavg_nr_running, FIXED_1, FSHIFT},
+    },
+    seq_printf,
+    syscall::{
+        stats::{syscall_stats_dump, syscall_stats_reset},
+        SystemError,
+    },
     time::TimeSpec,
 };
 
+use self::seq_file::SeqFile;
+
 use super::vfs::{
     file::{FileMode, FilePrivateData},
     FileSystem, FsInfo, IndexNode, InodeId, Metadata, PollStatus,
 };
 
+pub mod seq_file;
+
+/// /proc/stat等文件中时间的单位（每秒的时钟周期数）
+const USER_HZ: u64 = 100;
+
 /// @brief 进程文件类型
 /// @usage 用于定义进程文件夹下的各类文件类型
 #[derive(Debug)]
@@ -36,6 +67,36 @@ use super::vfs::{
 pub enum ProcFileType {
     ///展示进程状态信息
     ProcStatus = 0,
+    ///中断的cpu亲和性（/proc/irq/<n>/smp_affinity）
+    IrqAffinity = 1,
+    ///内核日志（/proc/kmsg）
+    Kmsg = 2,
+    ///内核采样分析器（/proc/profile）
+    Profile = 3,
+    ///跟踪点产生的事件（/proc/trace）
+    Trace = 4,
+    ///跟踪点的开关（/proc/trace_events）
+    TraceEvents = 5,
+    ///系统调用的统计信息（/proc/syscalls）
+    Syscalls = 6,
+    ///进程的系统调用统计信息（/proc/<pid>/syscalls）
+    ProcSyscalls = 7,
+    ///锁的竞争统计（/proc/lock_stat）
+    LockStat = 8,
+    ///内存的使用情况（/proc/meminfo）
+    Meminfo = 9,
+    ///cpu时间的统计（/proc/stat）
+    Stat = 10,
+    ///系统的平均负载（/proc/loadavg）
+    Loadavg = 11,
+    ///进程的状态信息（/proc/<pid>/stat）
+    ProcStat = 12,
+    ///进程的内存映射（/proc/<pid>/maps）
+    ProcMaps = 13,
+    ///内核基准测试（/proc/kbench）
+    KBench = 14,
+    ///压缩内存块设备（/proc/zram）
+    Zram = 15,
     //todo: 其他文件类型
     ///默认文件类型
     Default,
@@ -45,6 +106,21 @@ impl From<u8> for ProcFileType {
     fn from(value: u8) -> Self {
         match value {
             0 => ProcFileType::ProcStatus,
+            1 => ProcFileType::IrqAffinity,
+            2 => ProcFileType::Kmsg,
+            3 => ProcFileType::Profile,
+            4 => ProcFileType::Trace,
+            5 => ProcFileType::TraceEvents,
+            6 => ProcFileType::Syscalls,
+            7 => ProcFileType::ProcSyscalls,
+            8 => ProcFileType::LockStat,
+            9 => ProcFileType::Meminfo,
+            10 => ProcFileType::Stat,
+            11 => ProcFileType::Loadavg,
+            12 => ProcFileType::ProcStat,
+            13 => ProcFileType::ProcMaps,
+            14 => ProcFileType::KBench,
+            15 => ProcFileType::Zram,
             _ => ProcFileType::Default,
         }
     }
@@ -55,6 +131,8 @@ impl From<u8> for ProcFileType {
 pub struct InodeInfo {
     ///进程的pid
     pid: Pid,
+    ///中断向量号
+    irq_num: u64,
     ///文件类型
     ftype: ProcFileType,
     //其他需要传入的信息在此定义
@@ -114,29 +192,20 @@ impl ProcFSInode {
     }
     // todo:其他数据获取函数实现
 
-    /// @brief 打开status文件
+    /// @brief 生成status文件的内容
     ///
-    fn open_status(&self, pdata: &mut ProcfsFilePrivateData) -> Result<i64, SystemError> {
+    fn show_status(&self, seq: &mut SeqFile) -> Result<(), SystemError> {
         // 获取该pid对应的pcb结构体
         let pid = self.fdata.pid;
-        let pcb = ProcessManager::find(pid);
-        let pcb = if pcb.is_none() {
+        let pcb = if let Some(pcb) = ProcessManager::find(pid) {
+            pcb
+        } else {
             kerror!(
                 "ProcFS: Cannot find pcb for pid {:?} when opening its 'status' file.",
                 pid
             );
             return Err(SystemError::ESRCH);
-        } else {
-            pcb.unwrap()
         };
-        // 传入数据
-        let pdata: &mut Vec<u8> = &mut pdata.data;
-
-        pdata.append(
-            &mut format!("Name:\t{}", pcb.basic().name())
-                .as_bytes()
-                .to_owned(),
-        );
 
         let sched_info_guard = pcb.sched_info();
         let state = sched_info_guard.state();
@@ -150,52 +219,355 @@ impl ProcFSInode {
 
         drop(sched_info_guard);
 
-        pdata.append(&mut format!("\nState:\t{:?}", state).as_bytes().to_owned());
-        pdata.append(
-            &mut format!("\nPid:\t{}", pcb.pid().into())
-                .as_bytes()
-                .to_owned(),
-        );
-        pdata.append(
-            &mut format!("\nPpid:\t{}", pcb.basic().ppid().into())
-                .as_bytes()
-                .to_owned(),
-        );
-        pdata.append(&mut format!("\ncpu_id:\t{}", cpu_id).as_bytes().to_owned());
-        pdata.append(
-            &mut format!("\npriority:\t{}", priority.data())
-                .as_bytes()
-                .to_owned(),
-        );
-        pdata.append(
-            &mut format!("\npreempt:\t{}", pcb.preempt_count())
-                .as_bytes()
-                .to_owned(),
-        );
-        pdata.append(&mut format!("\nvrtime:\t{}", vrtime).as_bytes().to_owned());
-
-        let binding = pcb.basic().user_vm().unwrap();
-        let address_space_guard = binding.read();
-        // todo: 当前进程运行过程中占用内存的峰值
-        let hiwater_vm: u64 = 0;
-        // 进程代码段的大小
-        let text = (address_space_guard.end_code - address_space_guard.start_code) / 1024;
-        // 进程数据段的大小
-        let data = (address_space_guard.end_data - address_space_guard.start_data) / 1024;
-        drop(address_space_guard);
-
-        pdata.append(
-            &mut format!("\nVmPeak:\t{} kB", hiwater_vm)
-                .as_bytes()
-                .to_owned(),
-        );
-        pdata.append(&mut format!("\nVmData:\t{} kB", data).as_bytes().to_owned());
-        pdata.append(&mut format!("\nVmExe:\t{} kB", text).as_bytes().to_owned());
-        pdata.append(
-            &mut format!("\nflags: {:?}\n", pcb.flags().clone())
-                .as_bytes()
-                .to_owned(),
-        );
+        seq_printf!(seq, "Name:\t{}", pcb.basic().name())?;
+        seq_printf!(seq, "\nState:\t{:?}", state)?;
+        seq_printf!(seq, "\nPid:\t{}", pcb.pid().into())?;
+        seq_printf!(seq, "\nPpid:\t{}", pcb.basic().ppid().into())?;
+        seq_printf!(seq, "\ncpu_id:\t{}", cpu_id)?;
+        seq_printf!(seq, "\npriority:\t{}", priority.data())?;
+        seq_printf!(seq, "\npreempt:\t{}", pcb.preempt_count())?;
+        seq_printf!(seq, "\nvrtime:\t{}", vrtime)?;
+
+        // 内核线程没有用户地址空间
+        if let Some(binding) = pcb.basic().user_vm() {
+            let address_space_guard = binding.read();
+            // todo: 当前进程运行过程中占用内存的峰值
+            let hiwater_vm: u64 = 0;
+            // 进程代码段的大小
+            let text = (address_space_guard.end_code - address_space_guard.start_code) / 1024;
+            // 进程数据段的大小
+            let data = (address_space_guard.end_data - address_space_guard.start_data) / 1024;
+            drop(address_space_guard);
+
+            seq_printf!(seq, "\nVmPeak:\t{} kB", hiwater_vm)?;
+            seq_printf!(seq, "\nVmData:\t{} kB", data)?;
+            seq_printf!(seq, "\nVmExe:\t{} kB", text)?;
+        }
+        seq_printf!(seq, "\nflags: {:?}\n", pcb.flags().clone())?;
+
+        return Ok(());
+    }
+
+    /// @brief 生成meminfo文件的内容，单位为kB
+    ///
+    /// 内核堆目前直接从buddy分配整页，因此以它占用的页数作为Slab
+    fn show_meminfo(&self, seq: &mut SeqFile) -> Result<(), SystemError> {
+        let usage = unsafe { LockedFrameAllocator.usage() };
+        let to_kb = |pages: usize| pages * MMArch::PAGE_SIZE / 1024;
+        let free = usage.free().data();
+        let cached = page_cache_nr_pages();
+
+        seq_printf!(
+            seq,
+            "MemTotal:       {:8} kB\n",
+            to_kb(usage.total().data())
+        )?;
+        seq_printf!(seq, "MemFree:        {:8} kB\n", to_kb(free))?;
+        seq_printf!(seq, "MemAvailable:   {:8} kB\n", to_kb(free + cached))?;
+        seq_printf!(seq, "Buffers:        {:8} kB\n", 0)?;
+        seq_printf!(seq, "Cached:         {:8} kB\n", to_kb(cached))?;
+        seq_printf!(seq, "Slab:           {:8} kB\n", to_kb(kernel_heap_pages()))?;
+        return Ok(());
+    }
+
+    /// @brief 生成stat文件的内容，时间的单位为1/USER_HZ秒
+    ///
+    fn show_stat(&self, seq: &mut SeqFile) -> Result<(), SystemError> {
+        let cpus = unsafe { smp_get_total_cpu() } as usize;
+        let mut total = CpuTimeSnapshot::default();
+        for cpu_id in 0..cpus {
+            total += cputime_snapshot(cpu_id);
+        }
+        Self::show_cpu_line(seq, "cpu ", &total)?;
+        for cpu_id in 0..cpus {
+            let name = format!("cpu{}", cpu_id);
+            Self::show_cpu_line(seq, &name, &cputime_snapshot(cpu_id))?;
+        }
+        seq_printf!(seq, "processes {}\n", ProcessManager::process_count())?;
+        seq_printf!(seq, "procs_running {}\n", loadavg_nr_running())?;
+        return Ok(());
+    }
+
+    /// @brief 生成stat文件中一个cpu的统计信息
+    ///
+    /// 各列依次为user nice system idle iowait irq softirq steal guest guest_nice
+    fn show_cpu_line(
+        seq: &mut SeqFile,
+        name: &str,
+        time: &CpuTimeSnapshot,
+    ) -> Result<(), SystemError> {
+        let to_ticks = |us: u64| us * USER_HZ / 1000000;
+        seq_printf!(
+            seq,
+            "{} {} 0 {} {} 0 {} {} 0 0 0\n",
+            name,
+            to_ticks(time.user),
+            to_ticks(time.system),
+            to_ticks(time.idle),
+            to_ticks(time.irq),
+            to_ticks(time.softirq)
+        )?;
+        return Ok(());
+    }
+
+    /// @brief 生成loadavg文件的内容
+    ///
+    fn show_loadavg(&self, seq: &mut SeqFile) -> Result<(), SystemError> {
+        let loads = loadavg_get();
+        for load in loads.iter() {
+            // 四舍五入到两位小数
+            let load = load + FIXED_1 / 200;
+            seq_printf!(
+                seq,
+                "{}.{:02} ",
+                load >> FSHIFT,
+                ((load & (FIXED_1 - 1)) * 100) >> FSHIFT
+            )?;
+        }
+        let pids = ProcessManager::all_pids();
+        let last_pid = pids.iter().copied().max().map(Pid::into).unwrap_or(0);
+        seq_printf!(
+            seq,
+            "{}/{} {}\n",
+            loadavg_nr_running(),
+            pids.len(),
+            last_pid
+        )?;
+        return Ok(());
+    }
+
+    /// @brief 生成进程的stat文件的内容，格式与Linux的/proc/<pid>/stat的前24列相同
+    ///
+    fn show_pid_stat(&self, seq: &mut SeqFile) -> Result<(), SystemError> {
+        let pcb = ProcessManager::find(self.fdata.pid).ok_or(SystemError::ESRCH)?;
+        let sched_info_guard = pcb.sched_info();
+        let state = match sched_info_guard.state() {
+            ProcessState::Runnable => 'R',
+            ProcessState::Blocked(true) => 'S',
+            ProcessState::Blocked(false) => 'D',
+            ProcessState::Exited(_) => 'Z',
+        };
+        let priority = sched_info_guard.priority().data();
+        drop(sched_info_guard);
+
+        // 虚拟内存的大小（字节）以及已经映射到页表的大小（页）
+        let (vsize, rss) = if let Some(vm) = pcb.basic().user_vm() {
+            let guard = vm.read();
+            let mut vsize = 0;
+            let mut rss = 0;
+            for vma in guard.mappings.iter_vmas() {
+                let size = vma.lock().region().size();
+                vsize += size;
+                if vma.mapped() {
+                    rss += size / MMArch::PAGE_SIZE;
+                }
+            }
+            (vsize, rss)
+        } else {
+            (0, 0)
+        };
+
+        let to_ticks = |us: u64| us * USER_HZ / 1000000;
+        let basic = pcb.basic();
+        seq_printf!(
+            seq,
+            "{} ({}) {} {} {} 0 0 -1 {} 0 0 0 0 {} {} 0 0 {} 0 1 0 {} {} {}\n",
+            pcb.pid().into(),
+            basic.name(),
+            state,
+            basic.ppid().into(),
+            basic.pgid().into(),
+            pcb.flags().bits(),
+            to_ticks(pcb.cputime().utime()),
+            to_ticks(pcb.cputime().stime()),
+            priority,
+            to_ticks(pcb.start_time()),
+            vsize,
+            rss
+        )?;
+        return Ok(());
+    }
+
+    /// @brief 生成进程的maps文件的内容，按照地址从低到高列出所有的VMA
+    ///
+    fn show_maps(&self, seq: &mut SeqFile) -> Result<(), SystemError> {
+        let pcb = ProcessManager::find(self.fdata.pid).ok_or(SystemError::ESRCH)?;
+        let vm = match pcb.basic().user_vm() {
+            Some(vm) => vm,
+            None => return Ok(()),
+        };
+        let guard = vm.read();
+        let mut vmas: Vec<_> = guard
+            .mappings
+            .iter_vmas()
+            .map(|vma| {
+                let vma = vma.lock();
+                (*vma.region(), vma.flags(), vma.is_shared())
+            })
+            .collect();
+        vmas.sort_by_key(|(region, _, _)| region.start());
+
+        for (region, flags, shared) in vmas {
+            let name = if region.start() >= guard.brk_start && region.start() < guard.brk {
+                "[heap]"
+            } else if guard
+                .user_stack
+                .as_ref()
+                .map(|stack| stack.contains(region.start()))
+                .unwrap_or(false)
+            {
+                "[stack]"
+            } else {
+                ""
+            };
+            seq_printf!(
+                seq,
+                "{:08x}-{:08x} r{}{}{} 00000000 00:00 0 {}\n",
+                region.start().data(),
+                region.end().data(),
+                if flags.has_write() { 'w' } else { '-' },
+                if flags.has_execute() { 'x' } else { '-' },
+                if shared { 's' } else { 'p' },
+                name
+            )?;
+        }
+        return Ok(());
+    }
+
+    /// @brief 以SeqFile生成内容的文件，生成文件的内容
+    ///
+    /// ## 返回值
+    ///
+    /// 如果文件的内容不是以SeqFile生成的，返回None
+    fn show(&self, seq: &mut SeqFile) -> Option<Result<(), SystemError>> {
+        let result = match self.fdata.ftype {
+            ProcFileType::ProcStatus => self.show_status(seq),
+            ProcFileType::Meminfo => self.show_meminfo(seq),
+            ProcFileType::Stat => self.show_stat(seq),
+            ProcFileType::Loadavg => self.show_loadavg(seq),
+            ProcFileType::ProcStat => self.show_pid_stat(seq),
+            ProcFileType::ProcMaps => self.show_maps(seq),
+            _ => return None,
+        };
+        return Some(result);
+    }
+
+    /// @brief 打开以SeqFile生成内容的文件，只统计文件的大小，不保存文件的内容
+    ///
+    fn open_seq(&self) -> Result<i64, SystemError> {
+        let mut seq = SeqFile::counter();
+        self.show(&mut seq).unwrap_or(Err(SystemError::EINVAL))?;
+        return Ok(seq.size() as i64);
+    }
+
+    /// @brief 读取以SeqFile生成内容的文件，重新生成文件的内容，只拷贝读取的范围内的部分
+    ///
+    fn read_seq(&self, offset: usize, len: usize, buf: &mut [u8]) -> Result<usize, SystemError> {
+        let mut seq = SeqFile::window(offset, &mut buf[0..len]);
+        match self.show(&mut seq).unwrap_or(Err(SystemError::EINVAL)) {
+            Ok(()) => {}
+            // 读缓冲区已经写满，提前结束了生成
+            Err(SystemError::ENOBUFS) if seq.is_full() => {}
+            Err(e) => return Err(e),
+        }
+        return Ok(seq.written());
+    }
+
+    /// @brief 打开smp_affinity文件
+    ///
+    fn open_irq_affinity(&self, pdata: &mut ProcfsFilePrivateData) -> Result<i64, SystemError> {
+        let mask = irq_get_affinity(self.fdata.irq_num).ok_or(SystemError::ENOENT)?;
+        let pdata: &mut Vec<u8> = &mut pdata.data;
+        pdata.append(&mut format!("{:x}\n", mask).as_bytes().to_owned());
+
+        // 去除多余的\0
+        self.trim_string(pdata);
+
+        return Ok((pdata.len() * size_of::<u8>()) as i64);
+    }
+
+    /// @brief 打开kmsg文件，内容为内核日志缓冲区中仍然保存着的全部日志
+    ///
+    fn open_kmsg(&self, pdata: &mut ProcfsFilePrivateData) -> Result<i64, SystemError> {
+        let pdata: &mut Vec<u8> = &mut pdata.data;
+        pdata.append(&mut kmsg_dump());
+
+        // 去除多余的\0
+        self.trim_string(pdata);
+
+        return Ok((pdata.len() * size_of::<u8>()) as i64);
+    }
+
+    /// @brief 打开profile文件，内容为最近一次采样的folded格式的调用栈
+    ///
+    fn open_profile(&self, pdata: &mut ProcfsFilePrivateData) -> Result<i64, SystemError> {
+        let pdata: &mut Vec<u8> = &mut pdata.data;
+        pdata.append(&mut profile_folded());
+
+        // 去除多余的\0
+        self.trim_string(pdata);
+
+        return Ok((pdata.len() * size_of::<u8>()) as i64);
+    }
+
+    /// @brief 写入profile文件，控制采样的开始与停止
+    ///
+    fn write_profile(&self, buf: &[u8]) -> Result<usize, SystemError> {
+        let text = core::str::from_utf8(buf).map_err(|_| SystemError::EINVAL)?;
+        profile_control(text)?;
+        return Ok(buf.len());
+    }
+
+    /// @brief 打开trace文件，内容为所有cpu上按时间排序的跟踪事件
+    ///
+    fn open_trace(&self, pdata: &mut ProcfsFilePrivateData) -> Result<i64, SystemError> {
+        let pdata: &mut Vec<u8> = &mut pdata.data;
+        pdata.append(&mut trace_dump());
+
+        // 去除多余的\0
+        self.trim_string(pdata);
+
+        return Ok((pdata.len() * size_of::<u8>()) as i64);
+    }
+
+    /// @brief 打开trace_events文件，内容为所有跟踪点及其开关状态
+    ///
+    fn open_trace_events(&self, pdata: &mut ProcfsFilePrivateData) -> Result<i64, SystemError> {
+        let pdata: &mut Vec<u8> = &mut pdata.data;
+        pdata.append(&mut trace_events_list().as_bytes().to_owned());
+
+        // 去除多余的\0
+        self.trim_string(pdata);
+
+        return Ok((pdata.len() * size_of::<u8>()) as i64);
+    }
+
+    /// @brief 写入trace_events文件，打开或关闭跟踪点
+    ///
+    fn write_trace_events(&self, buf: &[u8]) -> Result<usize, SystemError> {
+        let text = core::str::from_utf8(buf).map_err(|_| SystemError::EINVAL)?;
+        trace_events_control(text)?;
+        return Ok(buf.len());
+    }
+
+    /// @brief 打开syscalls文件，内容为所有cpu上各个系统调用的统计信息
+    ///
+    fn open_syscalls(&self, pdata: &mut ProcfsFilePrivateData) -> Result<i64, SystemError> {
+        let pdata: &mut Vec<u8> = &mut pdata.data;
+        pdata.append(&mut syscall_stats_dump().as_bytes().to_owned());
+
+        // 去除多余的\0
+        self.trim_string(pdata);
+
+        return Ok((pdata.len() * size_of::<u8>()) as i64);
+    }
+
+    /// @brief 打开进程的syscalls文件，内容为该进程各个系统调用的统计信息
+    ///
+    fn open_proc_syscalls(&self, pdata: &mut ProcfsFilePrivateData) -> Result<i64, SystemError> {
+        let pcb = ProcessManager::find(self.fdata.pid).ok_or(SystemError::ESRCH)?;
+        let pdata: &mut Vec<u8> = &mut pdata.data;
+        pdata.append(&mut pcb.syscall_stats().dump().as_bytes().to_owned());
 
         // 去除多余的\0
         self.trim_string(pdata);
@@ -203,6 +575,85 @@ impl ProcFSInode {
         return Ok((pdata.len() * size_of::<u8>()) as i64);
     }
 
+    /// @brief 写入进程的syscalls文件，清零该进程的统计信息
+    ///
+    fn write_proc_syscalls(&self, buf: &[u8]) -> Result<usize, SystemError> {
+        let pcb = ProcessManager::find(self.fdata.pid).ok_or(SystemError::ESRCH)?;
+        pcb.syscall_stats().reset();
+        return Ok(buf.len());
+    }
+
+    /// @brief 打开lock_stat文件，内容为各个加锁位置的竞争统计
+    ///
+    fn open_lock_stat(&self, pdata: &mut ProcfsFilePrivateData) -> Result<i64, SystemError> {
+        let pdata: &mut Vec<u8> = &mut pdata.data;
+        pdata.append(&mut lock_stat_dump().as_bytes().to_owned());
+
+        // 去除多余的\0
+        self.trim_string(pdata);
+
+        return Ok((pdata.len() * size_of::<u8>()) as i64);
+    }
+
+    /// @brief 写入lock_stat文件，打开、关闭或清零锁的竞争统计
+    ///
+    fn write_lock_stat(&self, buf: &[u8]) -> Result<usize, SystemError> {
+        let text = core::str::from_utf8(buf).map_err(|_| SystemError::EINVAL)?;
+        lock_stat_control(text)?;
+        return Ok(buf.len());
+    }
+
+    /// @brief 打开kbench文件，内容为所有的基准测试以及最近一次测试的结果
+    ///
+    fn open_kbench(&self, pdata: &mut ProcfsFilePrivateData) -> Result<i64, SystemError> {
+        let pdata: &mut Vec<u8> = &mut pdata.data;
+        pdata.append(&mut kbench_dump().as_bytes().to_owned());
+
+        // 去除多余的\0
+        self.trim_string(pdata);
+
+        return Ok((pdata.len() * size_of::<u8>()) as i64);
+    }
+
+    /// @brief 写入kbench文件，开始运行基准测试
+    ///
+    fn write_kbench(&self, buf: &[u8]) -> Result<usize, SystemError> {
+        let text = core::str::from_utf8(buf).map_err(|_| SystemError::EINVAL)?;
+        kbench_control(text)?;
+        return Ok(buf.len());
+    }
+
+    /// @brief 打开zram文件，内容为所有zram设备的统计信息
+    ///
+    fn open_zram(&self, pdata: &mut ProcfsFilePrivateData) -> Result<i64, SystemError> {
+        let pdata: &mut Vec<u8> = &mut pdata.data;
+        pdata.append(&mut zram_dump().as_bytes().to_owned());
+
+        // 去除多余的\0
+        self.trim_string(pdata);
+
+        return Ok((pdata.len() * size_of::<u8>()) as i64);
+    }
+
+    /// @brief 写入zram文件，创建zram设备
+    ///
+    fn write_zram(&self, buf: &[u8]) -> Result<usize, SystemError> {
+        let text = core::str::from_utf8(buf).map_err(|_| SystemError::EINVAL)?;
+        zram_control(text)?;
+        return Ok(buf.len());
+    }
+
+    /// @brief 写入smp_affinity文件，内容为16进制的cpu掩码
+    ///
+    fn write_irq_affinity(&self, buf: &[u8]) -> Result<usize, SystemError> {
+        let text = core::str::from_utf8(buf).map_err(|_| SystemError::EINVAL)?;
+        let text = text.trim_matches(|c: char| c.is_whitespace() || c == '\0');
+        let text = text.trim_start_matches("0x");
+        let mask = u64::from_str_radix(text, 16).map_err(|_| SystemError::EINVAL)?;
+        irq_set_affinity(self.fdata.irq_num, mask)?;
+        return Ok(buf.len());
+    }
+
     /// status文件读取函数
     fn read_status(
         &self,
@@ -271,6 +722,7 @@ impl ProcFS {
                 fs: Weak::default(),
                 fdata: InodeInfo {
                     pid: Pid::new(0),
+                    irq_num: 0,
                     ftype: ProcFileType::Default,
                 },
             })));
@@ -305,11 +757,162 @@ impl ProcFS {
         _sf.0.lock().fdata.pid = pid;
         _sf.0.lock().fdata.ftype = ProcFileType::ProcStatus;
 
+        // syscalls文件
+        let binding: Arc<dyn IndexNode> = _pf.create("syscalls", FileType::File, 0o600)?;
+        let _sf: &LockedProcFSInode = binding
+            .as_any_ref()
+            .downcast_ref::<LockedProcFSInode>()
+            .unwrap();
+        _sf.0.lock().fdata.pid = pid;
+        _sf.0.lock().fdata.ftype = ProcFileType::ProcSyscalls;
+
+        // stat文件和maps文件
+        for (name, ftype) in [
+            ("stat", ProcFileType::ProcStat),
+            ("maps", ProcFileType::ProcMaps),
+        ] {
+            let binding: Arc<dyn IndexNode> = _pf.create(name, FileType::File, 0o444)?;
+            let _sf: &LockedProcFSInode = binding
+                .as_any_ref()
+                .downcast_ref::<LockedProcFSInode>()
+                .unwrap();
+            let mut guard = _sf.0.lock();
+            guard.fdata.pid = pid;
+            guard.fdata.ftype = ftype;
+        }
+
         //todo: 创建其他文件
 
         return Ok(());
     }
 
+    /// @brief 为外部中断创建/proc/irq/<n>/smp_affinity文件
+    fn register_irqs(&self) -> Result<(), SystemError> {
+        let irq_dir: Arc<dyn IndexNode> = self.root_inode().create("irq", FileType::Dir, 0o755)?;
+        for irq_num in IOAPIC_IRQ_RANGE.chain(LOCAL_APIC_IRQ_RANGE) {
+            let dir: Arc<dyn IndexNode> =
+                irq_dir.create(&irq_num.to_string(), FileType::Dir, 0o755)?;
+            let binding: Arc<dyn IndexNode> = dir.create("smp_affinity", FileType::File, 0o600)?;
+            let file: &LockedProcFSInode = binding
+                .as_any_ref()
+                .downcast_ref::<LockedProcFSInode>()
+                .unwrap();
+            let mut guard = file.0.lock();
+            guard.fdata.irq_num = irq_num;
+            guard.fdata.ftype = ProcFileType::IrqAffinity;
+        }
+        return Ok(());
+    }
+
+    /// @brief 创建/proc/kmsg文件
+    fn register_kmsg(&self) -> Result<(), SystemError> {
+        let binding: Arc<dyn IndexNode> =
+            self.root_inode().create("kmsg", FileType::File, 0o400)?;
+        let file: &LockedProcFSInode = binding
+            .as_any_ref()
+            .downcast_ref::<LockedProcFSInode>()
+            .unwrap();
+        file.0.lock().fdata.ftype = ProcFileType::Kmsg;
+        return Ok(());
+    }
+
+    /// @brief 创建/proc/profile文件
+    fn register_profile(&self) -> Result<(), SystemError> {
+        let binding: Arc<dyn IndexNode> =
+            self.root_inode().create("profile", FileType::File, 0o600)?;
+        let file: &LockedProcFSInode = binding
+            .as_any_ref()
+            .downcast_ref::<LockedProcFSInode>()
+            .unwrap();
+        file.0.lock().fdata.ftype = ProcFileType::Profile;
+        return Ok(());
+    }
+
+    /// @brief 创建/proc/trace和/proc/trace_events文件
+    fn register_trace(&self) -> Result<(), SystemError> {
+        for (name, ftype) in [
+            ("trace", ProcFileType::Trace),
+            ("trace_events", ProcFileType::TraceEvents),
+        ] {
+            let binding: Arc<dyn IndexNode> =
+                self.root_inode().create(name, FileType::File, 0o600)?;
+            let file: &LockedProcFSInode = binding
+                .as_any_ref()
+                .downcast_ref::<LockedProcFSInode>()
+                .unwrap();
+            file.0.lock().fdata.ftype = ftype;
+        }
+        return Ok(());
+    }
+
+    /// @brief 创建/proc/syscalls文件
+    fn register_syscalls(&self) -> Result<(), SystemError> {
+        let binding: Arc<dyn IndexNode> =
+            self.root_inode()
+                .create("syscalls", FileType::File, 0o600)?;
+        let file: &LockedProcFSInode = binding
+            .as_any_ref()
+            .downcast_ref::<LockedProcFSInode>()
+            .unwrap();
+        file.0.lock().fdata.ftype = ProcFileType::Syscalls;
+        return Ok(());
+    }
+
+    /// @brief 创建/proc/lock_stat文件
+    fn register_lock_stat(&self) -> Result<(), SystemError> {
+        let binding: Arc<dyn IndexNode> =
+            self.root_inode()
+                .create("lock_stat", FileType::File, 0o600)?;
+        let file: &LockedProcFSInode = binding
+            .as_any_ref()
+            .downcast_ref::<LockedProcFSInode>()
+            .unwrap();
+        file.0.lock().fdata.ftype = ProcFileType::LockStat;
+        return Ok(());
+    }
+
+    /// @brief 创建/proc/kbench文件
+    fn register_kbench(&self) -> Result<(), SystemError> {
+        let binding: Arc<dyn IndexNode> =
+            self.root_inode().create("kbench", FileType::File, 0o600)?;
+        let file: &LockedProcFSInode = binding
+            .as_any_ref()
+            .downcast_ref::<LockedProcFSInode>()
+            .unwrap();
+        file.0.lock().fdata.ftype = ProcFileType::KBench;
+        return Ok(());
+    }
+
+    /// @brief 创建/proc/zram文件
+    fn register_zram(&self) -> Result<(), SystemError> {
+        let binding: Arc<dyn IndexNode> =
+            self.root_inode().create("zram", FileType::File, 0o600)?;
+        let file: &LockedProcFSInode = binding
+            .as_any_ref()
+            .downcast_ref::<LockedProcFSInode>()
+            .unwrap();
+        file.0.lock().fdata.ftype = ProcFileType::Zram;
+        return Ok(());
+    }
+
+    /// @brief 创建/proc/meminfo、/proc/stat和/proc/loadavg文件
+    fn register_system_stats(&self) -> Result<(), SystemError> {
+        for (name, ftype) in [
+            ("meminfo", ProcFileType::Meminfo),
+            ("stat", ProcFileType::Stat),
+            ("loadavg", ProcFileType::Loadavg),
+        ] {
+            let binding: Arc<dyn IndexNode> =
+                self.root_inode().create(name, FileType::File, 0o444)?;
+            let file: &LockedProcFSInode = binding
+                .as_any_ref()
+                .downcast_ref::<LockedProcFSInode>()
+                .unwrap();
+            file.0.lock().fdata.ftype = ftype;
+        }
+        return Ok(());
+    }
+
     /// @brief 解除进程注册
     ///
     pub fn unregister_pid(&self, pid: Pid) -> Result<(), SystemError> {
@@ -319,6 +922,9 @@ impl ProcFS {
         let pid_dir: Arc<dyn IndexNode> = proc.find(&pid.to_string())?;
         // 删除进程文件夹下文件
         pid_dir.unlink("status")?;
+        pid_dir.unlink("syscalls")?;
+        pid_dir.unlink("stat")?;
+        pid_dir.unlink("maps")?;
 
         // 查看进程文件是否还存在
         // let pf= pid_dir.find("status").expect("Cannot find status");
@@ -342,7 +948,22 @@ impl IndexNode for LockedProcFSInode {
         let mut private_data = ProcfsFilePrivateData::new();
         // 根据文件类型获取相应数据
         let file_size = match inode.fdata.ftype {
-            ProcFileType::ProcStatus => inode.open_status(&mut private_data)?,
+            ProcFileType::ProcStatus
+            | ProcFileType::Meminfo
+            | ProcFileType::Stat
+            | ProcFileType::Loadavg
+            | ProcFileType::ProcStat
+            | ProcFileType::ProcMaps => inode.open_seq()?,
+            ProcFileType::IrqAffinity => inode.open_irq_affinity(&mut private_data)?,
+            ProcFileType::Kmsg => inode.open_kmsg(&mut private_data)?,
+            ProcFileType::Profile => inode.open_profile(&mut private_data)?,
+            ProcFileType::Trace => inode.open_trace(&mut private_data)?,
+            ProcFileType::TraceEvents => inode.open_trace_events(&mut private_data)?,
+            ProcFileType::Syscalls => inode.open_syscalls(&mut private_data)?,
+            ProcFileType::ProcSyscalls => inode.open_proc_syscalls(&mut private_data)?,
+            ProcFileType::LockStat => inode.open_lock_stat(&mut private_data)?,
+            ProcFileType::KBench => inode.open_kbench(&mut private_data)?,
+            ProcFileType::Zram => inode.open_zram(&mut private_data)?,
             _ => {
                 todo!()
             }
@@ -400,7 +1021,22 @@ impl IndexNode for LockedProcFSInode {
 
         // 根据文件类型读取相应数据
         match inode.fdata.ftype {
-            ProcFileType::ProcStatus => return inode.read_status(offset, len, buf, private_data),
+            ProcFileType::ProcStatus
+            | ProcFileType::Meminfo
+            | ProcFileType::Stat
+            | ProcFileType::Loadavg
+            | ProcFileType::ProcStat
+            | ProcFileType::ProcMaps => return inode.read_seq(offset, len, buf),
+            ProcFileType::IrqAffinity
+            | ProcFileType::Kmsg
+            | ProcFileType::Profile
+            | ProcFileType::Trace
+            | ProcFileType::TraceEvents
+            | ProcFileType::Syscalls
+            | ProcFileType::ProcSyscalls
+            | ProcFileType::LockStat
+            | ProcFileType::KBench
+            | ProcFileType::Zram => return inode.read_status(offset, len, buf, private_data),
             ProcFileType::Default => (),
         };
 
@@ -422,11 +1058,32 @@ impl IndexNode for LockedProcFSInode {
     fn write_at(
         &self,
         _offset: usize,
-        _len: usize,
-        _buf: &[u8],
+        len: usize,
+        buf: &[u8],
         _data: &mut FilePrivateData,
     ) -> Result<usize, SystemError> {
-        return Err(SystemError::EOPNOTSUPP_OR_ENOTSUP);
+        if buf.len() < len {
+            return Err(SystemError::EINVAL);
+        }
+        let inode: SpinLockGuard<ProcFSInode> = self.0.lock();
+        match inode.fdata.ftype {
+            ProcFileType::IrqAffinity => return inode.write_irq_affinity(&buf[0..len]),
+            ProcFileType::Profile => return inode.write_profile(&buf[0..len]),
+            ProcFileType::Trace => {
+                trace_clear();
+                return Ok(len);
+            }
+            ProcFileType::TraceEvents => return inode.write_trace_events(&buf[0..len]),
+            ProcFileType::Syscalls => {
+                syscall_stats_reset();
+                return Ok(len);
+            }
+            ProcFileType::ProcSyscalls => return inode.write_proc_syscalls(&buf[0..len]),
+            ProcFileType::LockStat => return inode.write_lock_stat(&buf[0..len]),
+            ProcFileType::KBench => return inode.write_kbench(&buf[0..len]),
+            ProcFileType::Zram => return inode.write_zram(&buf[0..len]),
+            _ => return Err(SystemError::EOPNOTSUPP_OR_ENOTSUP),
+        }
     }
 
     fn poll(&self) -> Result<PollStatus, SystemError> {
@@ -522,6 +1179,7 @@ impl IndexNode for LockedProcFSInode {
                 fs: inode.fs.clone(),
                 fdata: InodeInfo {
                     pid: Pid::new(0),
+                    irq_num: 0,
                     ftype: ProcFileType::Default,
                 },
             })));
@@ -710,7 +1368,18 @@ pub fn procfs_init() -> Result<(), SystemError> {
             .mount(procfs)
             .expect("Failed to mount proc");
         kinfo!("ProcFS mounted.");
-        result = Some(Ok(()));
+        result = Some(
+            procfs
+                .register_irqs()
+                .and_then(|_| procfs.register_kmsg())
+                .and_then(|_| procfs.register_profile())
+                .and_then(|_| procfs.register_trace())
+                .and_then(|_| procfs.register_syscalls())
+                .and_then(|_| procfs.register_lock_stat())
+                .and_then(|_| procfs.register_system_stats())
+                .and_then(|_| procfs.register_kbench())
+                .and_then(|_| procfs.register_zram()),
+        );
     });
 
     return result.unwrap();
@@ -0,0 +1,115 @@
+//! 流式生成procfs文件内容的写入器
+//!
+//! procfs的文件内容是在读取时才生成的。SeqFile让生成函数直接把格式化的结果写进用户的读缓冲区，
+//! 而不是先拼接出整个文件再拷贝：
+//!
+//! - 打开文件时，以计数模式运行一遍生成函数，只统计文件的大小（vfs需要用它判断是否读到了文件末尾）
+//! - 读取时，以窗口模式再运行一遍生成函数，只有落在`[offset, offset + len)`内的字节会被拷贝，
+//!   窗口写满之后立即停止生成
+use core::fmt;
+
+use crate::syscall::SystemError;
+
+pub struct SeqFile<'a> {
+    /// 读缓冲区，为None时是计数模式
+    buf: Option<&'a mut [u8]>,
+    /// 窗口在文件中的起始偏移量
+    offset: usize,
+    /// 到目前为止生成的字节数
+    pos: usize,
+    /// 已经拷贝到读缓冲区的字节数
+    written: usize,
+    /// 窗口是否已经写满
+    full: bool,
+}
+
+impl<'a> SeqFile<'a> {
+    /// @brief 创建一个计数模式的SeqFile，只统计生成的字节数
+    pub fn counter() -> Self {
+        return Self {
+            buf: None,
+            offset: 0,
+            pos: 0,
+            written: 0,
+            full: false,
+        };
+    }
+
+    /// @brief 创建一个窗口模式的SeqFile，把文件中从offset开始的内容写入buf
+    pub fn window(offset: usize, buf: &'a mut [u8]) -> Self {
+        let full = buf.is_empty();
+        return Self {
+            buf: Some(buf),
+            offset,
+            pos: 0,
+            written: 0,
+            full,
+        };
+    }
+
+    /// @brief 到目前为止生成的字节数（计数模式下即为文件的大小）
+    pub fn size(&self) -> usize {
+        return self.pos;
+    }
+
+    /// @brief 已经拷贝到读缓冲区的字节数
+    pub fn written(&self) -> usize {
+        return self.written;
+    }
+
+    /// @brief 窗口是否已经写满
+    pub fn is_full(&self) -> bool {
+        return self.full;
+    }
+
+    /// @brief 写入格式化的内容
+    ///
+    /// 窗口写满之后返回ENOBUFS，生成函数应当通过`?`把它向上传递，从而提前结束生成。
+    /// 调用者通过is_full()把这种情况和真正的错误区分开
+    pub fn print(&mut self, args: fmt::Arguments) -> Result<(), SystemError> {
+        if self.full {
+            return Err(SystemError::ENOBUFS);
+        }
+        fmt::Write::write_fmt(self, args).map_err(|_| SystemError::ENOBUFS)?;
+        if self.full {
+            return Err(SystemError::ENOBUFS);
+        }
+        return Ok(());
+    }
+}
+
+impl<'a> fmt::Write for SeqFile<'a> {
+    fn write_str(&mut self, s: &str) -> fmt::Result {
+        let bytes = s.as_bytes();
+        let start = self.pos;
+        self.pos += bytes.len();
+
+        let buf = match self.buf {
+            Some(ref mut buf) => buf,
+            None => return Ok(()),
+        };
+        // 与窗口重叠的部分
+        let window_end = self.offset + buf.len();
+        let copy_start = start.max(self.offset);
+        let copy_end = self.pos.min(window_end);
+        if copy_start < copy_end {
+            let dst = copy_start - self.offset;
+            buf[dst..dst + (copy_end - copy_start)]
+                .copy_from_slice(&bytes[copy_start - start..copy_end - start]);
+            self.written += copy_end - copy_start;
+        }
+        if self.pos >= window_end {
+            self.full = true;
+            return Err(fmt::Error);
+        }
+        return Ok(());
+    }
+}
+
+/// @brief 以printf的形式向SeqFile写入内容，窗口写满时返回ENOBUFS
+#[macro_export]
+macro_rules! seq_printf {
+    ($seq:expr, $($arg:tt)*) => {
+        $seq.print(format_args!($($arg)*))
+    };
+}
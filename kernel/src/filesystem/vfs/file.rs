@@ -10,6 +10,7 @@ use crate::{
     filesystem::procfs::ProcfsFilePrivateData,
     kerror,
     libs::spinlock::SpinLock,
+    mm::page_cache::page_cache_invalidate,
     process::ProcessManager,
     syscall::SystemError,
 };
@@ -176,6 +177,10 @@ impl File {
             .inode
             .write_at(self.offset, len, buf, &mut self.private_data)?;
         self.offset += len;
+        // 文件的内容已经改变，丢弃它的页缓存
+        if self.file_type == FileType::File {
+            page_cache_invalidate(&self.inode);
+        }
         return Ok(len);
     }
 
@@ -367,6 +372,7 @@ impl File {
 
         // 调用inode的truncate方法
         self.inode.resize(len)?;
+        page_cache_invalidate(&self.inode);
         return Ok(());
     }
 }
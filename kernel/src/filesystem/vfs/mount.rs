@@ -8,7 +8,7 @@ use alloc::{
     sync::{Arc, Weak},
 };
 
-use crate::{libs::spinlock::SpinLock, syscall::SystemError};
+use crate::{libs::rcu::Rcu, syscall::SystemError};
 
 use super::{file::FileMode, FilePrivateData, FileSystem, FileType, IndexNode, InodeId};
 
@@ -18,8 +18,8 @@ use super::{file::FileMode, FilePrivateData, FileSystem, FileType, IndexNode, In
 pub struct MountFS {
     // MountFS内部的文件系统
     inner_filesystem: Arc<dyn FileSystem>,
-    /// 用来存储InodeID->挂载点的MountFS的B树
-    mountpoints: SpinLock<BTreeMap<InodeId, Arc<MountFS>>>,
+    /// 用来存储InodeID->挂载点的MountFS的B树（路径查找时每一级都要读取，因此使用RCU保护）
+    mountpoints: Rcu<BTreeMap<InodeId, Arc<MountFS>>>,
     /// 当前文件系统挂载到的那个挂载点的Inode
     self_mountpoint: Option<Arc<MountFSInode>>,
     /// 指向当前MountFS的弱引用
@@ -44,7 +44,7 @@ impl MountFS {
     ) -> Arc<Self> {
         return MountFS {
             inner_filesystem: inner_fs,
-            mountpoints: SpinLock::new(BTreeMap::new()),
+            mountpoints: Rcu::new(BTreeMap::new()),
             self_mountpoint: self_mountpoint,
             self_ref: Weak::default(),
         }
@@ -120,7 +120,8 @@ impl MountFSInode {
     fn overlaid_inode(&self) -> Arc<MountFSInode> {
         let inode_id = self.metadata().unwrap().inode_id;
 
-        if let Some(sub_mountfs) = self.mount_fs.mountpoints.lock().get(&inode_id) {
+        let sub_mountfs = self.mount_fs.mountpoints.read().get(&inode_id).cloned();
+        if let Some(sub_mountfs) = sub_mountfs {
             return sub_mountfs.mountpoint_root_inode();
         } else {
             return self.self_ref.upgrade().unwrap();
@@ -233,7 +234,7 @@ impl IndexNode for MountFSInode {
         let inode_id = self.inner_inode.find(name)?.metadata()?.inode_id;
 
         // 先检查这个inode是否为一个挂载点，如果当前inode是一个挂载点，那么就不能删除这个inode
-        if self.mount_fs.mountpoints.lock().contains_key(&inode_id) {
+        if self.mount_fs.mountpoints.read().contains_key(&inode_id) {
             return Err(SystemError::EBUSY);
         }
         // 调用内层的inode的方法来删除这个inode
@@ -245,7 +246,7 @@ impl IndexNode for MountFSInode {
         let inode_id = self.inner_inode.find(name)?.metadata()?.inode_id;
 
         // 先检查这个inode是否为一个挂载点，如果当前inode是一个挂载点，那么就不能删除这个inode
-        if self.mount_fs.mountpoints.lock().contains_key(&inode_id) {
+        if self.mount_fs.mountpoints.read().contains_key(&inode_id) {
             return Err(SystemError::EBUSY);
         }
         // 调用内层的rmdir的方法来删除这个inode
@@ -340,10 +341,11 @@ impl IndexNode for MountFSInode {
         // 为新的挂载点创建挂载文件系统
         let new_mount_fs: Arc<MountFS> = MountFS::new(fs, Some(self.self_ref.upgrade().unwrap()));
         // 将新的挂载点-挂载文件系统添加到父级的挂载树
-        self.mount_fs
-            .mountpoints
-            .lock()
-            .insert(metadata.inode_id, new_mount_fs.clone());
+        self.mount_fs.mountpoints.update(|mountpoints| {
+            let mut mountpoints = mountpoints.clone();
+            mountpoints.insert(metadata.inode_id, new_mount_fs.clone());
+            mountpoints
+        });
         return Ok(new_mount_fs);
     }
 }
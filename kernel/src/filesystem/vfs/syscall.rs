@@ -1,4 +1,10 @@
+use core::{
+    ops::{Deref, DerefMut},
+    sync::atomic::{AtomicPtr, Ordering},
+};
+
 use alloc::{
+    boxed::Box,
     string::{String, ToString},
     sync::Arc,
     vec::Vec,
@@ -9,10 +15,14 @@ use crate::{
     filesystem::vfs::file::FileDescriptorVec,
     include::bindings::bindings::{verify_area, AT_REMOVEDIR, PAGE_4K_SIZE, PROC_MAX_FD_NUM},
     kerror,
-    libs::rwlock::RwLockWriteGuard,
-    mm::VirtAddr,
+    libs::{rwlock::RwLockWriteGuard, spinlock::SpinLock},
+    mm::{percpu::PerCpu, VirtAddr},
     process::ProcessManager,
-    syscall::{Syscall, SystemError},
+    smp::core::smp_get_processor_id,
+    syscall::{
+        user_access::{UserBufferReader, UserBufferWriter},
+        Syscall, SystemError,
+    },
     time::TimeSpec,
 };
 
@@ -29,6 +39,73 @@ pub const SEEK_CUR: u32 = 1;
 pub const SEEK_END: u32 = 2;
 pub const SEEK_MAX: u32 = 3;
 
+/// read/write系统调用在内核中转缓冲区与用户缓冲区之间一次拷贝的最大字节数
+const RW_BOUNCE_SIZE: usize = 64 * 1024;
+/// 不超过这个长度的read/write使用栈上的中转缓冲区
+const RW_STACK_BOUNCE_SIZE: usize = 256;
+
+/// 每个cpu缓存一个中转缓冲区，read/write不必每次都分配并清零
+static RW_BOUNCE_CACHE: [AtomicPtr<u8>; PerCpu::MAX_CPU_NUM] = {
+    const EMPTY: AtomicPtr<u8> = AtomicPtr::new(core::ptr::null_mut());
+    [EMPTY; PerCpu::MAX_CPU_NUM]
+};
+
+/// 大小为RW_BOUNCE_SIZE的中转缓冲区，释放时放回当前cpu的缓存
+///
+/// 缓冲区只是一个缓存，使用期间进程可以睡眠、被迁移到其他cpu
+struct RwBounceBuffer {
+    buf: Option<Box<[u8]>>,
+}
+
+impl RwBounceBuffer {
+    fn get() -> Self {
+        let cpu = smp_get_processor_id() as usize;
+        let ptr = RW_BOUNCE_CACHE[cpu].swap(core::ptr::null_mut(), Ordering::Acquire);
+        let buf = if ptr.is_null() {
+            // 只有新分配的缓冲区需要清零，之后一直复用
+            vec![0u8; RW_BOUNCE_SIZE].into_boxed_slice()
+        } else {
+            unsafe { Box::from_raw(core::ptr::slice_from_raw_parts_mut(ptr, RW_BOUNCE_SIZE)) }
+        };
+        return Self { buf: Some(buf) };
+    }
+}
+
+impl Deref for RwBounceBuffer {
+    type Target = [u8];
+
+    fn deref(&self) -> &[u8] {
+        return self.buf.as_ref().unwrap();
+    }
+}
+
+impl DerefMut for RwBounceBuffer {
+    fn deref_mut(&mut self) -> &mut [u8] {
+        return self.buf.as_mut().unwrap();
+    }
+}
+
+impl Drop for RwBounceBuffer {
+    fn drop(&mut self) {
+        let ptr = Box::into_raw(self.buf.take().unwrap()) as *mut u8;
+        let cpu = smp_get_processor_id() as usize;
+        if RW_BOUNCE_CACHE[cpu]
+            .compare_exchange(
+                core::ptr::null_mut(),
+                ptr,
+                Ordering::Release,
+                Ordering::Relaxed,
+            )
+            .is_err()
+        {
+            // 当前cpu已经缓存了一个，释放这个
+            drop(unsafe {
+                Box::from_raw(core::ptr::slice_from_raw_parts_mut(ptr, RW_BOUNCE_SIZE))
+            });
+        }
+    }
+}
+
 bitflags! {
     /// 文件类型和权限
     pub struct ModeType: u32 {
@@ -251,6 +328,136 @@ impl Syscall {
         return file.lock_no_preempt().write(buf.len(), buf);
     }
 
+    /// @brief 根据文件描述符，读取文件数据到（用户）缓冲区中。
+    ///
+    /// 数据先被读入内核的中转缓冲区，再通过能够处理缺页异常的拷贝写入buf，
+    /// 因此buf中存在无效的地址时返回EFAULT，而不会在持有文件的锁时发生内核缺页。
+    /// 普通文件按RW_BOUNCE_SIZE分块读取；对于管道、终端等文件，拆成多次读取会改变阻塞的语义，
+    /// 因此只读取一次，最多读取RW_BOUNCE_SIZE字节（即一次短读）。
+    /// 短的读取使用栈上的中转缓冲区，其余使用每个cpu缓存的中转缓冲区。
+    ///
+    /// @param fd 文件描述符编号
+    /// @param buf 缓冲区的起始地址
+    /// @param len 缓冲区的长度
+    /// @param from_user buf是否来自用户态
+    ///
+    /// @return Ok(usize) 成功读取的数据的字节数
+    /// @return Err(SystemError) 读取失败，返回posix错误码
+    pub fn read_to_user(
+        fd: i32,
+        buf: *mut u8,
+        len: usize,
+        from_user: bool,
+    ) -> Result<usize, SystemError> {
+        let file = Self::get_file(fd)?;
+        let mut writer = UserBufferWriter::new(buf, len, from_user)?;
+        if len <= RW_STACK_BOUNCE_SIZE {
+            let mut bounce = [0u8; RW_STACK_BOUNCE_SIZE];
+            return Self::do_read_to_user(&file, &mut writer, len, &mut bounce);
+        }
+        return Self::do_read_to_user(&file, &mut writer, len, &mut RwBounceBuffer::get());
+    }
+
+    fn do_read_to_user(
+        file: &Arc<SpinLock<File>>,
+        writer: &mut UserBufferWriter,
+        len: usize,
+        bounce: &mut [u8],
+    ) -> Result<usize, SystemError> {
+        let split = file.lock_no_preempt().file_type() == FileType::File;
+        let mut done = 0;
+        loop {
+            let chunk = (len - done).min(bounce.len());
+            let res = file
+                .lock_no_preempt()
+                .read(chunk, &mut bounce[..chunk])
+                .and_then(|n| {
+                    if n > 0 {
+                        writer.copy_to_user(&bounce[..n], done)?;
+                    }
+                    Ok(n)
+                });
+            let n = match res {
+                Ok(n) => n,
+                // 已经读到用户缓冲区中的数据不能丢弃，返回已经读取的字节数
+                Err(_) if done > 0 => break,
+                Err(e) => return Err(e),
+            };
+            done += n;
+            if !split || n < chunk || done == len {
+                break;
+            }
+        }
+        return Ok(done);
+    }
+
+    /// @brief 根据文件描述符，把（用户）缓冲区中的数据写入文件。
+    ///
+    /// 数据按RW_BOUNCE_SIZE分块，通过能够处理缺页异常的拷贝读入内核的中转缓冲区之后再写入文件，
+    /// 因此buf中存在无效的地址时返回EFAULT，而不会在持有文件的锁时发生内核缺页。
+    /// 短的写入使用栈上的中转缓冲区，其余使用每个cpu缓存的中转缓冲区。
+    ///
+    /// @param fd 文件描述符编号
+    /// @param buf 缓冲区的起始地址
+    /// @param len 缓冲区的长度
+    /// @param from_user buf是否来自用户态
+    ///
+    /// @return Ok(usize) 成功写入的数据的字节数
+    /// @return Err(SystemError) 写入失败，返回posix错误码
+    pub fn write_from_user(
+        fd: i32,
+        buf: *const u8,
+        len: usize,
+        from_user: bool,
+    ) -> Result<usize, SystemError> {
+        let file = Self::get_file(fd)?;
+        let reader = UserBufferReader::new(buf, len, from_user)?;
+        if len <= RW_STACK_BOUNCE_SIZE {
+            let mut bounce = [0u8; RW_STACK_BOUNCE_SIZE];
+            return Self::do_write_from_user(&file, &reader, len, &mut bounce);
+        }
+        return Self::do_write_from_user(&file, &reader, len, &mut RwBounceBuffer::get());
+    }
+
+    fn do_write_from_user(
+        file: &Arc<SpinLock<File>>,
+        reader: &UserBufferReader,
+        len: usize,
+        bounce: &mut [u8],
+    ) -> Result<usize, SystemError> {
+        let mut done = 0;
+        loop {
+            let chunk = (len - done).min(bounce.len());
+            let res = if chunk > 0 {
+                reader
+                    .copy_from_user(&mut bounce[..chunk], done)
+                    .map(|_| ())
+            } else {
+                Ok(())
+            }
+            .and_then(|_| file.lock_no_preempt().write(chunk, &bounce[..chunk]));
+            let n = match res {
+                Ok(n) => n,
+                // 已经写入的数据无法撤回，返回已经写入的字节数
+                Err(_) if done > 0 => break,
+                Err(e) => return Err(e),
+            };
+            done += n;
+            if n < chunk || done == len {
+                break;
+            }
+        }
+        return Ok(done);
+    }
+
+    /// @brief 获取当前进程中文件描述符对应的文件
+    fn get_file(fd: i32) -> Result<Arc<SpinLock<File>>, SystemError> {
+        let binding = ProcessManager::current_pcb().fd_table();
+        let fd_table_guard = binding.read();
+
+        return fd_table_guard.get_file_by_fd(fd).ok_or(SystemError::EBADF);
+    }
+
     /// @brief 调整文件操作指针的位置
     ///
     /// @param fd 文件描述符编号
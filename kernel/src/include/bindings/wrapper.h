@@ -13,6 +13,7 @@
 #include <common/blk_types.h>
 #include <common/crc16.h>
 #include <common/crc32.h>
+#include <common/crc32c.h>
 #include <common/crc64.h>
 #include <common/crc7.h>
 #include <common/crc8.h>
@@ -0,0 +1,280 @@
+//! 内核基准测试框架
+//!
+//! 每个基准测试由一个函数描述，在指定数量的内核线程中同时运行，每个线程都被绑定到一个选定的cpu上。
+//! 测试函数通过`Bencher::iter`给出需要被测量的操作：框架先执行若干次预热，然后用TSC逐次测量，
+//! 最后把所有线程的样本合并，报告最小值、中位数、p90、p99和最大值（单位：纳秒/次）。
+//!
+//! - 向/proc/kbench写入`run <测试名称|all> [cpu列表]`开始测试，例如`run spinlock_2 0,1`。
+//!   测试在工作队列中异步进行，cpu列表缺省时按顺序使用前N个cpu
+//! - 读取/proc/kbench得到所有的基准测试以及最近一次测试的结果
+use core::{
+    arch::x86_64::{_mm_lfence, _rdtsc},
+    hint::spin_loop,
+    sync::atomic::{AtomicBool, AtomicUsize, Ordering},
+};
+
+use alloc::{boxed::Box, format, string::String, sync::Arc, vec::Vec};
+
+use crate::{
+    include::bindings::bindings::{smp_get_total_cpu, Cpu_tsc_freq},
+    libs::spinlock::SpinLock,
+    process::{
+        kthread::{KernelThreadClosure, KernelThreadMechanism},
+        workqueue::{Work, SYSTEM_UNBOUND_WQ},
+        ProcessManager,
+    },
+    sched::completion::Completion,
+    syscall::SystemError,
+};
+
+mod suites;
+
+/// 一个基准测试
+pub struct KBench {
+    /// 测试的名称
+    pub name: &'static str,
+    /// 同时运行测试函数的线程数
+    pub threads: usize,
+    /// 每个线程预热的次数
+    pub warmup: usize,
+    /// 每个线程测量的次数
+    pub iters: usize,
+    /// 测试函数
+    pub func: fn(&mut Bencher),
+}
+
+/// 传递给测试函数的测量器
+pub struct Bencher {
+    /// 当前线程在本次测试的所有线程中的序号
+    thread_index: usize,
+    warmup: usize,
+    iters: usize,
+    /// 所有线程预热完毕后才开始测量
+    barrier: Arc<AtomicUsize>,
+    threads: usize,
+    /// 每次测量得到的TSC周期数
+    samples: Vec<u64>,
+}
+
+impl Bencher {
+    /// @brief 当前线程在本次测试的所有线程中的序号
+    ///
+    /// 需要多个线程相互配合的测试（例如唤醒的往返）根据它决定线程的角色
+    pub fn thread_index(&self) -> usize {
+        return self.thread_index;
+    }
+
+    /// @brief 测量一个操作
+    ///
+    /// 先执行warmup次不计时的预热，等待其他线程预热完毕，然后逐次测量iters次
+    pub fn iter<F: FnMut()>(&mut self, mut f: F) {
+        for _ in 0..self.warmup {
+            f();
+        }
+
+        self.barrier.fetch_add(1, Ordering::SeqCst);
+        while self.barrier.load(Ordering::SeqCst) < self.threads {
+            spin_loop();
+        }
+
+        let overhead = tsc_overhead();
+        self.samples.reserve(self.iters);
+        for _ in 0..self.iters {
+            let start = tsc();
+            f();
+            let end = tsc();
+            self.samples
+                .push((end.saturating_sub(start)).saturating_sub(overhead));
+        }
+    }
+}
+
+/// 测量用的TSC读取，用lfence防止乱序执行越过测量的边界
+#[inline(always)]
+fn tsc() -> u64 {
+    unsafe {
+        _mm_lfence();
+        let t = _rdtsc();
+        _mm_lfence();
+        return t;
+    }
+}
+
+/// @brief 估计一次测量本身的开销（两次读取TSC之间的最小间隔）
+fn tsc_overhead() -> u64 {
+    let mut min = u64::MAX;
+    for _ in 0..64 {
+        let start = tsc();
+        let end = tsc();
+        min = min.min(end - start);
+    }
+    return min;
+}
+
+/// 是否有测试正在进行
+static KBENCH_RUNNING: AtomicBool = AtomicBool::new(false);
+
+lazy_static! {
+    /// 最近一次测试的结果
+    static ref KBENCH_RESULTS: SpinLock<String> = SpinLock::new(String::new());
+}
+
+/// @brief 在选定的cpu上运行一个基准测试，返回结果中的一行
+fn kbench_run_one(bench: &'static KBench, cpus: &[u32]) -> String {
+    if bench.threads > cpus.len() {
+        return format!(
+            "{} skipped: needs {} cpus, {} selected\n",
+            bench.name,
+            bench.threads,
+            cpus.len()
+        );
+    }
+
+    let barrier = Arc::new(AtomicUsize::new(0));
+    let samples: Arc<SpinLock<Vec<u64>>> = Arc::new(SpinLock::new(Vec::new()));
+    let done = Arc::new(Completion::new());
+    // 有线程创建失败时置位，已经创建的线程不运行测试函数，直接退出
+    let abort = Arc::new(AtomicBool::new(false));
+
+    // 先创建所有的线程，全部创建成功之后才开始测试，否则先启动的线程会永远等待屏障
+    let mut pcbs = Vec::with_capacity(bench.threads);
+    for thread_index in 0..bench.threads {
+        let barrier = barrier.clone();
+        let samples = samples.clone();
+        let done = done.clone();
+        let abort = abort.clone();
+        let closure = KernelThreadClosure::EmptyClosure((
+            Box::new(move || {
+                if abort.load(Ordering::SeqCst) {
+                    done.complete();
+                    return 0;
+                }
+                let mut bencher = Bencher {
+                    thread_index,
+                    warmup: bench.warmup,
+                    iters: bench.iters,
+                    barrier: barrier.clone(),
+                    threads: bench.threads,
+                    samples: Vec::new(),
+                };
+                (bench.func)(&mut bencher);
+                samples.lock().append(&mut bencher.samples);
+                done.complete();
+                0
+            }),
+            (),
+        ));
+        match KernelThreadMechanism::create(closure, format!("kbench-{}", thread_index)) {
+            Some(pcb) => {
+                KernelThreadMechanism::bind(&pcb, cpus[thread_index]);
+                pcbs.push(pcb);
+            }
+            None => {
+                abort.store(true, Ordering::SeqCst);
+                break;
+            }
+        }
+    }
+
+    for pcb in pcbs.iter() {
+        ProcessManager::wakeup(pcb).ok();
+    }
+    for _ in 0..pcbs.len() {
+        done.wait_for_completion().ok();
+    }
+    if abort.load(Ordering::SeqCst) {
+        return format!("{} failed: cannot create kernel thread\n", bench.name);
+    }
+
+    let mut samples = core::mem::take(&mut *samples.lock());
+    return kbench_report(bench, &mut samples);
+}
+
+/// @brief 把样本转换为一行报告：`名称 线程数 样本数 min p50 p90 p99 max`，单位为纳秒/次
+fn kbench_report(bench: &KBench, samples: &mut [u64]) -> String {
+    if samples.is_empty() {
+        return format!("{} failed: no samples\n", bench.name);
+    }
+    samples.sort_unstable();
+    let tsc_freq = unsafe { Cpu_tsc_freq }.max(1) as u128;
+    let to_ns = |cycles: u64| (cycles as u128 * 1000000000 / tsc_freq) as u64;
+    let percentile = |p: usize| to_ns(samples[(samples.len() - 1) * p / 100]);
+    return format!(
+        "{} {} {} {} {} {} {} {}\n",
+        bench.name,
+        bench.threads,
+        samples.len(),
+        to_ns(samples[0]),
+        percentile(50),
+        percentile(90),
+        percentile(99),
+        to_ns(samples[samples.len() - 1])
+    );
+}
+
+/// @brief 运行名称匹配的基准测试，结果保存到KBENCH_RESULTS中
+fn kbench_run(name: String, cpus: Vec<u32>) {
+    *KBENCH_RESULTS.lock() =
+        String::from("name threads samples min_ns p50_ns p90_ns p99_ns max_ns\n");
+    for bench in suites::KBENCHES.iter() {
+        if name != "all" && bench.name != name {
+            continue;
+        }
+        let line = kbench_run_one(bench, &cpus);
+        KBENCH_RESULTS.lock().push_str(&line);
+    }
+    KBENCH_RUNNING.store(false, Ordering::SeqCst);
+}
+
+/// @brief 处理写入/proc/kbench的命令：`run <测试名称|all> [cpu列表]`
+pub fn kbench_control(cmd: &str) -> Result<(), SystemError> {
+    let mut args = cmd
+        .trim_matches(|c: char| c.is_whitespace() || c == '\0')
+        .split_whitespace();
+    if args.next() != Some("run") {
+        return Err(SystemError::EINVAL);
+    }
+    let name = args.next().ok_or(SystemError::EINVAL)?;
+    if name != "all" && !suites::KBENCHES.iter().any(|bench| bench.name == name) {
+        return Err(SystemError::ENOENT);
+    }
+
+    let total_cpus = unsafe { smp_get_total_cpu() };
+    let cpus: Vec<u32> = match args.next() {
+        Some(list) => {
+            let mut cpus = Vec::new();
+            for cpu in list.split(',') {
+                let cpu = cpu.parse::<u32>().map_err(|_| SystemError::EINVAL)?;
+                if cpu >= total_cpus {
+                    return Err(SystemError::EINVAL);
+                }
+                cpus.push(cpu);
+            }
+            cpus
+        }
+        None => (0..total_cpus).collect(),
+    };
+
+    if KBENCH_RUNNING.swap(true, Ordering::SeqCst) {
+        return Err(SystemError::EBUSY);
+    }
+    let name = String::from(name);
+    // 创建测试线程时需要等待kthreadd，不能在持有锁的上下文中进行，因此交给工作队列
+    let work = Work::new(Box::new(move || kbench_run(name.clone(), cpus.clone())));
+    SYSTEM_UNBOUND_WQ.queue_work(work);
+    return Ok(());
+}
+
+/// @brief 列出所有的基准测试以及最近一次测试的结果
+pub fn kbench_dump() -> String {
+    let mut result = String::from("benchmarks:");
+    for bench in suites::KBENCHES.iter() {
+        result.push_str(&format!(" {}", bench.name));
+    }
+    result.push_str(&format!(
+        "\nrunning: {}\n",
+        KBENCH_RUNNING.load(Ordering::SeqCst) as u8
+    ));
+    result.push_str(&KBENCH_RESULTS.lock());
+    return result;
+}
@@ -0,0 +1,211 @@
+//! 内核基准测试用例
+use core::alloc::{GlobalAlloc, Layout};
+
+use alloc::{boxed::Box, vec::Vec};
+
+use crate::{
+    arch::{mm::LockedFrameAllocator, sched::sched},
+    include::bindings::bindings::{
+        crc32, crc32_generic, crc32c, crc32c_generic, crc64, crc64_generic,
+    },
+    libs::{rbtree::RBTree, spinlock::SpinLock},
+    mm::allocator::{
+        kernel_allocator::KernelAllocator,
+        page_frame::{FrameAllocator, PageFrameCount},
+    },
+    sched::completion::Completion,
+    syscall::SystemError,
+    time::timer::{next_n_us_timer_jiffies, Timer, TimerFunction},
+};
+
+use super::{Bencher, KBench};
+
+/// @brief 定义一个基准测试，使用默认的预热次数和测量次数
+macro_rules! bench {
+    ($name:expr, $threads:expr, $func:expr) => {
+        KBench {
+            name: $name,
+            threads: $threads,
+            warmup: 1000,
+            iters: 10000,
+            func: $func,
+        }
+    };
+}
+
+/// 所有的基准测试
+pub static KBENCHES: [KBench; 25] = [
+    bench!("buddy_order0", 1, bench_buddy::<0>),
+    bench!("buddy_order1", 1, bench_buddy::<1>),
+    bench!("buddy_order2", 1, bench_buddy::<2>),
+    bench!("buddy_order4", 1, bench_buddy::<4>),
+    bench!("buddy_order8", 1, bench_buddy::<8>),
+    bench!("kmalloc_32", 1, bench_kmalloc::<32>),
+    bench!("kmalloc_256", 1, bench_kmalloc::<256>),
+    bench!("kmalloc_1024", 1, bench_kmalloc::<1024>),
+    bench!("kmalloc_4096", 1, bench_kmalloc::<4096>),
+    bench!("kmalloc_65536", 1, bench_kmalloc::<65536>),
+    bench!("spinlock_1", 1, bench_spinlock),
+    bench!("spinlock_2", 2, bench_spinlock),
+    bench!("spinlock_4", 4, bench_spinlock),
+    bench!("spinlock_8", 8, bench_spinlock),
+    bench!("rbtree_insert_pop", 1, bench_rbtree),
+    bench!("timer_activate_cancel", 1, bench_timer),
+    bench!("sched_yield", 1, bench_sched_yield),
+    bench!("sched_yield_2", 2, bench_sched_yield),
+    bench!("waitqueue_pingpong", 2, bench_waitqueue_pingpong),
+    bench!("crc32c_4k", 1, bench_crc32c::<true>),
+    bench!("crc32c_generic_4k", 1, bench_crc32c::<false>),
+    bench!("crc32_4k", 1, bench_crc32::<true>),
+    bench!("crc32_generic_4k", 1, bench_crc32::<false>),
+    bench!("crc64_4k", 1, bench_crc64::<true>),
+    bench!("crc64_generic_4k", 1, bench_crc64::<false>),
+];
+
+/// buddy分配器分配、释放`2^ORDER`页
+fn bench_buddy<const ORDER: usize>(b: &mut Bencher) {
+    let count = PageFrameCount::new(1 << ORDER);
+    b.iter(|| unsafe {
+        if let Some((paddr, count)) = LockedFrameAllocator.allocate(count) {
+            LockedFrameAllocator.free(paddr, count);
+        }
+    });
+}
+
+/// 内核堆分配、释放SIZE字节
+fn bench_kmalloc<const SIZE: usize>(b: &mut Bencher) {
+    let layout = Layout::from_size_align(SIZE, 8).unwrap();
+    b.iter(|| unsafe {
+        let ptr = KernelAllocator.alloc(layout);
+        if !ptr.is_null() {
+            // 写入一个字节，防止分配被优化掉
+            core::ptr::write_volatile(ptr, 0);
+            KernelAllocator.dealloc(ptr, layout);
+        }
+    });
+}
+
+static BENCH_SPINLOCK: SpinLock<u64> = SpinLock::new(0);
+
+/// 多个cpu竞争同一个自旋锁，临界区内只做一次加法
+fn bench_spinlock(b: &mut Bencher) {
+    b.iter(|| {
+        let mut guard = BENCH_SPINLOCK.lock();
+        *guard = guard.wrapping_add(1);
+    });
+}
+
+/// 在一棵保持1024个节点的红黑树中插入一个节点并弹出最小的节点
+fn bench_rbtree(b: &mut Bencher) {
+    let mut tree: RBTree<u64, u64> = RBTree::new();
+    let mut seed: u64 = 0x2545_F491_4F6C_DD1D;
+    let mut next_key = || {
+        // xorshift，避免插入的键是有序的
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        seed
+    };
+    for _ in 0..1024 {
+        let key = next_key();
+        tree.insert(key, key);
+    }
+    b.iter(|| {
+        let key = next_key();
+        tree.insert(key, key);
+        tree.pop_first();
+    });
+}
+
+#[derive(Debug)]
+struct NopTimerFunction;
+
+impl TimerFunction for NopTimerFunction {
+    fn run(&mut self) -> Result<(), SystemError> {
+        return Ok(());
+    }
+}
+
+/// 激活一个10秒后到期的定时器，然后取消它
+fn bench_timer(b: &mut Bencher) {
+    b.iter(|| {
+        let timer = Timer::new(
+            Box::new(NopTimerFunction),
+            next_n_us_timer_jiffies(10000000),
+        );
+        timer.activate();
+        timer.cancel();
+    });
+}
+
+/// 主动让出cpu，测量一次sched_enqueue加上do_sched的开销
+///
+/// 只有一个线程时，调度器会重新选中当前线程；把两个线程绑定到同一个cpu（`run sched_yield_2 0,0`）时，
+/// 测量的是上下文切换的开销
+fn bench_sched_yield(b: &mut Bencher) {
+    b.iter(|| sched());
+}
+
+static BENCH_PING: Completion = Completion::new();
+static BENCH_PONG: Completion = Completion::new();
+
+/// 两个线程通过等待队列相互唤醒，测量一次往返的开销
+fn bench_waitqueue_pingpong(b: &mut Bencher) {
+    if b.thread_index() == 0 {
+        b.iter(|| {
+            BENCH_PING.complete();
+            BENCH_PONG.wait_for_completion().ok();
+        });
+    } else {
+        b.iter(|| {
+            BENCH_PING.wait_for_completion().ok();
+            BENCH_PONG.complete();
+        });
+    }
+}
+
+/// crc测试使用的4KB数据
+fn crc_bench_data() -> Vec<u8> {
+    return (0..4096u32)
+        .map(|i| (i.wrapping_mul(0x9E37_79B9) >> 24) as u8)
+        .collect();
+}
+
+/// 计算4KB数据的crc32c，ACCEL为false时使用查表法
+fn bench_crc32c<const ACCEL: bool>(b: &mut Bencher) {
+    let data = crc_bench_data();
+    b.iter(|| unsafe {
+        let crc = if ACCEL {
+            crc32c(!0, data.as_ptr(), data.len())
+        } else {
+            crc32c_generic(!0, data.as_ptr(), data.len())
+        };
+        core::hint::black_box(crc);
+    });
+}
+
+/// 计算4KB数据的crc32，ACCEL为false时使用查表法
+fn bench_crc32<const ACCEL: bool>(b: &mut Bencher) {
+    let data = crc_bench_data();
+    b.iter(|| unsafe {
+        let crc = if ACCEL {
+            crc32(0, data.as_ptr(), data.len())
+        } else {
+            crc32_generic(0, data.as_ptr(), data.len())
+        };
+        core::hint::black_box(crc);
+    });
+}
+
+/// 计算4KB数据的crc64，ACCEL为false时使用查表法
+fn bench_crc64<const ACCEL: bool>(b: &mut Bencher) {
+    let data = crc_bench_data();
+    b.iter(|| unsafe {
+        let crc = if ACCEL {
+            crc64(0, data.as_ptr(), data.len())
+        } else {
+            crc64_generic(0, data.as_ptr(), data.len())
+        };
+        core::hint::black_box(crc);
+    });
+}
@@ -0,0 +1,6 @@
+//! 内核测试
+//!
+//! 功能测试位于本目录下的C文件中，通过ktest_start启动；Rust实现的模块的功能测试位于对应的子模块中，
+//! 同样导出为C函数并在ktest.h中声明。性能测试（基准测试）位于bench模块中。
+pub mod bench;
+mod zram;
@@ -0,0 +1,199 @@
+//! zram的功能测试
+//!
+//! 测试使用一个没有注册到块设备层的zram设备，不会占用zram的设备编号
+use core::{ffi::c_void, sync::atomic::Ordering};
+
+use alloc::{sync::Arc, vec, vec::Vec};
+
+use crate::{
+    driver::{
+        base::{
+            block::block_device::{BlockDevice, LBA_SIZE},
+            device::mkdev,
+        },
+        disk::zram::{ZramDevice, ZRAM_PAGE_SIZE},
+    },
+    kerror, kinfo,
+    syscall::SystemError,
+};
+
+/// 测试设备的页数
+const KTEST_ZRAM_PAGES: usize = 16;
+/// 每个页包含的LBA数
+const KTEST_ZRAM_LBAS_PER_PAGE: usize = ZRAM_PAGE_SIZE / LBA_SIZE;
+
+macro_rules! ktest_assert {
+    ($cond:expr) => {
+        if !($cond) {
+            kerror!(
+                "[ kTEST FAILED ] Ktest Assertion Failed, file:{}, Line:{}",
+                file!(),
+                line!()
+            );
+            return Err(SystemError::EINVAL);
+        }
+    };
+}
+
+type ZramCase = fn(&Arc<ZramDevice>) -> Result<(), SystemError>;
+
+/// 容易压缩的数据
+fn compressible_page(seed: u8) -> Vec<u8> {
+    return (0..ZRAM_PAGE_SIZE)
+        .map(|i| seed.wrapping_add((i / 64) as u8))
+        .collect();
+}
+
+/// 几乎无法压缩的数据（xorshift生成的伪随机数）
+fn incompressible_page(seed: u64) -> Vec<u8> {
+    let mut x = seed | 1;
+    let mut data = Vec::with_capacity(ZRAM_PAGE_SIZE);
+    while data.len() < ZRAM_PAGE_SIZE {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        data.extend_from_slice(&x.to_ne_bytes());
+    }
+    return data;
+}
+
+/// @brief 读取第index个页
+fn read_page(dev: &Arc<ZramDevice>, index: usize) -> Result<Vec<u8>, SystemError> {
+    let mut buf = vec![0u8; ZRAM_PAGE_SIZE];
+    dev.read_at(
+        index * KTEST_ZRAM_LBAS_PER_PAGE,
+        KTEST_ZRAM_LBAS_PER_PAGE,
+        &mut buf,
+    )?;
+    return Ok(buf);
+}
+
+/// @brief 写入第index个页
+fn write_page(dev: &Arc<ZramDevice>, index: usize, data: &[u8]) -> Result<(), SystemError> {
+    dev.write_at(
+        index * KTEST_ZRAM_LBAS_PER_PAGE,
+        KTEST_ZRAM_LBAS_PER_PAGE,
+        data,
+    )?;
+    return Ok(());
+}
+
+/// 写入可压缩的页之后读回
+fn ktest_zram_case_roundtrip(dev: &Arc<ZramDevice>) -> Result<(), SystemError> {
+    // 从未写入过的页读取为全零
+    ktest_assert!(read_page(dev, 0)?.iter().all(|b| *b == 0));
+
+    let data = compressible_page(1);
+    write_page(dev, 0, &data)?;
+    ktest_assert!(read_page(dev, 0)? == data);
+    ktest_assert!(dev.stats().pages_stored.load(Ordering::Relaxed) == 1);
+    ktest_assert!(dev.stats().huge_pages.load(Ordering::Relaxed) == 0);
+    let compr = dev.stats().compr_data_size.load(Ordering::Relaxed);
+    ktest_assert!(compr > 0 && compr < ZRAM_PAGE_SIZE);
+
+    // 覆盖写入后旧的数据被释放
+    let data = compressible_page(2);
+    write_page(dev, 0, &data)?;
+    ktest_assert!(read_page(dev, 0)? == data);
+    ktest_assert!(dev.stats().pages_stored.load(Ordering::Relaxed) == 1);
+    return Ok(());
+}
+
+/// 同值页不占用存储空间
+fn ktest_zram_case_same_page(dev: &Arc<ZramDevice>) -> Result<(), SystemError> {
+    let stored = dev.stats().pages_stored.load(Ordering::Relaxed);
+
+    write_page(dev, 1, &vec![0u8; ZRAM_PAGE_SIZE])?;
+    ktest_assert!(dev.stats().same_pages.load(Ordering::Relaxed) == 1);
+    ktest_assert!(dev.stats().pages_stored.load(Ordering::Relaxed) == stored);
+    ktest_assert!(read_page(dev, 1)?.iter().all(|b| *b == 0));
+
+    // 非零的8字节填充值同样被识别
+    let pattern: Vec<u8> = 0x0123456789abcdefu64
+        .to_ne_bytes()
+        .iter()
+        .cycle()
+        .take(ZRAM_PAGE_SIZE)
+        .copied()
+        .collect();
+    write_page(dev, 2, &pattern)?;
+    ktest_assert!(dev.stats().same_pages.load(Ordering::Relaxed) == 2);
+    ktest_assert!(read_page(dev, 2)? == pattern);
+
+    // 用同值页覆盖保存在内存池中的页，释放原来的空间
+    write_page(dev, 0, &vec![0xabu8; ZRAM_PAGE_SIZE])?;
+    ktest_assert!(dev.stats().same_pages.load(Ordering::Relaxed) == 3);
+    ktest_assert!(dev.stats().pages_stored.load(Ordering::Relaxed) == stored - 1);
+    ktest_assert!(dev.stats().compr_data_size.load(Ordering::Relaxed) == 0);
+    return Ok(());
+}
+
+/// 无法压缩的页以原始数据保存
+fn ktest_zram_case_huge_page(dev: &Arc<ZramDevice>) -> Result<(), SystemError> {
+    let data = incompressible_page(0x9e3779b97f4a7c15);
+    write_page(dev, 3, &data)?;
+    ktest_assert!(dev.stats().huge_pages.load(Ordering::Relaxed) == 1);
+    ktest_assert!(read_page(dev, 3)? == data);
+
+    // 再次写入可压缩的数据后不再是原始数据页
+    let data = compressible_page(3);
+    write_page(dev, 3, &data)?;
+    ktest_assert!(dev.stats().huge_pages.load(Ordering::Relaxed) == 0);
+    ktest_assert!(read_page(dev, 3)? == data);
+    return Ok(());
+}
+
+/// 不完整的页的写入只修改对应的扇区
+fn ktest_zram_case_partial(dev: &Arc<ZramDevice>) -> Result<(), SystemError> {
+    const FIRST: usize = 4;
+    let mut expected = compressible_page(4);
+    expected.extend_from_slice(&incompressible_page(5));
+    write_page(dev, FIRST, &expected[..ZRAM_PAGE_SIZE])?;
+    write_page(dev, FIRST + 1, &expected[ZRAM_PAGE_SIZE..])?;
+
+    // 页中间的一个扇区，以及跨越两个页的边界的两个扇区
+    let writes: [(usize, usize, u8); 2] = [(3, 1, 0x5a), (KTEST_ZRAM_LBAS_PER_PAGE - 1, 2, 0xc3)];
+    for (lba, count, fill) in writes {
+        let data = vec![fill; count * LBA_SIZE];
+        let lba_start = FIRST * KTEST_ZRAM_LBAS_PER_PAGE + lba;
+        ktest_assert!(dev.write_at(lba_start, count, &data)? == data.len());
+        expected[lba * LBA_SIZE..(lba + count) * LBA_SIZE].copy_from_slice(&data);
+    }
+
+    let mut actual = vec![0u8; 2 * ZRAM_PAGE_SIZE];
+    dev.read_at(
+        FIRST * KTEST_ZRAM_LBAS_PER_PAGE,
+        2 * KTEST_ZRAM_LBAS_PER_PAGE,
+        &mut actual,
+    )?;
+    ktest_assert!(actual == expected);
+
+    // 读取单个扇区
+    let mut sector = vec![0u8; LBA_SIZE];
+    dev.read_at(FIRST * KTEST_ZRAM_LBAS_PER_PAGE + 3, 1, &mut sector)?;
+    ktest_assert!(sector.iter().all(|b| *b == 0x5a));
+    return Ok(());
+}
+
+static KTEST_ZRAM_CASES: [ZramCase; 4] = [
+    ktest_zram_case_roundtrip,
+    ktest_zram_case_same_page,
+    ktest_zram_case_huge_page,
+    ktest_zram_case_partial,
+];
+
+/// @brief zram的测试入口，与C文件中的测试一样通过ktest_start启动
+#[no_mangle]
+pub extern "C" fn ktest_test_zram(_arg: *mut c_void) -> i32 {
+    kinfo!("[ kTEST ] Testing zram...");
+    let dev = ZramDevice::new(0, KTEST_ZRAM_PAGES * ZRAM_PAGE_SIZE, mkdev(0, 0));
+    let mut failed = 0;
+    for (i, case) in KTEST_ZRAM_CASES.iter().enumerate() {
+        kinfo!("[ kTEST ] Testing case {}", i);
+        if case(&dev).is_err() {
+            failed += 1;
+        }
+    }
+    kinfo!("[ kTEST ] zram Test done, {} case(s) failed.", failed);
+    return if failed == 0 { 0 } else { -1 };
+}
@@ -28,10 +28,12 @@ mod arch;
 mod libs;
 #[macro_use]
 mod include;
+mod debug;
 mod driver; // 如果driver依赖了libs，应该在libs后面导出
 mod exception;
 mod filesystem;
 mod ipc;
+mod ktest;
 mod mm;
 mod net;
 mod process;
@@ -68,6 +70,8 @@ pub static KERNEL_ALLOCATOR: KernelAllocator = KernelAllocator;
 #[panic_handler]
 #[no_mangle]
 pub fn panic(info: &PanicInfo) -> ! {
+    // 控制台线程可能再也得不到运行，改为同步输出
+    libs::kmsg::kmsg_console_emergency();
     kerror!("Kernel Panic Occurred.");
 
     match info.location() {
@@ -1,4 +1,6 @@
 #include <common/sys/types.h>
+#include <common/crc32.h>
+#include <common/crc_accel.h>
 // Polynomial=0x4C11DB7
 // Initial Value=0x0
 // Final Xor Value:0x0
@@ -39,14 +41,14 @@ uint32_t const crc32_table[256] = {
     0xAFB010B1, 0xAB710D06, 0xA6322BDF, 0xA2F33668, 0xBCB4666D, 0xB8757BDA, 0xB5365D03, 0xB1F740B4};
 
 /**
- * @brief 计算crc32
+ * @brief 使用查表法计算crc32
  *
  * @param crc crc初始值
  * @param buffer 输入缓冲区
  * @param len buffer大小（bytes）
  * @return uint32_t crc
  */
-uint32_t crc32(uint32_t crc, uint8_t const *buffer, size_t len)
+uint32_t crc32_generic(uint32_t crc, uint8_t const *buffer, size_t len)
 {
     while (len--)
     {
@@ -54,3 +56,25 @@ uint32_t crc32(uint32_t crc, uint8_t const *buffer, size_t len)
     }
     return crc;
 }
+
+static uint64_t crc32_generic_u64(uint64_t crc, uint8_t const *buffer, size_t len)
+{
+    return crc32_generic((uint32_t)crc, buffer, len);
+}
+
+/**
+ * @brief 计算crc32
+ *
+ * cpu支持PCLMULQDQ且数据足够长时，使用PCLMULQDQ折叠，否则使用查表法
+ *
+ * @param crc crc初始值
+ * @param buffer 输入缓冲区
+ * @param len buffer大小（bytes）
+ * @return uint32_t crc
+ */
+uint32_t crc32(uint32_t crc, uint8_t const *buffer, size_t len)
+{
+    if (crc_accel_has_pclmul && len >= CRC_PCLMUL_MIN_LEN)
+        return (uint32_t)crc_pclmul_msb(&crc32_fold_consts, 32, crc, buffer, len, crc32_generic_u64);
+    return crc32_generic(crc, buffer, len);
+}
@@ -1,4 +1,6 @@
 #include <common/sys/types.h>
+#include <common/crc64.h>
+#include <common/crc_accel.h>
 
 // Polynomial   =0x42F0E1EBA9EA3693
 // Initial Value=0x0
@@ -40,14 +42,14 @@ uint64_t const crc64_table[256] = {
 };
 
 /**
- * @brief 计算crc64
+ * @brief 使用查表法计算crc64
  *
  * @param crc crc初始值
  * @param buffer 输入缓冲区
  * @param len buffer大小（bytes）
  * @return uint64_t crc
  */
-uint64_t crc64(uint64_t crc, uint8_t const *buffer, size_t len)
+uint64_t crc64_generic(uint64_t crc, uint8_t const *buffer, size_t len)
 {
     while (len--)
     {
@@ -55,3 +57,25 @@ uint64_t crc64(uint64_t crc, uint8_t const *buffer, size_t len)
     }
     return crc;
 }
+
+static uint64_t crc64_generic_u64(uint64_t crc, uint8_t const *buffer, size_t len)
+{
+    return crc64_generic((uint64_t)crc, buffer, len);
+}
+
+/**
+ * @brief 计算crc64
+ *
+ * cpu支持PCLMULQDQ且数据足够长时，使用PCLMULQDQ折叠，否则使用查表法
+ *
+ * @param crc crc初始值
+ * @param buffer 输入缓冲区
+ * @param len buffer大小（bytes）
+ * @return uint64_t crc
+ */
+uint64_t crc64(uint64_t crc, uint8_t const *buffer, size_t len)
+{
+    if (crc_accel_has_pclmul && len >= CRC_PCLMUL_MIN_LEN)
+        return (uint64_t)crc_pclmul_msb(&crc64_fold_consts, 64, crc, buffer, len, crc64_generic_u64);
+    return crc64_generic(crc, buffer, len);
+}
@@ -0,0 +1,160 @@
+#include <common/crc_accel.h>
+#include <common/cpu.h>
+#include <common/glib.h>
+#include <asm/irqflags.h>
+
+bool crc_accel_has_sse42 = false;
+bool crc_accel_has_pclmul = false;
+
+struct crc_fold_consts crc32_fold_consts;
+struct crc_fold_consts crc64_fold_consts;
+
+typedef long long __crc_v2di __attribute__((vector_size(16)));
+
+/**
+ * @brief 计算 x^n mod P
+ *
+ * @param n 指数
+ * @param poly 多项式P去掉最高次项之后的部分
+ * @param width P的次数
+ */
+static uint64_t crc_xpow_mod(uint32_t n, uint64_t poly, uint32_t width)
+{
+    uint64_t top = 1UL << (width - 1);
+    uint64_t mask = (width == 64) ? ~0UL : ((1UL << width) - 1);
+    uint64_t r = 1;
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        bool carry = (r & top) != 0;
+        r = (r << 1) & mask;
+        if (carry)
+            r ^= poly;
+    }
+    return r;
+}
+
+static void crc_fold_consts_init(struct crc_fold_consts *consts, uint64_t poly, uint32_t width)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        consts->k[i][0] = crc_xpow_mod(128 * (i + 1), poly, width);
+        consts->k[i][1] = crc_xpow_mod(128 * (i + 1) + 64, poly, width);
+    }
+}
+
+/**
+ * @brief 按大端序加载一个16字节的块，使得块中的第一个bit成为128位整数的最高位
+ */
+static __always_inline __crc_v2di crc_load_be(const uint8_t *p)
+{
+    uint64_t hi = __builtin_bswap64(*(const uint64_t *)p);
+    uint64_t lo = __builtin_bswap64(*(const uint64_t *)(p + 8));
+    return (__crc_v2di){(long long)lo, (long long)hi};
+}
+
+/**
+ * @brief 把acc向后移动若干个块并对P取模：acc.lo * k.lo ^ acc.hi * k.hi
+ */
+__attribute__((target("pclmul"))) static __always_inline __crc_v2di crc_fold(__crc_v2di acc, __crc_v2di k)
+{
+    return __builtin_ia32_pclmulqdq128(acc, k, 0x00) ^ __builtin_ia32_pclmulqdq128(acc, k, 0x11);
+}
+
+/**
+ * @brief 把长度为16的倍数的数据折叠为一个与之模P同余的16字节的块
+ *
+ * 同时使用4个累加器，使得pclmulqdq的延迟可以被流水线隐藏
+ *
+ * @param out 折叠的结果（大端序）
+ */
+__attribute__((target("pclmul"))) static void crc_fold_msb(const struct crc_fold_consts *consts, uint32_t width,
+                                                           uint64_t crc, const uint8_t *p, size_t len, uint8_t *out)
+{
+    __crc_v2di k1 = {(long long)consts->k[0][0], (long long)consts->k[0][1]};
+    // crc初始值与数据的前width位异或
+    __crc_v2di acc = crc_load_be(p) ^ (__crc_v2di){0, (long long)(crc << (64 - width))};
+    p += 16;
+    len -= 16;
+
+    if (len >= 48)
+    {
+        __crc_v2di k2 = {(long long)consts->k[1][0], (long long)consts->k[1][1]};
+        __crc_v2di k3 = {(long long)consts->k[2][0], (long long)consts->k[2][1]};
+        __crc_v2di k4 = {(long long)consts->k[3][0], (long long)consts->k[3][1]};
+        __crc_v2di a0 = acc;
+        __crc_v2di a1 = crc_load_be(p);
+        __crc_v2di a2 = crc_load_be(p + 16);
+        __crc_v2di a3 = crc_load_be(p + 32);
+        p += 48;
+        len -= 48;
+        while (len >= 64)
+        {
+            a0 = crc_fold(a0, k4) ^ crc_load_be(p);
+            a1 = crc_fold(a1, k4) ^ crc_load_be(p + 16);
+            a2 = crc_fold(a2, k4) ^ crc_load_be(p + 32);
+            a3 = crc_fold(a3, k4) ^ crc_load_be(p + 48);
+            p += 64;
+            len -= 64;
+        }
+        acc = crc_fold(a0, k3) ^ crc_fold(a1, k2) ^ crc_fold(a2, k1) ^ a3;
+    }
+
+    while (len >= 16)
+    {
+        acc = crc_fold(acc, k1) ^ crc_load_be(p);
+        p += 16;
+        len -= 16;
+    }
+
+    *(uint64_t *)out = __builtin_bswap64((uint64_t)acc[1]);
+    *(uint64_t *)(out + 8) = __builtin_bswap64((uint64_t)acc[0]);
+}
+
+/**
+ * @brief 使用PCLMULQDQ计算MSB优先、初始值和结果均不取反的crc
+ *
+ * 内核不会在中断和系统调用的入口保存SIMD寄存器，因此使用前需要关中断，并把当前的SIMD状态保存到栈上，
+ * 用完之后恢复。为了限制关中断的时间，每次最多处理CRC_PCLMUL_CHUNK个字节
+ */
+uint64_t crc_pclmul_msb(const struct crc_fold_consts *consts, uint32_t width, uint64_t crc, const uint8_t *buffer,
+                        size_t len, uint64_t (*generic)(uint64_t crc, const uint8_t *buffer, size_t len))
+{
+    uint8_t fxsave_area[512] __attribute__((aligned(16)));
+    uint8_t folded[16];
+    uint64_t rflags;
+
+    while (len >= CRC_PCLMUL_MIN_LEN)
+    {
+        size_t chunk = (len < CRC_PCLMUL_CHUNK ? len : CRC_PCLMUL_CHUNK) & ~15UL;
+
+        local_irq_save(rflags);
+        __asm__ __volatile__("fxsaveq %0" : "=m"(fxsave_area)::"memory");
+        crc_fold_msb(consts, width, crc, buffer, chunk, folded);
+        __asm__ __volatile__("fxrstorq %0" ::"m"(fxsave_area) : "memory");
+        local_irq_restore(rflags);
+
+        // 折叠的结果与这一段数据同余，它的crc即为这一段数据的crc
+        crc = generic(0, folded, 16);
+        buffer += chunk;
+        len -= chunk;
+    }
+    return generic(crc, buffer, len);
+}
+
+/**
+ * @brief 检测cpu的特性，选择crc的实现，并计算折叠常量
+ *
+ */
+void crc_accel_init()
+{
+    uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+    cpu_cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+    // CPUID.01H:ECX[bit 1] PCLMULQDQ, ECX[bit 20] SSE4.2
+    crc_accel_has_sse42 = (ecx & (1 << 20)) != 0;
+
+    crc_fold_consts_init(&crc32_fold_consts, 0x04C11DB7UL, 32);
+    crc_fold_consts_init(&crc64_fold_consts, 0x42F0E1EBA9EA3693UL, 64);
+    // 常量计算完成后才允许使用PCLMULQDQ
+    barrier();
+    crc_accel_has_pclmul = (ecx & (1 << 1)) != 0;
+}
@@ -4,7 +4,7 @@ use core::{
     ops::Range,
 };
 
-use alloc::vec::Vec;
+use alloc::{sync::Arc, vec::Vec};
 use elf::{endian::AnyEndian, file::FileHeader, segment::ProgramHeader};
 
 use crate::{
@@ -14,6 +14,7 @@ use crate::{
     libs::align::page_align_up,
     mm::{
         allocator::page_frame::{PageFrameCount, VirtPageFrame},
+        page_cache::{page_cache_get_pages, CachedPage},
         syscall::{MapFlags, ProtFlags},
         ucontext::InnerAddressSpace,
         MemoryManagementArch, VirtAddr,
@@ -24,7 +25,7 @@ use crate::{
         ProcessManager,
     },
     syscall::{
-        user_access::{clear_user, copy_to_user},
+        user_access::{clear_user_locked, copy_to_user_locked},
         SystemError,
     },
 };
@@ -238,6 +239,7 @@ impl ElfLoader {
 
             // 加载文件到内存
             self.do_load_file(
+                user_vm_guard,
                 map_addr + beginning_page_offset,
                 seg_in_file_size,
                 file_offset,
@@ -250,6 +252,14 @@ impl ElfLoader {
                     *prot,
                 )?;
             }
+        } else if let Some(pages) =
+            self.segment_cached_pages(param, phent, prot, beginning_page_offset, map_size)
+        {
+            // 只读的段直接映射页缓存中的页，与运行同一程序的其他进程共享
+            map_addr = user_vm_guard
+                .map_page_cache(addr_to_map, pages, *prot, *map_flags)
+                .map_err(map_err_handler)?
+                .virt_address();
         } else {
             // kdebug!("total size = 0");
 
@@ -263,6 +273,7 @@ impl ElfLoader {
 
             // 加载文件到内存
             self.do_load_file(
+                user_vm_guard,
                 map_addr + beginning_page_offset,
                 seg_in_file_size,
                 file_offset,
@@ -281,6 +292,43 @@ impl ElfLoader {
         return Ok((map_addr, true));
     }
 
+    /// 获取可以直接映射页缓存的段在页缓存中的页
+    ///
+    /// 只有不可写、没有bss、且在文件中的偏移量与虚拟地址的页内偏移相同的段才能共享页缓存。
+    /// 可写的段仍然会被拷贝到进程私有的内存中。
+    ///
+    /// ## 返回值
+    ///
+    /// 段不满足条件，或者读取页缓存失败时，返回None，由调用者按照私有映射的方式加载
+    fn segment_cached_pages(
+        &self,
+        param: &mut ExecParam,
+        phent: &ProgramHeader,
+        prot: &ProtFlags,
+        beginning_page_offset: usize,
+        map_size: usize,
+    ) -> Option<Vec<Arc<CachedPage>>> {
+        let file_offset = phent.p_offset as usize;
+        if prot.contains(ProtFlags::PROT_WRITE)
+            || phent.p_memsz != phent.p_filesz
+            || self.elf_page_offset(VirtAddr::new(file_offset)) != beginning_page_offset
+        {
+            return None;
+        }
+
+        let file = param.file_mut();
+        let file_size = file.metadata().ok()?.size as usize;
+        if file_size < file_offset + phent.p_filesz as usize {
+            return None;
+        }
+        return page_cache_get_pages(
+            file,
+            file_offset - beginning_page_offset,
+            map_size / MMArch::PAGE_SIZE,
+        )
+        .ok();
+    }
+
     /// 加载ELF文件到用户空间
     ///
     /// ## 参数
@@ -289,8 +337,10 @@ impl ElfLoader {
     /// - `size`：要加载的大小
     /// - `offset_in_file`：在文件内的偏移量
     /// - `param`：执行参数
+    /// - `user_vm`：要加载到的地址空间（调用者持有它的写锁）
     fn do_load_file(
         &self,
+        user_vm: &InnerAddressSpace,
         mut vaddr: VirtAddr,
         size: usize,
         offset_in_file: usize,
@@ -312,7 +362,8 @@ impl ElfLoader {
             file.read(read_size, &mut buf[..read_size])?;
             // kdebug!("copy_to_user: vaddr={:?}, read_size = {read_size}", vaddr);
             unsafe {
-                copy_to_user(vaddr, &buf[..read_size]).map_err(|_| SystemError::EFAULT)?;
+                copy_to_user_locked(user_vm, vaddr, &buf[..read_size])
+                    .map_err(|_| SystemError::EFAULT)?;
             }
 
             vaddr += read_size;
@@ -322,11 +373,11 @@ impl ElfLoader {
     }
 
     /// 我们需要显式的把数据段之后剩余的内存页都清零。
-    fn pad_zero(&self, elf_bss: VirtAddr) -> Result<(), SystemError> {
+    fn pad_zero(&self, user_vm: &InnerAddressSpace, elf_bss: VirtAddr) -> Result<(), SystemError> {
         let nbyte = self.elf_page_offset(elf_bss);
         if nbyte > 0 {
             let nbyte = Self::ELF_PAGE_SIZE - nbyte;
-            unsafe { clear_user(elf_bss, nbyte).map_err(|_| SystemError::EFAULT) }?;
+            unsafe { clear_user_locked(user_vm, elf_bss, nbyte).map_err(|_| SystemError::EFAULT) }?;
         }
         return Ok(());
     }
@@ -542,7 +593,7 @@ impl BinaryLoader for ElfLoader {
                     unsafe {
                         // This bss-zeroing can fail if the ELF file specifies odd protections.
                         // So we don't check the return value.
-                        clear_user(elf_bss + load_bias, nbyte).ok();
+                        clear_user_locked(&user_vm, elf_bss + load_bias, nbyte).ok();
                     }
                 }
             }
@@ -692,7 +743,7 @@ impl BinaryLoader for ElfLoader {
         // );
         self.set_elf_brk(&mut user_vm, elf_bss, elf_brk, bss_prot_flags)?;
 
-        if likely(elf_bss != elf_brk) && unlikely(self.pad_zero(elf_bss).is_err()) {
+        if likely(elf_bss != elf_brk) && unlikely(self.pad_zero(&user_vm, elf_bss).is_err()) {
             // kdebug!("elf_bss = {elf_bss:?}, elf_brk = {elf_brk:?}");
             return Err(ExecError::BadAddress(Some(elf_bss)));
         }
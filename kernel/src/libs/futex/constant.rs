@@ -0,0 +1,78 @@
+// futex相关的常量，与Linux保持一致
+
+/// futex等待队列哈希表的桶数（必须是2的幂）
+pub const FUTEX_HASH_SIZE: usize = 256;
+
+/// 匹配任意bitset的掩码
+pub const FUTEX_BITSET_MATCH_ANY: u32 = 0xffff_ffff;
+
+/// op参数中，命令部分的掩码
+pub const FUTEX_CMD_MASK: u32 = !(FutexFlag::FLAGS_MASK.bits());
+
+bitflags! {
+    /// futex系统调用的op参数中的标志位
+    pub struct FutexFlag: u32 {
+        /// 该futex只在本进程（地址空间）内使用，无需按物理页进行匹配
+        const FUTEX_PRIVATE_FLAG = 128;
+        /// FUTEX_WAIT_BITSET的超时时间基于CLOCK_REALTIME
+        const FUTEX_CLOCK_REALTIME = 256;
+        const FLAGS_MASK = Self::FUTEX_PRIVATE_FLAG.bits | Self::FUTEX_CLOCK_REALTIME.bits;
+    }
+}
+
+/// futex系统调用的命令
+#[derive(Debug, Clone, Copy, PartialEq, Eq, FromPrimitive)]
+#[allow(non_camel_case_types)]
+pub enum FutexCmd {
+    FUTEX_WAIT = 0,
+    FUTEX_WAKE = 1,
+    FUTEX_FD = 2,
+    FUTEX_REQUEUE = 3,
+    FUTEX_CMP_REQUEUE = 4,
+    FUTEX_WAKE_OP = 5,
+    FUTEX_LOCK_PI = 6,
+    FUTEX_UNLOCK_PI = 7,
+    FUTEX_TRYLOCK_PI = 8,
+    FUTEX_WAIT_BITSET = 9,
+    FUTEX_WAKE_BITSET = 10,
+    FUTEX_WAIT_REQUEUE_PI = 11,
+    FUTEX_CMP_REQUEUE_PI = 12,
+    FUTEX_LOCK_PI2 = 13,
+}
+
+/// FUTEX_WAKE_OP中，对uaddr2执行的操作
+#[derive(Debug, Clone, Copy, PartialEq, Eq, FromPrimitive)]
+#[allow(non_camel_case_types)]
+pub enum FutexOP {
+    /// *uaddr2 = oparg
+    FUTEX_OP_SET = 0,
+    /// *uaddr2 += oparg
+    FUTEX_OP_ADD = 1,
+    /// *uaddr2 |= oparg
+    FUTEX_OP_OR = 2,
+    /// *uaddr2 &= ~oparg
+    FUTEX_OP_ANDN = 3,
+    /// *uaddr2 ^= oparg
+    FUTEX_OP_XOR = 4,
+}
+
+/// FUTEX_WAKE_OP中，oparg需要被解释为 1 << oparg
+pub const FUTEX_OP_OPARG_SHIFT: u32 = 8;
+
+/// FUTEX_WAKE_OP中，对uaddr2的旧值进行的比较
+#[derive(Debug, Clone, Copy, PartialEq, Eq, FromPrimitive)]
+#[allow(non_camel_case_types)]
+pub enum FutexOpCMP {
+    /// if (oldval == cmparg) wake
+    FUTEX_OP_CMP_EQ = 0,
+    /// if (oldval != cmparg) wake
+    FUTEX_OP_CMP_NE = 1,
+    /// if (oldval < cmparg) wake
+    FUTEX_OP_CMP_LT = 2,
+    /// if (oldval <= cmparg) wake
+    FUTEX_OP_CMP_LE = 3,
+    /// if (oldval > cmparg) wake
+    FUTEX_OP_CMP_GT = 4,
+    /// if (oldval >= cmparg) wake
+    FUTEX_OP_CMP_GE = 5,
+}
@@ -0,0 +1,493 @@
+use core::{
+    hash::{Hash, Hasher},
+    intrinsics::{likely, unlikely},
+};
+
+use alloc::{collections::LinkedList, sync::Arc};
+
+use crate::{
+    arch::{
+        mm::usercopy::{cmpxchg_user_u32, get_user_u32},
+        sched::sched,
+        CurrentIrqArch, MMArch,
+    },
+    exception::InterruptArch,
+    libs::spinlock::{SpinLock, SpinLockGuard},
+    mm::{ucontext::AddressSpace, verify_area, MemoryManagementArch, PhysAddr, VirtAddr},
+    process::{ProcessControlBlock, ProcessManager},
+    syscall::{user_access::verify_area_writable, SystemError},
+    time::{
+        timer::{next_n_us_timer_jiffies, Timer, WakeUpHelper},
+        TimeSpec,
+    },
+};
+
+use super::constant::*;
+
+/// futex的键。等待者与唤醒者依据这个键来匹配彼此。
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub enum FutexKey {
+    /// 私有futex：以地址空间+虚拟地址作为键
+    Private { mm: usize, addr: VirtAddr },
+    /// 共享futex：以物理页+页内偏移作为键，使得映射了同一物理页的不同进程能够相互唤醒
+    Shared { page: PhysAddr, offset: usize },
+}
+
+impl FutexKey {
+    /// 根据用户空间地址，生成futex的键
+    ///
+    /// ## 参数
+    ///
+    /// - `uaddr`：用户空间的futex地址（必须4字节对齐）
+    /// - `private`：是否为私有futex
+    pub fn new(uaddr: VirtAddr, private: bool) -> Result<Self, SystemError> {
+        if unlikely(!uaddr.check_aligned(core::mem::align_of::<u32>())) {
+            return Err(SystemError::EINVAL);
+        }
+        verify_area(uaddr, core::mem::size_of::<u32>())?;
+
+        let address_space = AddressSpace::current()?;
+        if private {
+            return Ok(FutexKey::Private {
+                mm: Arc::as_ptr(&address_space) as usize,
+                addr: uaddr,
+            });
+        }
+
+        let offset = uaddr.data() & MMArch::PAGE_OFFSET_MASK;
+        let page_vaddr = VirtAddr::new(uaddr.data() & !MMArch::PAGE_OFFSET_MASK);
+        let (page, _) = address_space
+            .read()
+            .user_mapper
+            .utable
+            .translate(page_vaddr)
+            .ok_or(SystemError::EFAULT)?;
+        return Ok(FutexKey::Shared { page, offset });
+    }
+
+    /// 计算这个键所在的哈希桶的下标
+    fn bucket_index(&self) -> usize {
+        let mut hasher = FutexHasher::default();
+        self.hash(&mut hasher);
+        return (hasher.finish() as usize) & (FUTEX_HASH_SIZE - 1);
+    }
+}
+
+/// 用于计算futex键哈希值的简单乘法哈希（fibonacci hashing）
+#[derive(Default)]
+struct FutexHasher(u64);
+
+impl Hasher for FutexHasher {
+    fn finish(&self) -> u64 {
+        return self.0.wrapping_mul(0x9E37_79B9_7F4A_7C15) >> 32;
+    }
+
+    fn write(&mut self, bytes: &[u8]) {
+        for b in bytes {
+            self.0 = self.0.rotate_left(5) ^ (*b as u64);
+        }
+    }
+
+    fn write_usize(&mut self, i: usize) {
+        self.0 = self.0.rotate_left(5) ^ (i as u64);
+    }
+}
+
+/// 一个在futex上等待的进程
+#[derive(Debug)]
+struct FutexWaiter {
+    key: FutexKey,
+    bitset: u32,
+    pcb: Arc<ProcessControlBlock>,
+}
+
+/// futex哈希桶，保存映射到这个桶的所有等待者
+#[derive(Debug)]
+struct FutexHashBucket {
+    chain: LinkedList<FutexWaiter>,
+}
+
+impl FutexHashBucket {
+    const INIT: SpinLock<FutexHashBucket> = SpinLock::new(FutexHashBucket {
+        chain: LinkedList::new(),
+    });
+
+    /// 唤醒桶中与key匹配、且bitset有交集的至多nr_wake个进程
+    ///
+    /// ## 返回值
+    ///
+    /// 被唤醒的进程数
+    fn wake(&mut self, key: &FutexKey, bitset: u32, nr_wake: usize) -> usize {
+        let mut woken = 0;
+        let mut remain = LinkedList::new();
+        while let Some(waiter) = self.chain.pop_front() {
+            if woken < nr_wake && waiter.key == *key && (waiter.bitset & bitset) != 0 {
+                ProcessManager::wakeup(&waiter.pcb).ok();
+                woken += 1;
+            } else {
+                remain.push_back(waiter);
+            }
+        }
+        self.chain = remain;
+        return woken;
+    }
+
+    /// 将等待者从桶中移除
+    ///
+    /// ## 返回值
+    ///
+    /// 如果等待者仍然在桶中（也就是说，它还没有被唤醒），返回true
+    fn remove(&mut self, key: &FutexKey, pcb: &Arc<ProcessControlBlock>) -> bool {
+        let removed = self
+            .chain
+            .drain_filter(|w| w.key == *key && Arc::ptr_eq(&w.pcb, pcb))
+            .count();
+        return removed > 0;
+    }
+
+    /// 从桶中取出至多nr个与key匹配的等待者
+    fn take(&mut self, key: &FutexKey, nr: usize) -> LinkedList<FutexWaiter> {
+        let mut taken = LinkedList::new();
+        let mut remain = LinkedList::new();
+        while let Some(waiter) = self.chain.pop_front() {
+            if taken.len() < nr && waiter.key == *key {
+                taken.push_back(waiter);
+            } else {
+                remain.push_back(waiter);
+            }
+        }
+        self.chain = remain;
+        return taken;
+    }
+}
+
+/// 解码后的FUTEX_WAKE_OP操作
+#[derive(Debug, Clone, Copy)]
+struct FutexWakeOp {
+    op: FutexOP,
+    oparg: u32,
+    cmp: FutexOpCMP,
+    cmparg: i32,
+}
+
+impl FutexWakeOp {
+    /// 解码并检查FUTEX_WAKE_OP的操作数，使得不合法的编码在修改用户空间的内存之前就被发现
+    fn decode(encoded_op: u32) -> Result<Self, SystemError> {
+        let op = (encoded_op >> 28) & 0x7;
+        let cmp = (encoded_op >> 24) & 0xf;
+        let mut oparg = ((encoded_op << 8) as i32 >> 20) as u32;
+        let cmparg = (encoded_op << 20) as i32 >> 20;
+        if (encoded_op >> 28) & FUTEX_OP_OPARG_SHIFT != 0 {
+            if oparg > 31 {
+                return Err(SystemError::EINVAL);
+            }
+            oparg = 1 << oparg;
+        }
+
+        let op = <FutexOP as num_traits::FromPrimitive>::from_u32(op).ok_or(SystemError::ENOSYS)?;
+        let cmp =
+            <FutexOpCMP as num_traits::FromPrimitive>::from_u32(cmp).ok_or(SystemError::ENOSYS)?;
+        return Ok(Self {
+            op,
+            oparg,
+            cmp,
+            cmparg,
+        });
+    }
+
+    /// 计算操作作用于oldval之后的新值
+    fn apply(&self, oldval: u32) -> u32 {
+        return match self.op {
+            FutexOP::FUTEX_OP_SET => self.oparg,
+            FutexOP::FUTEX_OP_ADD => oldval.wrapping_add(self.oparg),
+            FutexOP::FUTEX_OP_OR => oldval | self.oparg,
+            FutexOP::FUTEX_OP_ANDN => oldval & !self.oparg,
+            FutexOP::FUTEX_OP_XOR => oldval ^ self.oparg,
+        };
+    }
+
+    /// 根据比较操作，判断是否需要唤醒uaddr2上的进程
+    fn should_wake(&self, oldval: u32) -> bool {
+        let oldval = oldval as i32;
+        return match self.cmp {
+            FutexOpCMP::FUTEX_OP_CMP_EQ => oldval == self.cmparg,
+            FutexOpCMP::FUTEX_OP_CMP_NE => oldval != self.cmparg,
+            FutexOpCMP::FUTEX_OP_CMP_LT => oldval < self.cmparg,
+            FutexOpCMP::FUTEX_OP_CMP_LE => oldval <= self.cmparg,
+            FutexOpCMP::FUTEX_OP_CMP_GT => oldval > self.cmparg,
+            FutexOpCMP::FUTEX_OP_CMP_GE => oldval >= self.cmparg,
+        };
+    }
+}
+
+/// futex哈希表
+static FUTEX_QUEUES: [SpinLock<FutexHashBucket>; FUTEX_HASH_SIZE] =
+    [FutexHashBucket::INIT; FUTEX_HASH_SIZE];
+
+#[derive(Debug)]
+pub struct Futex;
+
+impl Futex {
+    #[inline(always)]
+    fn bucket(key: &FutexKey) -> &'static SpinLock<FutexHashBucket> {
+        return &FUTEX_QUEUES[key.bucket_index()];
+    }
+
+    /// 同时对两个桶加锁。若两个键落在同一个桶中，则只返回一个守卫
+    fn double_lock(
+        key1: &FutexKey,
+        key2: &FutexKey,
+    ) -> (
+        SpinLockGuard<'static, FutexHashBucket>,
+        Option<SpinLockGuard<'static, FutexHashBucket>>,
+    ) {
+        let idx1 = key1.bucket_index();
+        let idx2 = key2.bucket_index();
+        if idx1 == idx2 {
+            return (FUTEX_QUEUES[idx1].lock(), None);
+        }
+        // 按照下标顺序加锁，防止死锁
+        if idx1 < idx2 {
+            let g1 = FUTEX_QUEUES[idx1].lock();
+            let g2 = FUTEX_QUEUES[idx2].lock();
+            return (g1, Some(g2));
+        } else {
+            let g2 = FUTEX_QUEUES[idx2].lock();
+            let g1 = FUTEX_QUEUES[idx1].lock();
+            return (g1, Some(g2));
+        }
+    }
+
+    /// 读取用户空间的futex字
+    ///
+    /// 读取可以从缺页中恢复：地址没有被映射时返回EFAULT，而不是杀死进程。
+    /// 这个函数不会睡眠，因此可以在持有桶锁、关中断的情况下调用
+    #[inline(always)]
+    fn get_futex_value(uaddr: VirtAddr) -> Result<u32, SystemError> {
+        return unsafe { get_user_u32(uaddr.data() as *const u32) }.ok_or(SystemError::EFAULT);
+    }
+
+    /// 若*uaddr == val，则让当前进程在futex上睡眠，直到被唤醒或者超时。
+    ///
+    /// ## 参数
+    ///
+    /// - `uaddr`：futex的用户空间地址
+    /// - `private`：是否为私有futex
+    /// - `val`：期望的futex值
+    /// - `timeout`：相对的超时时间。为None时永久等待
+    /// - `bitset`：等待者的bitset，用于FUTEX_WAKE_BITSET的匹配
+    pub fn futex_wait(
+        uaddr: VirtAddr,
+        private: bool,
+        val: u32,
+        timeout: Option<TimeSpec>,
+        bitset: u32,
+    ) -> Result<usize, SystemError> {
+        if bitset == 0 {
+            return Err(SystemError::EINVAL);
+        }
+        let key = FutexKey::new(uaddr, private)?;
+        let pcb = ProcessManager::current_pcb();
+
+        let timeout_us = match timeout {
+            Some(ts) => {
+                if ts.tv_sec < 0 || ts.tv_nsec < 0 || ts.tv_nsec >= 1000000000 {
+                    return Err(SystemError::EINVAL);
+                }
+                Some(ts.tv_sec as u64 * 1000000 + ts.tv_nsec as u64 / 1000)
+            }
+            None => None,
+        };
+
+        // 加锁之前先读取一次：地址不合法时返回EFAULT，值不相等时无需加锁
+        if Self::get_futex_value(uaddr)? != val {
+            return Err(SystemError::EAGAIN_OR_EWOULDBLOCK);
+        }
+        // 超时时间为0时，只检查值
+        if timeout_us == Some(0) {
+            return Err(SystemError::ETIMEDOUT);
+        }
+        let timer = timeout_us
+            .map(|us| Timer::new(WakeUpHelper::new(pcb.clone()), next_n_us_timer_jiffies(us)));
+
+        // 关中断，防止在检查值与进入睡眠之间被抢占
+        let irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
+        let mut bucket = Self::bucket(&key).lock();
+
+        // 在桶锁的保护下再次检查futex的值。唤醒者在修改值之后才会获取桶锁，因此不会丢失唤醒
+        match Self::get_futex_value(uaddr) {
+            Ok(uval) if uval == val => {}
+            r => {
+                drop(bucket);
+                drop(irq_guard);
+                return Err(r.err().unwrap_or(SystemError::EAGAIN_OR_EWOULDBLOCK));
+            }
+        }
+
+        ProcessManager::mark_sleep(true)?;
+        bucket.chain.push_back(FutexWaiter {
+            key,
+            bitset,
+            pcb: pcb.clone(),
+        });
+        drop(bucket);
+
+        if let Some(timer) = timer.as_ref() {
+            timer.activate();
+        }
+        drop(irq_guard);
+        sched();
+
+        // 被唤醒后，如果仍然在桶中，说明不是由futex_wake唤醒的
+        let timer_pending = timer.map(|t| t.cancel()).unwrap_or(true);
+        let irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
+        let still_queued = Self::bucket(&key).lock().remove(&key, &pcb);
+        drop(irq_guard);
+
+        if likely(!still_queued) {
+            return Ok(0);
+        }
+        if !timer_pending {
+            return Err(SystemError::ETIMEDOUT);
+        }
+        return Err(SystemError::EINTR);
+    }
+
+    /// 唤醒至多nr_wake个在uaddr上等待的进程
+    ///
+    /// ## 返回值
+    ///
+    /// 被唤醒的进程数
+    pub fn futex_wake(
+        uaddr: VirtAddr,
+        private: bool,
+        nr_wake: u32,
+        bitset: u32,
+    ) -> Result<usize, SystemError> {
+        if bitset == 0 {
+            return Err(SystemError::EINVAL);
+        }
+        let key = FutexKey::new(uaddr, private)?;
+        let bucket = Self::bucket(&key);
+        // 快速路径：桶中没有等待者时，无需遍历
+        let mut guard = bucket.lock_irqsave();
+        if guard.chain.is_empty() {
+            return Ok(0);
+        }
+        let woken = guard.wake(&key, bitset, nr_wake as usize);
+        return Ok(woken);
+    }
+
+    /// 唤醒uaddr1上的至多nr_wake个进程，并把剩余的至多nr_requeue个等待者转移到uaddr2上
+    ///
+    /// ## 参数
+    ///
+    /// - `cmpval`：若为Some，则仅在*uaddr1 == cmpval时执行（FUTEX_CMP_REQUEUE）
+    ///
+    /// ## 返回值
+    ///
+    /// 被唤醒的进程数与被转移的进程数之和
+    pub fn futex_requeue(
+        uaddr1: VirtAddr,
+        uaddr2: VirtAddr,
+        private: bool,
+        nr_wake: u32,
+        nr_requeue: u32,
+        cmpval: Option<u32>,
+    ) -> Result<usize, SystemError> {
+        let key1 = FutexKey::new(uaddr1, private)?;
+        let key2 = FutexKey::new(uaddr2, private)?;
+
+        let irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
+        let (mut guard1, mut guard2) = Self::double_lock(&key1, &key2);
+
+        if let Some(cmpval) = cmpval {
+            match Self::get_futex_value(uaddr1) {
+                Ok(uval) if uval == cmpval => {}
+                r => {
+                    drop(guard2);
+                    drop(guard1);
+                    drop(irq_guard);
+                    return Err(r.err().unwrap_or(SystemError::EAGAIN_OR_EWOULDBLOCK));
+                }
+            }
+        }
+
+        let woken = guard1.wake(&key1, FUTEX_BITSET_MATCH_ANY, nr_wake as usize);
+        let moved = guard1.take(&key1, nr_requeue as usize);
+        let nr_moved = moved.len();
+        for mut waiter in moved {
+            waiter.key = key2;
+            match guard2.as_mut() {
+                Some(g2) => g2.chain.push_back(waiter),
+                None => guard1.chain.push_back(waiter),
+            }
+        }
+        drop(guard2);
+        drop(guard1);
+        drop(irq_guard);
+        return Ok(woken + nr_moved);
+    }
+
+    /// 对uaddr2执行原子操作，然后唤醒uaddr1上的至多nr_wake个进程，
+    /// 并根据uaddr2的旧值判断是否唤醒uaddr2上的至多nr_wake2个进程
+    pub fn futex_wake_op(
+        uaddr1: VirtAddr,
+        uaddr2: VirtAddr,
+        private: bool,
+        nr_wake: u32,
+        nr_wake2: u32,
+        encoded_op: u32,
+    ) -> Result<usize, SystemError> {
+        let op = FutexWakeOp::decode(encoded_op)?;
+        let key1 = FutexKey::new(uaddr1, private)?;
+        let key2 = FutexKey::new(uaddr2, private)?;
+        // uaddr2会被写入，因此它必须位于可写的映射中
+        verify_area_writable(uaddr2, core::mem::size_of::<u32>())?;
+
+        let irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
+        let (mut guard1, mut guard2) = Self::double_lock(&key1, &key2);
+
+        let oldval = match Self::futex_atomic_op(uaddr2, &op) {
+            Ok(v) => v,
+            Err(e) => {
+                drop(guard2);
+                drop(guard1);
+                drop(irq_guard);
+                return Err(e);
+            }
+        };
+
+        let mut woken = guard1.wake(&key1, FUTEX_BITSET_MATCH_ANY, nr_wake as usize);
+        if op.should_wake(oldval) {
+            woken += match guard2.as_mut() {
+                Some(g2) => g2.wake(&key2, FUTEX_BITSET_MATCH_ANY, nr_wake2 as usize),
+                None => guard1.wake(&key2, FUTEX_BITSET_MATCH_ANY, nr_wake2 as usize),
+            };
+        }
+        drop(guard2);
+        drop(guard1);
+        drop(irq_guard);
+        return Ok(woken);
+    }
+
+    /// 对uaddr执行FUTEX_WAKE_OP的原子操作
+    ///
+    /// 使用可以从缺页中恢复的`lock cmpxchg`循环实现，地址没有被映射或者不可写时返回EFAULT
+    ///
+    /// ## 返回值
+    ///
+    /// uaddr处的旧值
+    fn futex_atomic_op(uaddr: VirtAddr, op: &FutexWakeOp) -> Result<u32, SystemError> {
+        let mut oldval = Self::get_futex_value(uaddr)?;
+        loop {
+            let newval = op.apply(oldval);
+            let cur = unsafe { cmpxchg_user_u32(uaddr.data() as *mut u32, oldval, newval) }
+                .ok_or(SystemError::EFAULT)?;
+            if cur == oldval {
+                return Ok(oldval);
+            }
+            oldval = cur;
+        }
+    }
+}
@@ -0,0 +1,3 @@
+pub mod constant;
+pub mod futex;
+pub mod syscall;
@@ -0,0 +1,108 @@
+use num_traits::FromPrimitive;
+
+use crate::{
+    mm::VirtAddr,
+    syscall::{user_access::UserBufferReader, Syscall, SystemError},
+    time::{timekeeping::getnstimeofday, TimeSpec},
+};
+
+use super::{constant::*, futex::Futex};
+
+impl Syscall {
+    /// # futex系统调用
+    ///
+    /// ## 参数
+    ///
+    /// - `uaddr`：futex字的用户空间地址
+    /// - `operation`：futex命令以及标志位
+    /// - `val`：含义取决于命令（期望值或者唤醒的进程数）
+    /// - `timeout`：对于WAIT类命令，为超时时间的指针；对于REQUEUE/WAKE_OP，为val2
+    /// - `uaddr2`：第二个futex字的用户空间地址
+    /// - `val3`：含义取决于命令（bitset、比较值或者编码后的操作）
+    pub fn do_futex(
+        uaddr: VirtAddr,
+        operation: u32,
+        val: u32,
+        timeout: usize,
+        uaddr2: VirtAddr,
+        val3: u32,
+    ) -> Result<usize, SystemError> {
+        let flags = FutexFlag::from_bits_truncate(operation);
+        let private = flags.contains(FutexFlag::FUTEX_PRIVATE_FLAG);
+        let cmd = FutexCmd::from_u32(operation & FUTEX_CMD_MASK).ok_or(SystemError::ENOSYS)?;
+
+        match cmd {
+            FutexCmd::FUTEX_WAIT => {
+                let timeout = Self::futex_read_timeout(timeout, false)?;
+                return Futex::futex_wait(uaddr, private, val, timeout, FUTEX_BITSET_MATCH_ANY);
+            }
+            FutexCmd::FUTEX_WAIT_BITSET => {
+                let timeout = Self::futex_read_timeout(timeout, true)?;
+                return Futex::futex_wait(uaddr, private, val, timeout, val3);
+            }
+            FutexCmd::FUTEX_WAKE => {
+                return Futex::futex_wake(uaddr, private, val, FUTEX_BITSET_MATCH_ANY);
+            }
+            FutexCmd::FUTEX_WAKE_BITSET => {
+                return Futex::futex_wake(uaddr, private, val, val3);
+            }
+            FutexCmd::FUTEX_REQUEUE => {
+                return Futex::futex_requeue(uaddr, uaddr2, private, val, timeout as u32, None);
+            }
+            FutexCmd::FUTEX_CMP_REQUEUE => {
+                return Futex::futex_requeue(
+                    uaddr,
+                    uaddr2,
+                    private,
+                    val,
+                    timeout as u32,
+                    Some(val3),
+                );
+            }
+            FutexCmd::FUTEX_WAKE_OP => {
+                return Futex::futex_wake_op(uaddr, uaddr2, private, val, timeout as u32, val3);
+            }
+            _ => {
+                // todo: 支持PI futex
+                return Err(SystemError::ENOSYS);
+            }
+        }
+    }
+
+    /// 从用户空间读取futex的超时时间，并转换为相对时间
+    ///
+    /// ## 参数
+    ///
+    /// - `timeout`：用户空间的TimeSpec指针。为0时表示永久等待
+    /// - `absolute`：用户传入的是否为绝对时间（FUTEX_WAIT_BITSET）
+    fn futex_read_timeout(timeout: usize, absolute: bool) -> Result<Option<TimeSpec>, SystemError> {
+        if timeout == 0 {
+            return Ok(None);
+        }
+        let reader = UserBufferReader::new(
+            timeout as *const TimeSpec,
+            core::mem::size_of::<TimeSpec>(),
+            true,
+        )?;
+        let ts = *reader.read_one_from_user::<TimeSpec>(0)?;
+        if ts.tv_nsec < 0 || ts.tv_nsec >= 1000000000 {
+            return Err(SystemError::EINVAL);
+        }
+        if !absolute {
+            return Ok(Some(ts));
+        }
+
+        // todo: 目前只有墙上时钟，因此CLOCK_MONOTONIC与CLOCK_REALTIME都基于它计算
+        let now = getnstimeofday();
+        let mut sec = ts.tv_sec - now.tv_sec;
+        let mut nsec = ts.tv_nsec - now.tv_nsec;
+        if nsec < 0 {
+            nsec += 1000000000;
+            sec -= 1;
+        }
+        if sec < 0 {
+            return Err(SystemError::ETIMEDOUT);
+        }
+        return Ok(Some(TimeSpec::new(sec, nsec)));
+    }
+}
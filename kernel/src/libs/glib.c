@@ -1,5 +1,56 @@
 #include <common/glib.h>
 #include <common/string.h>
+#include <common/cpu.h>
+
+// 在glib_mem_init()之前，总是使用rep movsq/stosq
+uint64_t __memcpy_movsb_threshold = UINT64_MAX;
+uint64_t __memset_stosb_threshold = UINT64_MAX;
+uint64_t __memset_nt_threshold = UINT64_MAX;
+
+// 支持ERMS时，使用rep movsb/stosb的最小长度（更短时启动开销较大）
+#define MEM_ERMS_THRESHOLD 256
+// 使用非临时写入的最小长度，超过这个大小的清零通常不会很快被读取，写入cache只会把其他数据挤出去
+#define MEM_NT_THRESHOLD (1UL << 20)
+
+/**
+ * @brief 根据cpu的特性选择memcpy/memset的实现
+ *
+ * FSRM只说明短的rep movsb很快，rep stosb是否同样如此由FSRS单独说明，因此memcpy与memset分别设置阈值
+ */
+void glib_mem_init()
+{
+    uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+    cpu_cpuid(0, 0, &eax, &ebx, &ecx, &edx);
+    if (eax >= 7)
+    {
+        cpu_cpuid(7, 0, &eax, &ebx, &ecx, &edx);
+        uint32_t max_subleaf = eax;
+        // CPUID.(EAX=07H,ECX=0):EBX[bit 9] ERMS
+        if (ebx & (1 << 9))
+        {
+            __memcpy_movsb_threshold = MEM_ERMS_THRESHOLD;
+            __memset_stosb_threshold = MEM_ERMS_THRESHOLD;
+        }
+        // CPUID.(EAX=07H,ECX=0):EDX[bit 4] FSRM：短的rep movsb同样很快
+        // 长度为0时仍有启动开销，除非同时支持FZLRM
+        bool fsrm = edx & (1 << 4);
+        if (fsrm)
+            __memcpy_movsb_threshold = 1;
+
+        if (max_subleaf >= 1)
+        {
+            cpu_cpuid(7, 1, &eax, &ebx, &ecx, &edx);
+            // CPUID.(EAX=07H,ECX=1):EAX[bit 10] FZLRM：长度为0的rep movsb很快
+            if (fsrm && (eax & (1 << 10)))
+                __memcpy_movsb_threshold = 0;
+            // CPUID.(EAX=07H,ECX=1):EAX[bit 11] FSRS：短的rep stosb很快
+            if (eax & (1 << 11))
+                __memset_stosb_threshold = 0;
+        }
+    }
+    // movnti属于SSE2，x86_64的cpu都支持
+    __memset_nt_threshold = MEM_NT_THRESHOLD;
+}
 
 /**
  * @brief 这个函数让蜂鸣器发声，目前仅用于真机调试。未来将移除，请勿依赖此函数。
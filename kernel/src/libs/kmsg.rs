@@ -0,0 +1,334 @@
+//! 内核日志环形缓冲区
+//!
+//! printk不再在调用者的上下文中同步地把字符画到屏幕上，而是把格式化好的文本作为一条记录写入无锁的环形缓冲区，
+//! 由控制台内核线程在后台把记录输出到textui（以及串口）。
+//!
+//! 缓冲区是一个SeqRing（见seq_ring模块）：每条记录带有一个全局递增的序列号，写者之间不存在任何锁，
+//! 控制台按序列号依次读取，并能检测到未写完或者已经被新一轮写者覆盖的记录。
+//!
+//! 在控制台线程启动之前（以及内核panic之后），写者会在自己的上下文中立即把缓冲区的内容输出到控制台。
+//! 内核panic时若控制台锁一直被占用（持锁者可能正是出错的上下文），则绕过控制台锁和textui，直接把记录写入串口。
+use core::{
+    hint::spin_loop,
+    sync::atomic::{AtomicBool, AtomicU64, AtomicUsize, Ordering},
+};
+
+use alloc::{boxed::Box, format, string::String, sync::Arc, vec::Vec};
+
+use crate::{
+    arch::{sched::sched, CurrentIrqArch},
+    driver::uart::uart_device::{c_uart_send, UartPort},
+    exception::InterruptArch,
+    process::{
+        kthread::{KernelThreadClosure, KernelThreadMechanism},
+        ProcessControlBlock, ProcessManager,
+    },
+    smp::core::smp_get_processor_id,
+    time::timer::clock,
+};
+
+use super::{
+    lazy_init::Lazy,
+    lib_ui::textui::{textui_putchar, FontColor},
+    seq_ring::{SeqRing, SeqRingRead, SeqRingSlot},
+    spinlock::SpinLock,
+};
+
+/// 环形缓冲区中记录的数量（必须是2的幂）
+const KMSG_RECORD_NUM: usize = 1024;
+/// 一条记录最多保存的字节数，更长的文本会被拆分成多条记录
+pub const KMSG_TEXT_MAX: usize = 240;
+
+/// 控制台下一条要输出的记录的序列号
+static CONSOLE_SEQ: AtomicU64 = AtomicU64::new(0);
+/// 由于被覆盖而没能输出到控制台的记录数
+static CONSOLE_DROPPED: AtomicUsize = AtomicUsize::new(0);
+/// 控制台线程是否已经接管了输出
+static CONSOLE_ASYNC: AtomicBool = AtomicBool::new(false);
+/// 同一时刻只允许一个上下文向控制台输出
+static CONSOLE_LOCK: SpinLock<()> = SpinLock::new(());
+/// 内核panic时控制台锁无法获得，此后记录不经过控制台锁，直接写入串口
+static CONSOLE_EMERGENCY: AtomicBool = AtomicBool::new(false);
+/// 控制台内核线程
+static CONSOLE_THREAD: Lazy<Arc<ProcessControlBlock>> = Lazy::new();
+
+static KMSG_RECORDS: [SeqRingSlot<KmsgData>; KMSG_RECORD_NUM] = {
+    const EMPTY: SeqRingSlot<KmsgData> = SeqRingSlot::new(KmsgData::empty());
+    [EMPTY; KMSG_RECORD_NUM]
+};
+/// 内核日志的环形缓冲区
+static KMSG_RING: SeqRing<KmsgData> = SeqRing::new(&KMSG_RECORDS);
+
+/// 日志记录的内容
+#[derive(Clone, Copy)]
+struct KmsgData {
+    /// 写入时的时钟（微秒）
+    timestamp: u64,
+    cpu: u32,
+    fr_color: u32,
+    bk_color: u32,
+    len: u32,
+    text: [u8; KMSG_TEXT_MAX],
+}
+
+impl KmsgData {
+    const fn empty() -> Self {
+        return Self {
+            timestamp: 0,
+            cpu: 0,
+            fr_color: 0,
+            bk_color: 0,
+            len: 0,
+            text: [0; KMSG_TEXT_MAX],
+        };
+    }
+}
+
+/// @brief 写入一条不超过KMSG_TEXT_MAX字节的记录
+fn kmsg_store(text: &[u8], fr_color: u32, bk_color: u32) {
+    let len = text.len().min(KMSG_TEXT_MAX);
+    let mut data = KmsgData {
+        timestamp: clock(),
+        cpu: smp_get_processor_id(),
+        fr_color,
+        bk_color,
+        len: len as u32,
+        text: [0; KMSG_TEXT_MAX],
+    };
+    data.text[..len].copy_from_slice(&text[..len]);
+    KMSG_RING.push(&data);
+}
+
+/// @brief 把一段文本写入内核日志
+///
+/// 该函数不加锁、不睡眠，可以在任何上下文（包括中断上下文）中调用
+///
+/// ## 参数
+///
+/// - `text` : 要写入的文本
+/// - `fr_color` : 前景色
+/// - `bk_color` : 背景色
+pub fn kmsg_write(text: &[u8], fr_color: FontColor, bk_color: FontColor) {
+    let fr_color: u32 = fr_color.into();
+    let bk_color: u32 = bk_color.into();
+    for chunk in text.chunks(KMSG_TEXT_MAX) {
+        kmsg_store(chunk, fr_color, bk_color);
+    }
+
+    if !CONSOLE_ASYNC.load(Ordering::Acquire) {
+        console_flush();
+    }
+}
+
+/// @brief 把内核日志中尚未输出的记录输出到控制台
+///
+/// 每输出一条记录就释放一次控制台锁（并恢复中断），因此关中断的时间不超过输出一条记录的时间。
+/// 若其他上下文正在输出，则直接返回，由它负责输出新写入的记录
+fn console_flush() {
+    if CONSOLE_EMERGENCY.load(Ordering::Acquire) {
+        console_emergency_flush();
+        return;
+    }
+    loop {
+        let guard = match CONSOLE_LOCK.try_lock_irqsave() {
+            Ok(guard) => guard,
+            Err(_) => return,
+        };
+        let progressed = console_emit_one();
+        drop(guard);
+
+        if !progressed {
+            // 释放锁之前写入的记录可能因为try_lock失败而没有被输出
+            if !console_pending() {
+                return;
+            }
+            if let SeqRingRead::Pending = KMSG_RING.load(CONSOLE_SEQ.load(Ordering::Acquire)) {
+                return;
+            }
+        }
+    }
+}
+
+/// @brief 输出下一条记录（或者跳过已经被覆盖的记录），调用者需要持有CONSOLE_LOCK
+///
+/// @return 是否有进展。没有可以输出的记录、或者下一条记录还没有写完时返回false
+fn console_emit_one() -> bool {
+    let seq = CONSOLE_SEQ.load(Ordering::Relaxed);
+    if seq >= KMSG_RING.head() {
+        return false;
+    }
+    match KMSG_RING.load(seq) {
+        SeqRingRead::Ok(data) => {
+            for c in &data.text[..data.len as usize] {
+                textui_putchar(
+                    *c as char,
+                    FontColor::from(data.fr_color),
+                    FontColor::from(data.bk_color),
+                )
+                .ok();
+            }
+            CONSOLE_SEQ.store(seq + 1, Ordering::Release);
+        }
+        // 写者会在写完之后自己输出（或者由控制台线程输出）
+        SeqRingRead::Pending => return false,
+        SeqRingRead::Lost => {
+            // 跳过所有已经被覆盖的记录
+            let next = (seq + 1).max(KMSG_RING.oldest());
+            CONSOLE_DROPPED.fetch_add((next - seq) as usize, Ordering::Relaxed);
+            CONSOLE_SEQ.store(next, Ordering::Release);
+        }
+    }
+    return true;
+}
+
+/// @brief 不获取控制台锁，把尚未输出的记录直接写入串口（仅用于内核panic时）
+///
+/// 不经过textui：控制台锁被占用时，textui的状态可能已经被出错的持锁者破坏
+fn console_emergency_flush() {
+    let port = UartPort::COM1.to_u16();
+    loop {
+        let seq = CONSOLE_SEQ.load(Ordering::Acquire);
+        if seq >= KMSG_RING.head() {
+            return;
+        }
+        match KMSG_RING.load(seq) {
+            SeqRingRead::Ok(data) => {
+                for c in &data.text[..data.len as usize] {
+                    c_uart_send(port, *c);
+                }
+                CONSOLE_SEQ.fetch_max(seq + 1, Ordering::AcqRel);
+            }
+            // 写者可能已经停止运行，不再等待它
+            SeqRingRead::Pending => {
+                CONSOLE_DROPPED.fetch_add(1, Ordering::Relaxed);
+                CONSOLE_SEQ.fetch_max(seq + 1, Ordering::AcqRel);
+            }
+            SeqRingRead::Lost => {
+                let next = (seq + 1).max(KMSG_RING.oldest());
+                CONSOLE_DROPPED.fetch_add((next - seq) as usize, Ordering::Relaxed);
+                CONSOLE_SEQ.fetch_max(next, Ordering::AcqRel);
+            }
+        }
+    }
+}
+
+#[inline(always)]
+fn console_pending() -> bool {
+    return CONSOLE_SEQ.load(Ordering::Acquire) < KMSG_RING.head();
+}
+
+/// 控制台内核线程的主循环
+fn console_thread(_: usize) -> i32 {
+    loop {
+        console_flush();
+
+        let irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
+        if console_pending() {
+            drop(irq_guard);
+            // 有记录还没有写完，让出cpu给写者
+            sched();
+            continue;
+        }
+        // 由时钟中断负责唤醒，见kmsg_check_wakeup()
+        ProcessManager::mark_sleep(true).ok();
+        drop(irq_guard);
+        sched();
+    }
+}
+
+/// @brief 时钟中断处理函数中调用，在有尚未输出的日志时唤醒控制台线程
+///
+/// 写者本身不唤醒控制台线程，这样在持有调度器的锁时也能安全地打印日志
+#[inline]
+pub fn kmsg_check_wakeup() {
+    if !console_pending() {
+        return;
+    }
+    if let Some(pcb) = CONSOLE_THREAD.try_get() {
+        ProcessManager::wakeup(pcb).ok();
+    }
+}
+
+/// @brief 创建控制台内核线程，此后日志改为由它异步输出
+pub fn kmsg_console_init() {
+    let pcb = KernelThreadMechanism::create(
+        KernelThreadClosure::UsizeClosure((Box::new(console_thread), 0)),
+        String::from("kconsole"),
+    )
+    .unwrap_or_else(|| panic!("Failed to create console thread"));
+    CONSOLE_THREAD.init(pcb.clone());
+    CONSOLE_ASYNC.store(true, Ordering::Release);
+    ProcessManager::wakeup(&pcb).ok();
+}
+
+/// @brief 切换回同步输出，并立即输出所有尚未输出的日志（内核panic时调用）
+pub fn kmsg_console_emergency() {
+    CONSOLE_ASYNC.store(false, Ordering::Release);
+    // 正在输出的上下文可能已经无法继续运行，只等待有限的时间
+    for _ in 0..1000000 {
+        if !CONSOLE_LOCK.is_locked() {
+            break;
+        }
+        spin_loop();
+    }
+    if CONSOLE_LOCK.is_locked() {
+        // 持锁者没有在有限的时间内放锁（例如panic就发生在textui_putchar中），不再等待它
+        CONSOLE_EMERGENCY.store(true, Ordering::Release);
+    }
+    console_flush();
+}
+
+/// @brief 以文本形式导出内核日志中仍然保存着的全部记录（用于/proc/kmsg）
+///
+/// 每一行的开头是`<cpu>[秒.微秒]`形式的时间戳
+pub fn kmsg_dump() -> Vec<u8> {
+    let head = KMSG_RING.head();
+    let mut seq = KMSG_RING.oldest();
+    let mut result = Vec::new();
+    let mut line_start = true;
+    while seq < head {
+        if let SeqRingRead::Ok(data) = KMSG_RING.load(seq) {
+            for c in &data.text[..data.len as usize] {
+                if line_start {
+                    result.extend_from_slice(
+                        format!(
+                            "<{}>[{:5}.{:06}] ",
+                            data.cpu,
+                            data.timestamp / 1000000,
+                            data.timestamp % 1000000
+                        )
+                        .as_bytes(),
+                    );
+                }
+                result.push(*c);
+                line_start = *c == b'\n';
+            }
+        }
+        seq += 1;
+    }
+    let dropped = CONSOLE_DROPPED.load(Ordering::Relaxed);
+    if dropped != 0 {
+        if !line_start {
+            result.push(b'\n');
+        }
+        result.extend_from_slice(format!("({} records dropped by console)\n", dropped).as_bytes());
+    }
+    return result;
+}
+
+/// @brief 供C代码调用的日志写入接口
+///
+/// ## 参数
+///
+/// - `buf` : 要写入的文本
+/// - `len` : 文本的长度
+/// - `fr_color` : 前景色
+/// - `bk_color` : 背景色
+#[no_mangle]
+pub extern "C" fn rs_kmsg_write(buf: *const u8, len: i32, fr_color: u32, bk_color: u32) {
+    if buf.is_null() || len <= 0 {
+        return;
+    }
+    let text = unsafe { core::slice::from_raw_parts(buf, len as usize) };
+    kmsg_write(text, FontColor::from(fr_color), FontColor::from(bk_color));
+}
@@ -189,6 +189,8 @@ impl ScmBufferInfo {
                         double_buffer_guard.as_mut().copy_from_slice(x.as_ref());
                     }
                 };
+                // 整个双缓冲区都被修改了
+                video_refresh_manager().mark_all_dirty();
             }
         }
     }
@@ -40,6 +40,63 @@ pub static mut TEXTUI_IS_INIT: bool = false;
 
 pub static ENABLE_PUT_TO_WINDOW: AtomicBool = AtomicBool::new(true);
 
+/// 字形缓存的项数
+const GLYPH_CACHE_SIZE: usize = 256;
+
+lazy_static! {
+    /// 字形缓存（直接映射），以(字符, 前景色, 背景色)的哈希值为索引
+    static ref GLYPH_CACHE: SpinLock<Vec<Option<GlyphCacheEntry>>> = {
+        let mut cache = Vec::with_capacity(GLYPH_CACHE_SIZE);
+        cache.resize_with(GLYPH_CACHE_SIZE, || None);
+        SpinLock::new(cache)
+    };
+}
+
+/// 光栅化之后的字形，即字符的每个像素点的颜色
+type GlyphPixels = [[u32; TEXTUI_CHAR_WIDTH as usize]; TEXTUI_CHAR_HEIGHT as usize];
+
+/// 字形缓存中的一项
+#[derive(Debug)]
+struct GlyphCacheEntry {
+    c: char,
+    frcolor: u32,
+    bkcolor: u32,
+    pixels: GlyphPixels,
+}
+
+/// 获取字符以指定的颜色光栅化之后的字形，不在缓存中时会先光栅化并放入缓存
+fn glyph_lookup(c: char, frcolor: u32, bkcolor: u32) -> GlyphPixels {
+    let hash =
+        (c as u32 ^ frcolor.rotate_left(11) ^ bkcolor.rotate_left(22)).wrapping_mul(0x9e37_79b1);
+    let index = (hash >> 24) as usize % GLYPH_CACHE_SIZE;
+
+    let mut cache = GLYPH_CACHE.lock_irqsave();
+    if let Some(entry) = &cache[index] {
+        if entry.c == c && entry.frcolor == frcolor && entry.bkcolor == bkcolor {
+            return entry.pixels;
+        }
+    }
+
+    let font = Font::get_font(c);
+    let mut pixels: GlyphPixels = [[0; TEXTUI_CHAR_WIDTH as usize]; TEXTUI_CHAR_HEIGHT as usize];
+    for (i, row) in pixels.iter_mut().enumerate() {
+        for (j, pixel) in row.iter_mut().enumerate() {
+            *pixel = if font.is_frcolor(i, j) {
+                frcolor
+            } else {
+                bkcolor
+            };
+        }
+    }
+    cache[index] = Some(GlyphCacheEntry {
+        c,
+        frcolor,
+        bkcolor,
+        pixels,
+    });
+    return pixels;
+}
+
 /// 获取TEXTUI_FRAMEWORK的可变实例
 pub fn textui_framework() -> Arc<TextUiFramework> {
     unsafe {
@@ -307,6 +364,19 @@ impl TextuiBuf<'_> {
         }
     }
 
+    /// 标记某个真实行所在的像素行已被修改（只有双缓冲区需要标记，设备缓冲区的修改会直接显示）
+    pub fn mark_dirty(&self, lineid: LineId) {
+        if self.guard.is_some() {
+            let y: u32 = <LineId as Into<u32>>::into(lineid) * TEXTUI_CHAR_HEIGHT;
+            video_refresh_manager().mark_dirty(y, y + TEXTUI_CHAR_HEIGHT);
+        }
+    }
+
+    /// 是否是双缓冲区
+    pub fn is_double_buffer(&self) -> bool {
+        return self.guard.is_some();
+    }
+
     pub fn buf_mut(&mut self) -> &mut [u32] {
         if let Some(buf) = &mut self.buf {
             return buf;
@@ -373,31 +443,28 @@ impl TextuiCharChromatic {
         lineid: LineId,
         lineindex: LineIndex,
     ) -> Result<i32, SystemError> {
-        // 找到要渲染的字符的像素点数据
-
-        let font: Font = Font::get_font(self.c.unwrap_or(' '));
+        // 找到要渲染的字符光栅化之后的像素点数据
+        let glyph = glyph_lookup(
+            self.c.unwrap_or(' '),
+            self.frcolor.into(),
+            self.bkcolor.into(),
+        );
 
         let mut count = TextuiBuf::get_start_index_by_lineid_lineindex(lineid, lineindex);
 
         let mut _binding = textui_framework().metadata.read().buf_info();
+        let buf_width = _binding.width() as usize;
 
         let mut buf = TextuiBuf::new(&mut _binding);
+        let buf_slice = buf.buf_mut();
 
-        // 在缓冲区画出一个字体，每个字体有TEXTUI_CHAR_HEIGHT行，TEXTUI_CHAR_WIDTH列个像素点
-        for i in 0..TEXTUI_CHAR_HEIGHT {
-            let start = count;
-            for j in 0..TEXTUI_CHAR_WIDTH {
-                if font.is_frcolor(i as usize, j as usize) {
-                    // 字，显示前景色
-                    buf.put_color_in_pixel(self.frcolor.into(), count);
-                } else {
-                    // 背景色
-                    buf.put_color_in_pixel(self.bkcolor.into(), count);
-                }
-                count += 1;
-            }
-            count = TextuiBuf::get_index_of_next_line(start);
+        // 在缓冲区画出一个字体，每个字体有TEXTUI_CHAR_HEIGHT行，每行整行拷贝TEXTUI_CHAR_WIDTH个像素点
+        for row in glyph.iter() {
+            buf_slice[count..count + TEXTUI_CHAR_WIDTH as usize].copy_from_slice(row);
+            count += buf_width;
         }
+        // 在释放双缓冲区的锁之前，标记被修改的像素行
+        buf.mark_dirty(lineid);
 
         return Ok(0);
     }
@@ -637,6 +704,29 @@ impl TextuiWindow {
         return Ok(0);
     }
 
+    /// 把缓冲区中显示的内容整体向上移动一个字符行
+    ///
+    /// 只对双缓冲区进行移动：设备缓冲区读起来很慢，不如重新渲染
+    ///
+    /// ## 返回值
+    ///
+    /// 移动成功返回true，此时只需重新渲染最后一行；否则返回false，需要重新渲染所有行
+    fn textui_scroll_up(actual_line_sum: i32) -> bool {
+        let mut binding = textui_framework().metadata.read().buf_info();
+        let buf_width = binding.width() as usize;
+        let mut buf = TextuiBuf::new(&mut binding);
+        if !buf.is_double_buffer() {
+            return false;
+        }
+
+        let line_pixels = buf_width * TEXTUI_CHAR_HEIGHT as usize;
+        let total_pixels = line_pixels * actual_line_sum as usize;
+        buf.buf_mut().copy_within(line_pixels..total_pixels, 0);
+        // 整个屏幕的内容都改变了
+        video_refresh_manager().mark_dirty(0, actual_line_sum as u32 * TEXTUI_CHAR_HEIGHT);
+        return true;
+    }
+
     /// 往某个窗口的缓冲区的某个虚拟行插入换行
     /// ## 参数
     /// - window 窗口结构体
@@ -672,8 +762,13 @@ impl TextuiWindow {
                 self.top_vline = LineId::new(0);
             }
 
-            // 刷新所有行
-            self.textui_refresh_vlines(self.top_vline, actual_line_sum)?;
+            if Self::textui_scroll_up(actual_line_sum) {
+                // 只有新的最后一行需要重新渲染
+                self.textui_refresh_vline(self.vline_operating)?;
+            } else {
+                // 刷新所有行
+                self.textui_refresh_vlines(self.top_vline, actual_line_sum)?;
+            }
         } else {
             //换行说明上一行已经在缓冲区中，所以已经使用的虚拟行总数+1
             self.vlines_used += 1;
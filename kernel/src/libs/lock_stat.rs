@@ -0,0 +1,287 @@
+//! 锁的竞争统计（lock_stat）
+//!
+//! 打开之后，SpinLock、RwLock和Mutex每次加锁时，都会以加锁处的代码位置（通过`#[track_caller]`获得）
+//! 作为锁的类别，统计加锁次数、发生竞争的次数、等待时间的总和与最大值，以及持锁时间的总和与最大值。
+//! 时间以TSC计，输出时转换为纳秒。
+//!
+//! 统计表是一个静态的开放寻址哈希表，记录时只使用原子操作，不加锁也不分配内存，
+//! 因此内存分配器等底层模块的锁同样可以被统计。关闭时，加锁路径上只多了一次对`AtomicBool`的读取。
+//!
+//! - 读取/proc/lock_stat得到按等待时间总和排序的统计结果
+//! - 向/proc/lock_stat写入`1`打开统计，写入`0`关闭统计，写入`clear`清零统计结果
+use core::{
+    arch::x86_64::_rdtsc,
+    intrinsics::unlikely,
+    panic::Location,
+    ptr::null_mut,
+    sync::atomic::{AtomicBool, AtomicPtr, AtomicU64, AtomicU8, AtomicUsize, Ordering},
+};
+
+use alloc::{format, string::String, vec::Vec};
+
+use crate::{include::bindings::bindings::Cpu_tsc_freq, syscall::SystemError};
+
+/// 统计表能容纳的锁类别的数量（必须是2的幂）
+const LOCK_STAT_CLASSES: usize = 1024;
+
+/// 是否打开了锁的统计
+static LOCK_STAT_ENABLED: AtomicBool = AtomicBool::new(false);
+/// 由于统计表已满而没有被统计的加锁次数
+static LOCK_STAT_OVERFLOW: AtomicUsize = AtomicUsize::new(0);
+
+static LOCK_STAT_TABLE: [LockClass; LOCK_STAT_CLASSES] = {
+    const EMPTY: LockClass = LockClass::new();
+    [EMPTY; LOCK_STAT_CLASSES]
+};
+
+/// 锁的种类
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(u8)]
+pub enum LockKind {
+    Spin = 1,
+    RwRead = 2,
+    RwUpgradeable = 3,
+    RwWrite = 4,
+    Mutex = 5,
+}
+
+impl LockKind {
+    fn name(value: u8) -> &'static str {
+        return match value {
+            1 => "spin",
+            2 => "read",
+            3 => "upgradeable",
+            4 => "write",
+            5 => "mutex",
+            _ => "unknown",
+        };
+    }
+}
+
+/// 一个锁类别（一个加锁的位置）的统计信息
+struct LockClass {
+    /// 加锁的位置，为空表示该槽位还没有被使用
+    key: AtomicPtr<Location<'static>>,
+    kind: AtomicU8,
+    acquisitions: AtomicU64,
+    contended: AtomicU64,
+    wait_total: AtomicU64,
+    wait_max: AtomicU64,
+    hold_total: AtomicU64,
+    hold_max: AtomicU64,
+}
+
+impl LockClass {
+    const fn new() -> Self {
+        return Self {
+            key: AtomicPtr::new(null_mut()),
+            kind: AtomicU8::new(0),
+            acquisitions: AtomicU64::new(0),
+            contended: AtomicU64::new(0),
+            wait_total: AtomicU64::new(0),
+            wait_max: AtomicU64::new(0),
+            hold_total: AtomicU64::new(0),
+            hold_max: AtomicU64::new(0),
+        };
+    }
+
+    fn reset(&self) {
+        self.acquisitions.store(0, Ordering::Relaxed);
+        self.contended.store(0, Ordering::Relaxed);
+        self.wait_total.store(0, Ordering::Relaxed);
+        self.wait_max.store(0, Ordering::Relaxed);
+        self.hold_total.store(0, Ordering::Relaxed);
+        self.hold_max.store(0, Ordering::Relaxed);
+    }
+}
+
+/// 保存在锁的守卫中，用于在放锁时统计持锁时间
+#[derive(Debug)]
+pub struct LockStatHold {
+    /// 锁类别在统计表中的下标加1，为0表示不统计
+    class: u32,
+    /// 获得锁时的TSC
+    since: u64,
+}
+
+impl LockStatHold {
+    pub const NONE: Self = Self { class: 0, since: 0 };
+
+    /// @brief 放锁时调用，统计持锁时间
+    #[inline(always)]
+    pub fn release(&self) {
+        if unlikely(self.class != 0) {
+            lock_stat_release(self);
+        }
+    }
+}
+
+#[inline(always)]
+fn lock_stat_enabled() -> bool {
+    return unlikely(LOCK_STAT_ENABLED.load(Ordering::Relaxed));
+}
+
+/// @brief 在加锁发生竞争、开始等待时调用，获取开始等待的时间
+///
+/// 统计关闭时返回0，不读取TSC
+#[inline(always)]
+pub fn lock_stat_wait_start() -> u64 {
+    if lock_stat_enabled() {
+        return unsafe { _rdtsc() };
+    }
+    return 0;
+}
+
+/// @brief 获得锁之后调用，统计本次加锁
+///
+/// 调用者及其调用链上的函数都需要标注`#[track_caller]`，这样记录的才是最外层的加锁位置
+///
+/// ## 参数
+///
+/// - `kind` : 锁的种类
+/// - `wait_start` : 发生竞争时为lock_stat_wait_start()的返回值，没有发生竞争时为None
+///
+/// ## 返回值
+///
+/// 需要保存在守卫中的信息，放锁时调用它的release()方法
+#[inline(always)]
+#[track_caller]
+pub fn lock_stat_acquired(kind: LockKind, wait_start: Option<u64>) -> LockStatHold {
+    if lock_stat_enabled() {
+        return lock_stat_record(Location::caller(), kind, wait_start);
+    }
+    return LockStatHold::NONE;
+}
+
+/// @brief 查找（或创建）加锁位置对应的锁类别
+fn lock_class(location: &'static Location<'static>, kind: LockKind) -> Option<usize> {
+    let key = location as *const Location<'static> as *mut Location<'static>;
+    let hash = (key as usize >> 3).wrapping_mul(0x9E37_79B9_7F4A_7C15);
+    let start = hash >> (usize::BITS - LOCK_STAT_CLASSES.trailing_zeros());
+    for i in 0..LOCK_STAT_CLASSES {
+        let idx = (start + i) & (LOCK_STAT_CLASSES - 1);
+        let class = &LOCK_STAT_TABLE[idx];
+        let cur = class.key.load(Ordering::Acquire);
+        if cur == key {
+            return Some(idx);
+        }
+        if cur.is_null() {
+            match class
+                .key
+                .compare_exchange(null_mut(), key, Ordering::AcqRel, Ordering::Acquire)
+            {
+                Ok(_) => {
+                    class.kind.store(kind as u8, Ordering::Relaxed);
+                    return Some(idx);
+                }
+                // 其他cpu抢先占用了这个槽位，它记录的可能就是同一个位置
+                Err(other) if other == key => return Some(idx),
+                Err(_) => continue,
+            }
+        }
+    }
+    return None;
+}
+
+#[cold]
+#[inline(never)]
+fn lock_stat_record(
+    location: &'static Location<'static>,
+    kind: LockKind,
+    wait_start: Option<u64>,
+) -> LockStatHold {
+    let now = unsafe { _rdtsc() };
+    let idx = match lock_class(location, kind) {
+        Some(idx) => idx,
+        None => {
+            LOCK_STAT_OVERFLOW.fetch_add(1, Ordering::Relaxed);
+            return LockStatHold::NONE;
+        }
+    };
+    let class = &LOCK_STAT_TABLE[idx];
+    class.acquisitions.fetch_add(1, Ordering::Relaxed);
+    if let Some(wait_start) = wait_start {
+        // 开始等待时统计可能还没有打开
+        let wait = if wait_start == 0 {
+            0
+        } else {
+            now.saturating_sub(wait_start)
+        };
+        class.contended.fetch_add(1, Ordering::Relaxed);
+        class.wait_total.fetch_add(wait, Ordering::Relaxed);
+        class.wait_max.fetch_max(wait, Ordering::Relaxed);
+    }
+    return LockStatHold {
+        class: idx as u32 + 1,
+        since: now,
+    };
+}
+
+#[cold]
+#[inline(never)]
+fn lock_stat_release(hold: &LockStatHold) {
+    let hold_time = unsafe { _rdtsc() }.saturating_sub(hold.since);
+    let class = &LOCK_STAT_TABLE[hold.class as usize - 1];
+    class.hold_total.fetch_add(hold_time, Ordering::Relaxed);
+    class.hold_max.fetch_max(hold_time, Ordering::Relaxed);
+}
+
+/// @brief 清零所有锁类别的统计结果
+pub fn lock_stat_clear() {
+    for class in LOCK_STAT_TABLE.iter() {
+        class.reset();
+    }
+    LOCK_STAT_OVERFLOW.store(0, Ordering::Relaxed);
+}
+
+/// @brief 处理写入/proc/lock_stat的命令：`1`打开统计，`0`关闭统计，`clear`清零统计结果
+pub fn lock_stat_control(cmd: &str) -> Result<(), SystemError> {
+    match cmd.trim_matches(|c: char| c.is_whitespace() || c == '\0') {
+        "1" => LOCK_STAT_ENABLED.store(true, Ordering::Relaxed),
+        "0" => LOCK_STAT_ENABLED.store(false, Ordering::Relaxed),
+        "clear" => lock_stat_clear(),
+        _ => return Err(SystemError::EINVAL),
+    }
+    return Ok(());
+}
+
+/// @brief 以文本形式导出统计结果（用于/proc/lock_stat），按等待时间的总和从大到小排序
+///
+/// 每一行的格式为`<加锁位置> <种类> <加锁次数> <竞争次数> <等待总时间> <最长等待时间> <持锁总时间> <最长持锁时间>`，
+/// 时间的单位为纳秒
+pub fn lock_stat_dump() -> String {
+    let tsc_freq = unsafe { Cpu_tsc_freq }.max(1) as u128;
+    let to_ns = |cycles: u64| (cycles as u128 * 1000000000 / tsc_freq) as u64;
+
+    let mut classes: Vec<&LockClass> = LOCK_STAT_TABLE
+        .iter()
+        .filter(|class| {
+            !class.key.load(Ordering::Acquire).is_null()
+                && class.acquisitions.load(Ordering::Relaxed) != 0
+        })
+        .collect();
+    classes.sort_by_key(|class| core::cmp::Reverse(class.wait_total.load(Ordering::Relaxed)));
+
+    let mut result = format!(
+        "enabled: {}\noverflow: {}\nclass kind acquisitions contended wait_total_ns wait_max_ns hold_total_ns hold_max_ns\n",
+        LOCK_STAT_ENABLED.load(Ordering::Relaxed) as u8,
+        LOCK_STAT_OVERFLOW.load(Ordering::Relaxed)
+    );
+    for class in classes {
+        let location = unsafe { &*class.key.load(Ordering::Acquire) };
+        result.push_str(&format!(
+            "{}:{}:{} {} {} {} {} {} {} {}\n",
+            location.file(),
+            location.line(),
+            location.column(),
+            LockKind::name(class.kind.load(Ordering::Relaxed)),
+            class.acquisitions.load(Ordering::Relaxed),
+            class.contended.load(Ordering::Relaxed),
+            to_ns(class.wait_total.load(Ordering::Relaxed)),
+            to_ns(class.wait_max.load(Ordering::Relaxed)),
+            to_ns(class.hold_total.load(Ordering::Relaxed)),
+            to_ns(class.hold_max.load(Ordering::Relaxed))
+        ));
+    }
+    return result;
+}
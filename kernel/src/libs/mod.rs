@@ -3,19 +3,25 @@ pub mod atomic;
 pub mod casting;
 pub mod elf;
 pub mod ffi_convert;
+pub mod futex;
 #[macro_use]
 pub mod int_like;
 pub mod keyboard_parser;
+pub mod kmsg;
 pub mod lazy_init;
 pub mod lib_ui;
+pub mod lock_stat;
 pub mod mutex;
 pub mod notifier;
 pub mod once;
 pub mod printk;
 pub mod rbtree;
+pub mod rcu;
 #[macro_use]
 pub mod rwlock;
 pub mod semaphore;
+pub mod seq_ring;
+pub mod seqlock;
 pub mod spinlock;
 pub mod vec_cursor;
 #[macro_use]
@@ -1,6 +1,8 @@
 use core::{
     cell::UnsafeCell,
+    hint::spin_loop,
     ops::{Deref, DerefMut},
+    sync::atomic::{AtomicBool, AtomicU32, AtomicUsize, Ordering},
 };
 
 use alloc::{collections::LinkedList, sync::Arc};
@@ -8,27 +10,63 @@ use alloc::{collections::LinkedList, sync::Arc};
 use crate::{
     arch::{sched::sched, CurrentIrqArch},
     exception::InterruptArch,
-    libs::spinlock::SpinLockGuard,
-    process::{Pid, ProcessControlBlock, ProcessManager},
+    libs::{
+        lock_stat::{lock_stat_acquired, lock_stat_wait_start, LockKind, LockStatHold},
+        spinlock::SpinLockGuard,
+    },
+    process::{Pid, ProcessControlBlock, ProcessFlags, ProcessManager},
+    sched::core::CPU_EXECUTING,
+    smp::core::smp_get_processor_id,
     syscall::SystemError,
 };
 
 use super::spinlock::SpinLock;
 
+/// owner字段的标志位：等待队列不为空，放锁时需要走慢速路径唤醒等待者
+const MUTEX_FLAG_WAITERS: usize = 1 << 0;
+/// owner字段的标志位：队首的等待者已经被唤醒过却没有抢到锁，放锁时需要把锁直接移交给它
+const MUTEX_FLAG_HANDOFF: usize = 1 << 1;
+const MUTEX_FLAG_MASK: usize = MUTEX_FLAG_WAITERS | MUTEX_FLAG_HANDOFF;
+const MUTEX_FLAG_BITS: usize = 2;
+
+/// 乐观自旋的最大轮数，超过之后就进入睡眠
+const MUTEX_SPIN_MAX: usize = 1 << 14;
+/// 乐观自旋时，每隔这么多轮检查一次当前进程是否需要被调度
+const MUTEX_SPIN_RESCHED_CHECK: usize = 64;
+
+/// 等待获得Mutex的进程
+#[derive(Debug)]
+struct MutexWaiter {
+    pcb: Arc<ProcessControlBlock>,
+    /// 是否还在等待队列中（只在持有inner锁时修改）
+    queued: AtomicBool,
+}
+
 #[derive(Debug)]
 struct MutexInner {
-    /// 当前Mutex是否已经被上锁(上锁时，为true)
-    is_locked: bool,
-    /// 等待获得这个锁的进程的链表
-    wait_list: LinkedList<Arc<ProcessControlBlock>>,
+    /// 等待获得这个锁的进程的链表。
+    ///
+    /// 放锁时只唤醒队首而不将其出队（除非把锁移交给它），等待者在获得锁之后才把自己移出队列，
+    /// 因此被唤醒却没抢到锁的等待者仍然位于队首
+    wait_list: LinkedList<Arc<MutexWaiter>>,
 }
 
 /// @brief Mutex互斥量结构体
 /// 请注意！由于Mutex属于休眠锁，因此，如果您的代码可能在中断上下文内执行，请勿采用Mutex！
+///
+/// 加锁的快速路径只对owner做一次cmpxchg；锁被占用且持有者正在其他cpu上运行时，
+/// 先乐观自旋一段时间（自旋者在osq上排队，只有队首会去读owner），
+/// 失败后才加入等待队列睡眠。已经被唤醒过却仍没抢到锁的等待者会请求持有者在放锁时直接把锁移交给它，避免饿死。
 #[derive(Debug)]
 pub struct Mutex<T> {
     /// 该Mutex保护的数据
     data: UnsafeCell<T>,
+    /// 持有者的id（(pid + 1) << MUTEX_FLAG_BITS，为0表示未上锁）以及标志位
+    owner: AtomicUsize,
+    /// 持有者加锁时所在的cpu，用于判断持有者是否正在运行
+    owner_cpu: AtomicU32,
+    /// 乐观自旋者排队用的锁
+    osq: SpinLock<()>,
     /// Mutex内部的信息
     inner: SpinLock<MutexInner>,
 }
@@ -37,6 +75,8 @@ pub struct Mutex<T> {
 #[derive(Debug)]
 pub struct MutexGuard<'a, T: 'a> {
     lock: &'a Mutex<T>,
+    /// 用于统计持锁时间，见lock_stat模块
+    stat: LockStatHold,
 }
 
 unsafe impl<T> Sync for Mutex<T> where T: Send {}
@@ -47,8 +87,10 @@ impl<T> Mutex<T> {
     pub const fn new(value: T) -> Self {
         return Self {
             data: UnsafeCell::new(value),
+            owner: AtomicUsize::new(0),
+            owner_cpu: AtomicU32::new(0),
+            osq: SpinLock::new(()),
             inner: SpinLock::new(MutexInner {
-                is_locked: false,
                 wait_list: LinkedList::new(),
             }),
         };
@@ -58,30 +100,30 @@ impl<T> Mutex<T> {
     /// @return MutexGuard<T> 返回Mutex的守卫，您可以使用这个守卫来操作被保护的数据
     #[inline(always)]
     #[allow(dead_code)]
+    #[track_caller]
     pub fn lock(&self) -> MutexGuard<T> {
-        loop {
-            let mut inner: SpinLockGuard<MutexInner> = self.inner.lock();
-            // 当前mutex已经上锁
-            if inner.is_locked {
-                // 检查当前进程是否处于等待队列中,如果不在，就加到等待队列内
-                if self.check_pid_in_wait_list(&inner, ProcessManager::current_pcb().pid()) == false
-                {
-                    inner.wait_list.push_back(ProcessManager::current_pcb());
-                }
+        let pcb = ProcessManager::current_pcb();
+        let me = Self::owner_id(pcb.pid());
 
-                // 加到等待唤醒的队列，然后睡眠
-                drop(inner);
-                self.__sleep();
-            } else {
-                // 加锁成功
-                inner.is_locked = true;
-                drop(inner);
-                break;
-            }
+        // 快速路径：锁空闲
+        if self.try_acquire(me) {
+            return MutexGuard {
+                lock: self,
+                stat: lock_stat_acquired(LockKind::Mutex, None),
+            };
+        }
+
+        let wait_start = lock_stat_wait_start();
+        // 持有者正在运行，它很可能马上就会放锁，先自旋等待
+        if !self.optimistic_spin(&pcb, me) {
+            self.lock_slowpath(pcb, me);
         }
 
         // 加锁成功，返回一个守卫
-        return MutexGuard { lock: self };
+        return MutexGuard {
+            lock: self,
+            stat: lock_stat_acquired(LockKind::Mutex, Some(wait_start)),
+        };
     }
 
     /// @brief 尝试对Mutex加锁。如果加锁失败，不会将当前进程加入等待队列。
@@ -89,59 +131,193 @@ impl<T> Mutex<T> {
     /// @return Err 如果Mutex当前已经上锁，则返回Err.
     #[inline(always)]
     #[allow(dead_code)]
+    #[track_caller]
     pub fn try_lock(&self) -> Result<MutexGuard<T>, SystemError> {
-        let mut inner = self.inner.lock();
-
+        let me = Self::owner_id(ProcessManager::current_pcb().pid());
+        if self.try_acquire(me) {
+            return Ok(MutexGuard {
+                lock: self,
+                stat: lock_stat_acquired(LockKind::Mutex, None),
+            });
+        }
         // 如果当前mutex已经上锁，则失败
-        if inner.is_locked {
-            return Err(SystemError::EBUSY);
-        } else {
-            // 加锁成功
-            inner.is_locked = true;
-            return Ok(MutexGuard { lock: self });
+        return Err(SystemError::EBUSY);
+    }
+
+    #[inline(always)]
+    fn owner_id(pid: Pid) -> usize {
+        return (pid.into() + 1) << MUTEX_FLAG_BITS;
+    }
+
+    /// @brief 若锁空闲，则将其持有者设置为me（保留WAITERS标志位）
+    #[inline(always)]
+    fn try_acquire(&self, me: usize) -> bool {
+        let mut cur = self.owner.load(Ordering::Relaxed);
+        loop {
+            if cur & !MUTEX_FLAG_MASK != 0 {
+                return false;
+            }
+            match self.owner.compare_exchange_weak(
+                cur,
+                me | (cur & MUTEX_FLAG_WAITERS),
+                Ordering::Acquire,
+                Ordering::Relaxed,
+            ) {
+                Ok(_) => {
+                    self.owner_cpu
+                        .store(smp_get_processor_id(), Ordering::Relaxed);
+                    return true;
+                }
+                Err(x) => cur = x,
+            }
+        }
+    }
+
+    /// @brief 判断持有者是否正在其所在的cpu上运行
+    #[inline(always)]
+    fn owner_running(&self, owner: usize) -> bool {
+        let owner_pid = (owner >> MUTEX_FLAG_BITS) - 1;
+        let cpu_id = self.owner_cpu.load(Ordering::Relaxed);
+        return CPU_EXECUTING.get(cpu_id).into() == owner_pid;
+    }
+
+    /// @brief 乐观自旋：只要持有者还在运行，就自旋等待它放锁
+    ///
+    /// @return true 自旋期间成功获得了锁
+    /// @return false 持有者已经睡眠、当前进程需要被调度或者自旋超时，需要进入睡眠
+    fn optimistic_spin(&self, pcb: &Arc<ProcessControlBlock>, me: usize) -> bool {
+        // 自旋者在osq上排队，同一时刻只有一个自旋者会去读owner（持有osq期间抢占是关闭的）
+        let _osq_guard = self.osq.lock();
+        for i in 0..MUTEX_SPIN_MAX {
+            let cur = self.owner.load(Ordering::Relaxed);
+            if cur & !MUTEX_FLAG_MASK == 0 {
+                if self.try_acquire(me) {
+                    return true;
+                }
+                continue;
+            }
+
+            if !self.owner_running(cur) {
+                return false;
+            }
+
+            if i % MUTEX_SPIN_RESCHED_CHECK == 0
+                && pcb.flags().contains(ProcessFlags::NEED_SCHEDULE)
+            {
+                return false;
+            }
+            spin_loop();
         }
+        return false;
     }
 
-    /// @brief Mutex内部的睡眠函数
-    fn __sleep(&self) {
-        let irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
-        ProcessManager::mark_sleep(true).ok();
-        drop(irq_guard);
-        sched();
+    /// @brief 加锁的慢速路径：加入等待队列并睡眠，直到获得锁
+    fn lock_slowpath(&self, pcb: Arc<ProcessControlBlock>, me: usize) {
+        let waiter = Arc::new(MutexWaiter {
+            pcb,
+            queued: AtomicBool::new(false),
+        });
+        let mut woken = false;
+        loop {
+            let mut inner: SpinLockGuard<MutexInner> = self.inner.lock();
+
+            // 放锁者已经直接把锁移交给了当前进程（并已将当前进程出队）
+            if self.owner.load(Ordering::Acquire) & !MUTEX_FLAG_MASK == me {
+                self.owner_cpu
+                    .store(smp_get_processor_id(), Ordering::Relaxed);
+                break;
+            }
+
+            // 检查当前进程是否处于等待队列中,如果不在，就加到等待队列内
+            if !waiter.queued.load(Ordering::Relaxed) {
+                inner.wait_list.push_back(waiter.clone());
+                waiter.queued.store(true, Ordering::Relaxed);
+            }
+            // 先设置WAITERS再尝试加锁，这样持有者放锁时一定会走慢速路径来唤醒我们
+            self.owner.fetch_or(MUTEX_FLAG_WAITERS, Ordering::Relaxed);
+
+            let is_head = inner
+                .wait_list
+                .front()
+                .map_or(false, |w| Arc::ptr_eq(w, &waiter));
+
+            if self.try_acquire(me) {
+                if is_head {
+                    inner.wait_list.pop_front();
+                } else {
+                    inner.wait_list.drain_filter(|w| Arc::ptr_eq(w, &waiter));
+                }
+                waiter.queued.store(false, Ordering::Relaxed);
+                if inner.wait_list.is_empty() {
+                    self.owner.fetch_and(!MUTEX_FLAG_WAITERS, Ordering::Relaxed);
+                }
+                break;
+            }
+
+            // 作为队首被唤醒过，却仍然被别人抢先，请求持有者放锁时直接移交给队首（也就是当前进程）
+            if woken && is_head {
+                self.owner.fetch_or(MUTEX_FLAG_HANDOFF, Ordering::Relaxed);
+            }
+
+            // 在持有inner锁的情况下标记睡眠，避免放锁者的唤醒丢失
+            let irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
+            ProcessManager::mark_sleep(true).ok();
+            drop(irq_guard);
+            drop(inner);
+            sched();
+            woken = true;
+        }
     }
 
     /// @brief 放锁。
     ///
     /// 本函数只能是私有的，且只能被守卫的drop方法调用，否则将无法保证并发安全。
     fn unlock(&self) {
-        let mut inner: SpinLockGuard<MutexInner> = self.inner.lock();
+        let cur = self.owner.load(Ordering::Relaxed);
         // 当前mutex一定是已经加锁的状态
-        assert!(inner.is_locked);
-        // 标记mutex已经解锁
-        inner.is_locked = false;
-        if inner.wait_list.is_empty() {
+        assert!(cur & !MUTEX_FLAG_MASK != 0);
+
+        // 快速路径：没有等待者
+        if cur & MUTEX_FLAG_MASK == 0
+            && self
+                .owner
+                .compare_exchange(cur, 0, Ordering::Release, Ordering::Relaxed)
+                .is_ok()
+        {
             return;
         }
 
-        // wait_list不为空，则获取下一个要被唤醒的进程的pcb
-        let to_wakeup: Arc<ProcessControlBlock> = inner.wait_list.pop_front().unwrap();
-        drop(inner);
-
-        ProcessManager::wakeup(&to_wakeup).ok();
-    }
-
-    /// @brief 检查进程是否在该mutex的等待队列内
-    #[inline]
-    fn check_pid_in_wait_list(&self, inner: &MutexInner, pid: Pid) -> bool {
-        for p in inner.wait_list.iter() {
-            if p.pid() == pid {
-                // 在等待队列内
-                return true;
+        let mut inner: SpinLockGuard<MutexInner> = self.inner.lock();
+        let cur = self.owner.load(Ordering::Relaxed);
+        let to_wakeup = match inner.wait_list.front() {
+            Some(w) => w.clone(),
+            None => {
+                // 标记mutex已经解锁
+                self.owner.store(0, Ordering::Release);
+                return;
             }
+        };
+
+        if cur & MUTEX_FLAG_HANDOFF != 0 {
+            // 直接把锁交给请求移交的队首等待者，其他人无法在这期间抢到锁
+            inner.wait_list.pop_front();
+            to_wakeup.queued.store(false, Ordering::Relaxed);
+            let waiters = if inner.wait_list.is_empty() {
+                0
+            } else {
+                MUTEX_FLAG_WAITERS
+            };
+            self.owner.store(
+                Self::owner_id(to_wakeup.pcb.pid()) | waiters,
+                Ordering::Release,
+            );
+        } else {
+            // 队首仍留在队列中，由它在获得锁之后出队
+            self.owner.store(MUTEX_FLAG_WAITERS, Ordering::Release);
         }
+        drop(inner);
 
-        // 不在等待队列内
-        return false;
+        ProcessManager::wakeup(&to_wakeup.pcb).ok();
     }
 }
 
@@ -164,6 +340,7 @@ impl<T> DerefMut for MutexGuard<'_, T> {
 /// @brief 为MutexGuard实现Drop方法，那么，一旦守卫的生命周期结束，就会自动释放自旋锁，避免了忘记放锁的情况
 impl<T> Drop for MutexGuard<'_, T> {
     fn drop(&mut self) {
+        self.stat.release();
         self.lock.unlock();
     }
 }
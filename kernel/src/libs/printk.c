@@ -11,7 +11,9 @@
 #include <common/math.h>
 #include <common/string.h>
 
-static spinlock_t __printk_lock = {1};
+// 把文本写入内核日志缓冲区，由控制台线程异步输出（定义在libs/kmsg.rs）
+extern void rs_kmsg_write(const char *buf, int len, unsigned int FRcolor, unsigned int BKcolor);
+
 /**
  * @brief 将数字按照指定的要求转换成对应的字符串（2~36进制）
  *
@@ -593,29 +595,16 @@ static char *write_float_point_num(char *str, double num, int field_width, int p
  */
 int printk_color(unsigned int FRcolor, unsigned int BKcolor, const char *fmt, ...)
 {
-    uint64_t rflags;
-    io_mfence();
-    spin_lock_irqsave(&__printk_lock, rflags);
-    io_mfence();
     va_list args;
     va_start(args, fmt);
     char buf[4096]; // vsprintf()的缓冲区
     int len = vsprintf(buf, fmt, args);
 
     va_end(args);
-    unsigned char current;
 
-    int i; // 总共输出的字符数
-    for (i = 0; i < len; ++i)
-    {
-        current = *(buf + i);
-        // 输出
-        rs_textui_putchar(current, FRcolor, BKcolor);
-    }
-    io_mfence();
-    spin_unlock_irqrestore(&__printk_lock, rflags);
-    io_mfence();
-    return i;
+    // 日志缓冲区是无锁的，这里不需要再加锁
+    rs_kmsg_write(buf, len, FRcolor, BKcolor);
+    return len;
 }
 
 int sprintk(char *buf, const char *fmt, ...)
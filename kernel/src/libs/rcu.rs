@@ -0,0 +1,251 @@
+//! 基于静止状态（quiescent state）的RCU
+//!
+//! 读者通过`rcu_read_lock()`进入临界区，期间只关闭抢占，不写任何共享变量，因此读者之间可以完美扩展。
+//! 每个cpu在发生进程切换、或者时钟中断打断了一个不处于任何临界区（preempt count为0）的上下文时，
+//! 即经历了一次静止状态。写者发布新版本之后，旧版本要等到所有cpu都经历过一次静止状态（一个宽限期）后才能释放。
+//!
+//! ## 注意
+//!
+//! 读者临界区内不能睡眠，也不能主动调用调度函数。
+use core::{
+    fmt::Debug,
+    marker::PhantomData,
+    ops::Deref,
+    ptr::null_mut,
+    sync::atomic::{AtomicBool, AtomicPtr, AtomicUsize, Ordering},
+};
+
+use alloc::{boxed::Box, collections::LinkedList, sync::Arc};
+
+use crate::{
+    exception::softirq::{softirq_vectors, SoftirqNumber, SoftirqVec},
+    kinfo,
+    mm::percpu::PerCpu,
+    process::ProcessManager,
+    smp::core::smp_get_processor_id,
+};
+
+use super::spinlock::SpinLock;
+
+/// 最近一次开始的宽限期的编号
+static RCU_GP_SEQ: AtomicUsize = AtomicUsize::new(0);
+
+/// 每个cpu最近一次经历静止状态时，所看到的宽限期编号。
+/// 为usize::MAX表示该cpu尚未上线，不参与宽限期的判断。
+static RCU_CPU_QS: [AtomicUsize; PerCpu::MAX_CPU_NUM] = {
+    const OFFLINE: AtomicUsize = AtomicUsize::new(usize::MAX);
+    [OFFLINE; PerCpu::MAX_CPU_NUM]
+};
+
+/// 尚未执行的回调函数的数量
+static RCU_PENDING: AtomicUsize = AtomicUsize::new(0);
+/// RCU软中断是否已经注册
+static RCU_INITIALIZED: AtomicBool = AtomicBool::new(false);
+
+lazy_static! {
+    /// 等待宽限期结束的回调函数
+    static ref RCU_CALLBACKS: SpinLock<LinkedList<RcuCallback>> = SpinLock::new(LinkedList::new());
+}
+
+struct RcuCallback {
+    /// 当该编号的宽限期结束后，才能执行回调
+    gp_seq: usize,
+    func: Box<dyn FnOnce() + Send>,
+}
+
+/// RCU读者临界区的守卫。在守卫的生命周期内，当前cpu不会经历静止状态
+#[derive(Debug)]
+pub struct RcuReadGuard {
+    _private: (),
+}
+
+impl Drop for RcuReadGuard {
+    fn drop(&mut self) {
+        ProcessManager::preempt_enable();
+    }
+}
+
+/// 进入RCU读者临界区
+#[inline(always)]
+pub fn rcu_read_lock() -> RcuReadGuard {
+    ProcessManager::preempt_disable();
+    return RcuReadGuard { _private: () };
+}
+
+/// 报告当前cpu经历了一次静止状态
+///
+/// 只能在确定当前cpu不处于任何读者临界区时调用（例如进程切换时）
+#[inline]
+pub fn rcu_quiescent_state() {
+    let gp = RCU_GP_SEQ.load(Ordering::Acquire);
+    RCU_CPU_QS[smp_get_processor_id() as usize].store(gp, Ordering::Release);
+}
+
+/// 获取已经结束的宽限期的编号，即所有在线cpu看到的宽限期编号的最小值
+fn rcu_completed_gp() -> usize {
+    let mut completed = RCU_GP_SEQ.load(Ordering::Acquire);
+    for qs in RCU_CPU_QS.iter() {
+        let qs = qs.load(Ordering::Acquire);
+        if qs != usize::MAX && qs < completed {
+            completed = qs;
+        }
+    }
+    return completed;
+}
+
+/// 开始一个新的宽限期，返回它的编号
+#[inline]
+fn rcu_start_gp() -> usize {
+    return RCU_GP_SEQ.fetch_add(1, Ordering::AcqRel) + 1;
+}
+
+/// 时钟中断处理函数中调用，检查当前cpu是否处于静止状态，并在有待执行的回调时触发RCU软中断
+///
+/// 请注意，该函数只能被时钟中断处理程序调用
+pub fn rcu_check_callbacks() {
+    // 被打断的上下文没有关闭抢占，说明它不处于任何读者临界区
+    if ProcessManager::current_pcb().preempt_count() == 0 {
+        rcu_quiescent_state();
+    } else {
+        // 该cpu第一次参与宽限期的判断，但此刻可能正处于读者临界区内
+        RCU_CPU_QS[smp_get_processor_id() as usize]
+            .compare_exchange(usize::MAX, 0, Ordering::AcqRel, Ordering::Relaxed)
+            .ok();
+    }
+
+    if RCU_PENDING.load(Ordering::Relaxed) != 0 && RCU_INITIALIZED.load(Ordering::Acquire) {
+        softirq_vectors().raise_softirq(SoftirqNumber::RCU);
+    }
+}
+
+/// 在当前所有的读者都退出临界区之后，执行func
+///
+/// func会在软中断上下文中被执行，因此不能睡眠
+pub fn call_rcu(func: Box<dyn FnOnce() + Send>) {
+    let gp_seq = rcu_start_gp();
+    let mut callbacks = RCU_CALLBACKS.lock_irqsave();
+    callbacks.push_back(RcuCallback { gp_seq, func });
+    RCU_PENDING.fetch_add(1, Ordering::Relaxed);
+}
+
+/// 执行宽限期已经结束的回调函数
+fn rcu_do_callbacks() {
+    let completed = rcu_completed_gp();
+    let mut callbacks = RCU_CALLBACKS.lock_irqsave();
+    let ready: LinkedList<RcuCallback> = callbacks
+        .drain_filter(|cb| cb.gp_seq <= completed)
+        .collect();
+    drop(callbacks);
+
+    RCU_PENDING.fetch_sub(ready.len(), Ordering::Relaxed);
+    for cb in ready {
+        (cb.func)();
+    }
+}
+
+#[derive(Debug)]
+struct RcuSoftirq;
+
+impl SoftirqVec for RcuSoftirq {
+    fn run(&self) {
+        rcu_do_callbacks();
+    }
+}
+
+/// @brief 初始化RCU模块
+pub fn rcu_init() {
+    softirq_vectors()
+        .register_softirq(SoftirqNumber::RCU, Arc::new(RcuSoftirq))
+        .expect("Failed to register rcu softirq");
+    // 初始化时当前cpu显然不在读者临界区内，将其标记为在线
+    rcu_quiescent_state();
+    RCU_INITIALIZED.store(true, Ordering::Release);
+    kinfo!("RCU initialized.");
+}
+
+#[no_mangle]
+pub extern "C" fn rs_rcu_init() {
+    rcu_init();
+}
+
+/// 受RCU保护的数据
+///
+/// 读者通过`read()`无锁地获得当前版本的引用；写者通过`update()`以copy-on-write的方式发布新版本，
+/// 旧版本在宽限期结束后被释放。写者之间通过内部的自旋锁互斥。
+pub struct Rcu<T: Send + Sync + 'static> {
+    ptr: AtomicPtr<T>,
+    /// 写者之间互斥
+    writer: SpinLock<()>,
+    _marker: PhantomData<Box<T>>,
+}
+
+/// RCU保护的数据的引用，在其生命周期内处于读者临界区
+pub struct RcuRef<'a, T: 'a> {
+    data: &'a T,
+    _guard: RcuReadGuard,
+}
+
+impl<T> Deref for RcuRef<'_, T> {
+    type Target = T;
+
+    fn deref(&self) -> &Self::Target {
+        return self.data;
+    }
+}
+
+impl<T: Send + Sync + 'static> Rcu<T> {
+    pub fn new(value: T) -> Self {
+        return Self {
+            ptr: AtomicPtr::new(Box::into_raw(Box::new(value))),
+            writer: SpinLock::new(()),
+            _marker: PhantomData,
+        };
+    }
+
+    /// 获取当前版本的数据
+    #[inline(always)]
+    pub fn read(&self) -> RcuRef<T> {
+        let guard = rcu_read_lock();
+        let data = unsafe { &*self.ptr.load(Ordering::Acquire) };
+        return RcuRef {
+            data,
+            _guard: guard,
+        };
+    }
+
+    /// 根据当前版本生成新版本并发布
+    ///
+    /// ## 参数
+    ///
+    /// - `f` : 根据旧版本生成新版本的函数。该函数在持有写者锁的情况下执行，不能睡眠
+    pub fn update<F: FnOnce(&T) -> T>(&self, f: F) {
+        let writer = self.writer.lock();
+        let old = self.ptr.load(Ordering::Relaxed);
+        let new = Box::into_raw(Box::new(f(unsafe { &*old })));
+        self.ptr.store(new, Ordering::Release);
+        drop(writer);
+
+        let old = unsafe { Box::from_raw(old) };
+        call_rcu(Box::new(move || drop(old)));
+    }
+
+    /// 用新的值替换当前版本
+    pub fn replace(&self, value: T) {
+        self.update(|_| value);
+    }
+}
+
+impl<T: Send + Sync + 'static> Drop for Rcu<T> {
+    fn drop(&mut self) {
+        let ptr = self.ptr.swap(null_mut(), Ordering::AcqRel);
+        if !ptr.is_null() {
+            drop(unsafe { Box::from_raw(ptr) });
+        }
+    }
+}
+
+impl<T: Send + Sync + Debug + 'static> Debug for Rcu<T> {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        f.debug_struct("Rcu").field("data", &*self.read()).finish()
+    }
+}
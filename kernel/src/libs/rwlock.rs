@@ -10,6 +10,7 @@ use core::{
 use crate::{
     arch::CurrentIrqArch,
     exception::{InterruptArch, IrqFlagsGuard},
+    libs::lock_stat::{lock_stat_acquired, lock_stat_wait_start, LockKind, LockStatHold},
     process::ProcessManager,
     syscall::SystemError,
 };
@@ -44,6 +45,7 @@ pub struct RwLock<T> {
 pub struct RwLockReadGuard<'a, T: 'a> {
     data: *const T,
     lock: &'a AtomicU32,
+    stat: LockStatHold,
 }
 
 /// @brief UPGRADED是介于READER和WRITER之间的一种锁,它可以升级为WRITER,
@@ -53,6 +55,7 @@ pub struct RwLockReadGuard<'a, T: 'a> {
 pub struct RwLockUpgradableGuard<'a, T: 'a> {
     data: *const T,
     inner: &'a RwLock<T>,
+    stat: LockStatHold,
 }
 
 /// @brief WRITER守卫的数据结构
@@ -62,6 +65,8 @@ pub struct RwLockWriteGuard<'a, T: 'a> {
     data: *mut T,
     inner: &'a RwLock<T>,
     irq_guard: Option<IrqFlagsGuard>,
+    /// 用于统计持锁时间，见lock_stat模块
+    stat: LockStatHold,
 }
 
 unsafe impl<T: Send> Send for RwLock<T> {}
@@ -115,13 +120,20 @@ impl<T> RwLock<T> {
     #[allow(dead_code)]
     #[inline]
     /// @brief 尝试获取READER守卫
+    #[track_caller]
     pub fn try_read(&self) -> Option<RwLockReadGuard<T>> {
         ProcessManager::preempt_disable();
         let r = self.inner_try_read();
-        if r.is_none() {
-            ProcessManager::preempt_enable();
+        match r {
+            Some(mut guard) => {
+                guard.stat = lock_stat_acquired(LockKind::RwRead, None);
+                return Some(guard);
+            }
+            None => {
+                ProcessManager::preempt_enable();
+                return None;
+            }
         }
-        return r;
     }
 
     fn inner_try_read(&self) -> Option<RwLockReadGuard<T>> {
@@ -144,6 +156,7 @@ impl<T> RwLock<T> {
             return Some(RwLockReadGuard {
                 data: unsafe { &*self.data.get() },
                 lock: &self.lock,
+                stat: LockStatHold::NONE,
             });
         }
     }
@@ -151,12 +164,20 @@ impl<T> RwLock<T> {
     #[allow(dead_code)]
     #[inline]
     /// @brief 获得READER的守卫
+    #[track_caller]
     pub fn read(&self) -> RwLockReadGuard<T> {
+        let mut wait_start = None;
         loop {
-            match self.try_read() {
-                Some(guard) => return guard,
-                None => spin_loop(),
+            ProcessManager::preempt_disable();
+            if let Some(mut guard) = self.inner_try_read() {
+                guard.stat = lock_stat_acquired(LockKind::RwRead, wait_start);
+                return guard;
             }
+            ProcessManager::preempt_enable();
+            if wait_start.is_none() {
+                wait_start = Some(lock_stat_wait_start());
+            }
+            spin_loop();
         } //忙等待
     }
 
@@ -179,14 +200,20 @@ impl<T> RwLock<T> {
     #[allow(dead_code)]
     #[inline]
     /// @brief 尝试获得WRITER守卫
+    #[track_caller]
     pub fn try_write(&self) -> Option<RwLockWriteGuard<T>> {
         ProcessManager::preempt_disable();
         let r = self.inner_try_write();
-        if r.is_none() {
-            ProcessManager::preempt_enable();
+        match r {
+            Some(mut guard) => {
+                guard.stat = lock_stat_acquired(LockKind::RwWrite, None);
+                return Some(guard);
+            }
+            None => {
+                ProcessManager::preempt_enable();
+                return None;
+            }
         }
-
-        return r;
     } //当架构为arm时,有些代码需要作出调整compare_exchange=>compare_exchange_weak
 
     #[cfg(target_arch = "x86_64")]
@@ -202,6 +229,7 @@ impl<T> RwLock<T> {
                 data: unsafe { &mut *self.data.get() },
                 inner: self,
                 irq_guard: None,
+                stat: LockStatHold::NONE,
             });
         } else {
             return None;
@@ -211,42 +239,63 @@ impl<T> RwLock<T> {
     #[allow(dead_code)]
     #[inline]
     /// @brief 获得WRITER守卫
+    #[track_caller]
     pub fn write(&self) -> RwLockWriteGuard<T> {
+        let mut wait_start = None;
         loop {
-            match self.try_write() {
-                Some(guard) => return guard,
-                None => spin_loop(),
+            ProcessManager::preempt_disable();
+            if let Some(mut guard) = self.inner_try_write() {
+                guard.stat = lock_stat_acquired(LockKind::RwWrite, wait_start);
+                return guard;
+            }
+            ProcessManager::preempt_enable();
+            if wait_start.is_none() {
+                wait_start = Some(lock_stat_wait_start());
             }
+            spin_loop();
         }
     }
 
     #[allow(dead_code)]
     #[inline]
     /// @brief 获取WRITER守卫并关中断
+    #[track_caller]
     pub fn write_irqsave(&self) -> RwLockWriteGuard<T> {
+        let mut wait_start = None;
         loop {
             let irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
-            match self.try_write() {
-                Some(mut guard) => {
-                    guard.irq_guard = Some(irq_guard);
-                    return guard;
-                }
-                None => spin_loop(),
+            ProcessManager::preempt_disable();
+            if let Some(mut guard) = self.inner_try_write() {
+                guard.irq_guard = Some(irq_guard);
+                guard.stat = lock_stat_acquired(LockKind::RwWrite, wait_start);
+                return guard;
+            }
+            ProcessManager::preempt_enable();
+            drop(irq_guard);
+            if wait_start.is_none() {
+                wait_start = Some(lock_stat_wait_start());
             }
+            spin_loop();
         }
     }
 
     #[allow(dead_code)]
     #[inline]
     /// @brief 尝试获得UPGRADER守卫
+    #[track_caller]
     pub fn try_upgradeable_read(&self) -> Option<RwLockUpgradableGuard<T>> {
         ProcessManager::preempt_disable();
         let r = self.inner_try_upgradeable_read();
-        if r.is_none() {
-            ProcessManager::preempt_enable();
+        match r {
+            Some(mut guard) => {
+                guard.stat = lock_stat_acquired(LockKind::RwUpgradeable, None);
+                return Some(guard);
+            }
+            None => {
+                ProcessManager::preempt_enable();
+                return None;
+            }
         }
-
-        return r;
     }
 
     fn inner_try_upgradeable_read(&self) -> Option<RwLockUpgradableGuard<T>> {
@@ -256,6 +305,7 @@ impl<T> RwLock<T> {
             return Some(RwLockUpgradableGuard {
                 inner: self,
                 data: unsafe { &mut *self.data.get() },
+                stat: LockStatHold::NONE,
             });
         } else {
             return None;
@@ -265,12 +315,20 @@ impl<T> RwLock<T> {
     #[allow(dead_code)]
     #[inline]
     /// @brief 获得UPGRADER守卫
+    #[track_caller]
     pub fn upgradeable_read(&self) -> RwLockUpgradableGuard<T> {
+        let mut wait_start = None;
         loop {
-            match self.try_upgradeable_read() {
-                Some(guard) => return guard,
-                None => spin_loop(),
+            ProcessManager::preempt_disable();
+            if let Some(mut guard) = self.inner_try_upgradeable_read() {
+                guard.stat = lock_stat_acquired(LockKind::RwUpgradeable, wait_start);
+                return guard;
             }
+            ProcessManager::preempt_enable();
+            if wait_start.is_none() {
+                wait_start = Some(lock_stat_wait_start());
+            }
+            spin_loop();
         }
     }
 
@@ -350,6 +408,7 @@ impl<'rwlock, T> RwLockUpgradableGuard<'rwlock, T> {
                 data: unsafe { &mut *inner.data.get() },
                 inner,
                 irq_guard: None,
+                stat: LockStatHold::NONE,
             })
         } else {
             Err(self)
@@ -386,6 +445,7 @@ impl<'rwlock, T> RwLockUpgradableGuard<'rwlock, T> {
         RwLockReadGuard {
             data: unsafe { &*inner.data.get() },
             lock: &inner.lock,
+            stat: LockStatHold::NONE,
         }
     }
 
@@ -439,6 +499,7 @@ impl<'rwlock, T> RwLockWriteGuard<'rwlock, T> {
         return RwLockReadGuard {
             data: unsafe { &*inner.data.get() },
             lock: &inner.lock,
+            stat: LockStatHold::NONE,
         };
     }
 
@@ -460,6 +521,7 @@ impl<'rwlock, T> RwLockWriteGuard<'rwlock, T> {
         return RwLockUpgradableGuard {
             inner,
             data: unsafe { &*inner.data.get() },
+            stat: LockStatHold::NONE,
         };
     }
 }
@@ -497,6 +559,7 @@ impl<'rwlock, T> DerefMut for RwLockWriteGuard<'rwlock, T> {
 impl<'rwlock, T> Drop for RwLockReadGuard<'rwlock, T> {
     fn drop(&mut self) {
         debug_assert!(self.lock.load(Ordering::Relaxed) & !(WRITER | UPGRADED) > 0);
+        self.stat.release();
         self.lock.fetch_sub(READER, Ordering::Release);
         ProcessManager::preempt_enable();
     }
@@ -508,6 +571,7 @@ impl<'rwlock, T> Drop for RwLockUpgradableGuard<'rwlock, T> {
             self.inner.lock.load(Ordering::Relaxed) & (WRITER | UPGRADED),
             UPGRADED
         );
+        self.stat.release();
         self.inner.lock.fetch_sub(UPGRADED, Ordering::AcqRel);
         ProcessManager::preempt_enable();
         //这里为啥要AcqRel? Release应该就行了?
@@ -517,6 +581,7 @@ impl<'rwlock, T> Drop for RwLockUpgradableGuard<'rwlock, T> {
 impl<'rwlock, T> Drop for RwLockWriteGuard<'rwlock, T> {
     fn drop(&mut self) {
         debug_assert_eq!(self.inner.lock.load(Ordering::Relaxed) & WRITER, WRITER);
+        self.stat.release();
         self.inner
             .lock
             .fetch_and(!(WRITER | UPGRADED), Ordering::Release);
@@ -0,0 +1,132 @@
+//! 无锁的覆盖式环形缓冲区
+//!
+//! 每个元素带有一个全局递增的序列号：写者通过`fetch_add`领取序列号，从而得到环中的一个槽位，
+//! 写入期间槽位的状态为`2*seq+1`，写完之后变为`2*seq+2`（0表示从未被写入过）。
+//! 读者按序列号读取，像顺序锁一样在读取前后比较槽位的状态，从而检测到还没有写完、
+//! 或者已经被新一轮写者覆盖的元素。
+//!
+//! 写者之间不存在任何锁，写入只需要几次原子操作和一次内存拷贝，因此可以在任何上下文
+//! （包括中断上下文、持有调度器的锁时）中写入。缓冲区写满之后，新的元素覆盖最旧的元素。
+//!
+//! 内核日志（kmsg）和跟踪点的事件缓冲区都基于它实现。
+use core::{
+    cell::UnsafeCell,
+    sync::atomic::{fence, AtomicU64, Ordering},
+};
+
+/// 环形缓冲区中的一个槽位
+pub struct SeqRingSlot<T: Copy> {
+    /// 槽位的状态。序列号为seq的元素正在写入时为`2*seq+1`，写完之后为`2*seq+2`
+    state: AtomicU64,
+    data: UnsafeCell<T>,
+}
+
+unsafe impl<T: Copy + Send> Sync for SeqRingSlot<T> {}
+
+impl<T: Copy> SeqRingSlot<T> {
+    pub const fn new(value: T) -> Self {
+        return Self {
+            state: AtomicU64::new(0),
+            data: UnsafeCell::new(value),
+        };
+    }
+}
+
+/// 读取元素的结果
+pub enum SeqRingRead<T> {
+    Ok(T),
+    /// 元素还没有写完
+    Pending,
+    /// 元素已经被新一轮的写者覆盖
+    Lost,
+}
+
+/// 无锁的覆盖式环形缓冲区，见模块文档
+pub struct SeqRing<T: Copy + 'static> {
+    /// 下一个要分配的序列号
+    head: AtomicU64,
+    /// 槽位的数量必须是2的幂
+    slots: &'static [SeqRingSlot<T>],
+}
+
+impl<T: Copy + 'static> SeqRing<T> {
+    /// @brief 在给定的槽位上创建环形缓冲区
+    ///
+    /// ## Panic
+    ///
+    /// 槽位的数量不是2的幂时panic
+    pub const fn new(slots: &'static [SeqRingSlot<T>]) -> Self {
+        assert!(slots.len().is_power_of_two());
+        return Self {
+            head: AtomicU64::new(0),
+            slots,
+        };
+    }
+
+    /// 缓冲区能同时保存的元素个数
+    #[inline(always)]
+    pub fn capacity(&self) -> u64 {
+        return self.slots.len() as u64;
+    }
+
+    /// 下一个要分配的序列号（即已经写入过的元素的总数）
+    #[inline(always)]
+    pub fn head(&self) -> u64 {
+        return self.head.load(Ordering::Acquire);
+    }
+
+    /// 仍然保存在缓冲区中的最旧的元素的序列号
+    #[inline(always)]
+    pub fn oldest(&self) -> u64 {
+        return self.head().saturating_sub(self.capacity());
+    }
+
+    #[inline(always)]
+    fn slot(&self, seq: u64) -> &SeqRingSlot<T> {
+        return &self.slots[seq as usize & (self.slots.len() - 1)];
+    }
+
+    /// @brief 写入一个元素
+    ///
+    /// 该函数不加锁、不睡眠，可以在任何上下文中调用
+    ///
+    /// @return 元素的序列号
+    pub fn push(&self, value: &T) -> u64 {
+        let seq = self.head.fetch_add(1, Ordering::Relaxed);
+        let slot = self.slot(seq);
+        // 在极端情况下，一整圈之后的写者可能已经抢先占用了这个槽位，此时丢弃本元素
+        if slot.state.fetch_max(2 * seq + 1, Ordering::Acquire) >= 2 * seq + 1 {
+            return seq;
+        }
+        fence(Ordering::Release);
+
+        unsafe { core::ptr::write_volatile(slot.data.get(), *value) };
+
+        slot.state
+            .compare_exchange(
+                2 * seq + 1,
+                2 * seq + 2,
+                Ordering::Release,
+                Ordering::Relaxed,
+            )
+            .ok();
+        return seq;
+    }
+
+    /// @brief 读取序列号为seq的元素
+    pub fn load(&self, seq: u64) -> SeqRingRead<T> {
+        let slot = self.slot(seq);
+        let state = slot.state.load(Ordering::Acquire);
+        if state < 2 * seq + 2 {
+            return SeqRingRead::Pending;
+        } else if state > 2 * seq + 2 {
+            return SeqRingRead::Lost;
+        }
+        let data = unsafe { core::ptr::read_volatile(slot.data.get()) };
+        fence(Ordering::Acquire);
+        if slot.state.load(Ordering::Relaxed) != state {
+            return SeqRingRead::Lost;
+        }
+        return SeqRingRead::Ok(data);
+    }
+}
@@ -0,0 +1,105 @@
+use core::{
+    cell::UnsafeCell,
+    hint::spin_loop,
+    ops::{Deref, DerefMut},
+    sync::atomic::{fence, AtomicUsize, Ordering},
+};
+
+use super::spinlock::{SpinLock, SpinLockGuard};
+
+/// 顺序锁
+///
+/// 适用于读多写少、且数据可以按值拷贝的场景。读者不写任何共享变量，
+/// 只需在读取前后比较序列号，若期间发生了写入（或正在写入）则重试。
+/// 写者之间通过自旋锁互斥，并在写入期间保持序列号为奇数。
+#[derive(Debug)]
+pub struct SeqLock<T: Copy> {
+    /// 序列号，为奇数表示正在写入
+    seq: AtomicUsize,
+    /// 写者之间互斥
+    lock: SpinLock<()>,
+    data: UnsafeCell<T>,
+}
+
+/// SeqLock的写者守卫
+#[derive(Debug)]
+pub struct SeqLockWriteGuard<'a, T: Copy + 'a> {
+    lock: &'a SeqLock<T>,
+    _guard: SpinLockGuard<'a, ()>,
+}
+
+unsafe impl<T: Copy + Send> Sync for SeqLock<T> {}
+
+impl<T: Copy> SeqLock<T> {
+    pub const fn new(value: T) -> Self {
+        return Self {
+            seq: AtomicUsize::new(0),
+            lock: SpinLock::new(()),
+            data: UnsafeCell::new(value),
+        };
+    }
+
+    /// 开始一次读取，返回读取开始时的序列号
+    #[inline(always)]
+    pub fn read_begin(&self) -> usize {
+        loop {
+            let seq = self.seq.load(Ordering::Acquire);
+            if seq & 1 == 0 {
+                return seq;
+            }
+            spin_loop();
+        }
+    }
+
+    /// 检查从read_begin开始到现在，数据是否被修改过。若返回true，则需要重新读取
+    #[inline(always)]
+    pub fn read_retry(&self, seq: usize) -> bool {
+        fence(Ordering::Acquire);
+        return self.seq.load(Ordering::Relaxed) != seq;
+    }
+
+    /// 读取数据的一份一致的拷贝
+    #[inline(always)]
+    pub fn read(&self) -> T {
+        loop {
+            let seq = self.read_begin();
+            let value = unsafe { core::ptr::read_volatile(self.data.get()) };
+            if !self.read_retry(seq) {
+                return value;
+            }
+        }
+    }
+
+    /// 获取写者守卫
+    ///
+    /// 写入期间关闭中断，防止本cpu上的中断处理函数作为读者时永远等待写入完成
+    pub fn write(&self) -> SeqLockWriteGuard<T> {
+        let guard = self.lock.lock_irqsave();
+        self.seq.fetch_add(1, Ordering::Relaxed);
+        fence(Ordering::Release);
+        return SeqLockWriteGuard {
+            lock: self,
+            _guard: guard,
+        };
+    }
+}
+
+impl<T: Copy> Deref for SeqLockWriteGuard<'_, T> {
+    type Target = T;
+
+    fn deref(&self) -> &Self::Target {
+        return unsafe { &*self.lock.data.get() };
+    }
+}
+
+impl<T: Copy> DerefMut for SeqLockWriteGuard<'_, T> {
+    fn deref_mut(&mut self) -> &mut Self::Target {
+        return unsafe { &mut *self.lock.data.get() };
+    }
+}
+
+impl<T: Copy> Drop for SeqLockWriteGuard<'_, T> {
+    fn drop(&mut self) {
+        self.lock.seq.fetch_add(1, Ordering::Release);
+    }
+}
@@ -4,18 +4,30 @@ use core::hint::spin_loop;
 use core::mem::ManuallyDrop;
 use core::ops::{Deref, DerefMut};
 
-use core::sync::atomic::{AtomicBool, Ordering};
+use core::sync::atomic::{AtomicU16, Ordering};
 
 use crate::arch::CurrentIrqArch;
 use crate::exception::{InterruptArch, IrqFlagsGuard};
+use crate::libs::lock_stat::{lock_stat_acquired, lock_stat_wait_start, LockKind, LockStatHold};
 use crate::process::ProcessManager;
 use crate::syscall::SystemError;
 
+/// 等待者每排在前面一个票号，就多自旋这么多次pause再去读owner，减少对锁所在缓存行的争抢
+const SPIN_BACKOFF_UNIT: u16 = 32;
+/// 单次退避最多自旋的pause次数
+const SPIN_BACKOFF_MAX: u16 = 1024;
+
 /// 实现了守卫的SpinLock, 能够支持内部可变性
 ///
+/// 采用排队自旋锁（ticket lock）实现：加锁者原子地领取一个票号（next），
+/// 然后等待owner等于自己的票号。这样保证了先来先服务，
+/// 并且等待期间只读owner，不会像test-and-set那样不停地对同一缓存行发起写操作。
 #[derive(Debug)]
 pub struct SpinLock<T> {
-    lock: AtomicBool,
+    /// 当前持有锁的票号
+    owner: AtomicU16,
+    /// 下一个可领取的票号。当owner == next时，锁处于空闲状态
+    next: AtomicU16,
     /// 自旋锁保护的数据
     data: UnsafeCell<T>,
 }
@@ -29,6 +41,8 @@ pub struct SpinLockGuard<'a, T: 'a> {
     data: *mut T,
     irq_flag: Option<IrqFlagsGuard>,
     flags: SpinLockGuardFlags,
+    /// 用于统计持锁时间，见lock_stat模块
+    stat: LockStatHold,
 }
 
 impl<'a, T: 'a> SpinLockGuard<'a, T> {
@@ -62,42 +76,85 @@ unsafe impl<T> Sync for SpinLock<T> where T: Send {}
 impl<T> SpinLock<T> {
     pub const fn new(value: T) -> Self {
         return Self {
-            lock: AtomicBool::new(false),
+            owner: AtomicU16::new(0),
+            next: AtomicU16::new(0),
             data: UnsafeCell::new(value),
         };
     }
 
     #[inline(always)]
+    #[track_caller]
     pub fn lock(&self) -> SpinLockGuard<T> {
-        loop {
-            let res = self.try_lock();
-            if res.is_ok() {
-                return res.unwrap();
-            }
-            spin_loop();
-        }
+        // 先增加自旋锁持有计数。领取票号之后就不能放弃，因此不能像try_lock那样反复开关抢占
+        ProcessManager::preempt_disable();
+        let stat = self.inner_lock();
+        return SpinLockGuard {
+            lock: self,
+            data: unsafe { &mut *self.data.get() },
+            irq_flag: None,
+            flags: SpinLockGuardFlags::empty(),
+            stat,
+        };
     }
 
     /// 加锁，但是不更改preempt count
     #[inline(always)]
+    #[track_caller]
     pub fn lock_no_preempt(&self) -> SpinLockGuard<T> {
-        loop {
-            if let Ok(guard) = self.try_lock_no_preempt() {
-                return guard;
-            }
-            spin_loop();
-        }
+        let stat = self.inner_lock();
+        return SpinLockGuard {
+            lock: self,
+            data: unsafe { &mut *self.data.get() },
+            irq_flag: None,
+            flags: SpinLockGuardFlags::NO_PREEMPT,
+            stat,
+        };
     }
 
+    /// 保存中断状态，关闭中断，并加锁
+    ///
+    /// 等待期间中断保持关闭：如果持有票号时被中断，而中断处理函数又申请同一把锁，
+    /// 它会排在我们后面，从而造成死锁。
+    #[track_caller]
     pub fn lock_irqsave(&self) -> SpinLockGuard<T> {
+        let irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
+        ProcessManager::preempt_disable();
+        let stat = self.inner_lock();
+        return SpinLockGuard {
+            lock: self,
+            data: unsafe { &mut *self.data.get() },
+            irq_flag: Some(irq_guard),
+            flags: SpinLockGuardFlags::empty(),
+            stat,
+        };
+    }
+
+    /// 领取票号，并等待轮到自己
+    #[inline(always)]
+    #[track_caller]
+    fn inner_lock(&self) -> LockStatHold {
+        let ticket = self.next.fetch_add(1, Ordering::Relaxed);
+        if self.owner.load(Ordering::Acquire) == ticket {
+            return lock_stat_acquired(LockKind::Spin, None);
+        }
+        let wait_start = lock_stat_wait_start();
         loop {
-            if let Ok(guard) = self.try_lock_irqsave() {
-                return guard;
+            let owner = self.owner.load(Ordering::Acquire);
+            if owner == ticket {
+                return lock_stat_acquired(LockKind::Spin, Some(wait_start));
+            }
+            // 按照前面还有多少个等待者进行退避
+            let distance = ticket.wrapping_sub(owner);
+            let spins = distance
+                .saturating_mul(SPIN_BACKOFF_UNIT)
+                .min(SPIN_BACKOFF_MAX);
+            for _ in 0..spins {
+                spin_loop();
             }
-            spin_loop();
         }
     }
 
+    #[track_caller]
     pub fn try_lock(&self) -> Result<SpinLockGuard<T>, SystemError> {
         // 先增加自旋锁持有计数
         ProcessManager::preempt_disable();
@@ -108,6 +165,7 @@ impl<T> SpinLock<T> {
                 data: unsafe { &mut *self.data.get() },
                 irq_flag: None,
                 flags: SpinLockGuardFlags::empty(),
+                stat: lock_stat_acquired(LockKind::Spin, None),
             });
         }
 
@@ -117,14 +175,28 @@ impl<T> SpinLock<T> {
         return Err(SystemError::EAGAIN_OR_EWOULDBLOCK);
     }
 
+    /// 仅当锁空闲（next == owner）时领取票号
     fn inner_try_lock(&self) -> bool {
+        let owner = self.owner.load(Ordering::Relaxed);
         let res = self
-            .lock
-            .compare_exchange(false, true, Ordering::SeqCst, Ordering::SeqCst)
+            .next
+            .compare_exchange(
+                owner,
+                owner.wrapping_add(1),
+                Ordering::Acquire,
+                Ordering::Relaxed,
+            )
             .is_ok();
         return res;
     }
 
+    /// 判断自旋锁当前是否被持有
+    #[inline]
+    pub fn is_locked(&self) -> bool {
+        return self.owner.load(Ordering::Relaxed) != self.next.load(Ordering::Relaxed);
+    }
+
+    #[track_caller]
     pub fn try_lock_irqsave(&self) -> Result<SpinLockGuard<T>, SystemError> {
         let irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
         ProcessManager::preempt_disable();
@@ -134,6 +206,7 @@ impl<T> SpinLock<T> {
                 data: unsafe { &mut *self.data.get() },
                 irq_flag: Some(irq_guard),
                 flags: SpinLockGuardFlags::empty(),
+                stat: lock_stat_acquired(LockKind::Spin, None),
             });
         }
         ProcessManager::preempt_enable();
@@ -141,6 +214,7 @@ impl<T> SpinLock<T> {
         return Err(SystemError::EAGAIN_OR_EWOULDBLOCK);
     }
 
+    #[track_caller]
     pub fn try_lock_no_preempt(&self) -> Result<SpinLockGuard<T>, SystemError> {
         if self.inner_try_lock() {
             return Ok(SpinLockGuard {
@@ -148,6 +222,7 @@ impl<T> SpinLock<T> {
                 data: unsafe { &mut *self.data.get() },
                 irq_flag: None,
                 flags: SpinLockGuardFlags::NO_PREEMPT,
+                stat: lock_stat_acquired(LockKind::Spin, None),
             });
         }
         return Err(SystemError::EAGAIN_OR_EWOULDBLOCK);
@@ -160,11 +235,12 @@ impl<T> SpinLock<T> {
     /// 由于这样做可能导致preempt count不正确，因此必须小心的手动维护好preempt count。
     /// 如非必要，请不要使用这个函数。
     pub unsafe fn force_unlock(&self) {
-        self.lock.store(false, Ordering::SeqCst);
+        // 只有持锁者会修改owner，把锁交给下一个票号
+        self.owner.fetch_add(1, Ordering::Release);
     }
 
     fn unlock(&self) {
-        self.lock.store(false, Ordering::SeqCst);
+        self.owner.fetch_add(1, Ordering::Release);
         ProcessManager::preempt_enable();
     }
 }
@@ -188,6 +264,7 @@ impl<T> DerefMut for SpinLockGuard<'_, T> {
 /// @brief 为SpinLockGuard实现Drop方法，那么，一旦守卫的生命周期结束，就会自动释放自旋锁，避免了忘记放锁的情况
 impl<T> Drop for SpinLockGuard<'_, T> {
     fn drop(&mut self) {
+        self.stat.release();
         if self.flags.contains(SpinLockGuardFlags::NO_PREEMPT) {
             self.unlock_no_preempt();
         } else {
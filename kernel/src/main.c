@@ -31,10 +31,12 @@
 #include <time/timer.h>
 
 #include <driver/interrupt/apic/apic_timer.h>
+#include <common/crc_accel.h>
 
 extern int rs_device_init();
  extern int rs_tty_init();
 extern void rs_softirq_init();
+extern void rs_rcu_init();
 extern void rs_mm_init();
 extern int rs_video_init();
 extern void rs_kthread_init();
@@ -89,6 +91,8 @@ void system_initialize()
     // 初始化中断描述符表
     sys_vector_init();
     //  初始化内存管理单元
+    glib_mem_init();
+    crc_accel_init();
     // mm_init();
     rs_mm_init();
 
@@ -114,6 +118,7 @@ void system_initialize()
     io_mfence();
 
     rs_softirq_init();
+    rs_rcu_init();
 
     syscall_init();
     io_mfence();
@@ -65,6 +65,8 @@ impl<A> PageList<A> {
 pub struct BuddyAllocator<A> {
     // 存放每个阶的空闲“链表”的头部地址
     free_area: [PhysAddr; (MAX_ORDER - MIN_ORDER) as usize],
+    /// 初始化时交给buddy管理的总页数
+    total: PageFrameCount,
     phantom: PhantomData<A>,
 }
 
@@ -230,6 +232,7 @@ impl<A: MemoryManagementArch> BuddyAllocator<A> {
         // Self::print_free_area(free_area);
         let allocator = Self {
             free_area,
+            total: pages_to_buddy,
             phantom: PhantomData,
         };
 
@@ -662,7 +665,18 @@ impl<A: MemoryManagementArch> FrameAllocator for BuddyAllocator<A> {
     }
 
     unsafe fn usage(&self) -> PageFrameUsage {
-        todo!("BuddyAllocator::usage")
+        // 遍历每个阶的空闲链表，统计空闲的页数
+        let mut free = 0;
+        for (index, head) in self.free_area.iter().enumerate() {
+            let mut page = *head;
+            while !page.is_null() {
+                let page_list: PageList<A> = Self::read_page(page);
+                free += page_list.entry_num << index;
+                page = page_list.next_page;
+            }
+        }
+        let total = self.total.data();
+        return PageFrameUsage::new(PageFrameCount::new(total.saturating_sub(free)), self.total);
     }
 }
 
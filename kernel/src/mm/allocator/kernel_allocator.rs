@@ -8,6 +8,7 @@ use core::{
     alloc::{AllocError, GlobalAlloc, Layout},
     intrinsics::unlikely,
     ptr::NonNull,
+    sync::atomic::{AtomicUsize, Ordering},
 };
 
 use super::page_frame::{FrameAllocator, PageFrameCount};
@@ -19,6 +20,14 @@ pub trait LocalAlloc {
     unsafe fn local_dealloc(&self, ptr: *mut u8, layout: Layout);
 }
 
+/// 内核堆当前从buddy申请的页数
+static KERNEL_HEAP_PAGES: AtomicUsize = AtomicUsize::new(0);
+
+/// @brief 获取内核堆当前占用的页数
+pub fn kernel_heap_pages() -> usize {
+    return KERNEL_HEAP_PAGES.load(Ordering::Relaxed);
+}
+
 pub struct KernelAllocator;
 
 impl KernelAllocator {
@@ -29,6 +38,7 @@ impl KernelAllocator {
         let (phy_addr, allocated_frame_count) = LockedFrameAllocator
             .allocate(page_frame_count)
             .ok_or(AllocError)?;
+        KERNEL_HEAP_PAGES.fetch_add(allocated_frame_count.data(), Ordering::Relaxed);
 
         let virt_addr = unsafe { MMArch::phys_2_virt(phy_addr).ok_or(AllocError)? };
         if unlikely(virt_addr.is_null()) {
@@ -50,6 +60,7 @@ impl KernelAllocator {
         let page_frame_count = PageFrameCount::new(count);
         let phy_addr = MMArch::virt_2_phys(VirtAddr::new(ptr as usize)).unwrap();
         LockedFrameAllocator.free(phy_addr, page_frame_count);
+        KERNEL_HEAP_PAGES.fetch_sub(count, Ordering::Relaxed);
     }
 }
 
@@ -1,15 +1,14 @@
 //! 这是暴露给C的接口，用于在C语言中使用Rust的内存分配器。
 
-use core::intrinsics::unlikely;
+use core::{alloc::Layout, intrinsics::unlikely};
 
-use alloc::vec::Vec;
-use hashbrown::HashMap;
+use alloc::alloc::{alloc, alloc_zeroed, dealloc};
 
 use crate::{
     arch::mm::LowAddressRemapping,
     include::bindings::bindings::{gfp_t, PAGE_U_S},
     kerror,
-    libs::{align::page_align_up, spinlock::SpinLock},
+    libs::align::page_align_up,
     mm::MMArch,
     syscall::SystemError,
 };
@@ -19,11 +18,6 @@ use super::{
     page::PageFlags, MemoryManagementArch, PhysAddr, VirtAddr,
 };
 
-lazy_static! {
-    // 用于记录内核分配给C的空间信息
-    static ref C_ALLOCATION_MAP: SpinLock<HashMap<VirtAddr, (VirtAddr, usize, usize)>> = SpinLock::new(HashMap::new());
-}
-
 /// [EXTERN TO C] Use pseudo mapper to map physical memory to virtual memory.
 #[no_mangle]
 pub unsafe extern "C" fn rs_pseudo_map_phys(vaddr: usize, paddr: usize, size: usize) {
@@ -72,51 +66,74 @@ pub unsafe extern "C" fn kzalloc(size: usize, _gfp: gfp_t) -> usize {
 #[no_mangle]
 pub unsafe extern "C" fn kmalloc(size: usize, _gfp: gfp_t) -> usize {
     // kdebug!("kmalloc: size: {size}");
-    // 由于C代码不规范，因此都全部清空
-    return do_kmalloc(size, true);
+    return do_kmalloc(size, false);
 }
 
-fn do_kmalloc(size: usize, _zero: bool) -> usize {
-    let space: Vec<u8> = vec![0u8; size];
-
-    assert!(space.len() == size);
-    let (ptr, len, cap) = space.into_raw_parts();
-    if !ptr.is_null() {
-        let vaddr = VirtAddr::new(ptr as usize);
-        let len = len as usize;
-        let cap = cap as usize;
-        let mut guard = C_ALLOCATION_MAP.lock();
-        if unlikely(guard.contains_key(&vaddr)) {
-            drop(guard);
-            unsafe {
-                drop(Vec::from_raw_parts(vaddr.data() as *mut u8, len, cap));
-            }
-            panic!(
-                "do_kmalloc: vaddr {:?} already exists in C Allocation Map, query size: {size}, zero: {_zero}",
-                vaddr
-            );
-        }
-        // 插入到C Allocation Map中
-        guard.insert(vaddr, (vaddr, len, cap));
-        return vaddr.data();
+/// 分配给C的内存块前面的头部，记录分配时的大小，使得kfree不需要查表就能构造出Layout
+#[repr(C, align(16))]
+struct CAllocHeader {
+    /// 分配的总大小（包括头部）
+    size: usize,
+    /// 用于检查传给kfree的地址是否由kmalloc分配，以及是否被重复释放
+    magic: usize,
+}
+
+const C_ALLOC_MAGIC: usize = 0x4b4d_414c_4c4f_4321;
+const C_ALLOC_FREED: usize = 0x4b46_5245_4544_4421;
+/// C代码对kmalloc返回的地址的对齐要求（与头部的对齐相同）
+const C_ALLOC_ALIGN: usize = core::mem::align_of::<CAllocHeader>();
+const C_ALLOC_HEADER_SIZE: usize = core::mem::size_of::<CAllocHeader>();
+
+unsafe fn do_kmalloc(size: usize, zero: bool) -> usize {
+    let total = match size.checked_add(C_ALLOC_HEADER_SIZE) {
+        Some(total) => total,
+        None => return 0,
+    };
+    let layout = match Layout::from_size_align(total, C_ALLOC_ALIGN) {
+        Ok(layout) => layout,
+        Err(_) => return 0,
+    };
+    let ptr = if zero {
+        alloc_zeroed(layout)
     } else {
-        return SystemError::ENOMEM.to_posix_errno() as i64 as usize;
+        alloc(layout)
+    };
+    if unlikely(ptr.is_null()) {
+        return 0;
     }
+
+    let header = ptr as *mut CAllocHeader;
+    header.write(CAllocHeader {
+        size: total,
+        magic: C_ALLOC_MAGIC,
+    });
+    return ptr as usize + C_ALLOC_HEADER_SIZE;
 }
 
 #[no_mangle]
 pub unsafe extern "C" fn kfree(vaddr: usize) -> usize {
-    let vaddr = VirtAddr::new(vaddr);
-    let mut guard = C_ALLOCATION_MAP.lock();
-    let p = guard.remove(&vaddr);
-    drop(guard);
-
-    if p.is_none() {
-        kerror!("kfree: vaddr {:?} not found in C Allocation Map", vaddr);
+    if vaddr == 0 {
+        return 0;
+    }
+    if unlikely(vaddr < C_ALLOC_HEADER_SIZE || vaddr & (C_ALLOC_ALIGN - 1) != 0) {
+        kerror!("kfree: vaddr {:#x} is not allocated by kmalloc", vaddr);
         return SystemError::EINVAL.to_posix_errno() as i64 as usize;
     }
-    let (vaddr, len, cap) = p.unwrap();
-    drop(Vec::from_raw_parts(vaddr.data() as *mut u8, len, cap));
+    let header = (vaddr - C_ALLOC_HEADER_SIZE) as *mut CAllocHeader;
+    match (*header).magic {
+        C_ALLOC_MAGIC => {}
+        C_ALLOC_FREED => {
+            kerror!("kfree: double free of vaddr {:#x}", vaddr);
+            return SystemError::EINVAL.to_posix_errno() as i64 as usize;
+        }
+        _ => {
+            kerror!("kfree: vaddr {:#x} is not allocated by kmalloc", vaddr);
+            return SystemError::EINVAL.to_posix_errno() as i64 as usize;
+        }
+    }
+    (*header).magic = C_ALLOC_FREED;
+    let layout = Layout::from_size_align_unchecked((*header).size, C_ALLOC_ALIGN);
+    dealloc(header as *mut u8, layout);
     return 0;
 }
 
@@ -23,6 +23,7 @@ pub mod kernel_mapper;
 pub mod mmio_buddy;
 pub mod no_init;
 pub mod page;
+pub mod page_cache;
 pub mod percpu;
 pub mod syscall;
 pub mod ucontext;
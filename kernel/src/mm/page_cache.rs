@@ -0,0 +1,211 @@
+//! 文件页缓存
+//!
+//! 以(inode, 页号)为索引缓存文件的内容。同一个文件的同一页在内存中只有一份，
+//! exec时只读的程序段直接映射这些物理页，使得运行同一个程序的多个进程共享代码段，
+//! 并且再次exec时不需要重新读文件。
+//!
+//! 缓存中的页被`Arc<CachedPage>`引用计数：映射了它的VMA各持有一个引用，
+//! 最后一个引用被释放时，物理页才被归还给页分配器。
+use core::sync::atomic::{AtomicUsize, Ordering};
+
+use alloc::{collections::BTreeMap, sync::Arc, vec::Vec};
+
+use crate::{
+    arch::MMArch,
+    filesystem::vfs::{file::File, IndexNode},
+    libs::spinlock::SpinLock,
+    syscall::SystemError,
+    time::TimeSpec,
+};
+
+use super::{
+    allocator::page_frame::{
+        allocate_page_frames, deallocate_page_frames, PageFrameCount, PhysPageFrame,
+    },
+    MemoryManagementArch, PhysAddr,
+};
+
+/// 页缓存最多缓存的页数。超过之后，没有被任何进程映射的页会被回收
+const PAGE_CACHE_MAX_PAGES: usize = 4096;
+
+/// 页缓存中的页的总数
+static PAGE_CACHE_NR_PAGES: AtomicUsize = AtomicUsize::new(0);
+
+lazy_static! {
+    /// 每个文件的页缓存（以inode的地址为索引）
+    static ref PAGE_CACHE: SpinLock<BTreeMap<usize, FileCache>> = SpinLock::new(BTreeMap::new());
+}
+
+/// 页缓存中的一页
+#[derive(Debug)]
+pub struct CachedPage {
+    paddr: PhysAddr,
+}
+
+impl CachedPage {
+    /// 分配一个物理页，并用文件`offset`处的内容填充它（文件末尾之后的部分填0）
+    fn new(file: &mut File, offset: usize) -> Result<Arc<Self>, SystemError> {
+        let (paddr, _) =
+            unsafe { allocate_page_frames(PageFrameCount::new(1)) }.ok_or(SystemError::ENOMEM)?;
+        let page = Arc::new(Self { paddr });
+
+        let buf = unsafe {
+            let vaddr = MMArch::phys_2_virt(paddr).expect("Phys2Virt: vaddr overflow.");
+            MMArch::write_bytes(vaddr, 0, MMArch::PAGE_SIZE);
+            core::slice::from_raw_parts_mut(vaddr.data() as *mut u8, MMArch::PAGE_SIZE)
+        };
+        let inode = file.inode();
+        let mut filled = 0;
+        while filled < MMArch::PAGE_SIZE {
+            let len = inode.read_at(
+                offset + filled,
+                MMArch::PAGE_SIZE - filled,
+                &mut buf[filled..],
+                &mut file.private_data,
+            )?;
+            if len == 0 {
+                break;
+            }
+            filled += len;
+        }
+        return Ok(page);
+    }
+
+    #[inline(always)]
+    pub fn phys_address(&self) -> PhysAddr {
+        return self.paddr;
+    }
+}
+
+impl Drop for CachedPage {
+    fn drop(&mut self) {
+        unsafe { deallocate_page_frames(PhysPageFrame::new(self.paddr), PageFrameCount::new(1)) };
+    }
+}
+
+/// 一个文件的页缓存
+#[derive(Debug)]
+struct FileCache {
+    /// 持有inode的引用，保证作为索引的inode地址在缓存存在期间不会被复用
+    _inode: Arc<dyn IndexNode>,
+    /// 建立缓存时文件的修改时间和大小，任何一个发生变化都说明缓存已经失效
+    mtime: TimeSpec,
+    size: i64,
+    pages: BTreeMap<usize, Arc<CachedPage>>,
+}
+
+impl Drop for FileCache {
+    fn drop(&mut self) {
+        PAGE_CACHE_NR_PAGES.fetch_sub(self.pages.len(), Ordering::Relaxed);
+    }
+}
+
+#[inline(always)]
+fn inode_key(inode: &Arc<dyn IndexNode>) -> usize {
+    return Arc::as_ptr(inode) as *const u8 as usize;
+}
+
+/// @brief 获取文件中从`offset`开始的`count`个页的页缓存，不在缓存中的页会从文件中读取
+///
+/// ## 参数
+///
+/// - `file` : 要读取的文件
+/// - `offset` : 在文件中的偏移量，必须按页对齐
+/// - `count` : 页的数量
+pub fn page_cache_get_pages(
+    file: &mut File,
+    offset: usize,
+    count: usize,
+) -> Result<Vec<Arc<CachedPage>>, SystemError> {
+    if offset & MMArch::PAGE_OFFSET_MASK != 0 {
+        return Err(SystemError::EINVAL);
+    }
+    let inode = file.inode();
+    let key = inode_key(&inode);
+    let metadata = file.metadata()?;
+    let first_index = offset / MMArch::PAGE_SIZE;
+
+    let mut result = Vec::with_capacity(count);
+    for index in first_index..first_index + count {
+        let mut cache = PAGE_CACHE.lock();
+        let entry = cache.get(&key);
+        // 文件已经被修改，丢弃旧的缓存。已经映射了旧页的进程仍然持有它们的引用
+        let stale = if entry.map_or(false, |e| {
+            e.mtime != metadata.mtime || e.size != metadata.size
+        }) {
+            cache.remove(&key)
+        } else {
+            None
+        };
+        let cached = cache.get(&key).and_then(|e| e.pages.get(&index)).cloned();
+        drop(cache);
+        drop(stale);
+        if let Some(page) = cached {
+            result.push(page);
+            continue;
+        }
+
+        // 读文件可能会睡眠，因此不能持有锁
+        let page = CachedPage::new(file, index * MMArch::PAGE_SIZE)?;
+
+        let mut cache = PAGE_CACHE.lock();
+        let entry = cache.entry(key).or_insert_with(|| FileCache {
+            _inode: inode.clone(),
+            mtime: metadata.mtime,
+            size: metadata.size,
+            pages: BTreeMap::new(),
+        });
+        // 其他进程可能已经抢先把这一页读入了缓存
+        let page = entry
+            .pages
+            .entry(index)
+            .or_insert_with(|| {
+                PAGE_CACHE_NR_PAGES.fetch_add(1, Ordering::Relaxed);
+                page
+            })
+            .clone();
+        drop(cache);
+        result.push(page);
+    }
+
+    if PAGE_CACHE_NR_PAGES.load(Ordering::Relaxed) > PAGE_CACHE_MAX_PAGES {
+        page_cache_shrink();
+    }
+    return Ok(result);
+}
+
+/// @brief 获取页缓存中的页的总数
+pub fn page_cache_nr_pages() -> usize {
+    return PAGE_CACHE_NR_PAGES.load(Ordering::Relaxed);
+}
+
+/// @brief 丢弃文件的页缓存（文件被写入或者截断时调用）
+///
+/// 已经映射了缓存页的进程仍然会看到旧的内容，这与私有映射的语义一致
+pub fn page_cache_invalidate(inode: &Arc<dyn IndexNode>) {
+    let key = inode_key(inode);
+    let removed = PAGE_CACHE.lock().remove(&key);
+    // 在锁外释放，避免在持有锁时归还物理页
+    drop(removed);
+}
+
+/// @brief 回收没有被任何进程映射的缓存页
+fn page_cache_shrink() {
+    let mut cache = PAGE_CACHE.lock();
+    let mut freed: Vec<Arc<CachedPage>> = Vec::new();
+    for entry in cache.values_mut() {
+        let unused: Vec<usize> = entry
+            .pages
+            .iter()
+            .filter(|(_, page)| Arc::strong_count(page) == 1)
+            .map(|(index, _)| *index)
+            .collect();
+        for index in unused {
+            freed.push(entry.pages.remove(&index).unwrap());
+        }
+    }
+    cache.retain(|_, entry| !entry.pages.is_empty());
+    PAGE_CACHE_NR_PAGES.fetch_sub(freed.len(), Ordering::Relaxed);
+    drop(cache);
+    drop(freed);
+}
@@ -3,11 +3,11 @@
 #include "mm.h"
 
 /**
- * @brief 通用内存分配函数
+ * @brief 通用内存分配函数（不会清空内存，需要清空的请使用kzalloc）
  *
  * @param size 要分配的内存大小
  * @param gfp 内存的flag
- * @return void* 分配得到的内存的指针
+ * @return void* 分配得到的内存的指针（16字节对齐），失败时返回NULL
  */
 extern void *kmalloc(unsigned long size, gfp_t gfp);
 
@@ -23,7 +23,7 @@ extern void *kzalloc(size_t size, gfp_t gfp);
 /**
  * @brief 通用内存释放函数
  *
- * @param address 要释放的内存地址
+ * @param address 要释放的内存地址（为NULL时什么都不做）
  * @return unsigned long
  */
 extern unsigned long kfree(void *address);
@@ -32,6 +32,7 @@ use super::{
         deallocate_page_frames, PageFrameCount, PhysPageFrame, VirtPageFrame, VirtPageFrameIter,
     },
     page::{Flusher, InactiveFlusher, PageFlags, PageFlushAll},
+    page_cache::CachedPage,
     syscall::{MapFlags, ProtFlags},
     MemoryManagementArch, PageTableKind, VirtAddr, VirtRegion,
 };
@@ -163,10 +164,21 @@ impl InnerAddressSpace {
         let current_mapper = &mut self.user_mapper.utable;
 
         for vma in self.mappings.vmas.iter() {
-            // TODO: 增加对VMA是否为文件映射的判断，如果是的话，就跳过
-
             let vma_guard: SpinLockGuard<'_, VMA> = vma.lock();
             let old_flags = vma_guard.flags();
+
+            // 映射自页缓存的VMA是只读的，子进程直接映射同样的物理页，不需要拷贝
+            if vma_guard.is_shared() {
+                let new_vma = VMA::shared(
+                    VirtPageFrame::new(vma_guard.region.start()),
+                    vma_guard.shared_pages.clone(),
+                    old_flags,
+                    &mut new_guard.user_mapper.utable,
+                    (),
+                )?;
+                new_guard.mappings.vmas.insert(new_vma);
+                continue;
+            }
             let tmp_flags: PageFlags<MMArch> = PageFlags::new().set_write(true);
 
             // 分配内存页并创建新的VMA
@@ -282,6 +294,50 @@ impl InnerAddressSpace {
         return Ok(start_page);
     }
 
+    /// 把页缓存中的页映射到地址空间。这些页会与映射了同一文件的其他进程共享
+    ///
+    /// ## 参数
+    ///
+    /// - `start_vaddr`：映射的起始地址，需要按页对齐
+    /// - `pages`：要映射的页缓存页
+    /// - `prot_flags`：保护标志，不能包含`PROT_WRITE`
+    /// - `map_flags`：映射标志
+    ///
+    /// ## 返回
+    ///
+    /// 返回映射的起始虚拟页帧
+    pub fn map_page_cache(
+        &mut self,
+        start_vaddr: VirtAddr,
+        pages: Vec<Arc<CachedPage>>,
+        prot_flags: ProtFlags,
+        map_flags: MapFlags,
+    ) -> Result<VirtPageFrame, SystemError> {
+        // 共享的页不能被写入，否则会影响到其他进程
+        if prot_flags.contains(ProtFlags::PROT_WRITE) {
+            return Err(SystemError::EACCES);
+        }
+        let hint = if start_vaddr.data() == 0 {
+            None
+        } else {
+            Some(VirtAddr::new(
+                start_vaddr.data() & (!MMArch::PAGE_OFFSET_MASK),
+            ))
+        };
+
+        let start_page: VirtPageFrame = self.mmap(
+            hint,
+            PageFrameCount::new(pages.len()),
+            prot_flags,
+            map_flags,
+            move |page, _count, flags, mapper, flusher| {
+                Ok(VMA::shared(page, pages, flags, mapper, flusher)?)
+            },
+        )?;
+
+        return Ok(start_page);
+    }
+
     /// 向进程的地址空间映射页面
     ///
     /// # 参数
@@ -619,6 +675,24 @@ impl UserMappings {
         return None;
     }
 
+    /// 判断[vaddr, vaddr + len)是否全部位于可写的VMA中
+    pub fn is_writable(&self, vaddr: VirtAddr, len: usize) -> bool {
+        let end = vaddr.add(len);
+        let mut cur = vaddr;
+        while cur < end {
+            let vma = match self.contains(cur) {
+                Some(vma) => vma,
+                None => return false,
+            };
+            let guard = vma.lock();
+            if !guard.flags().has_write() {
+                return false;
+            }
+            cur = guard.region().end();
+        }
+        return true;
+    }
+
     /// 获取当前进程的地址空间中，与给定虚拟地址范围有重叠的VMA的迭代器。
     pub fn conflicts(&self, request: VirtRegion) -> impl Iterator<Item = Arc<LockedVMA>> + '_ {
         let r = self
@@ -847,10 +921,21 @@ impl LockedVMA {
     }
 
     pub fn unmap(&self, mapper: &mut PageMapper, mut flusher: impl Flusher<MMArch>) {
-        // todo: 如果当前vma与文件相关，完善文件相关的逻辑
-
         let mut guard = self.lock();
         assert!(guard.mapped);
+
+        // 映射自页缓存的页由页缓存管理，这里只解除映射并释放引用
+        if guard.is_shared() {
+            for page in guard.region.pages() {
+                let (_, _, flush) = unsafe { mapper.unmap_phys(page.virt_address(), true) }
+                    .expect("Failed to unmap, beacuse of some page is not mapped");
+                flusher.consume(flush);
+            }
+            guard.shared_pages.clear();
+            guard.mapped = false;
+            return;
+        }
+
         for page in guard.region.pages() {
             let (paddr, _, flush) = unsafe { mapper.unmap_phys(page.virt_address(), true) }
                 .expect("Failed to unmap, beacuse of some page is not mapped");
@@ -910,9 +995,25 @@ impl LockedVMA {
             }
         }
 
+        // 按照切分的位置，把页缓存页也分到三个VMA中
+        let mut shared_pages = core::mem::take(&mut guard.shared_pages);
+        let (before_shared, after_shared) = if shared_pages.is_empty() {
+            (Vec::new(), Vec::new())
+        } else {
+            let before_count = (region.start() - guard.region.start()) / MMArch::PAGE_SIZE;
+            let after_shared =
+                shared_pages.split_off(before_count + region.size() / MMArch::PAGE_SIZE);
+            let mid_shared = shared_pages.split_off(before_count);
+            (
+                core::mem::replace(&mut shared_pages, mid_shared),
+                after_shared,
+            )
+        };
+
         let before: Option<Arc<LockedVMA>> = guard.region.before(&region).map(|virt_region| {
             let mut vma: VMA = unsafe { guard.clone() };
             vma.region = virt_region;
+            vma.shared_pages = before_shared;
 
             let vma: Arc<LockedVMA> = LockedVMA::new(vma);
             vma
@@ -921,12 +1022,14 @@ impl LockedVMA {
         let after: Option<Arc<LockedVMA>> = guard.region.after(&region).map(|virt_region| {
             let mut vma: VMA = unsafe { guard.clone() };
             vma.region = virt_region;
+            vma.shared_pages = after_shared;
 
             let vma: Arc<LockedVMA> = LockedVMA::new(vma);
             vma
         });
 
         guard.region = region;
+        guard.shared_pages = shared_pages;
 
         // TODO: 重新设置before、after这两个VMA里面的物理页的anon_vma
 
@@ -946,6 +1049,8 @@ pub struct VMA {
     /// VMA所属的用户地址空间
     user_address_space: Option<Weak<AddressSpace>>,
     self_ref: Weak<LockedVMA>,
+    /// 映射自页缓存的页（按虚拟地址排列）。为空表示这是一个私有的VMA，其中的物理页归它自己所有
+    shared_pages: Vec<Arc<CachedPage>>,
 }
 
 impl core::hash::Hash for VMA {
@@ -974,9 +1079,16 @@ impl VMA {
             mapped: self.mapped,
             user_address_space: self.user_address_space.clone(),
             self_ref: self.self_ref.clone(),
+            shared_pages: self.shared_pages.clone(),
         };
     }
 
+    /// 当前VMA是否映射自页缓存
+    #[inline(always)]
+    pub fn is_shared(&self) -> bool {
+        return !self.shared_pages.is_empty();
+    }
+
     #[inline(always)]
     pub fn flags(&self) -> PageFlags<MMArch> {
         return self.flags;
@@ -1070,6 +1182,43 @@ impl VMA {
             mapped: true,
             user_address_space: None,
             self_ref: Weak::default(),
+            shared_pages: Vec::new(),
+        });
+        return Ok(r);
+    }
+
+    /// 把页缓存中的页映射到指定的虚拟地址，然后创建VMA
+    ///
+    /// @param destination 要映射到的虚拟地址
+    /// @param pages 要映射的页缓存页
+    /// @param flags 页面标志位，不能可写
+    /// @param mapper 页表映射器
+    /// @param flusher 页表项刷新器
+    ///
+    /// @return 返回映射后的虚拟内存区域
+    pub fn shared(
+        destination: VirtPageFrame,
+        pages: Vec<Arc<CachedPage>>,
+        flags: PageFlags<MMArch>,
+        mapper: &mut PageMapper,
+        mut flusher: impl Flusher<MMArch>,
+    ) -> Result<Arc<LockedVMA>, SystemError> {
+        assert!(!flags.has_write(), "Shared pages must not be writable");
+        let mut cur_dest = destination;
+        for page in pages.iter() {
+            let r = unsafe { mapper.map_phys(cur_dest.virt_address(), page.phys_address(), flags) }
+                .expect("Failed to map phys, may be OOM error");
+            flusher.consume(r);
+            cur_dest = cur_dest.next();
+        }
+
+        let r: Arc<LockedVMA> = LockedVMA::new(VMA {
+            region: VirtRegion::new(destination.virt_address(), pages.len() * MMArch::PAGE_SIZE),
+            flags,
+            mapped: true,
+            user_address_space: None,
+            self_ref: Weak::default(),
+            shared_pages: pages,
         });
         return Ok(r);
     }
@@ -1118,6 +1267,7 @@ impl VMA {
             mapped: true,
             user_address_space: None,
             self_ref: Weak::default(),
+            shared_pages: Vec::new(),
         });
         drop(flusher);
         // kdebug!("VMA::zeroed: flusher dropped");
@@ -1307,6 +1457,13 @@ impl UserStack {
         return self.current_sp;
     }
 
+    /// 判断地址是否位于用户栈（包括保护页）的范围内
+    pub fn contains(&self, addr: VirtAddr) -> bool {
+        let guard_size = Self::GUARD_PAGES_NUM * MMArch::PAGE_SIZE;
+        return addr >= self.stack_bottom - self.mapped_size
+            && addr < self.stack_bottom + guard_size;
+    }
+
     pub unsafe fn set_sp(&mut self, sp: VirtAddr) {
         self.current_sp = sp;
     }
@@ -5,7 +5,7 @@ use core::{
 
 use alloc::{boxed::Box, collections::BTreeMap, sync::Arc};
 
-use crate::{driver::net::NetDriver, kwarn, libs::rwlock::RwLock, syscall::SystemError};
+use crate::{driver::net::NetDriver, kwarn, libs::rcu::Rcu, syscall::SystemError};
 use smoltcp::wire::IpEndpoint;
 
 use self::socket::SocketMetadata;
@@ -17,7 +17,9 @@ pub mod syscall;
 
 lazy_static! {
     /// @brief 所有网络接口的列表
-    pub static ref NET_DRIVERS: RwLock<BTreeMap<usize, Arc<dyn NetDriver>>> = RwLock::new(BTreeMap::new());
+    ///
+    /// 每次轮询网卡都要读取这张表，而网卡只在初始化时注册，因此使用RCU保护
+    pub static ref NET_DRIVERS: Rcu<BTreeMap<usize, Arc<dyn NetDriver>>> = Rcu::new(BTreeMap::new());
 }
 
 /// @brief 生成网络接口的id (全局自增)
@@ -4,40 +4,36 @@ use smoltcp::{socket::dhcpv4, wire};
 use crate::{
     driver::net::NetDriver,
     kdebug, kinfo, kwarn,
-    libs::rwlock::RwLockReadGuard,
+    libs::rcu::RcuRef,
     net::NET_DRIVERS,
+    process::workqueue::{Work, SYSTEM_WQ},
     syscall::SystemError,
-    time::timer::{next_n_ms_timer_jiffies, Timer, TimerFunction},
+    trace_event,
 };
 
 use super::socket::{SOCKET_SET, SOCKET_WAITQUEUE};
 
-/// The network poll function, which will be called by timer.
+lazy_static! {
+    /// 网卡轮询工作。在工作队列的worker中（进程上下文）执行，而不是在定时器软中断中执行
+    static ref NET_POLL_WORK: Arc<Work> = Work::new(Box::new(net_poll_work));
+}
+
+/// The network poll function, which will be run by the system workqueue.
 ///
 /// The main purpose of this function is to poll all network interfaces.
-#[derive(Debug)]
-struct NetWorkPollFunc;
-
-impl TimerFunction for NetWorkPollFunc {
-    fn run(&mut self) -> Result<(), SystemError> {
-        poll_ifaces_try_lock(10).ok();
-        let next_time = next_n_ms_timer_jiffies(10);
-        let timer = Timer::new(Box::new(NetWorkPollFunc), next_time);
-        timer.activate();
-        return Ok(());
-    }
+fn net_poll_work() {
+    poll_ifaces();
+    SYSTEM_WQ.queue_delayed_work(NET_POLL_WORK.clone(), 10_000);
 }
 
 pub fn net_init() -> Result<(), SystemError> {
     dhcp_query()?;
-    // Init poll timer function
-    let next_time = next_n_ms_timer_jiffies(5);
-    let timer = Timer::new(Box::new(NetWorkPollFunc), next_time);
-    timer.activate();
+    // Init poll work
+    SYSTEM_WQ.queue_delayed_work(NET_POLL_WORK.clone(), 5_000);
     return Ok(());
 }
 fn dhcp_query() -> Result<(), SystemError> {
-    let binding = NET_DRIVERS.write();
+    let binding = NET_DRIVERS.read();
 
     let net_face = binding.get(&0).ok_or(SystemError::ENODEV)?.clone();
 
@@ -117,11 +113,12 @@ fn dhcp_query() -> Result<(), SystemError> {
 }
 
 pub fn poll_ifaces() {
-    let guard: RwLockReadGuard<BTreeMap<usize, Arc<dyn NetDriver>>> = NET_DRIVERS.read();
+    let guard: RcuRef<BTreeMap<usize, Arc<dyn NetDriver>>> = NET_DRIVERS.read();
     if guard.len() == 0 {
         kwarn!("poll_ifaces: No net driver found!");
         return;
     }
+    trace_event!(TP_NET_POLL_IFACES, guard.len());
     let mut sockets = SOCKET_SET.lock();
     for (_, iface) in guard.iter() {
         iface.poll(&mut sockets).ok();
@@ -137,7 +134,7 @@ pub fn poll_ifaces() {
 pub fn poll_ifaces_try_lock(times: u16) -> Result<(), SystemError> {
     let mut i = 0;
     while i < times {
-        let guard: RwLockReadGuard<BTreeMap<usize, Arc<dyn NetDriver>>> = NET_DRIVERS.read();
+        let guard: RcuRef<BTreeMap<usize, Arc<dyn NetDriver>>> = NET_DRIVERS.read();
         if guard.len() == 0 {
             kwarn!("poll_ifaces: No net driver found!");
             // 没有网卡，返回错误
@@ -1,8 +1,16 @@
 use alloc::{string::ToString, sync::Arc};
 
 use crate::{
-    arch::interrupt::TrapFrame, filesystem::procfs::procfs_register_pid, libs::rwlock::RwLock,
-    process::ProcessFlags, syscall::SystemError,
+    arch::{interrupt::TrapFrame, MMArch},
+    filesystem::procfs::procfs_register_pid,
+    libs::rwlock::RwLock,
+    mm::{MemoryManagementArch, VirtAddr},
+    process::ProcessFlags,
+    sched::completion::Completion,
+    syscall::{
+        user_access::{copy_to_user, verify_area_writable, verify_area_writable_locked},
+        SystemError,
+    },
 };
 
 use super::{
@@ -27,6 +35,73 @@ bitflags! {
         const CLONE_THREAD = (1 << 5);
         /// 共享打开的文件
         const CLONE_FILES = (1 << 6);
+        /// 为新线程设置TLS（x86_64下为fsbase）
+        const CLONE_SETTLS = (1 << 7);
+        /// 把子进程的tid写到父进程的parent_tid指针处
+        const CLONE_PARENT_SETTID = (1 << 8);
+        /// 把子进程的tid写到子进程的child_tid指针处
+        const CLONE_CHILD_SETTID = (1 << 9);
+        /// 子进程退出时，清零child_tid指针处的值，并在其上执行futex唤醒
+        const CLONE_CHILD_CLEARTID = (1 << 10);
+        /// 挂起父进程，直到子进程调用execve或者退出（与CLONE_VM一起使用时，即为vfork）
+        const CLONE_VFORK = (1 << 11);
+    }
+}
+
+/// 创建进程/线程时的参数
+#[derive(Debug, Clone, Copy)]
+pub struct KernelCloneArgs {
+    pub flags: CloneFlags,
+    /// 子进程的用户栈。为0时，使用与父进程相同的栈指针
+    pub stack: usize,
+    /// CLONE_PARENT_SETTID时，写入子进程tid的地址
+    pub parent_tid: VirtAddr,
+    /// CLONE_CHILD_SETTID/CLONE_CHILD_CLEARTID时，子进程tid的地址
+    pub child_tid: VirtAddr,
+    /// CLONE_SETTLS时，子进程的TLS
+    pub tls: usize,
+}
+
+impl KernelCloneArgs {
+    pub fn new(flags: CloneFlags) -> Self {
+        Self {
+            flags,
+            stack: 0,
+            parent_tid: VirtAddr::new(0),
+            child_tid: VirtAddr::new(0),
+            tls: 0,
+        }
+    }
+
+    /// 检查克隆参数的合法性
+    pub fn verify(&self) -> Result<(), SystemError> {
+        let flags = &self.flags;
+        // 线程必须与线程组共享信号处理结构体
+        if flags.contains(CloneFlags::CLONE_THREAD) && !flags.contains(CloneFlags::CLONE_SIGHAND) {
+            return Err(SystemError::EINVAL);
+        }
+        // 共享信号处理结构体，必须共享地址空间
+        if flags.contains(CloneFlags::CLONE_SIGHAND) && !flags.contains(CloneFlags::CLONE_VM) {
+            return Err(SystemError::EINVAL);
+        }
+        if flags.contains(CloneFlags::CLONE_PARENT_SETTID) {
+            Self::verify_tid_ptr(self.parent_tid)?;
+        }
+        if flags.intersects(CloneFlags::CLONE_CHILD_SETTID | CloneFlags::CLONE_CHILD_CLEARTID) {
+            Self::verify_tid_ptr(self.child_tid)?;
+        }
+        return Ok(());
+    }
+
+    /// 检查tid指针是否位于用户空间中可写的VMA内，并且按i32对齐。
+    ///
+    /// 子进程的地址空间是父进程的拷贝，因此在父进程中检查通过之后，子进程中也一定可写。
+    fn verify_tid_ptr(addr: VirtAddr) -> Result<(), SystemError> {
+        if !addr.check_aligned(core::mem::align_of::<i32>()) {
+            return Err(SystemError::EINVAL);
+        }
+        verify_area_writable(addr, core::mem::size_of::<i32>())?;
+        return Ok(());
     }
 }
 
@@ -50,6 +125,26 @@ impl ProcessManager {
         current_trapframe: &mut TrapFrame,
         clone_flags: CloneFlags,
     ) -> Result<Pid, SystemError> {
+        return Self::do_fork(current_trapframe, KernelCloneArgs::new(clone_flags));
+    }
+
+    /// 根据克隆参数，创建一个新进程或者线程
+    ///
+    /// ## 参数
+    ///
+    /// - `current_trapframe`: 当前进程的trapframe
+    /// - `clone_args`: 克隆参数
+    ///
+    /// ## 返回值
+    ///
+    /// - 成功：返回新进程的pid
+    /// - 失败：返回Err(SystemError)，fork失败的话，子线程不会执行。
+    pub fn do_fork(
+        current_trapframe: &mut TrapFrame,
+        clone_args: KernelCloneArgs,
+    ) -> Result<Pid, SystemError> {
+        clone_args.verify()?;
+        let clone_flags = clone_args.flags;
         let current_pcb = ProcessManager::current_pcb();
         let new_kstack = KernelStack::new()?;
         let name = current_pcb.basic().name().to_string();
@@ -89,14 +184,26 @@ impl ProcessManager {
 
         // todo: 拷贝信号相关数据
 
+        // 设置线程组与tid相关的信息。写入tid的地址由用户给出，失败时返回错误，新进程不会执行
+        ProcessManager::copy_thread_info(&clone_args, &current_pcb, &pcb)?;
+
         // 拷贝线程
-        ProcessManager::copy_thread(&clone_flags, &current_pcb, &pcb, &current_trapframe).unwrap_or_else(|e| {
+        ProcessManager::copy_thread(&clone_args, &current_pcb, &pcb, &current_trapframe).unwrap_or_else(|e| {
             panic!(
                 "fork: Failed to copy thread from current process, current pid: [{:?}], new pid: [{:?}]. Error: {:?}",
                 current_pcb.pid(), pcb.pid(), e
             )
         });
 
+        // vfork：子进程借用父进程的地址空间，父进程要等到子进程不再使用它之后才能继续运行
+        let vfork_done = if clone_flags.contains(CloneFlags::CLONE_VFORK) {
+            let vfork_done = Arc::new(Completion::new());
+            *pcb.vfork_done.lock_irqsave() = Some(vfork_done.clone());
+            Some(vfork_done)
+        } else {
+            None
+        };
+
         ProcessManager::add_pcb(pcb.clone());
 
         // 向procfs注册进程
@@ -116,6 +223,11 @@ impl ProcessManager {
             )
         });
 
+        if let Some(vfork_done) = vfork_done {
+            // 子进程execve或者退出之前，父进程不能返回用户态，否则两者会同时使用同一个用户栈
+            vfork_done.wait_for_completion_uninterruptible();
+        }
+
         return Ok(pcb.pid());
     }
 
@@ -123,10 +235,13 @@ impl ProcessManager {
         clone_flags: &CloneFlags,
         new_pcb: &Arc<ProcessControlBlock>,
     ) -> Result<(), SystemError> {
-        if clone_flags.contains(CloneFlags::CLONE_VM) {
+        *new_pcb.flags.lock() = ProcessManager::current_pcb().flags().clone();
+        // 线程本来就与线程组共享地址空间，不属于vfork
+        if clone_flags.contains(CloneFlags::CLONE_VM)
+            && !clone_flags.contains(CloneFlags::CLONE_THREAD)
+        {
             new_pcb.flags().insert(ProcessFlags::VFORK);
         }
-        *new_pcb.flags.lock() = ProcessManager::current_pcb().flags().clone();
         return Ok(());
     }
 
@@ -182,6 +297,7 @@ impl ProcessManager {
             let new_fd_table = current_pcb.basic().fd_table().unwrap().read().clone();
             let new_fd_table = Arc::new(RwLock::new(new_fd_table));
             new_pcb.basic_mut().set_fd_table(Some(new_fd_table));
+            return Ok(());
         }
 
         // 如果共享文件描述符表，则直接拷贝指针
@@ -192,6 +308,63 @@ impl ProcessManager {
         return Ok(());
     }
 
+    /// 设置新进程的线程组，并处理CLONE_*_SETTID/CLONE_CHILD_CLEARTID
+    fn copy_thread_info(
+        clone_args: &KernelCloneArgs,
+        current_pcb: &Arc<ProcessControlBlock>,
+        new_pcb: &Arc<ProcessControlBlock>,
+    ) -> Result<(), SystemError> {
+        let clone_flags = &clone_args.flags;
+        let mut thread_info = new_pcb.thread_info_mut();
+        if clone_flags.contains(CloneFlags::CLONE_THREAD) {
+            let current_thread_info = current_pcb.thread_info();
+            thread_info.group_leader = current_thread_info.group_leader.clone();
+            thread_info.tgid = current_thread_info.tgid;
+        }
+
+        if clone_flags.contains(CloneFlags::CLONE_CHILD_CLEARTID) {
+            thread_info.clear_child_tid = Some(clone_args.child_tid);
+        }
+        drop(thread_info);
+
+        let tid = new_pcb.pid().into() as i32;
+        if clone_flags.contains(CloneFlags::CLONE_PARENT_SETTID) {
+            unsafe { copy_to_user(clone_args.parent_tid, &tid.to_ne_bytes())? };
+        }
+
+        if clone_flags.contains(CloneFlags::CLONE_CHILD_SETTID) {
+            if clone_flags.contains(CloneFlags::CLONE_VM) {
+                unsafe { copy_to_user(clone_args.child_tid, &tid.to_ne_bytes())? };
+            } else {
+                // 子进程拥有独立的地址空间，需要写到子进程的物理页中。
+                // 直接写物理页会绕过页表的写保护，因此先确认child_tid位于子进程中可写的VMA内：
+                // 可写的VMA在fork时被逐页拷贝，这个物理页只属于子进程
+                let addr_space = new_pcb.basic().user_vm().ok_or(SystemError::EFAULT)?;
+                let guard = addr_space.read();
+                verify_area_writable_locked(
+                    &guard,
+                    clone_args.child_tid,
+                    core::mem::size_of::<i32>(),
+                )?;
+                let page_vaddr =
+                    VirtAddr::new(clone_args.child_tid.data() & !MMArch::PAGE_OFFSET_MASK);
+                let (paddr, flags) = guard
+                    .user_mapper
+                    .utable
+                    .translate(page_vaddr)
+                    .ok_or(SystemError::EFAULT)?;
+                if !flags.has_write() {
+                    return Err(SystemError::EFAULT);
+                }
+                let offset = clone_args.child_tid.data() & MMArch::PAGE_OFFSET_MASK;
+                let vaddr =
+                    unsafe { MMArch::phys_2_virt(paddr + offset) }.ok_or(SystemError::EFAULT)?;
+                unsafe { *(vaddr.data() as *mut i32) = tid };
+            }
+        }
+        return Ok(());
+    }
+
     #[allow(dead_code)]
     fn copy_sighand(
         _clone_flags: &CloneFlags,
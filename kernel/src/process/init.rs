@@ -5,14 +5,22 @@ use alloc::string::String;
 use crate::{
     arch::process::arch_switch_to_user,
     driver::{disk::ahci::ahci_init, virtio::virtio::virtio_probe},
+    exception::{irq::irq_thread_init, softirq::ksoftirqd_init},
     filesystem::vfs::core::mount_root_fs,
     kdebug, kerror,
+    libs::kmsg::kmsg_console_init,
     net::net_core::net_init,
-    process::{kthread::KernelThreadMechanism, process::stdio_init},
+    process::{kthread::KernelThreadMechanism, process::stdio_init, workqueue::workqueue_init},
+    sched::loadavg::loadavg_init,
 };
 
 pub fn initial_kernel_thread() -> i32 {
     KernelThreadMechanism::init_stage2();
+    ksoftirqd_init();
+    workqueue_init();
+    loadavg_init();
+    irq_thread_init();
+    kmsg_console_init();
     // 由于目前加锁，速度过慢，所以先不开启双缓冲
     // scm_enable_double_buffer().expect("Failed to enable double buffer");
     stdio_init().expect("Failed to initialize stdio");
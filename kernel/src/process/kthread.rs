@@ -295,6 +295,11 @@ impl KernelThreadMechanism {
         });
     }
 
+    /// kthreadd是否已经启动，即是否已经可以创建内核线程
+    pub fn daemon_started() -> bool {
+        return unsafe { KTHREAD_DAEMON_PCB.is_some() };
+    }
+
     /// 创建一个新的内核线程
     ///
     /// ## 参数
@@ -414,6 +419,48 @@ impl KernelThreadMechanism {
             .contains(KernelThreadFlags::SHOULD_STOP);
     }
 
+    /// 将内核线程绑定到指定的cpu上运行，此后它不再参与负载均衡
+    ///
+    /// ## 参数
+    ///
+    /// - pcb: 目标内核线程的PCB
+    /// - cpu_id: 要绑定到的cpu
+    ///
+    /// ## Panic
+    ///
+    /// 如果目标进程不是内核线程，会panic
+    pub fn bind(pcb: &Arc<ProcessControlBlock>, cpu_id: u32) {
+        if !pcb.flags().contains(ProcessFlags::KTHREAD) {
+            panic!("Cannt bind a non-kthread process");
+        }
+
+        let mut worker_private = pcb.worker_private();
+        assert!(
+            worker_private.is_some(),
+            "kthread bind: worker_private is none, pid: {:?}",
+            pcb.pid()
+        );
+        worker_private
+            .as_mut()
+            .unwrap()
+            .kernel_thread_mut()
+            .expect("Error type of worker private")
+            .flags
+            .insert(KernelThreadFlags::IS_PER_CPU);
+        drop(worker_private);
+        pcb.per_cpu.store(true, Ordering::Release);
+
+        // 在下一次加入调度队列时迁移到目标cpu
+        pcb.sched_info().set_migrate_to(Some(cpu_id));
+        pcb.flags().insert(ProcessFlags::NEED_MIGRATE);
+    }
+
+    /// 判断一个进程是否为绑定到某个cpu上的内核线程
+    #[inline(always)]
+    pub fn is_per_cpu(pcb: &Arc<ProcessControlBlock>) -> bool {
+        return pcb.is_per_cpu();
+    }
+
     /// A daemon thread which creates other kernel threads
     fn kthread_daemon() -> i32 {
         let current_pcb = ProcessManager::current_pcb();
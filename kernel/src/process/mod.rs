@@ -1,7 +1,7 @@
 use core::{
     hash::{Hash, Hasher},
     intrinsics::{likely, unlikely},
-    mem::ManuallyDrop,
+    mem::{size_of, ManuallyDrop},
     sync::atomic::{compiler_fence, AtomicBool, AtomicI32, AtomicIsize, AtomicUsize, Ordering},
 };
 
@@ -23,21 +23,32 @@ use crate::{
     libs::{
         align::AlignedBox,
         casting::DowncastArc,
+        futex::{constant::FUTEX_BITSET_MATCH_ANY, futex::Futex},
+        rcu::{rcu_quiescent_state, Rcu},
         rwlock::{RwLock, RwLockReadGuard, RwLockWriteGuard},
         spinlock::{SpinLock, SpinLockGuard},
         wait_queue::WaitQueue,
     },
-    mm::{percpu::PerCpuVar, set_INITIAL_PROCESS_ADDRESS_SPACE, ucontext::AddressSpace, VirtAddr},
+    mm::{
+        percpu::PerCpuVar, set_INITIAL_PROCESS_ADDRESS_SPACE, ucontext::AddressSpace, verify_area,
+        VirtAddr,
+    },
     net::socket::SocketInode,
     sched::{
+        completion::Completion,
         core::{sched_enqueue, CPU_EXECUTING},
+        cputime::ProcessCpuTime,
         SchedPolicy, SchedPriority,
     },
     smp::kick_cpu,
-    syscall::SystemError,
+    syscall::{stats::ProcessSyscallStats, user_access::clear_user, SystemError},
+    time::timer::clock,
 };
 
-use self::kthread::WorkerPrivate;
+use self::{
+    kthread::WorkerPrivate,
+    workqueue::{wq_worker_sleeping, wq_worker_waking_up},
+};
 
 pub mod abi;
 pub mod c_adapter;
@@ -48,9 +59,72 @@ pub mod init;
 pub mod kthread;
 pub mod process;
 pub mod syscall;
+pub mod workqueue;
+
+lazy_static! {
+    /// 系统中所有进程的pcb
+    static ref ALL_PROCESS: PidHash = PidHash::new();
+}
+
+/// 进程哈希表中桶的数量
+const PID_HASH_BUCKETS: usize = 256;
+
+/// 按pid散列的进程哈希表
+///
+/// 查找进程远比创建、销毁进程频繁，因此每个桶由RCU保护：查找时无锁，
+/// 增删进程时只复制pid所在的那个桶（通常只有一两个进程），而不是整张表
+struct PidHash {
+    buckets: [Rcu<Vec<Arc<ProcessControlBlock>>>; PID_HASH_BUCKETS],
+}
+
+impl PidHash {
+    fn new() -> Self {
+        return Self {
+            buckets: core::array::from_fn(|_| Rcu::new(Vec::new())),
+        };
+    }
+
+    #[inline(always)]
+    fn bucket(&self, pid: Pid) -> &Rcu<Vec<Arc<ProcessControlBlock>>> {
+        return &self.buckets[pid.into() % PID_HASH_BUCKETS];
+    }
+
+    fn find(&self, pid: Pid) -> Option<Arc<ProcessControlBlock>> {
+        return self
+            .bucket(pid)
+            .read()
+            .iter()
+            .find(|pcb| pcb.pid() == pid)
+            .cloned();
+    }
+
+    fn insert(&self, pcb: Arc<ProcessControlBlock>) {
+        let pid = pcb.pid();
+        self.bucket(pid).update(|bucket| {
+            let mut bucket: Vec<Arc<ProcessControlBlock>> =
+                bucket.iter().filter(|p| p.pid() != pid).cloned().collect();
+            bucket.push(pcb);
+            bucket
+        });
+    }
 
-/// 系统中所有进程的pcb
-static ALL_PROCESS: SpinLock<Option<HashMap<Pid, Arc<ProcessControlBlock>>>> = SpinLock::new(None);
+    fn remove(&self, pid: Pid) {
+        self.bucket(pid)
+            .update(|bucket| bucket.iter().filter(|p| p.pid() != pid).cloned().collect());
+    }
+
+    fn len(&self) -> usize {
+        return self.buckets.iter().map(|b| b.read().len()).sum();
+    }
+
+    fn pids(&self) -> Vec<Pid> {
+        let mut pids = Vec::new();
+        for bucket in self.buckets.iter() {
+            pids.extend(bucket.read().iter().map(|pcb| pcb.pid()));
+        }
+        return pids;
+    }
+}
 
 pub static mut SWITCH_RESULT: Option<PerCpuVar<SwitchResult>> = None;
 
@@ -95,7 +169,6 @@ impl ProcessManager {
             compiler_fence(Ordering::SeqCst);
         };
 
-        ALL_PROCESS.lock().replace(HashMap::new());
         Self::arch_init();
         kdebug!("process arch init done.");
         Self::init_idle();
@@ -138,7 +211,17 @@ impl ProcessManager {
     ///
     /// 如果找到了对应的进程，那么返回该进程的pcb，否则返回None
     pub fn find(pid: Pid) -> Option<Arc<ProcessControlBlock>> {
-        return ALL_PROCESS.lock().as_ref()?.get(&pid).cloned();
+        return ALL_PROCESS.find(pid);
+    }
+
+    /// 获取系统中进程的数量（不包括idle进程）
+    pub fn process_count() -> usize {
+        return ALL_PROCESS.len();
+    }
+
+    /// 获取系统中所有进程的pid
+    pub fn all_pids() -> Vec<Pid> {
+        return ALL_PROCESS.pids();
     }
 
     /// 向系统中添加一个进程的pcb
@@ -151,11 +234,12 @@ impl ProcessManager {
     ///
     /// 无
     pub fn add_pcb(pcb: Arc<ProcessControlBlock>) {
-        ALL_PROCESS
-            .lock()
-            .as_mut()
-            .unwrap()
-            .insert(pcb.pid(), pcb.clone());
+        ALL_PROCESS.insert(pcb);
+    }
+
+    /// 从系统中移除一个进程的pcb
+    fn remove_pcb(pid: Pid) {
+        ALL_PROCESS.remove(pid);
     }
 
     /// 唤醒一个进程
@@ -170,6 +254,10 @@ impl ProcessManager {
                 // avoid deadlock
                 drop(writer);
 
+                if pcb.flags().contains(ProcessFlags::WQ_WORKER) {
+                    wq_worker_waking_up(pcb);
+                }
+
                 sched_enqueue(pcb.clone(), true);
                 return Ok(());
             } else if state.is_exited() {
@@ -204,6 +292,10 @@ impl ProcessManager {
             pcb.flags().insert(ProcessFlags::NEED_SCHEDULE);
             drop(writer);
 
+            // worker即将阻塞，必要时让同一pool中的其他worker接手剩余的工作
+            if pcb.flags().contains(ProcessFlags::WQ_WORKER) {
+                wq_worker_sleeping(&pcb);
+            }
             return Ok(());
         }
         return Err(SystemError::EINTR);
@@ -229,6 +321,12 @@ impl ProcessManager {
     ///
     /// - `exit_code` : 进程的退出码
     pub fn exit(exit_code: usize) -> ! {
+        ProcessManager::exit_clear_child_tid();
+        ProcessManager::complete_vfork_done();
+        let is_thread = ProcessManager::current_pcb().is_thread();
+        if is_thread {
+            ProcessManager::release_thread();
+        }
         // 关中断
         let irq_guard = unsafe { CurrentIrqArch::save_and_disable_irq() };
         let pcb = ProcessManager::current_pcb();
@@ -237,12 +335,93 @@ impl ProcessManager {
             .set_state(ProcessState::Exited(exit_code));
         pcb.wait_queue.wakeup(Some(ProcessState::Blocked(true)));
         drop(pcb);
-        ProcessManager::exit_notify();
+        if !is_thread {
+            ProcessManager::exit_notify();
+        }
         drop(irq_guard);
         sched();
         loop {}
     }
 
+    /// 退出当前线程组中的所有线程（exit_group）
+    ///
+    /// 组中的其他线程被标记为正在退出并被唤醒，它们在下一次返回用户态时退出。
+    /// 组长的退出码为exit_code，由父进程通过wait()获取
+    ///
+    /// ## 参数
+    ///
+    /// - `exit_code` : 线程组的退出码
+    pub fn exit_group(exit_code: usize) -> ! {
+        let current = ProcessManager::current_pcb();
+        let tgid = current.tgid();
+        for pid in ProcessManager::all_pids() {
+            let pcb = match ProcessManager::find(pid) {
+                Some(pcb) => pcb,
+                None => continue,
+            };
+            if pcb.tgid() != tgid || Arc::ptr_eq(&pcb, &current) {
+                continue;
+            }
+            pcb.thread_info_mut().group_exit_code = Some(exit_code);
+            pcb.flags().insert(ProcessFlags::EXITING);
+            // 在可中断的睡眠中的线程会被唤醒，系统调用返回后即退出；
+            // 正在其他cpu上运行用户态代码的线程会在下一次时钟中断返回时退出
+            ProcessManager::wakeup(&pcb).ok();
+        }
+        drop(current);
+        ProcessManager::exit(exit_code);
+    }
+
+    /// 返回用户态之前调用：如果线程组正在退出（其他线程调用了exit_group），则退出当前线程
+    pub fn exit_if_group_exiting() {
+        let pcb = ProcessManager::current_pcb();
+        if likely(!pcb.flags().contains(ProcessFlags::EXITING)) {
+            return;
+        }
+        let exit_code = pcb.thread_info().group_exit_code.unwrap_or(0);
+        drop(pcb);
+        ProcessManager::exit(exit_code);
+    }
+
+    /// 线程（线程组中除组长之外的线程）退出时回收自身
+    ///
+    /// 子进程交给INIT进程收养，然后把自己从父进程的子进程表、全局的进程表以及procfs中移除。
+    /// 线程不会向父进程发出通知，也不会成为等待wait()收集的僵尸进程
+    fn release_thread() {
+        let current = ProcessManager::current_pcb();
+        unsafe { current.adopt_childen().ok() };
+        if let Some(ppcb) = current.parent_pcb.read().upgrade() {
+            ppcb.children.write().remove(&current.pid());
+        }
+        ProcessManager::remove_pcb(current.pid());
+        procfs_unregister_pid(current.pid()).ok();
+    }
+
+    /// 当前进程不再使用从vfork的父进程借来的地址空间（execve或者退出时调用），唤醒被挂起的父进程
+    pub fn complete_vfork_done() {
+        let pcb = ProcessManager::current_pcb();
+        let vfork_done = pcb.vfork_done.lock_irqsave().take();
+        if let Some(vfork_done) = vfork_done {
+            pcb.flags().remove(ProcessFlags::VFORK);
+            vfork_done.complete();
+        }
+    }
+
+    /// 如果当前线程设置了clear_child_tid，则把该地址清零，并唤醒在其上等待的线程（用于实现pthread_join）
+    fn exit_clear_child_tid() {
+        let pcb = ProcessManager::current_pcb();
+        let clear_child_tid = pcb.thread_info_mut().clear_child_tid.take();
+        if let Some(addr) = clear_child_tid {
+            if pcb.basic().user_vm().is_none() || verify_area(addr, size_of::<i32>()).is_err() {
+                return;
+            }
+            unsafe { clear_user(addr, size_of::<i32>()).ok() };
+            // 等待者可能使用私有futex，也可能使用共享futex，因此两种都需要唤醒
+            Futex::futex_wake(addr, true, 1, FUTEX_BITSET_MATCH_ANY).ok();
+            Futex::futex_wake(addr, false, 1, FUTEX_BITSET_MATCH_ANY).ok();
+        }
+    }
+
     pub unsafe fn release(pid: Pid) {
         let pcb = ProcessManager::find(pid);
         if !pcb.is_none() {
@@ -250,7 +429,7 @@ impl ProcessManager {
             // 判断该pcb是否在全局没有任何引用
             if Arc::strong_count(&pcb) <= 1 {
                 drop(pcb);
-                ALL_PROCESS.lock().as_mut().unwrap().remove(&pid);
+                ProcessManager::remove_pcb(pid);
             } else {
                 // 如果不为1就panic
                 panic!("pcb is still referenced");
@@ -279,6 +458,9 @@ impl ProcessManager {
         // 由于进程切换前使用了SpinLockGuard::leak()，所以这里需要手动释放锁
         prev_pcb.arch_info.force_unlock();
         next_pcb.arch_info.force_unlock();
+
+        // 发生了进程切换，说明当前cpu已经不处于任何RCU读者临界区
+        rcu_quiescent_state();
     }
 
     /// 如果目标进程正在目标CPU上运行，那么就让这个cpu陷入内核态
@@ -366,7 +548,7 @@ bitflags! {
         const VFORK = 1 << 2;
         /// 进程不可被冻结
         const NOFREEZE = 1 << 3;
-        /// 进程正在退出
+        /// 进程正在退出（线程组中的其他线程调用了exit_group）
         const EXITING = 1 << 4;
         /// 进程由于接收到终止信号唤醒
         const WAKEKILL = 1 << 5;
@@ -374,6 +556,8 @@ bitflags! {
         const SIGNALED = 1 << 6;
         /// 进程需要迁移到其他cpu上
         const NEED_MIGRATE = 1 << 7;
+        /// 进程是工作队列的worker
+        const WQ_WORKER = 1 << 8;
     }
 }
 
@@ -388,6 +572,9 @@ pub struct ProcessControlBlock {
 
     flags: SpinLock<ProcessFlags>,
     worker_private: SpinLock<Option<WorkerPrivate>>,
+    /// 是否为绑定到某个cpu上的内核线程（KernelThreadFlags::IS_PER_CPU的缓存），
+    /// 调度器每次入队都要检查它，因此不需要获取flags和worker_private的锁
+    per_cpu: AtomicBool,
     /// 进程的内核栈
     kernel_stack: RwLock<KernelStack>,
 
@@ -404,6 +591,21 @@ pub struct ProcessControlBlock {
 
     /// 等待队列
     wait_queue: WaitQueue,
+
+    /// 线程组以及线程相关的信息
+    thread: RwLock<ThreadInfo>,
+
+    /// 通过vfork创建的子进程，在execve或者退出时，通过它唤醒被挂起的父进程
+    vfork_done: SpinLock<Option<Arc<Completion>>>,
+
+    /// 系统调用的统计信息
+    syscall_stats: ProcessSyscallStats,
+
+    /// 进程在用户态和内核态花费的时间
+    cputime: ProcessCpuTime,
+
+    /// 进程被创建时的时间（定时器时间片，单位：微秒）
+    start_time: u64,
 }
 
 impl ProcessControlBlock {
@@ -458,14 +660,22 @@ impl ProcessControlBlock {
             flags,
             kernel_stack: RwLock::new(kstack),
             worker_private: SpinLock::new(None),
+            per_cpu: AtomicBool::new(false),
             sched_info,
             arch_info,
             parent_pcb: RwLock::new(ppcb),
             children: RwLock::new(HashMap::new()),
             wait_queue: WaitQueue::INIT,
+            thread: RwLock::new(ThreadInfo::new(pid)),
+            vfork_done: SpinLock::new(None),
+            syscall_stats: ProcessSyscallStats::new(),
+            cputime: ProcessCpuTime::new(),
+            start_time: clock(),
         };
 
         let pcb = Arc::new(pcb);
+        // 默认情况下，进程自身就是线程组的组长
+        pcb.thread.write().group_leader = Arc::downgrade(&pcb);
 
         // 设置进程的arc指针到内核栈的最低地址处
         unsafe { pcb.kernel_stack.write().set_pcb(Arc::clone(&pcb)).unwrap() };
@@ -490,6 +700,12 @@ impl ProcessControlBlock {
         return NEXT_PID.fetch_add(Pid(1), Ordering::SeqCst);
     }
 
+    /// 当前进程是否为绑定到某个cpu上的内核线程
+    #[inline(always)]
+    pub fn is_per_cpu(&self) -> bool {
+        return self.per_cpu.load(Ordering::Acquire);
+    }
+
     /// 返回当前进程的锁持有计数
     #[inline(always)]
     pub fn preempt_count(&self) -> usize {
@@ -574,11 +790,49 @@ impl ProcessControlBlock {
         return self.worker_private.lock();
     }
 
+    #[inline(always)]
+    pub fn syscall_stats(&self) -> &ProcessSyscallStats {
+        return &self.syscall_stats;
+    }
+
+    #[inline(always)]
+    pub fn cputime(&self) -> &ProcessCpuTime {
+        return &self.cputime;
+    }
+
+    /// 获取进程被创建时的时间（定时器时间片，单位：微秒）
+    #[inline(always)]
+    pub fn start_time(&self) -> u64 {
+        return self.start_time;
+    }
+
     #[inline(always)]
     pub fn pid(&self) -> Pid {
         return self.pid;
     }
 
+    /// 获取线程组id（也就是线程组组长的pid）
+    #[inline(always)]
+    pub fn tgid(&self) -> Pid {
+        return self.thread.read().tgid;
+    }
+
+    /// 当前pcb是否为线程组中除组长之外的线程
+    #[inline(always)]
+    pub fn is_thread(&self) -> bool {
+        return self.pid != self.tgid();
+    }
+
+    #[inline(always)]
+    pub fn thread_info(&self) -> RwLockReadGuard<ThreadInfo> {
+        return self.thread.read();
+    }
+
+    #[inline(always)]
+    pub fn thread_info_mut(&self) -> RwLockWriteGuard<ThreadInfo> {
+        return self.thread.write();
+    }
+
     /// 获取文件描述符表的Arc指针
     #[inline(always)]
     pub fn fd_table(&self) -> Arc<RwLock<FileDescriptorVec>> {
@@ -734,6 +988,34 @@ impl ProcessBasicInfo {
     }
 }
 
+/// 线程相关的信息
+#[derive(Debug)]
+pub struct ThreadInfo {
+    /// 线程组的组长
+    pub group_leader: Weak<ProcessControlBlock>,
+    /// 线程组id
+    pub tgid: Pid,
+    /// 线程退出时，需要清零并执行futex唤醒的用户空间地址
+    pub clear_child_tid: Option<VirtAddr>,
+    /// 线程组中的其他线程调用了exit_group时，线程组的退出码
+    pub group_exit_code: Option<usize>,
+}
+
+impl ThreadInfo {
+    pub fn new(tgid: Pid) -> Self {
+        Self {
+            group_leader: Weak::new(),
+            tgid,
+            clear_child_tid: None,
+            group_exit_code: None,
+        }
+    }
+
+    pub fn group_leader(&self) -> Option<Arc<ProcessControlBlock>> {
+        return self.group_leader.upgrade();
+    }
+}
+
 #[derive(Debug)]
 pub struct ProcessSchedulerInfo {
     /// 当前进程所在的cpu
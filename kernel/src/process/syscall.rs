@@ -2,11 +2,15 @@ use core::ffi::c_void;
 
 use alloc::{string::String, vec::Vec};
 
-use super::{fork::CloneFlags, Pid, ProcessManager, ProcessState};
+use super::{
+    fork::{CloneFlags, KernelCloneArgs},
+    Pid, ProcessManager, ProcessState,
+};
 use crate::{
     arch::{interrupt::TrapFrame, sched::sched, CurrentIrqArch},
     exception::InterruptArch,
     filesystem::vfs::MAX_PATHLEN,
+    mm::VirtAddr,
     process::ProcessControlBlock,
     syscall::{
         user_access::{
@@ -22,14 +26,47 @@ impl Syscall {
         return r;
     }
 
+    /// 创建子进程，子进程直接使用父进程的地址空间，而不拷贝它。
+    ///
+    /// 父进程会被挂起，直到子进程调用execve或者退出。在此之前，子进程不能从调用vfork的函数返回，
+    /// 也不能修改除了保存返回值的变量以外的任何数据。
     pub fn vfork(frame: &mut TrapFrame) -> Result<usize, SystemError> {
         ProcessManager::fork(
             frame,
-            CloneFlags::CLONE_VM | CloneFlags::CLONE_FS | CloneFlags::CLONE_SIGNAL,
+            CloneFlags::CLONE_VM
+                | CloneFlags::CLONE_FS
+                | CloneFlags::CLONE_SIGNAL
+                | CloneFlags::CLONE_VFORK,
         )
         .map(|pid| pid.into())
     }
 
+    /// # 创建子进程或线程
+    ///
+    /// ## 参数
+    ///
+    /// - `frame`: 当前进程的trapframe
+    /// - `flags`: 克隆标志
+    /// - `stack`: 子进程的用户栈（为0则与父进程使用相同的栈指针）
+    /// - `parent_tid`: CLONE_PARENT_SETTID时，写入子进程tid的地址
+    /// - `child_tid`: CLONE_CHILD_SETTID/CLONE_CHILD_CLEARTID时使用的地址
+    /// - `tls`: CLONE_SETTLS时，子进程的fsbase
+    pub fn clone(
+        frame: &mut TrapFrame,
+        flags: CloneFlags,
+        stack: usize,
+        parent_tid: VirtAddr,
+        child_tid: VirtAddr,
+        tls: usize,
+    ) -> Result<usize, SystemError> {
+        let mut clone_args = KernelCloneArgs::new(flags);
+        clone_args.stack = stack;
+        clone_args.parent_tid = parent_tid;
+        clone_args.child_tid = child_tid;
+        clone_args.tls = tls;
+        return ProcessManager::do_fork(frame, clone_args).map(|pid| pid.into());
+    }
+
     pub fn execve(
         path: *const u8,
         argv: *const *const u8,
@@ -135,8 +172,23 @@ impl Syscall {
         ProcessManager::exit(status);
     }
 
-    /// @brief 获取当前进程的pid
+    /// # 退出线程组中的所有线程
+    ///
+    /// ## 参数
+    ///
+    /// - status: 线程组的退出状态
+    pub fn exit_group(status: usize) -> ! {
+        ProcessManager::exit_group(status);
+    }
+
+    /// @brief 获取当前进程的pid（对于线程而言，是线程组的id）
     pub fn getpid() -> Result<Pid, SystemError> {
+        let current_pcb = ProcessManager::current_pcb();
+        return Ok(current_pcb.tgid());
+    }
+
+    /// @brief 获取当前线程的tid
+    pub fn gettid() -> Result<Pid, SystemError> {
         let current_pcb = ProcessManager::current_pcb();
         return Ok(current_pcb.pid());
     }
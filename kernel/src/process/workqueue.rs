@@ -0,0 +1,407 @@
+//! 工作队列
+//!
+//! 把需要在进程上下文中执行的工作交给内核线程池（worker pool）异步执行。
+//! 每个cpu都有一个绑定到该cpu的worker pool，另外还有一个不绑定cpu的unbound pool。
+//!
+//! 每个pool只在没有正在运行的worker时才唤醒空闲的worker：正在运行的worker处理完当前工作后会继续处理后续工作，
+//! 只有当它阻塞（睡眠）时，才会唤醒另一个空闲的worker接手。worker开始处理工作时若发现没有空闲的worker，
+//! 就创建一个新的worker备用，因此额外的worker只会在已有的worker阻塞时才真正投入使用。
+use core::{
+    fmt::Debug,
+    iter,
+    sync::atomic::{AtomicBool, AtomicUsize, Ordering},
+};
+
+use alloc::{
+    boxed::Box,
+    collections::{BTreeMap, LinkedList},
+    format,
+    string::{String, ToString},
+    sync::Arc,
+    vec::Vec,
+};
+
+use crate::{
+    arch::sched::sched,
+    include::bindings::bindings::smp_get_total_cpu,
+    kinfo, kwarn,
+    libs::{once::Once, rcu::Rcu, spinlock::SpinLock},
+    smp::core::smp_get_processor_id,
+    syscall::SystemError,
+    time::timer::{next_n_us_timer_jiffies, Timer, TimerFunction},
+};
+
+use super::{
+    kthread::{KernelThreadClosure, KernelThreadMechanism},
+    Pid, ProcessControlBlock, ProcessFlags, ProcessManager,
+};
+
+/// 每个worker pool最多的worker数量
+const MAX_WORKERS_PER_POOL: usize = 16;
+
+lazy_static! {
+    /// 所有的worker pool。下标0~cpu_num-1为绑定到对应cpu的pool，最后一个为unbound pool
+    static ref WORKER_POOLS: Vec<WorkerPool> = {
+        let cpu_num = unsafe { smp_get_total_cpu() };
+        let mut pools = Vec::with_capacity(cpu_num as usize + 1);
+        for cpu_id in 0..cpu_num {
+            pools.push(WorkerPool::new(pools.len(), Some(cpu_id)));
+        }
+        pools.push(WorkerPool::new(pools.len(), None));
+        pools
+    };
+
+    /// worker的pid到其所属pool的下标的映射
+    static ref WQ_WORKERS: Rcu<BTreeMap<Pid, usize>> = Rcu::new(BTreeMap::new());
+
+    /// 系统默认的工作队列，工作在提交它的cpu上执行
+    pub static ref SYSTEM_WQ: Arc<WorkQueue> = WorkQueue::new("events", WorkQueueFlags::empty());
+    /// 系统默认的unbound工作队列，适用于耗时较长、不关心在哪个cpu上执行的工作
+    pub static ref SYSTEM_UNBOUND_WQ: Arc<WorkQueue> =
+        WorkQueue::new("events_unbound", WorkQueueFlags::UNBOUND);
+}
+
+bitflags! {
+    pub struct WorkQueueFlags: u32 {
+        /// 工作不绑定到提交它的cpu，由unbound pool执行
+        const UNBOUND = 1 << 0;
+    }
+}
+
+/// 可以被提交到工作队列的一项工作
+///
+/// 同一项工作在执行之前被重复提交，只会被执行一次
+pub struct Work {
+    func: Box<dyn Fn() + Send + Sync>,
+    /// 是否已经被提交、正在等待执行
+    pending: AtomicBool,
+}
+
+impl Debug for Work {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        f.debug_struct("Work")
+            .field("pending", &self.pending.load(Ordering::Relaxed))
+            .finish()
+    }
+}
+
+impl Work {
+    pub fn new(func: Box<dyn Fn() + Send + Sync>) -> Arc<Self> {
+        return Arc::new(Self {
+            func,
+            pending: AtomicBool::new(false),
+        });
+    }
+
+    /// 工作是否正在等待执行
+    pub fn is_pending(&self) -> bool {
+        return self.pending.load(Ordering::Acquire);
+    }
+
+    /// 将工作标记为等待执行。如果已经处于等待执行的状态，返回false
+    #[inline]
+    fn mark_pending(&self) -> bool {
+        return self
+            .pending
+            .compare_exchange(false, true, Ordering::AcqRel, Ordering::Relaxed)
+            .is_ok();
+    }
+
+    fn run(&self) {
+        // 先清除pending，使得工作函数可以再次提交自己
+        self.pending.store(false, Ordering::Release);
+        (self.func)();
+    }
+}
+
+/// 工作队列
+#[derive(Debug)]
+pub struct WorkQueue {
+    name: String,
+    flags: WorkQueueFlags,
+}
+
+impl WorkQueue {
+    pub fn new(name: &str, flags: WorkQueueFlags) -> Arc<Self> {
+        return Arc::new(Self {
+            name: name.to_string(),
+            flags,
+        });
+    }
+
+    pub fn name(&self) -> &str {
+        &self.name
+    }
+
+    /// 选择执行工作的worker pool
+    fn select_pool(&self) -> &'static WorkerPool {
+        let pools: &'static Vec<WorkerPool> = &WORKER_POOLS;
+        let unbound = pools.last().unwrap();
+        if self.flags.contains(WorkQueueFlags::UNBOUND) {
+            return unbound;
+        }
+        return pools
+            .get(smp_get_processor_id() as usize)
+            .filter(|pool| pool.cpu.is_some())
+            .unwrap_or(unbound);
+    }
+
+    /// 提交一项工作
+    ///
+    /// ## 返回值
+    ///
+    /// - true 提交成功
+    /// - false 该工作已经在等待执行
+    pub fn queue_work(&self, work: Arc<Work>) -> bool {
+        if !work.mark_pending() {
+            return false;
+        }
+        self.select_pool().insert(iter::once(work));
+        return true;
+    }
+
+    /// 一次性提交多项工作，只需加一次锁、最多唤醒一个worker
+    ///
+    /// ## 返回值
+    ///
+    /// 实际提交成功的工作的数量（已经在等待执行的工作会被跳过）
+    pub fn queue_work_batch(&self, works: Vec<Arc<Work>>) -> usize {
+        let works: Vec<Arc<Work>> = works.into_iter().filter(|w| w.mark_pending()).collect();
+        let count = works.len();
+        self.select_pool().insert(works.into_iter());
+        return count;
+    }
+
+    /// 在delay_us微秒之后提交一项工作
+    ///
+    /// ## 返回值
+    ///
+    /// - true 提交成功
+    /// - false 该工作已经在等待执行
+    pub fn queue_delayed_work(self: &Arc<Self>, work: Arc<Work>, delay_us: u64) -> bool {
+        if !work.mark_pending() {
+            return false;
+        }
+        let timer = Timer::new(
+            Box::new(DelayedWorkTimer {
+                wq: self.clone(),
+                work,
+            }),
+            next_n_us_timer_jiffies(delay_us),
+        );
+        timer.activate();
+        return true;
+    }
+}
+
+/// 延迟工作的定时器，到期后把工作放入worker pool
+#[derive(Debug)]
+struct DelayedWorkTimer {
+    wq: Arc<WorkQueue>,
+    work: Arc<Work>,
+}
+
+impl TimerFunction for DelayedWorkTimer {
+    fn run(&mut self) -> Result<(), SystemError> {
+        self.wq.select_pool().insert(iter::once(self.work.clone()));
+        return Ok(());
+    }
+}
+
+#[derive(Debug)]
+struct WorkerPoolInner {
+    /// 等待执行的工作
+    worklist: LinkedList<Arc<Work>>,
+    /// 空闲的worker
+    idle: LinkedList<Arc<ProcessControlBlock>>,
+    /// worker的总数（包括正在创建的）
+    nr_workers: usize,
+}
+
+#[derive(Debug)]
+struct WorkerPool {
+    /// 在WORKER_POOLS中的下标
+    id: usize,
+    /// 绑定的cpu，为None表示unbound pool
+    cpu: Option<u32>,
+    inner: SpinLock<WorkerPoolInner>,
+    /// 没有处于睡眠状态的worker的数量
+    nr_running: AtomicUsize,
+    /// 等待执行的工作的数量
+    nr_pending: AtomicUsize,
+    /// 用于给worker命名
+    next_worker_id: AtomicUsize,
+}
+
+impl WorkerPool {
+    fn new(id: usize, cpu: Option<u32>) -> Self {
+        return Self {
+            id,
+            cpu,
+            inner: SpinLock::new(WorkerPoolInner {
+                worklist: LinkedList::new(),
+                idle: LinkedList::new(),
+                nr_workers: 0,
+            }),
+            nr_running: AtomicUsize::new(0),
+            nr_pending: AtomicUsize::new(0),
+            next_worker_id: AtomicUsize::new(0),
+        };
+    }
+
+    /// 把工作放入队列，并在必要时唤醒一个空闲的worker
+    fn insert<I: Iterator<Item = Arc<Work>>>(&self, works: I) {
+        let mut inner = self.inner.lock_irqsave();
+        let mut count = 0;
+        for work in works {
+            inner.worklist.push_back(work);
+            count += 1;
+        }
+        if count == 0 {
+            return;
+        }
+        self.nr_pending.fetch_add(count, Ordering::Release);
+
+        // 已经有worker在运行的话，它处理完当前工作后会继续处理新的工作，不需要唤醒其他worker
+        let to_wakeup = if self.nr_running.load(Ordering::Acquire) == 0 {
+            inner.idle.pop_front()
+        } else {
+            None
+        };
+        drop(inner);
+
+        if let Some(worker) = to_wakeup {
+            ProcessManager::wakeup(&worker).ok();
+        }
+    }
+
+    /// 创建一个新的worker
+    fn create_worker(&self) -> Result<(), SystemError> {
+        let worker_id = self.next_worker_id.fetch_add(1, Ordering::Relaxed);
+        let name = match self.cpu {
+            Some(cpu_id) => format!("kworker/{cpu_id}:{worker_id}"),
+            None => format!("kworker/u:{worker_id}"),
+        };
+        let pcb = KernelThreadMechanism::create(
+            KernelThreadClosure::UsizeClosure((Box::new(worker_thread), self.id)),
+            name,
+        )
+        .ok_or(SystemError::ENOMEM)?;
+        if let Some(cpu_id) = self.cpu {
+            KernelThreadMechanism::bind(&pcb, cpu_id);
+        }
+        ProcessManager::wakeup(&pcb)?;
+        return Ok(());
+    }
+
+    /// 为pool预留一个worker的名额并创建worker，失败时归还名额
+    fn spawn_worker(&self) {
+        if let Err(e) = self.create_worker() {
+            kwarn!("Failed to create worker for pool {}: {:?}", self.id, e);
+            self.inner.lock_irqsave().nr_workers -= 1;
+        }
+    }
+}
+
+/// worker内核线程的主循环
+fn worker_thread(pool_id: usize) -> i32 {
+    let pool: &'static WorkerPool = &WORKER_POOLS[pool_id];
+    let pcb = ProcessManager::current_pcb();
+
+    // 先把自己计入运行中的worker，再打上WQ_WORKER标志，使得之后的睡眠、唤醒都会被统计
+    pool.nr_running.fetch_add(1, Ordering::AcqRel);
+    WQ_WORKERS.update(|workers| {
+        let mut workers = workers.clone();
+        workers.insert(pcb.pid(), pool_id);
+        workers
+    });
+    pcb.flags().insert(ProcessFlags::WQ_WORKER);
+
+    loop {
+        let mut inner = pool.inner.lock_irqsave();
+        // 可能是被虚假唤醒的，此时自己还在空闲链表中
+        inner.idle.drain_filter(|x| Arc::ptr_eq(x, &pcb));
+
+        if let Some(work) = inner.worklist.pop_front() {
+            pool.nr_pending.fetch_sub(1, Ordering::AcqRel);
+            // 没有空闲的worker了，创建一个备用，以便当前worker阻塞时有人接手
+            let spawn = inner.idle.is_empty() && inner.nr_workers < MAX_WORKERS_PER_POOL;
+            if spawn {
+                inner.nr_workers += 1;
+            }
+            drop(inner);
+
+            if spawn {
+                pool.spawn_worker();
+            }
+            work.run();
+            continue;
+        }
+
+        if KernelThreadMechanism::should_stop(&pcb) {
+            inner.nr_workers -= 1;
+            drop(inner);
+            pcb.flags().remove(ProcessFlags::WQ_WORKER);
+            pool.nr_running.fetch_sub(1, Ordering::AcqRel);
+            WQ_WORKERS.update(|workers| {
+                let mut workers = workers.clone();
+                workers.remove(&pcb.pid());
+                workers
+            });
+            return 0;
+        }
+
+        // 没有工作了，进入空闲状态。持有pool的锁（中断已关闭）标记睡眠，避免丢失唤醒。
+        // 此时worklist为空，nr_pending一定为0，因此wq_worker_sleeping()不会再去获取pool的锁
+        inner.idle.push_back(pcb.clone());
+        ProcessManager::mark_sleep(true).ok();
+        drop(inner);
+        sched();
+    }
+}
+
+/// 获取worker所属的pool
+fn worker_pool_of(pcb: &Arc<ProcessControlBlock>) -> Option<&'static WorkerPool> {
+    let pool_id = *WQ_WORKERS.read().get(&pcb.pid())?;
+    return WORKER_POOLS.get(pool_id);
+}
+
+/// worker即将睡眠时被调用（由ProcessManager::mark_sleep调用）
+///
+/// 如果它是pool中最后一个运行中的worker，且还有工作等待执行，就唤醒一个空闲的worker接手
+pub fn wq_worker_sleeping(pcb: &Arc<ProcessControlBlock>) {
+    let pool = match worker_pool_of(pcb) {
+        Some(pool) => pool,
+        None => return,
+    };
+    if pool.nr_running.fetch_sub(1, Ordering::AcqRel) == 1
+        && pool.nr_pending.load(Ordering::Acquire) > 0
+    {
+        let to_wakeup = pool.inner.lock_irqsave().idle.pop_front();
+        if let Some(worker) = to_wakeup {
+            ProcessManager::wakeup(&worker).ok();
+        }
+    }
+}
+
+/// worker被唤醒时被调用（由ProcessManager::wakeup调用）
+pub fn wq_worker_waking_up(pcb: &Arc<ProcessControlBlock>) {
+    if let Some(pool) = worker_pool_of(pcb) {
+        pool.nr_running.fetch_add(1, Ordering::AcqRel);
+    }
+}
+
+/// 初始化工作队列，为每个worker pool创建一个worker
+pub fn workqueue_init() {
+    static INIT: Once = Once::new();
+    INIT.call_once(|| {
+        for pool in WORKER_POOLS.iter() {
+            pool.inner.lock_irqsave().nr_workers += 1;
+            pool.spawn_worker();
+        }
+        kinfo!(
+            "Workqueue initialized, {} worker pools.",
+            WORKER_POOLS.len()
+        );
+    });
+}
@@ -1,5 +1,6 @@
 #![allow(dead_code)]
 use crate::{
+    arch::sched::sched,
     libs::{spinlock::SpinLock, wait_queue::WaitQueue},
     syscall::SystemError,
     time::timer::schedule_timeout,
@@ -73,6 +74,23 @@ impl Completion {
         self.do_wait_for_common(MAX_TIMEOUT, false)
     }
 
+    /// @brief 不可中断地等待completion完成。
+    ///
+    /// 与wait_for_completion不同，本函数没有超时，也不会出错返回：只有completion完成之后才会返回，
+    /// 被其他原因唤醒时会重新睡眠
+    pub fn wait_for_completion_uninterruptible(&self) {
+        let mut inner = self.inner.lock_irqsave();
+        while inner.done == 0 {
+            unsafe { inner.wait_queue.sleep_without_schedule_uninterruptible() };
+            drop(inner);
+            sched();
+            inner = self.inner.lock_irqsave();
+        }
+        if inner.done != COMPLETE_ALL {
+            inner.done -= 1;
+        }
+    }
+
     /// @brief @brief 等待completion的完成，但是可以被中断
     pub fn wait_for_completion_interruptible(&self) -> Result<i64, SystemError> {
         self.do_wait_for_common(MAX_TIMEOUT, true)
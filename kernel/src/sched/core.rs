@@ -5,9 +5,14 @@ use alloc::{sync::Arc, vec::Vec};
 use crate::{
     include::bindings::bindings::smp_get_total_cpu,
     kinfo,
+    libs::{kmsg::kmsg_check_wakeup, rcu::rcu_check_callbacks},
     mm::percpu::PerCpu,
-    process::{AtomicPid, Pid, ProcessControlBlock, ProcessFlags, ProcessManager, ProcessState},
+    process::{
+        kthread::KernelThreadMechanism, AtomicPid, Pid, ProcessControlBlock, ProcessFlags,
+        ProcessManager, ProcessState,
+    },
     smp::core::smp_get_processor_id,
+    trace_event,
 };
 
 use super::rt::{sched_rt_init, SchedulerRT, __get_rt_scheduler};
@@ -131,8 +136,8 @@ pub fn sched_enqueue(pcb: Arc<ProcessControlBlock>, mut reset_time: bool) {
     }
     let cfs_scheduler = __get_cfs_scheduler();
     let rt_scheduler = __get_rt_scheduler();
-    // 除了IDLE以外的进程，都进行负载均衡
-    if pcb.pid().into() > 0 {
+    // 除了IDLE以及绑定到某个cpu的内核线程以外的进程，都进行负载均衡
+    if pcb.pid().into() > 0 && !KernelThreadMechanism::is_per_cpu(&pcb) {
         loads_balance(pcb.clone());
     }
 
@@ -144,6 +149,11 @@ pub fn sched_enqueue(pcb: Arc<ProcessControlBlock>, mut reset_time: bool) {
     }
 
     assert!(pcb.sched_info().on_cpu().is_some());
+    trace_event!(
+        TP_SCHED_ENQUEUE,
+        pcb.pid().into(),
+        pcb.sched_info().on_cpu().unwrap()
+    );
 
     match pcb.sched_info().policy() {
         SchedPolicy::CFS => {
@@ -174,6 +184,8 @@ pub extern "C" fn sched_init() {
 #[allow(dead_code)]
 #[no_mangle]
 pub extern "C" fn sched_update_jiffies() {
+    rcu_check_callbacks();
+    kmsg_check_wakeup();
     let policy = ProcessManager::current_pcb().sched_info().policy();
     match policy {
         SchedPolicy::CFS => {
@@ -0,0 +1,152 @@
+//! cpu时间的统计
+//!
+//! 每次时钟中断时，根据被打断的上下文，把一个时钟周期的时间记到当前cpu的用户态、内核态、软中断或者空闲时间上，
+//! 同时记到当前进程的用户态或内核态时间上。硬件中断处理函数运行时中断是关闭的，时钟中断无法采样到它们，
+//! 因此硬件中断的时间由do_IRQ使用TSC直接测量。
+use core::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+
+use crate::{
+    include::bindings::bindings::{pt_regs, Cpu_tsc_freq, APIC_TIMER_INTERVAL},
+    mm::percpu::PerCpu,
+    process::{Pid, ProcessManager},
+    smp::core::smp_get_processor_id,
+    time::USEC_PER_MSEC,
+};
+
+/// 时钟中断的周期（微秒），与APIC定时器的中断间隔保持一致
+pub const SCHED_TICK_US: u64 = APIC_TIMER_INTERVAL as u64 * USEC_PER_MSEC as u64;
+
+static CPU_TIME: [CpuTime; PerCpu::MAX_CPU_NUM] = {
+    const EMPTY: CpuTime = CpuTime::new();
+    [EMPTY; PerCpu::MAX_CPU_NUM]
+};
+
+/// 每个cpu是否正在处理软中断
+static CPU_IN_SOFTIRQ: [AtomicBool; PerCpu::MAX_CPU_NUM] = {
+    const FALSE: AtomicBool = AtomicBool::new(false);
+    [FALSE; PerCpu::MAX_CPU_NUM]
+};
+
+/// 一个cpu在各种状态下花费的时间
+struct CpuTime {
+    /// 以下时间的单位均为微秒
+    user: AtomicU64,
+    system: AtomicU64,
+    idle: AtomicU64,
+    softirq: AtomicU64,
+    /// 处理硬件中断花费的TSC周期数
+    irq_cycles: AtomicU64,
+}
+
+impl CpuTime {
+    const fn new() -> Self {
+        return Self {
+            user: AtomicU64::new(0),
+            system: AtomicU64::new(0),
+            idle: AtomicU64::new(0),
+            softirq: AtomicU64::new(0),
+            irq_cycles: AtomicU64::new(0),
+        };
+    }
+}
+
+/// 一个cpu的时间统计结果（单位：微秒）
+#[derive(Debug, Clone, Copy, Default)]
+pub struct CpuTimeSnapshot {
+    pub user: u64,
+    pub system: u64,
+    pub idle: u64,
+    pub irq: u64,
+    pub softirq: u64,
+}
+
+impl core::ops::AddAssign for CpuTimeSnapshot {
+    fn add_assign(&mut self, rhs: Self) {
+        self.user += rhs.user;
+        self.system += rhs.system;
+        self.idle += rhs.idle;
+        self.irq += rhs.irq;
+        self.softirq += rhs.softirq;
+    }
+}
+
+/// 进程在用户态和内核态花费的时间（单位：微秒）
+#[derive(Debug)]
+pub struct ProcessCpuTime {
+    utime: AtomicU64,
+    stime: AtomicU64,
+}
+
+impl ProcessCpuTime {
+    pub const fn new() -> Self {
+        return Self {
+            utime: AtomicU64::new(0),
+            stime: AtomicU64::new(0),
+        };
+    }
+
+    #[inline(always)]
+    pub fn utime(&self) -> u64 {
+        return self.utime.load(Ordering::Relaxed);
+    }
+
+    #[inline(always)]
+    pub fn stime(&self) -> u64 {
+        return self.stime.load(Ordering::Relaxed);
+    }
+}
+
+/// @brief 标记当前cpu开始（或结束）处理软中断
+#[inline(always)]
+pub fn cputime_set_softirq(running: bool) {
+    let cpu_id = smp_get_processor_id() as usize;
+    CPU_IN_SOFTIRQ[cpu_id].store(running, Ordering::Relaxed);
+}
+
+/// @brief 时钟中断处理函数中调用，把一个时钟周期记到被打断的上下文上
+#[no_mangle]
+pub extern "C" fn rs_cputime_account_tick(regs: *mut pt_regs) {
+    let cpu_id = smp_get_processor_id() as usize;
+    let cpu_time = &CPU_TIME[cpu_id];
+    let pcb = ProcessManager::current_pcb();
+    let user_mode = unsafe { (*regs).cs & 3 != 0 };
+
+    if user_mode {
+        cpu_time.user.fetch_add(SCHED_TICK_US, Ordering::Relaxed);
+        pcb.cputime()
+            .utime
+            .fetch_add(SCHED_TICK_US, Ordering::Relaxed);
+    } else if CPU_IN_SOFTIRQ[cpu_id].load(Ordering::Relaxed) {
+        cpu_time.softirq.fetch_add(SCHED_TICK_US, Ordering::Relaxed);
+    } else if pcb.pid() == Pid::new(0) {
+        cpu_time.idle.fetch_add(SCHED_TICK_US, Ordering::Relaxed);
+    } else {
+        cpu_time.system.fetch_add(SCHED_TICK_US, Ordering::Relaxed);
+        pcb.cputime()
+            .stime
+            .fetch_add(SCHED_TICK_US, Ordering::Relaxed);
+    }
+}
+
+/// @brief do_IRQ中调用，记录处理一次硬件中断花费的TSC周期数
+#[no_mangle]
+pub extern "C" fn rs_cputime_account_irq(cycles: u64) {
+    let cpu_id = smp_get_processor_id() as usize;
+    CPU_TIME[cpu_id]
+        .irq_cycles
+        .fetch_add(cycles, Ordering::Relaxed);
+}
+
+/// @brief 获取一个cpu在各种状态下花费的时间
+pub fn cputime_snapshot(cpu_id: usize) -> CpuTimeSnapshot {
+    let cpu_time = &CPU_TIME[cpu_id];
+    let tsc_freq = unsafe { Cpu_tsc_freq }.max(1) as u128;
+    let irq_cycles = cpu_time.irq_cycles.load(Ordering::Relaxed) as u128;
+    return CpuTimeSnapshot {
+        user: cpu_time.user.load(Ordering::Relaxed),
+        system: cpu_time.system.load(Ordering::Relaxed),
+        idle: cpu_time.idle.load(Ordering::Relaxed),
+        irq: (irq_cycles * 1000000 / tsc_freq) as u64,
+        softirq: cpu_time.softirq.load(Ordering::Relaxed),
+    };
+}
@@ -0,0 +1,97 @@
+//! 系统的平均负载
+//!
+//! 每隔LOAD_FREQ_US微秒，统计一次处于可运行状态（正在运行或者在运行队列中等待）的进程数，
+//! 并以定点数的形式，按照1分钟、5分钟、15分钟的时间常数做指数加权移动平均。
+//! 统计在unbound工作队列中进行，因为获取运行队列的长度需要持有调度器的锁，不能在中断上下文中进行。
+use core::sync::atomic::{AtomicU64, Ordering};
+
+use alloc::{boxed::Box, sync::Arc};
+
+use crate::{
+    include::bindings::bindings::smp_get_total_cpu,
+    libs::{lazy_init::Lazy, once::Once},
+    process::{
+        workqueue::{Work, SYSTEM_UNBOUND_WQ},
+        Pid,
+    },
+    sched::core::{get_cpu_loads, CPU_EXECUTING},
+};
+
+/// 定点数的小数位数
+pub const FSHIFT: u32 = 11;
+/// 定点数的1.0
+pub const FIXED_1: u64 = 1 << FSHIFT;
+/// 统计的周期（微秒）
+const LOAD_FREQ_US: u64 = 5000000;
+/// 1/exp(5s/1min)，定点数
+const EXP_1: u64 = 1884;
+/// 1/exp(5s/5min)，定点数
+const EXP_5: u64 = 2014;
+/// 1/exp(5s/15min)，定点数
+const EXP_15: u64 = 2037;
+
+/// 1分钟、5分钟、15分钟的平均负载（定点数）
+static AVENRUN: [AtomicU64; 3] = {
+    const ZERO: AtomicU64 = AtomicU64::new(0);
+    [ZERO; 3]
+};
+/// 最近一次统计时处于可运行状态的进程数
+static NR_RUNNING: AtomicU64 = AtomicU64::new(0);
+
+static LOADAVG_WORK: Lazy<Arc<Work>> = Lazy::new();
+static LOADAVG_INIT: Once = Once::new();
+
+/// @brief 计算一次指数加权移动平均
+fn calc_load(load: u64, exp: u64, active: u64) -> u64 {
+    let mut newload = load * exp + active * (FIXED_1 - exp);
+    if active >= load {
+        newload += FIXED_1 - 1;
+    }
+    return newload / FIXED_1;
+}
+
+/// @brief 统计当前处于可运行状态的进程数
+fn count_active() -> u64 {
+    let mut active = 0;
+    for cpu_id in 0..unsafe { smp_get_total_cpu() } {
+        active += get_cpu_loads(cpu_id) as u64;
+        if CPU_EXECUTING.get(cpu_id) != Pid::new(0) {
+            active += 1;
+        }
+    }
+    // 不统计正在执行统计工作的worker自己
+    return active.saturating_sub(1);
+}
+
+fn loadavg_update() {
+    let active = count_active();
+    NR_RUNNING.store(active, Ordering::Relaxed);
+    let active = active * FIXED_1;
+    for (avg, exp) in AVENRUN.iter().zip([EXP_1, EXP_5, EXP_15]) {
+        let load = avg.load(Ordering::Relaxed);
+        avg.store(calc_load(load, exp, active), Ordering::Relaxed);
+    }
+    SYSTEM_UNBOUND_WQ.queue_delayed_work(LOADAVG_WORK.get().clone(), LOAD_FREQ_US);
+}
+
+/// @brief 开始周期性地统计平均负载，需要在工作队列初始化之后调用
+pub fn loadavg_init() {
+    LOADAVG_INIT.call_once(|| {
+        LOADAVG_WORK.init(Work::new(Box::new(loadavg_update)));
+        SYSTEM_UNBOUND_WQ.queue_delayed_work(LOADAVG_WORK.get().clone(), LOAD_FREQ_US);
+    });
+}
+
+/// @brief 获取1分钟、5分钟、15分钟的平均负载（定点数，小数位数为FSHIFT）
+pub fn loadavg_get() -> [u64; 3] {
+    return [
+        AVENRUN[0].load(Ordering::Relaxed),
+        AVENRUN[1].load(Ordering::Relaxed),
+        AVENRUN[2].load(Ordering::Relaxed),
+    ];
+}
+
+/// @brief 获取最近一次统计时处于可运行状态的进程数
+pub fn loadavg_nr_running() -> u64 {
+    return NR_RUNNING.load(Ordering::Relaxed);
+}
@@ -1,6 +1,8 @@
 pub mod cfs;
 pub mod completion;
 pub mod core;
+pub mod cputime;
+pub mod loadavg;
 pub mod rt;
 pub mod syscall;
 
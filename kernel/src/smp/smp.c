@@ -15,7 +15,7 @@
 static void __smp_kick_cpu_handler(uint64_t irq_num, uint64_t param, struct pt_regs *regs);
 static void __smp__flush_tlb_ipi_handler(uint64_t irq_num, uint64_t param, struct pt_regs *regs);
 
-static spinlock_t multi_core_starting_lock = {1}; // 多核启动锁
+static DEFINE_SPINLOCK(multi_core_starting_lock); // 多核启动锁
 
 static struct acpi_Processor_Local_APIC_Structure_t *proc_local_apic_structs[MAX_SUPPORTED_PROCESSOR_NUM];
 static uint32_t total_processor_num = 0;
@@ -80,6 +80,9 @@ void smp_init()
         kdebug("[core %d] acpi processor UID=%d, APIC ID=%d, flags=%#010lx", i,
                proc_local_apic_structs[i]->ACPI_Processor_UID, proc_local_apic_structs[i]->local_apic_id,
                proc_local_apic_structs[i]->flags);
+        // 记录cpu编号与APIC ID的对应关系，用于设置中断的目标处理器
+        cpu_core_info[proc_local_apic_structs[i]->ACPI_Processor_UID].apic_id =
+            proc_local_apic_structs[i]->local_apic_id;
         if (proc_local_apic_structs[i]->local_apic_id == 0)
         {
             // --total_processor_num;
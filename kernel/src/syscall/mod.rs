@@ -19,15 +19,19 @@ use crate::{
     libs::align::page_align_up,
     mm::{verify_area, MemoryManagementArch, VirtAddr},
     net::syscall::SockAddr,
-    process::Pid,
+    process::{fork::CloneFlags, Pid},
     time::{
         syscall::{PosixTimeZone, PosixTimeval},
         TimeSpec,
     },
 };
 
-use self::user_access::UserBufferWriter;
+use self::{
+    stats::{syscall_stats_record, syscall_stats_start},
+    user_access::UserBufferWriter,
+};
 
+pub mod stats;
 pub mod user_access;
 
 #[repr(i32)]
@@ -375,6 +379,10 @@ pub const SYS_GETPGID: usize = 50;
 
 pub const SYS_FCNTL: usize = 51;
 pub const SYS_FTRUNCATE: usize = 52;
+pub const SYS_FUTEX: usize = 53;
+pub const SYS_CLONE: usize = 54;
+pub const SYS_GETTID: usize = 55;
+pub const SYS_EXIT_GROUP: usize = 56;
 
 #[derive(Debug)]
 pub struct Syscall;
@@ -406,6 +414,7 @@ impl Syscall {
     /// 这个函数内，需要根据系统调用号，调用对应的系统调用处理函数。
     /// 并且，对于用户态传入的指针参数，需要在本函数内进行越界检查，防止访问到内核空间。
     pub fn handle(syscall_num: usize, args: &[usize], frame: &mut TrapFrame) -> usize {
+        let start = syscall_stats_start();
         let r = match syscall_num {
             SYS_PUT_STRING => {
                 Self::put_string(args[0] as *const u8, args[1] as u32, args[2] as u32)
@@ -431,43 +440,15 @@ impl Syscall {
             }
             SYS_READ => {
                 let fd = args[0] as i32;
-                let buf_vaddr = args[1];
+                let buf = args[1] as *mut u8;
                 let len = args[2];
-                let virt_addr: VirtAddr = VirtAddr::new(buf_vaddr);
-                // 判断缓冲区是否来自用户态，进行权限校验
-                let res = if frame.from_user() && verify_area(virt_addr, len as usize).is_err() {
-                    // 来自用户态，而buffer在内核态，这样的操作不被允许
-                    Err(SystemError::EPERM)
-                } else {
-                    let buf: &mut [u8] = unsafe {
-                        core::slice::from_raw_parts_mut::<'static, u8>(buf_vaddr as *mut u8, len)
-                    };
-
-                    Self::read(fd, buf)
-                };
-                // kdebug!("sys read, fd: {}, len: {}, res: {:?}", fd, len, res);
-                res
+                Self::read_to_user(fd, buf, len, frame.from_user())
             }
             SYS_WRITE => {
                 let fd = args[0] as i32;
-                let buf_vaddr = args[1];
+                let buf = args[1] as *const u8;
                 let len = args[2];
-                let virt_addr = VirtAddr::new(buf_vaddr);
-                // 判断缓冲区是否来自用户态，进行权限校验
-                let res = if frame.from_user() && verify_area(virt_addr, len as usize).is_err() {
-                    // 来自用户态，而buffer在内核态，这样的操作不被允许
-                    Err(SystemError::EPERM)
-                } else {
-                    let buf: &[u8] = unsafe {
-                        core::slice::from_raw_parts::<'static, u8>(buf_vaddr as *const u8, len)
-                    };
-
-                    Self::write(fd, buf)
-                };
-
-                // kdebug!("sys write, fd: {}, len: {}, res: {:?}", fd, len, res);
-
-                res
+                Self::write_from_user(fd, buf, len, frame.from_user())
             }
 
             SYS_LSEEK => {
@@ -969,10 +950,38 @@ impl Syscall {
                 res
             }
 
+            SYS_FUTEX => {
+                let uaddr = VirtAddr::new(args[0]);
+                let operation = args[1] as u32;
+                let val = args[2] as u32;
+                let timeout = args[3];
+                let uaddr2 = VirtAddr::new(args[4]);
+                let val3 = args[5] as u32;
+
+                Self::do_futex(uaddr, operation, val, timeout, uaddr2, val3)
+            }
+
+            SYS_CLONE => {
+                let flags = CloneFlags::from_bits_truncate(args[0] as u32);
+                let stack = args[1];
+                let parent_tid = VirtAddr::new(args[2]);
+                let child_tid = VirtAddr::new(args[3]);
+                let tls = args[4];
+                Self::clone(frame, flags, stack, parent_tid, child_tid, tls)
+            }
+
+            SYS_GETTID => Self::gettid().map(|tid| tid.into()),
+
+            SYS_EXIT_GROUP => {
+                let exit_code = args[0];
+                Self::exit_group(exit_code)
+            }
+
             _ => panic!("Unsupported syscall ID: {}", syscall_num),
         };
 
         let r = r.unwrap_or_else(|e| e.to_posix_errno() as usize);
+        syscall_stats_record(syscall_num, start, r);
         return r;
     }
 
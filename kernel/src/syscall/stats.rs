@@ -0,0 +1,343 @@
+//! 系统调用的统计信息
+//!
+//! 系统调用分发器使用TSC记录每个系统调用的耗时，按系统调用号统计调用次数、出错次数以及耗时的直方图。
+//! 全局的统计信息按cpu分开保存，每个cpu只更新自己的计数器，读取/proc/syscalls时再把所有cpu的计数器相加；
+//! 耗时以cycle为单位、按以2为底的对数分桶。每个进程另外记录自己的调用次数、出错次数和总耗时，
+//! 通过/proc/<pid>/syscalls读取。
+//!
+//! 向/proc/syscalls或/proc/<pid>/syscalls写入任意内容会清零相应的统计信息。
+use core::{
+    arch::x86_64::_rdtsc,
+    intrinsics::unlikely,
+    sync::atomic::{AtomicU64, Ordering},
+};
+
+use alloc::{format, string::String, vec::Vec};
+
+use crate::{
+    include::bindings::bindings::{smp_get_total_cpu, Cpu_tsc_freq},
+    libs::{lazy_init::Lazy, once::Once},
+    process::ProcessManager,
+    smp::core::smp_get_processor_id,
+};
+
+use super::*;
+
+/// 统计的系统调用号的上限（不包含）
+pub const SYSCALL_STATS_MAX: usize = 64;
+/// 耗时直方图的桶数。第i个桶统计耗时在[2^i, 2^(i+1))个cycle之间的调用，最后一个桶还包含更长的耗时
+const SYSCALL_HIST_BUCKETS: usize = 32;
+
+/// 每个cpu的计数器，下标为`cpu * SYSCALL_STATS_MAX + 系统调用号`
+static SYSCALL_STATS: Lazy<Vec<SyscallCounter>> = Lazy::new();
+static SYSCALL_STATS_INIT: Once = Once::new();
+
+/// 一个cpu上某个系统调用的计数器
+struct SyscallCounter {
+    count: AtomicU64,
+    errors: AtomicU64,
+    cycles: AtomicU64,
+    max_cycles: AtomicU64,
+    hist: [AtomicU64; SYSCALL_HIST_BUCKETS],
+}
+
+impl SyscallCounter {
+    const fn new() -> Self {
+        const ZERO: AtomicU64 = AtomicU64::new(0);
+        return Self {
+            count: ZERO,
+            errors: ZERO,
+            cycles: ZERO,
+            max_cycles: ZERO,
+            hist: [ZERO; SYSCALL_HIST_BUCKETS],
+        };
+    }
+
+    #[inline(always)]
+    fn add(&self, cycles: u64, error: bool) {
+        self.count.fetch_add(1, Ordering::Relaxed);
+        if error {
+            self.errors.fetch_add(1, Ordering::Relaxed);
+        }
+        self.cycles.fetch_add(cycles, Ordering::Relaxed);
+        self.max_cycles.fetch_max(cycles, Ordering::Relaxed);
+        self.hist[hist_bucket(cycles)].fetch_add(1, Ordering::Relaxed);
+    }
+
+    fn reset(&self) {
+        self.count.store(0, Ordering::Relaxed);
+        self.errors.store(0, Ordering::Relaxed);
+        self.cycles.store(0, Ordering::Relaxed);
+        self.max_cycles.store(0, Ordering::Relaxed);
+        for bucket in self.hist.iter() {
+            bucket.store(0, Ordering::Relaxed);
+        }
+    }
+}
+
+/// 某个系统调用在所有cpu上的计数器之和
+struct SyscallSummary {
+    count: u64,
+    errors: u64,
+    cycles: u64,
+    max_cycles: u64,
+    hist: [u64; SYSCALL_HIST_BUCKETS],
+}
+
+/// 进程中某个系统调用的计数器
+#[derive(Debug)]
+struct ProcessSyscallCounter {
+    count: AtomicU64,
+    errors: AtomicU64,
+    cycles: AtomicU64,
+}
+
+/// 进程的系统调用统计信息
+#[derive(Debug)]
+pub struct ProcessSyscallStats {
+    counters: Vec<ProcessSyscallCounter>,
+}
+
+impl ProcessSyscallStats {
+    pub fn new() -> Self {
+        let mut counters = Vec::with_capacity(SYSCALL_STATS_MAX);
+        for _ in 0..SYSCALL_STATS_MAX {
+            counters.push(ProcessSyscallCounter {
+                count: AtomicU64::new(0),
+                errors: AtomicU64::new(0),
+                cycles: AtomicU64::new(0),
+            });
+        }
+        return Self { counters };
+    }
+
+    #[inline(always)]
+    fn add(&self, nr: usize, cycles: u64, error: bool) {
+        let counter = &self.counters[nr];
+        counter.count.fetch_add(1, Ordering::Relaxed);
+        if error {
+            counter.errors.fetch_add(1, Ordering::Relaxed);
+        }
+        counter.cycles.fetch_add(cycles, Ordering::Relaxed);
+    }
+
+    /// @brief 清零统计信息
+    pub fn reset(&self) {
+        for counter in self.counters.iter() {
+            counter.count.store(0, Ordering::Relaxed);
+            counter.errors.store(0, Ordering::Relaxed);
+            counter.cycles.store(0, Ordering::Relaxed);
+        }
+    }
+
+    /// @brief 以文本形式导出统计信息（用于/proc/<pid>/syscalls）
+    ///
+    /// 每一行的格式为`<系统调用号> <名称> <调用次数> <出错次数> <平均耗时(ns)>`
+    pub fn dump(&self) -> String {
+        let mut result = String::from("nr name calls errors avg_ns\n");
+        for (nr, counter) in self.counters.iter().enumerate() {
+            let count = counter.count.load(Ordering::Relaxed);
+            if count == 0 {
+                continue;
+            }
+            result.push_str(&format!(
+                "{} {} {} {} {}\n",
+                nr,
+                syscall_name(nr),
+                count,
+                counter.errors.load(Ordering::Relaxed),
+                cycles_to_ns(counter.cycles.load(Ordering::Relaxed) / count)
+            ));
+        }
+        return result;
+    }
+}
+
+#[inline(always)]
+fn hist_bucket(cycles: u64) -> usize {
+    if cycles == 0 {
+        return 0;
+    }
+    return (63 - cycles.leading_zeros() as usize).min(SYSCALL_HIST_BUCKETS - 1);
+}
+
+fn cycles_to_ns(cycles: u64) -> u64 {
+    let tsc_freq = unsafe { Cpu_tsc_freq }.max(1) as u128;
+    return (cycles as u128 * 1000000000 / tsc_freq) as u64;
+}
+
+/// @brief 获取所有cpu的计数器，第一次调用时分配
+#[inline(always)]
+fn syscall_counters() -> &'static Vec<SyscallCounter> {
+    SYSCALL_STATS_INIT.call_once(|| {
+        let cpus = unsafe { smp_get_total_cpu() }.max(1) as usize;
+        let mut counters = Vec::with_capacity(cpus * SYSCALL_STATS_MAX);
+        for _ in 0..cpus * SYSCALL_STATS_MAX {
+            counters.push(SyscallCounter::new());
+        }
+        SYSCALL_STATS.init(counters);
+    });
+    return SYSCALL_STATS.get();
+}
+
+/// @brief 获取系统调用开始时的时间戳，与syscall_stats_record()配合使用
+#[inline(always)]
+pub fn syscall_stats_start() -> u64 {
+    return unsafe { _rdtsc() };
+}
+
+/// @brief 记录一次系统调用
+///
+/// ## 参数
+///
+/// - `nr` : 系统调用号
+/// - `start` : 系统调用开始时syscall_stats_start()的返回值
+/// - `ret` : 系统调用的返回值，负数表示出错
+#[inline]
+pub fn syscall_stats_record(nr: usize, start: u64, ret: usize) {
+    if unlikely(nr >= SYSCALL_STATS_MAX) {
+        return;
+    }
+    // 进程可能在系统调用期间被迁移到TSC稍慢的cpu上
+    let cycles = unsafe { _rdtsc() }.saturating_sub(start);
+    let error = (ret as isize) < 0;
+
+    let counters = syscall_counters();
+    let cpu = smp_get_processor_id() as usize;
+    if let Some(counter) = counters.get(cpu * SYSCALL_STATS_MAX + nr) {
+        counter.add(cycles, error);
+    }
+    ProcessManager::current_pcb()
+        .syscall_stats()
+        .add(nr, cycles, error);
+}
+
+/// @brief 清零所有cpu上的统计信息
+pub fn syscall_stats_reset() {
+    if let Some(counters) = SYSCALL_STATS.try_get() {
+        for counter in counters.iter() {
+            counter.reset();
+        }
+    }
+}
+
+/// @brief 以文本形式导出所有cpu上的统计信息之和（用于/proc/syscalls）
+///
+/// 每个被调用过的系统调用占一行：`<系统调用号> <名称> <调用次数> <出错次数> <平均耗时(ns)> <最大耗时(ns)>`，
+/// 随后是它的耗时直方图，每个非空的桶占一行：`    <耗时下限(ns)>-<耗时上限(ns)>: <次数>`
+pub fn syscall_stats_dump() -> String {
+    let mut result = String::from("nr name calls errors avg_ns max_ns\n");
+    let counters = match SYSCALL_STATS.try_get() {
+        Some(counters) => counters,
+        None => return result,
+    };
+    let cpus = counters.len() / SYSCALL_STATS_MAX;
+    for nr in 0..SYSCALL_STATS_MAX {
+        let mut summary = SyscallSummary {
+            count: 0,
+            errors: 0,
+            cycles: 0,
+            max_cycles: 0,
+            hist: [0; SYSCALL_HIST_BUCKETS],
+        };
+        for cpu in 0..cpus {
+            let counter = &counters[cpu * SYSCALL_STATS_MAX + nr];
+            summary.count += counter.count.load(Ordering::Relaxed);
+            summary.errors += counter.errors.load(Ordering::Relaxed);
+            summary.cycles += counter.cycles.load(Ordering::Relaxed);
+            summary.max_cycles = summary
+                .max_cycles
+                .max(counter.max_cycles.load(Ordering::Relaxed));
+            for (i, bucket) in counter.hist.iter().enumerate() {
+                summary.hist[i] += bucket.load(Ordering::Relaxed);
+            }
+        }
+        if summary.count == 0 {
+            continue;
+        }
+
+        result.push_str(&format!(
+            "{} {} {} {} {} {}\n",
+            nr,
+            syscall_name(nr),
+            summary.count,
+            summary.errors,
+            cycles_to_ns(summary.cycles / summary.count),
+            cycles_to_ns(summary.max_cycles)
+        ));
+        for (i, count) in summary.hist.iter().enumerate() {
+            if *count == 0 {
+                continue;
+            }
+            result.push_str(&format!(
+                "    {}-{}: {}\n",
+                cycles_to_ns(1 << i),
+                cycles_to_ns(1 << (i + 1)),
+                count
+            ));
+        }
+    }
+    return result;
+}
+
+/// @brief 获取系统调用的名称
+fn syscall_name(nr: usize) -> &'static str {
+    return match nr {
+        SYS_PUT_STRING => "put_string",
+        SYS_OPEN => "open",
+        SYS_CLOSE => "close",
+        SYS_READ => "read",
+        SYS_WRITE => "write",
+        SYS_LSEEK => "lseek",
+        SYS_FORK => "fork",
+        SYS_VFORK => "vfork",
+        SYS_BRK => "brk",
+        SYS_SBRK => "sbrk",
+        SYS_REBOOT => "reboot",
+        SYS_CHDIR => "chdir",
+        SYS_GET_DENTS => "getdents",
+        SYS_EXECVE => "execve",
+        SYS_WAIT4 => "wait4",
+        SYS_EXIT => "exit",
+        SYS_MKDIR => "mkdir",
+        SYS_NANOSLEEP => "nanosleep",
+        SYS_CLOCK => "clock",
+        SYS_PIPE => "pipe",
+        SYS_UNLINK_AT => "unlinkat",
+        SYS_KILL => "kill",
+        SYS_SIGACTION => "sigaction",
+        SYS_RT_SIGRETURN => "rt_sigreturn",
+        SYS_GETPID => "getpid",
+        SYS_SCHED => "sched",
+        SYS_DUP => "dup",
+        SYS_DUP2 => "dup2",
+        SYS_SOCKET => "socket",
+        SYS_SETSOCKOPT => "setsockopt",
+        SYS_GETSOCKOPT => "getsockopt",
+        SYS_CONNECT => "connect",
+        SYS_BIND => "bind",
+        SYS_SENDTO => "sendto",
+        SYS_RECVFROM => "recvfrom",
+        SYS_RECVMSG => "recvmsg",
+        SYS_LISTEN => "listen",
+        SYS_SHUTDOWN => "shutdown",
+        SYS_ACCEPT => "accept",
+        SYS_GETSOCKNAME => "getsockname",
+        SYS_GETPEERNAME => "getpeername",
+        SYS_GETTIMEOFDAY => "gettimeofday",
+        SYS_MMAP => "mmap",
+        SYS_MUNMAP => "munmap",
+        SYS_MPROTECT => "mprotect",
+        SYS_FSTAT => "fstat",
+        SYS_GETCWD => "getcwd",
+        SYS_GETPPID => "getppid",
+        SYS_GETPGID => "getpgid",
+        SYS_FCNTL => "fcntl",
+        SYS_FTRUNCATE => "ftruncate",
+        SYS_FUTEX => "futex",
+        SYS_CLONE => "clone",
+        SYS_GETTID => "gettid",
+        SYS_EXIT_GROUP => "exit_group",
+        _ => "unknown",
+    };
+}
@@ -59,4 +59,8 @@
 #define SYS_MPROTECT 46     // 内存保护
 
 #define SYS_FSTAT 47        // 根据文件描述符获取文件信息
+#define SYS_FUTEX 53        // 快速用户态互斥锁
+#define SYS_CLONE 54        // 创建子进程或线程
+#define SYS_GETTID 55       // 获取当前线程的tid
+#define SYS_EXIT_GROUP 56   // 退出线程组中的所有线程
 
@@ -7,10 +7,45 @@ use core::{
 
 use alloc::{string::String, vec::Vec};
 
-use crate::mm::{verify_area, VirtAddr};
+use crate::{
+    arch::mm::usercopy::{clear_user_raw, copy_user},
+    mm::{ucontext::InnerAddressSpace, verify_area, VirtAddr},
+    process::ProcessManager,
+};
 
 use super::SystemError;
 
+/// 检查用户空间的一段内存是否可以被内核写入
+///
+/// 除了verify_area的范围检查之外，还要求这段内存全部位于带有PROT_WRITE的VMA中，
+/// 防止通过系统调用写入只读的映射（例如多个进程共享的代码段）
+///
+/// ## 错误
+///
+/// - `EFAULT`：地址不合法，或者其中有不可写的部分
+pub fn verify_area_writable(dest: VirtAddr, len: usize) -> Result<(), SystemError> {
+    verify_area(dest, len).map_err(|_| SystemError::EFAULT)?;
+    let vm = ProcessManager::current_pcb()
+        .basic()
+        .user_vm()
+        .ok_or(SystemError::EFAULT)?;
+    let guard = vm.read();
+    return verify_area_writable_locked(&guard, dest, len);
+}
+
+/// 与verify_area_writable相同，用于调用者已经持有地址空间的锁的情况
+pub fn verify_area_writable_locked(
+    vm: &InnerAddressSpace,
+    dest: VirtAddr,
+    len: usize,
+) -> Result<(), SystemError> {
+    verify_area(dest, len).map_err(|_| SystemError::EFAULT)?;
+    if !vm.mappings.is_writable(dest, len) {
+        return Err(SystemError::EFAULT);
+    }
+    return Ok(());
+}
+
 /// 清空用户空间指定范围内的数据
 ///
 /// ## 参数
@@ -24,33 +59,78 @@ use super::SystemError;
 ///
 /// ## 错误
 ///
-/// - `EFAULT`：目标地址不合法
+/// - `EFAULT`：目标地址不合法、不可写，或者目标地址所在的页不存在
 pub unsafe fn clear_user(dest: VirtAddr, len: usize) -> Result<usize, SystemError> {
-    verify_area(dest, len).map_err(|_| SystemError::EFAULT)?;
+    verify_area_writable(dest, len)?;
+    return clear_user_unchecked(dest, len);
+}
 
-    let p = dest.data() as *mut u8;
+/// 与clear_user相同，用于调用者已经持有地址空间的锁的情况（例如加载ELF文件）
+pub unsafe fn clear_user_locked(
+    vm: &InnerAddressSpace,
+    dest: VirtAddr,
+    len: usize,
+) -> Result<usize, SystemError> {
+    verify_area_writable_locked(vm, dest, len)?;
+    return clear_user_unchecked(dest, len);
+}
+
+unsafe fn clear_user_unchecked(dest: VirtAddr, len: usize) -> Result<usize, SystemError> {
     // 清空用户空间的数据
-    p.write_bytes(0, len);
+    if clear_user_raw(dest.data() as *mut u8, len) != 0 {
+        return Err(SystemError::EFAULT);
+    }
     return Ok(len);
 }
 
+/// 从内核空间拷贝数据到用户空间
+///
+/// ## 返回值
+///
+/// 返回拷贝的数据长度
+///
+/// ## 错误
+///
+/// - `EFAULT`：目标地址不合法、不可写，或者目标地址所在的页不存在
 pub unsafe fn copy_to_user(dest: VirtAddr, src: &[u8]) -> Result<usize, SystemError> {
-    verify_area(dest, src.len()).map_err(|_| SystemError::EFAULT)?;
+    verify_area_writable(dest, src.len())?;
+    return copy_to_user_unchecked(dest, src);
+}
+
+/// 与copy_to_user相同，用于调用者已经持有地址空间的锁的情况（例如加载ELF文件）
+pub unsafe fn copy_to_user_locked(
+    vm: &InnerAddressSpace,
+    dest: VirtAddr,
+    src: &[u8],
+) -> Result<usize, SystemError> {
+    verify_area_writable_locked(vm, dest, src.len())?;
+    return copy_to_user_unchecked(dest, src);
+}
 
-    let p = dest.data() as *mut u8;
+unsafe fn copy_to_user_unchecked(dest: VirtAddr, src: &[u8]) -> Result<usize, SystemError> {
     // 拷贝数据
-    p.copy_from_nonoverlapping(src.as_ptr(), src.len());
+    if copy_user(dest.data() as *mut u8, src.as_ptr(), src.len()) != 0 {
+        return Err(SystemError::EFAULT);
+    }
     return Ok(src.len());
 }
 
 /// 从用户空间拷贝数据到内核空间
+///
+/// ## 返回值
+///
+/// 返回拷贝的数据长度
+///
+/// ## 错误
+///
+/// - `EFAULT`：源地址不合法，或者源地址所在的页不存在
 pub unsafe fn copy_from_user(dst: &mut [u8], src: VirtAddr) -> Result<usize, SystemError> {
     verify_area(src, dst.len()).map_err(|_| SystemError::EFAULT)?;
 
-    let src: &[u8] = core::slice::from_raw_parts(src.data() as *const u8, dst.len());
     // 拷贝数据
-    dst.copy_from_slice(&src);
-
+    if copy_user(dst.as_mut_ptr(), src.data() as *const u8, dst.len()) != 0 {
+        return Err(SystemError::EFAULT);
+    }
     return Ok(dst.len());
 }
 
@@ -191,16 +271,29 @@ impl<'a> UserBufferReader<'a> {
 
     /// 从用户空间拷贝数据(到指定地址中)
     ///
-    /// @param dst 目标地址指针
-    /// @return 拷贝成功的话返回拷贝的元素数量
+    /// @param dst 目标地址指针，拷贝dst.len()个元素
+    /// @param offset 在UserBuffer中的字节偏移量
+    /// @return 拷贝成功的话返回拷贝的元素数量。UserBuffer在offset之后的数据不足时返回EINVAL
     ///
     pub fn copy_from_user<T: core::marker::Copy>(
         &self,
         dst: &mut [T],
         offset: usize,
     ) -> Result<usize, SystemError> {
-        let data = self.convert_with_offset(&self.buffer, offset)?;
-        dst.copy_from_slice(data);
+        let data: &[T] = self.convert_with_offset(&self.buffer, offset)?;
+        if data.len() < dst.len() {
+            return Err(SystemError::EINVAL);
+        }
+        if unsafe {
+            copy_user(
+                dst.as_mut_ptr() as *mut u8,
+                data.as_ptr() as *const u8,
+                core::mem::size_of_val(dst),
+            )
+        } != 0
+        {
+            return Err(SystemError::EFAULT);
+        }
         return Ok(dst.len());
     }
 
@@ -215,7 +308,16 @@ impl<'a> UserBufferReader<'a> {
         offset: usize,
     ) -> Result<(), SystemError> {
         let data = self.convert_one_with_offset::<T>(&self.buffer, offset)?;
-        dst.clone_from(data);
+        if unsafe {
+            copy_user(
+                dst as *mut T as *mut u8,
+                data as *const T as *const u8,
+                size_of::<T>(),
+            )
+        } != 0
+        {
+            return Err(SystemError::EFAULT);
+        }
         return Ok(());
     }
 
@@ -258,8 +360,8 @@ impl<'a> UserBufferWriter<'a> {
     /// @return 构造成功返回UserbufferWriter实例，否则返回错误码
     ///
     pub fn new<U>(addr: *mut U, len: usize, from_user: bool) -> Result<Self, SystemError> {
-        if from_user && verify_area(VirtAddr::new(addr as usize), len).is_err() {
-            return Err(SystemError::EFAULT);
+        if from_user {
+            verify_area_writable(VirtAddr::new(addr as usize), len)?;
         }
         return Ok(Self {
             buffer: unsafe { core::slice::from_raw_parts_mut(addr as *mut u8, len) },
@@ -268,17 +370,29 @@ impl<'a> UserBufferWriter<'a> {
 
     /// 从指定地址写入数据到用户空间
     ///
-    /// @param data 要写入的数据地址
+    /// @param data 要写入的数据地址，长度可以小于UserBuffer在offset之后的剩余空间
     /// @param offset 在UserBuffer中的字节偏移量
-    /// @return 返回写入元素的数量
+    /// @return 返回写入元素的数量。剩余空间放不下data时返回EINVAL
     ///
     pub fn copy_to_user<T: core::marker::Copy>(
-        &'a mut self,
-        src: &'a [T],
+        &mut self,
+        src: &[T],
         offset: usize,
     ) -> Result<usize, SystemError> {
-        let dst = Self::convert_with_offset(self.buffer, offset)?;
-        dst.copy_from_slice(&src);
+        let dst: &mut [T] = Self::convert_with_offset(self.buffer, offset)?;
+        if dst.len() < src.len() {
+            return Err(SystemError::EINVAL);
+        }
+        if unsafe {
+            copy_user(
+                dst.as_mut_ptr() as *mut u8,
+                src.as_ptr() as *const u8,
+                core::mem::size_of_val(src),
+            )
+        } != 0
+        {
+            return Err(SystemError::EFAULT);
+        }
         return Ok(src.len());
     }
 
@@ -289,12 +403,21 @@ impl<'a> UserBufferWriter<'a> {
     /// @return 返回写入元素的数量
     ///
     pub fn copy_one_to_user<T: core::marker::Copy>(
-        &'a mut self,
-        src: &'a T,
+        &mut self,
+        src: &T,
         offset: usize,
     ) -> Result<(), SystemError> {
         let dst = Self::convert_one_with_offset::<T>(self.buffer, offset)?;
-        dst.clone_from(src);
+        if unsafe {
+            copy_user(
+                dst as *mut T as *mut u8,
+                src as *const T as *const u8,
+                size_of::<T>(),
+            )
+        } != 0
+        {
+            return Err(SystemError::EFAULT);
+        }
         return Ok(());
     }
 
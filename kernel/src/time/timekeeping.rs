@@ -6,7 +6,7 @@ use crate::{
     arch::CurrentIrqArch,
     exception::InterruptArch,
     kdebug, kinfo,
-    libs::rwlock::RwLock,
+    libs::{rwlock::RwLock, seqlock::SeqLock},
     time::{jiffies::clocksource_default_clock, timekeep::ktime_get_real_ns, TimeSpec},
 };
 
@@ -26,14 +26,28 @@ pub const NTP_SCALE_SHIFT: u32 = 32;
 pub static TIMEKEEPING_SUSPENDED: AtomicBool = AtomicBool::new(false);
 /// 已经递增的微秒数
 static __ADDED_USEC: AtomicI64 = AtomicI64::new(0);
-/// 已经递增的秒数
-static __ADDED_SEC: AtomicI64 = AtomicI64::new(0);
+/// 墙上时间。getnstimeofday()无锁地读取它，时钟中断更新它
+static WALL_TIME: SeqLock<WallTime> = SeqLock::new(WallTime {
+    xtime: TimeSpec {
+        tv_nsec: 0,
+        tv_sec: 0,
+    },
+    added_sec: 0,
+});
 /// timekeeper全局变量，用于管理timekeeper模块
 static mut __TIMEKEEPER: Option<Timekeeper> = None;
 
 #[derive(Debug)]
 pub struct Timekeeper(RwLock<TimekeeperData>);
 
+#[derive(Debug, Clone, Copy)]
+struct WallTime {
+    /// 上一次与硬件时钟同步时得到的时间
+    xtime: TimeSpec,
+    /// 上一次同步之后已经递增的秒数
+    added_sec: i64,
+}
+
 #[allow(dead_code)]
 #[derive(Debug)]
 pub struct TimekeeperData {
@@ -60,7 +74,6 @@ pub struct TimekeeperData {
     raw_time: TimeSpec,
     wall_to_monotonic: TimeSpec,
     total_sleep_time: TimeSpec,
-    xtime: TimeSpec,
 }
 impl TimekeeperData {
     pub fn new() -> Self {
@@ -75,10 +88,6 @@ impl TimekeeperData {
             ntp_error: Default::default(),
             ntp_error_shift: Default::default(),
             mult: Default::default(),
-            xtime: TimeSpec {
-                tv_nsec: 0,
-                tv_sec: 0,
-            },
             wall_to_monotonic: TimeSpec {
                 tv_nsec: 0,
                 tv_sec: 0,
@@ -157,28 +166,11 @@ pub fn timekeeper_init() {
 ///
 /// * 'TimeSpec' - 时间戳
 pub fn getnstimeofday() -> TimeSpec {
-    // kdebug!("enter getnstimeofday");
-
-    // let mut nsecs: u64 = 0;0
-    let mut _xtime = TimeSpec {
-        tv_nsec: 0,
-        tv_sec: 0,
-    };
-    loop {
-        match timekeeper().0.try_read() {
-            None => continue,
-            Some(tk) => {
-                _xtime = tk.xtime;
-                drop(tk);
-                // nsecs = timekeeper().tk_get_ns();
-                // TODO 不同架构可能需要加上不同的偏移量
-                break;
-            }
-        }
-    }
-    // xtime.tv_nsec += nsecs as i64;
-    let sec = __ADDED_SEC.load(Ordering::SeqCst);
-    _xtime.tv_sec += sec;
+    // 读者不获取任何锁，与时钟中断中的写者冲突时重新读取
+    let wall = WALL_TIME.read();
+    // TODO 不同架构可能需要加上不同的偏移量
+    let mut _xtime = wall.xtime;
+    _xtime.tv_sec += wall.added_sec;
     while _xtime.tv_nsec >= NSEC_PER_SEC.into() {
         _xtime.tv_nsec -= NSEC_PER_SEC as i64;
         _xtime.tv_sec += 1;
@@ -217,11 +209,14 @@ pub fn timekeeping_init() {
     timekeeper().timekeeper_setup_internals(clock);
     // 暂时不支持其他架构平台对时间的设置 所以使用x86平台对应值初始化
     let mut timekeeper = timekeeper().0.write();
-    timekeeper.xtime.tv_nsec = ktime_get_real_ns();
+    let mut wall = WALL_TIME.write();
+    wall.xtime.tv_nsec = ktime_get_real_ns();
+    wall.added_sec = 0;
 
     // 初始化wall time到monotonic的时间
-    let mut nsec = -timekeeper.xtime.tv_nsec;
-    let mut sec = -timekeeper.xtime.tv_sec;
+    let mut nsec = -wall.xtime.tv_nsec;
+    let mut sec = -wall.xtime.tv_sec;
+    drop(wall);
     // FIXME: 这里有个奇怪的奇怪的bug
     let num = nsec % NSEC_PER_SEC as i64;
     nsec += num * NSEC_PER_SEC as i64;
@@ -230,7 +225,6 @@ pub fn timekeeping_init() {
     timekeeper.wall_to_monotonic.tv_sec = sec;
 
     __ADDED_USEC.store(0, Ordering::SeqCst);
-    __ADDED_SEC.store(0, Ordering::SeqCst);
 
     drop(irq_guard);
     kinfo!("timekeeping_init successfully");
@@ -274,10 +268,7 @@ pub fn update_wall_time() {
 
     let usec = __ADDED_USEC.load(Ordering::SeqCst);
     if usec % USEC_PER_SEC as i64 == 0 {
-        compiler_fence(Ordering::SeqCst);
-
-        __ADDED_SEC.fetch_add(1, Ordering::SeqCst);
-        compiler_fence(Ordering::SeqCst);
+        WALL_TIME.write().added_sec += 1;
     }
     loop {
         if (usec & !((1 << 26) - 1)) != 0 {
@@ -286,14 +277,12 @@ pub fn update_wall_time() {
                 .is_ok()
                 || retry == 0
             {
-                // 同步时间
-                // 我感觉这里会出问题：多个读者不退出的话，写者就无法写入
-                // 然后这里会超时，导致在中断返回之后，会不断的进入这个中断，最终爆栈。
-                let mut timekeeper = timekeeper().0.write();
-                timekeeper.xtime.tv_nsec = ktime_get_real_ns();
-                timekeeper.xtime.tv_sec = 0;
-                __ADDED_SEC.store(0, Ordering::SeqCst);
-                drop(timekeeper);
+                // 同步时间。读者不持有锁，因此写者不会被读者阻塞
+                let mut wall = WALL_TIME.write();
+                wall.xtime.tv_nsec = ktime_get_real_ns();
+                wall.xtime.tv_sec = 0;
+                wall.added_sec = 0;
+                drop(wall);
                 break;
             }
             retry -= 1;
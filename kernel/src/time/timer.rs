@@ -20,6 +20,7 @@ use crate::{
     libs::spinlock::SpinLock,
     process::{ProcessControlBlock, ProcessManager},
     syscall::SystemError,
+    trace_event,
 };
 
 use super::timekeeping::update_wall_time;
@@ -82,6 +83,11 @@ impl Timer {
     /// @brief 将定时器插入到定时器链表中
     pub fn activate(&self) {
         let inner_guard = self.0.lock();
+        trace_event!(
+            TP_TIMER_ACTIVATE,
+            inner_guard.expire_jiffies,
+            TIMER_JIFFIES.load(Ordering::Relaxed)
+        );
         let timer_list = &mut TIMER_LIST.lock();
 
         // 链表为空，则直接插入
@@ -110,6 +116,20 @@ impl Timer {
         drop(timer_list);
     }
 
+    /// @brief 将定时器从定时器链表中移除
+    ///
+    /// @return true 定时器尚未触发，已被成功移除
+    /// @return false 定时器已经触发（或从未被激活）
+    pub fn cancel(&self) -> bool {
+        let self_ref = self.0.lock().self_ref.clone();
+        let mut timer_list = TIMER_LIST.lock_irqsave();
+        let removed = timer_list
+            .drain_filter(|x| Weak::as_ptr(&self_ref) == Arc::as_ptr(x))
+            .count();
+        drop(timer_list);
+        return removed > 0;
+    }
+
     #[inline]
     fn run(&self) {
         let r = self.0.lock().timer_func.run();
@@ -0,0 +1,631 @@
+/**
+ * @file main.c
+ * @brief lmbench风格的系统基准测试程序
+ *
+ * 测量系统调用、进程创建、管道与socket通信、上下文切换、内存映射、缺页以及文件读写的开销。
+ *
+ * 用法: bench_sys [测试名称...]
+ *      不带参数时运行全部测试。
+ *
+ * 每个测试输出一行JSON，便于脚本收集与对比不同内核版本的结果，例如:
+ *      {"bench":"null_syscall","value":123,"unit":"ns","iters":100000}
+ * 测试失败或者内核不支持时输出:
+ *      {"bench":"tcp_latency","error":"connect"}
+ */
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define PAGE_SIZE 4096
+#define TCP_PORT 12581
+#define BW_CHUNK (64 * 1024)
+#define BW_TOTAL (16 * 1024 * 1024)
+#define FILE_PATH "/bench_sys.tmp"
+#define FILE_SIZE (8 * 1024 * 1024)
+#define MMAP_SIZE (4 * 1024 * 1024)
+#define CTX_PROCS 4
+
+/// 用于exec测试：以该参数启动时立即退出
+#define EXEC_EXIT_ARG "--exec-exit"
+
+static char bw_buf[BW_CHUNK];
+static const char *self_path = "/bin/bench_sys";
+
+/**
+ * @brief 获取当前时间（微秒）
+ */
+static uint64_t now_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void report_latency(const char *name, uint64_t total_us, uint64_t iters)
+{
+    printf("{\"bench\":\"%s\",\"value\":%lu,\"unit\":\"ns\",\"iters\":%lu}\n", name,
+           (unsigned long)(total_us * 1000 / iters), (unsigned long)iters);
+}
+
+static void report_bandwidth(const char *name, uint64_t total_us, uint64_t bytes)
+{
+    if (total_us == 0)
+        total_us = 1;
+    // 字节/微秒 即 MB/s（以10^6字节为1MB）
+    printf("{\"bench\":\"%s\",\"value\":%lu,\"unit\":\"MB/s\",\"bytes\":%lu}\n", name,
+           (unsigned long)(bytes / total_us), (unsigned long)bytes);
+}
+
+static void report_error(const char *name, const char *what)
+{
+    printf("{\"bench\":\"%s\",\"error\":\"%s\"}\n", name, what);
+}
+
+/**
+ * @brief 测试出错时结束子进程并等待它们退出
+ *
+ * 子进程也持有管道/socket的所有端，父进程关闭自己的端并不能让阻塞在read中的子进程返回，因此直接杀死它们
+ */
+static void kill_children(const pid_t *pids, int n)
+{
+    for (int i = 0; i < n; i++)
+        kill(pids[i], SIGKILL);
+    for (int i = 0; i < n; i++)
+        waitpid(pids[i], NULL, 0);
+}
+
+/**
+ * @brief 完整地读取/写入len字节
+ */
+static int read_full(int fd, void *buf, size_t len)
+{
+    size_t done = 0;
+    while (done < len)
+    {
+        ssize_t r = read(fd, (char *)buf + done, len - done);
+        if (r <= 0)
+            return -1;
+        done += r;
+    }
+    return 0;
+}
+
+static int write_full(int fd, const void *buf, size_t len)
+{
+    size_t done = 0;
+    while (done < len)
+    {
+        ssize_t r = write(fd, (const char *)buf + done, len - done);
+        if (r <= 0)
+            return -1;
+        done += r;
+    }
+    return 0;
+}
+
+/**
+ * @brief 空系统调用（getppid）的开销
+ */
+static void bench_null_syscall(void)
+{
+    const uint64_t iters = 100000;
+    uint64_t start = now_us();
+    for (uint64_t i = 0; i < iters; i++)
+        getppid();
+    report_latency("null_syscall", now_us() - start, iters);
+}
+
+/**
+ * @brief gettimeofday的开销
+ */
+static void bench_gettimeofday(void)
+{
+    const uint64_t iters = 100000;
+    struct timeval tv;
+    uint64_t start = now_us();
+    for (uint64_t i = 0; i < iters; i++)
+        gettimeofday(&tv, NULL);
+    report_latency("gettimeofday", now_us() - start, iters);
+}
+
+/**
+ * @brief fork之后子进程立即退出，父进程等待子进程
+ */
+static void bench_fork_exit(void)
+{
+    const uint64_t iters = 200;
+    uint64_t start = now_us();
+    for (uint64_t i = 0; i < iters; i++)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            report_error("fork_exit", "fork");
+            return;
+        }
+        if (pid == 0)
+            _exit(0);
+        waitpid(pid, NULL, 0);
+    }
+    report_latency("fork_exit", now_us() - start, iters);
+}
+
+/**
+ * @brief fork之后子进程exec本程序（立即退出），父进程等待子进程
+ */
+static void bench_fork_exec_exit(void)
+{
+    const uint64_t iters = 100;
+    uint64_t start = now_us();
+    for (uint64_t i = 0; i < iters; i++)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            report_error("fork_exec_exit", "fork");
+            return;
+        }
+        if (pid == 0)
+        {
+            char *argv[] = {(char *)self_path, EXEC_EXIT_ARG, NULL};
+            execv(self_path, argv);
+            _exit(127);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 127)
+        {
+            report_error("fork_exec_exit", "execv");
+            return;
+        }
+    }
+    report_latency("fork_exec_exit", now_us() - start, iters);
+}
+
+/**
+ * @brief 两个进程通过一对管道来回传递1字节，报告单程的延迟
+ */
+static void bench_pipe_latency(void)
+{
+    const uint64_t iters = 10000;
+    int p2c[2], c2p[2];
+    char c = 0;
+    if (pipe(p2c) < 0 || pipe(c2p) < 0)
+    {
+        report_error("pipe_latency", "pipe");
+        return;
+    }
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        report_error("pipe_latency", "fork");
+        return;
+    }
+    if (pid == 0)
+    {
+        for (uint64_t i = 0; i < iters; i++)
+        {
+            if (read_full(p2c[0], &c, 1) < 0 || write_full(c2p[1], &c, 1) < 0)
+                _exit(1);
+        }
+        _exit(0);
+    }
+    uint64_t start = now_us();
+    for (uint64_t i = 0; i < iters; i++)
+    {
+        if (write_full(p2c[1], &c, 1) < 0 || read_full(c2p[0], &c, 1) < 0)
+        {
+            report_error("pipe_latency", "io");
+            kill_children(&pid, 1);
+            goto out;
+        }
+    }
+    uint64_t elapsed = now_us() - start;
+    waitpid(pid, NULL, 0);
+    report_latency("pipe_latency", elapsed, iters * 2);
+out:
+    close(p2c[0]);
+    close(p2c[1]);
+    close(c2p[0]);
+    close(c2p[1]);
+}
+
+/**
+ * @brief 子进程通过管道向父进程发送BW_TOTAL字节
+ */
+static void bench_pipe_bandwidth(void)
+{
+    int fds[2];
+    if (pipe(fds) < 0)
+    {
+        report_error("pipe_bandwidth", "pipe");
+        return;
+    }
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        report_error("pipe_bandwidth", "fork");
+        return;
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        for (size_t sent = 0; sent < BW_TOTAL; sent += BW_CHUNK)
+        {
+            if (write_full(fds[1], bw_buf, BW_CHUNK) < 0)
+                _exit(1);
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    uint64_t start = now_us();
+    size_t received = 0;
+    while (received < BW_TOTAL)
+    {
+        ssize_t r = read(fds[0], bw_buf, BW_CHUNK);
+        if (r <= 0)
+        {
+            report_error("pipe_bandwidth", "io");
+            kill_children(&pid, 1);
+            close(fds[0]);
+            return;
+        }
+        received += r;
+    }
+    uint64_t elapsed = now_us() - start;
+    waitpid(pid, NULL, 0);
+    close(fds[0]);
+    report_bandwidth("pipe_bandwidth", elapsed, received);
+}
+
+/**
+ * @brief CTX_PROCS个进程组成一个环，通过管道传递令牌，报告每次传递（一次上下文切换加一次管道读写）的开销
+ */
+static void bench_context_switch(void)
+{
+    const uint64_t rounds = 2000;
+    int ring[CTX_PROCS][2];
+    pid_t pids[CTX_PROCS];
+    char c = 0;
+    for (int i = 0; i < CTX_PROCS; i++)
+    {
+        if (pipe(ring[i]) < 0)
+        {
+            report_error("context_switch", "pipe");
+            return;
+        }
+    }
+    // 进程i从ring[i]读，向ring[(i + 1) % CTX_PROCS]写；进程0就是父进程自己
+    for (int i = 1; i < CTX_PROCS; i++)
+    {
+        pids[i] = fork();
+        if (pids[i] < 0)
+        {
+            report_error("context_switch", "fork");
+            kill_children(&pids[1], i - 1);
+            goto out;
+        }
+        if (pids[i] == 0)
+        {
+            for (uint64_t r = 0; r < rounds; r++)
+            {
+                if (read_full(ring[i][0], &c, 1) < 0 || write_full(ring[(i + 1) % CTX_PROCS][1], &c, 1) < 0)
+                    _exit(1);
+            }
+            _exit(0);
+        }
+    }
+    uint64_t start = now_us();
+    for (uint64_t r = 0; r < rounds; r++)
+    {
+        if (write_full(ring[1][1], &c, 1) < 0 || read_full(ring[0][0], &c, 1) < 0)
+        {
+            report_error("context_switch", "io");
+            kill_children(&pids[1], CTX_PROCS - 1);
+            goto out;
+        }
+    }
+    uint64_t elapsed = now_us() - start;
+    for (int i = 1; i < CTX_PROCS; i++)
+        waitpid(pids[i], NULL, 0);
+    report_latency("context_switch", elapsed, rounds * CTX_PROCS);
+out:
+    for (int i = 0; i < CTX_PROCS; i++)
+    {
+        close(ring[i][0]);
+        close(ring[i][1]);
+    }
+}
+
+/**
+ * @brief 建立一对回环TCP连接，返回0表示成功
+ */
+static int tcp_pair(int *server_fd, int *client_fd, int *listen_fd, const char *name)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(TCP_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    *listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (*listen_fd < 0)
+    {
+        report_error(name, "socket");
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(*listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (bind(*listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        report_error(name, "bind");
+        close(*listen_fd);
+        return -1;
+    }
+    if (listen(*listen_fd, 1) < 0)
+    {
+        report_error(name, "listen");
+        close(*listen_fd);
+        return -1;
+    }
+    *client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (*client_fd < 0 || connect(*client_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        report_error(name, "connect");
+        close(*listen_fd);
+        return -1;
+    }
+    *server_fd = accept(*listen_fd, NULL, NULL);
+    if (*server_fd < 0)
+    {
+        report_error(name, "accept");
+        close(*client_fd);
+        close(*listen_fd);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 通过回环TCP连接来回传递1字节，报告单程的延迟
+ */
+static void bench_tcp_latency(void)
+{
+    const uint64_t iters = 2000;
+    int server_fd, client_fd, listen_fd;
+    char c = 0;
+    if (tcp_pair(&server_fd, &client_fd, &listen_fd, "tcp_latency") < 0)
+        return;
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        report_error("tcp_latency", "fork");
+        return;
+    }
+    if (pid == 0)
+    {
+        for (uint64_t i = 0; i < iters; i++)
+        {
+            if (read_full(server_fd, &c, 1) < 0 || write_full(server_fd, &c, 1) < 0)
+                _exit(1);
+        }
+        _exit(0);
+    }
+    uint64_t start = now_us();
+    for (uint64_t i = 0; i < iters; i++)
+    {
+        if (write_full(client_fd, &c, 1) < 0 || read_full(client_fd, &c, 1) < 0)
+        {
+            report_error("tcp_latency", "io");
+            kill_children(&pid, 1);
+            goto out;
+        }
+    }
+    uint64_t elapsed = now_us() - start;
+    waitpid(pid, NULL, 0);
+    report_latency("tcp_latency", elapsed, iters * 2);
+out:
+    close(server_fd);
+    close(client_fd);
+    close(listen_fd);
+}
+
+/**
+ * @brief 子进程通过回环TCP连接向父进程发送BW_TOTAL字节
+ */
+static void bench_tcp_bandwidth(void)
+{
+    int server_fd, client_fd, listen_fd;
+    if (tcp_pair(&server_fd, &client_fd, &listen_fd, "tcp_bandwidth") < 0)
+        return;
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        report_error("tcp_bandwidth", "fork");
+        return;
+    }
+    if (pid == 0)
+    {
+        for (size_t sent = 0; sent < BW_TOTAL; sent += BW_CHUNK)
+        {
+            if (write_full(client_fd, bw_buf, BW_CHUNK) < 0)
+                _exit(1);
+        }
+        _exit(0);
+    }
+    uint64_t start = now_us();
+    size_t received = 0;
+    while (received < BW_TOTAL)
+    {
+        ssize_t r = read(server_fd, bw_buf, BW_CHUNK);
+        if (r <= 0)
+        {
+            report_error("tcp_bandwidth", "io");
+            kill_children(&pid, 1);
+            goto out;
+        }
+        received += r;
+    }
+    uint64_t elapsed = now_us() - start;
+    waitpid(pid, NULL, 0);
+    report_bandwidth("tcp_bandwidth", elapsed, received);
+out:
+    close(server_fd);
+    close(client_fd);
+    close(listen_fd);
+}
+
+/**
+ * @brief 映射并解除映射MMAP_SIZE字节的匿名内存
+ */
+static void bench_mmap(void)
+{
+    const uint64_t iters = 1000;
+    uint64_t start = now_us();
+    for (uint64_t i = 0; i < iters; i++)
+    {
+        void *p = mmap(NULL, MMAP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+        {
+            report_error("mmap_munmap", "mmap");
+            return;
+        }
+        munmap(p, MMAP_SIZE);
+    }
+    report_latency("mmap_munmap", now_us() - start, iters);
+}
+
+/**
+ * @brief 访问新映射的匿名内存的每一页，报告每次缺页的开销
+ */
+static void bench_page_fault(void)
+{
+    const uint64_t rounds = 16;
+    const uint64_t pages = MMAP_SIZE / PAGE_SIZE;
+    uint64_t total = 0;
+    for (uint64_t r = 0; r < rounds; r++)
+    {
+        volatile char *p = mmap(NULL, MMAP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+        {
+            report_error("page_fault", "mmap");
+            return;
+        }
+        uint64_t start = now_us();
+        for (uint64_t i = 0; i < pages; i++)
+            p[i * PAGE_SIZE] = 1;
+        total += now_us() - start;
+        munmap((void *)p, MMAP_SIZE);
+    }
+    report_latency("page_fault", total, rounds * pages);
+}
+
+/**
+ * @brief 顺序读取整个文件，返回读到的字节数
+ */
+static size_t read_file(void)
+{
+    int fd = open(FILE_PATH, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    size_t total = 0;
+    ssize_t r;
+    while ((r = read(fd, bw_buf, BW_CHUNK)) > 0)
+        total += r;
+    close(fd);
+    return total;
+}
+
+/**
+ * @brief 文件顺序写入和顺序读取的吞吐量
+ *
+ * 页缓存只服务于mmap映射的文件，read()总是经过文件系统读取数据，因此只统计一个file_read指标
+ */
+static void bench_file_io(void)
+{
+    int fd = open(FILE_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        report_error("file_write", "open");
+        return;
+    }
+    memset(bw_buf, 'a', BW_CHUNK);
+    uint64_t start = now_us();
+    for (size_t written = 0; written < FILE_SIZE; written += BW_CHUNK)
+    {
+        if (write_full(fd, bw_buf, BW_CHUNK) < 0)
+        {
+            report_error("file_write", "write");
+            close(fd);
+            unlink(FILE_PATH);
+            return;
+        }
+    }
+    close(fd);
+    report_bandwidth("file_write", now_us() - start, FILE_SIZE);
+
+    start = now_us();
+    size_t got = read_file();
+    uint64_t elapsed = now_us() - start;
+    if (got != FILE_SIZE)
+        report_error("file_read", "read");
+    else
+        report_bandwidth("file_read", elapsed, got);
+
+    unlink(FILE_PATH);
+}
+
+struct bench
+{
+    const char *name;
+    void (*func)(void);
+};
+
+static const struct bench benches[] = {
+    {"null_syscall", bench_null_syscall},
+    {"gettimeofday", bench_gettimeofday},
+    {"fork_exit", bench_fork_exit},
+    {"fork_exec_exit", bench_fork_exec_exit},
+    {"pipe_latency", bench_pipe_latency},
+    {"pipe_bandwidth", bench_pipe_bandwidth},
+    {"context_switch", bench_context_switch},
+    {"tcp_latency", bench_tcp_latency},
+    {"tcp_bandwidth", bench_tcp_bandwidth},
+    {"mmap_munmap", bench_mmap},
+    {"page_fault", bench_page_fault},
+    {"file_io", bench_file_io},
+};
+
+#define NR_BENCHES (sizeof(benches) / sizeof(benches[0]))
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 2 && strcmp(argv[1], EXEC_EXIT_ARG) == 0)
+        return 0;
+    if (argc >= 1 && argv[0][0] == '/')
+        self_path = argv[0];
+
+    // 让输出及时写出，避免fork时缓冲区中的内容被子进程重复输出
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    for (size_t i = 0; i < NR_BENCHES; i++)
+    {
+        int selected = (argc < 2);
+        for (int j = 1; j < argc && !selected; j++)
+            selected = (strcmp(argv[j], benches[i].name) == 0);
+        if (selected)
+            benches[i].func();
+    }
+    return 0;
+}
@@ -496,27 +496,27 @@ int shell_cmd_rm(int argc, char **argv)
  */
 int shell_cmd_exec(int argc, char **argv)
 {
-    pid_t pid = fork();
+    // 在vfork之前准备好路径，子进程借用的是shell的地址空间，不能在其中分配或释放内存
+    int path_len = 0;
+    char *file_path = get_target_filepath(argv[1], &path_len);
     int retval = 0;
+
+    // 使用vfork，避免拷贝整个地址空间之后又立即被execv丢弃
+    pid_t pid = vfork();
     // printf("  pid=%d  \n",pid);
 
     if (pid == 0)
     {
-
         // 子进程
-        int path_len = 0;
-        char *file_path = get_target_filepath(argv[1], &path_len);
         // printf("before execv, path=%s, argc=%d\n", file_path, argc);
-
         execv(file_path, argv);
         // printf("after execv, path=%s, argc=%d\n", file_path, argc);
-        free(argv);
-        free(file_path);
-
-        exit(-1);
+        _exit(-1);
     }
     else
     {
+        // 到这里时，子进程已经执行了execv或者已经退出
+        free(file_path);
         // 如果不指定后台运行,则等待退出
         if (strcmp(argv[argc - 1], "&") != 0)
             waitpid(pid, &retval, 0);
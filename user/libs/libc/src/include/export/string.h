@@ -1,12 +1,36 @@
 #pragma once
 
 #include <sys/types.h>
+#include <stddef.h>
 
 #if defined(__cplusplus) 
 extern  "C"  { 
 #endif
 
 void *memset(void *dst, unsigned char C, uint64_t size);
+
+/**
+ * @brief 在内存区域的前n个字节中查找字节c
+ *
+ * @return void* 第一个等于c的字节的地址，没有找到时返回NULL
+ */
+void *memchr(const void *s, int c, size_t n);
+
+/**
+ * @brief 比较两块内存
+ *
+ * @return int 相等时返回0，否则返回第一个不同的字节之差
+ */
+int memcmp(const void *s1, const void *s2, size_t n);
+
+/**
+ * @brief memcpy使用rep movsb的最小长度，由libc初始化时根据cpu是否支持ERMS/FSRM/FZLRM设置
+ */
+extern uint64_t __libc_memcpy_movsb_threshold;
+/**
+ * @brief memset使用rep stosb的最小长度，由libc初始化时根据cpu是否支持ERMS/FSRS设置
+ */
+extern uint64_t __libc_memset_stosb_threshold;
 /**
  * @brief 获取字符串的大小
  *
@@ -63,6 +87,16 @@ char *strcat(char *dest, const char *src);
 static void *memcpy(void *dst, const void *src, long Num)
 {
     int d0 = 0, d1 = 0, d2 = 0;
+    if ((uint64_t)Num >= __libc_memcpy_movsb_threshold)
+    {
+        __asm__ __volatile__("cld	\n\t"
+                             "rep	\n\t"
+                             "movsb	\n\t"
+                             : "=&c"(d0), "=&D"(d1), "=&S"(d2)
+                             : "0"(Num), "1"(dst), "2"(src)
+                             : "memory");
+        return dst;
+    }
     __asm__ __volatile__("cld	\n\t"
                          "rep	\n\t"
                          "movsq	\n\t"
@@ -52,12 +52,21 @@ off_t lseek(int fd, off_t offset, int whence);
 pid_t fork(void);
 
 /**
- * @brief fork当前进程，但是与父进程共享VM、flags、fd
+ * @brief fork当前进程，但是子进程直接使用父进程的地址空间。父进程会被挂起，直到子进程调用execve或者退出
+ *
+ * 在调用execve或者_exit之前，子进程不能从调用vfork的函数返回，也不能修改除了保存返回值的变量以外的任何数据。
  *
  * @return pid_t
  */
 pid_t vfork(void);
 
+/**
+ * @brief 立即退出当前进程，不执行任何清理工作（vfork的子进程应当使用它来退出）
+ *
+ * @param status 退出码
+ */
+void _exit(int status);
+
 /**
  * @brief 将堆内存调整为end_brk
  *
@@ -5,8 +5,13 @@ FILE *stdin;
 FILE *stdout;
 FILE *stderr;
 
+extern void __libc_string_init();
+
 void _libc_init()
 {
+    // 根据cpu的特性选择memcpy/memset的实现
+    __libc_string_init();
+
     // 初始化标准流对应的文件描述符
     stdin = malloc(sizeof(FILE));
     stdout = malloc(sizeof(FILE));
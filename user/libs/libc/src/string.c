@@ -1,13 +1,131 @@
 #include <string.h>
 
+/**
+ * x86_64的cpu都支持SSE2，因此strlen、memchr、memcmp直接使用SSE2每次处理16字节，不需要按cpu特性选择。
+ * 内核只用fxsave保存用户的浮点状态（不保存ymm寄存器的高128位），所以这里不使用AVX2。
+ */
+typedef char __v16qi_t __attribute__((vector_size(16), __may_alias__));
+typedef char __v16qi_u __attribute__((vector_size(16), __may_alias__, aligned(1)));
+
+// 在_libc_init()之前，memcpy/memset总是使用rep movsq/stosq
+uint64_t __libc_memcpy_movsb_threshold = UINT64_MAX;
+uint64_t __libc_memset_stosb_threshold = UINT64_MAX;
+
+// 支持ERMS时，使用rep movsb/stosb的最小长度
+#define LIBC_ERMS_THRESHOLD 256
+
+/**
+ * @brief 根据cpu的特性选择memcpy/memset的实现
+ *
+ * FSRM只说明短的rep movsb很快，rep stosb是否同样如此由FSRS单独说明，因此memcpy与memset分别设置阈值
+ */
+void __libc_string_init()
+{
+    uint32_t eax, ebx, ecx, edx;
+    __asm__ __volatile__("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(0), "c"(0));
+    if (eax < 7)
+        return;
+    __asm__ __volatile__("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(7), "c"(0));
+    uint32_t max_subleaf = eax;
+    // CPUID.(EAX=07H,ECX=0):EBX[bit 9] ERMS
+    if (ebx & (1 << 9))
+    {
+        __libc_memcpy_movsb_threshold = LIBC_ERMS_THRESHOLD;
+        __libc_memset_stosb_threshold = LIBC_ERMS_THRESHOLD;
+    }
+    // CPUID.(EAX=07H,ECX=0):EDX[bit 4] FSRM：短的rep movsb同样很快
+    // 长度为0时仍有启动开销，除非同时支持FZLRM
+    int fsrm = (edx & (1 << 4)) != 0;
+    if (fsrm)
+        __libc_memcpy_movsb_threshold = 1;
+
+    if (max_subleaf < 1)
+        return;
+    __asm__ __volatile__("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(7), "c"(1));
+    // CPUID.(EAX=07H,ECX=1):EAX[bit 10] FZLRM：长度为0的rep movsb很快
+    if (fsrm && (eax & (1 << 10)))
+        __libc_memcpy_movsb_threshold = 0;
+    // CPUID.(EAX=07H,ECX=1):EAX[bit 11] FSRS：短的rep stosb很快
+    if (eax & (1 << 11))
+        __libc_memset_stosb_threshold = 0;
+}
+
+/**
+ * @brief 加载一个16字节对齐的块，返回其中等于c的字节的位图
+ */
+static inline uint32_t __match16(const void *p, char c)
+{
+    __v16qi_t v = *(const __v16qi_t *)p;
+    __v16qi_t target = {c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, c};
+    return (uint32_t)__builtin_ia32_pmovmskb128((__v16qi_t)(v == target));
+}
+
 size_t strlen(const char *s)
 {
-    register int __res = 0;
-    while (s[__res] != '\0')
+    // 按16字节对齐向下取整后读取，对齐的块不会跨页，因此不会越界访问到不存在的页
+    uintptr_t off = (uintptr_t)s & 15;
+    const char *p = s - off;
+    uint32_t mask = __match16(p, 0) >> off;
+    if (mask)
+        return __builtin_ctz(mask);
+    for (;;)
     {
-        ++__res;
+        p += 16;
+        mask = __match16(p, 0);
+        if (mask)
+            return (size_t)(p - s) + __builtin_ctz(mask);
     }
-    return __res;
+}
+
+void *memchr(const void *s, int c, size_t n)
+{
+    const unsigned char *p = (const unsigned char *)s;
+    if (n == 0)
+        return NULL;
+    // 与strlen相同，按对齐的块读取，第一个块中位于s之前的字节被屏蔽
+    uintptr_t off = (uintptr_t)p & 15;
+    const unsigned char *block = p - off;
+    uint32_t mask = __match16(block, (char)c) & (0xffffU << off);
+    for (;;)
+    {
+        if (mask)
+        {
+            const unsigned char *r = block + __builtin_ctz(mask);
+            return r < p + n ? (void *)r : NULL;
+        }
+        block += 16;
+        if (block >= p + n)
+            return NULL;
+        mask = __match16(block, (char)c);
+    }
+}
+
+int memcmp(const void *s1, const void *s2, size_t n)
+{
+    const unsigned char *p1 = (const unsigned char *)s1;
+    const unsigned char *p2 = (const unsigned char *)s2;
+    while (n >= 16)
+    {
+        __v16qi_t a = *(const __v16qi_u *)p1;
+        __v16qi_t b = *(const __v16qi_u *)p2;
+        uint32_t mask = (uint32_t)__builtin_ia32_pmovmskb128((__v16qi_t)(a == b));
+        if (mask != 0xffff)
+        {
+            int idx = __builtin_ctz(~mask);
+            return (int)p1[idx] - (int)p2[idx];
+        }
+        p1 += 16;
+        p2 += 16;
+        n -= 16;
+    }
+    while (n--)
+    {
+        if (*p1 != *p2)
+            return (int)*p1 - (int)*p2;
+        ++p1;
+        ++p2;
+    }
+    return 0;
 }
 
 int strcmp(const char *FirstPart, const char *SecondPart)
@@ -38,6 +156,16 @@ void *memset(void *dst, unsigned char C, uint64_t size)
 
     int d0, d1;
     unsigned long tmp = C * 0x0101010101010101UL;
+    if (size >= __libc_memset_stosb_threshold)
+    {
+        __asm__ __volatile__("cld	\n\t"
+                             "rep	\n\t"
+                             "stosb	\n\t"
+                             : "=&c"(d0), "=&D"(d1)
+                             : "a"(tmp), "0"(size), "1"(dst)
+                             : "memory");
+        return dst;
+    }
     __asm__ __volatile__("cld	\n\t"
                          "rep	\n\t"
                          "stosq	\n\t"
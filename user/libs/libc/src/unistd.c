@@ -84,13 +84,35 @@ int pipe2(int fd[2], int flags)
     return (int)syscall_invoke(SYS_PIPE, fd, flags, 0, 0, 0, 0, 0, 0);
 }
 /**
- * @brief fork当前进程，但是与父进程共享VM、flags、fd
+ * @brief fork当前进程，但是子进程直接使用父进程的地址空间。父进程会被挂起，直到子进程调用execve或者退出
+ *
+ * 子进程与父进程共用同一个栈，如果vfork是一个普通的C函数，子进程从它返回之后调用的函数会覆盖掉
+ * 栈上vfork的返回地址，导致父进程被唤醒后无法正确返回。因此在系统调用之前，先把返回地址从栈上弹出到rdx中
+ * （系统调用会保存并恢复rdx），返回前再压回栈上。
  *
  * @return pid_t
  */
-pid_t vfork(void)
+#define __VFORK_STR(x) #x
+#define __VFORK_XSTR(x) __VFORK_STR(x)
+__asm__(".global vfork      \n\t"
+        ".type vfork, @function \n\t"
+        "vfork:             \n\t"
+        "popq %rdx          \n\t"
+        "movq $" __VFORK_XSTR(SYS_VFORK) ", %rax \n\t"
+        "int $0x80          \n\t"
+        "pushq %rdx         \n\t"
+        "retq               \n\t");
+
+/**
+ * @brief 立即退出当前进程，不执行任何清理工作（vfork的子进程应当使用它来退出）
+ *
+ * @param status 退出码
+ */
+void _exit(int status)
 {
-    return (pid_t)syscall_invoke(SYS_VFORK, 0, 0, 0, 0, 0, 0, 0, 0);
+    syscall_invoke(SYS_EXIT, status, 0, 0, 0, 0, 0, 0, 0);
+    while (1)
+        ;
 }
 
 /**
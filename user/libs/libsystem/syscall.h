@@ -48,6 +48,10 @@
 #define SYS_ACCEPT 40     // 接受一个socket连接
 #define SYS_GETSOCKNAME 41 // 获取socket的名字
 #define SYS_GETPEERNAME 42 // 获取socket的对端名字
+#define SYS_FUTEX 53       // 快速用户态互斥锁
+#define SYS_CLONE 54       // 创建子进程或线程
+#define SYS_GETTID 55      // 获取当前线程的tid
+#define SYS_EXIT_GROUP 56  // 退出线程组中的所有线程
 
 /**
  * @brief 用户态系统调用函数